@@ -20,7 +20,11 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "mfx_samples_config.h"
 
 #include "pipeline_decode.h"
+#include "decode_host.h"
 #include <sstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 #include "version.h"
 #include "ConfigFile.h"
 
@@ -202,6 +206,33 @@ mfxStatus ParseInputString(sInputParams* pParams)
 		//swprintf(pParams->strDstFile, MSDK_MAX_FILENAME_LEN, L"%hs", ".\\enc.yuv");
 	}
 
+    pParams->bPushMode = (0 != config.Read<int>("PushMode", 0));
+    pParams->bRingBuffer = (0 != config.Read<int>("RingBuffer", 0));
+    pParams->bSysMemArena = (0 != config.Read<int>("SysMemArena", 0));
+    pParams->nNumaNode = config.Read<mfxI32>("NumaNode", MSDK_NUMA_NODE_ANY);
+
+    // Thread<Role>Cpus, Thread<Role>Policy and Thread<Role>Priority, see msdk_thread_read_role_policies
+    sts = msdk_thread_read_role_policies([&config](const std::string &key, std::string &value)
+    {
+        if (!config.KeyExists(key))
+            return false;
+        value = config.Read<std::string>(key, "");
+        return true;
+    });
+    MSDK_CHECK_STATUS(sts, "msdk_thread_read_role_policies failed");
+    // threads of the task pool, one per CPU by default
+    MSDKTaskPool::SetDefaultWorkerCount(config.Read<mfxU32>("PoolWorkers", 0));
+
+    pParams->bKeyFramesOnly = (0 != config.Read<int>("KeyFramesOnly", 0));
+    pParams->nStartFrame = config.Read<mfxU32>("StartFrame", 0);
+    pParams->bTransportStream = (0 != config.Read<int>("TransportStream", 0));
+    pParams->nTsPid = (mfxU16)config.Read<mfxU32>("TsPid", 0);
+    pParams->nChannels = config.Read<mfxU32>("Channels", 0);
+    pParams->nWorkers = config.Read<mfxU32>("Workers", 0);
+    // frames for the largest stream, resolution changes below it keep the allocation
+    pParams->nMaxWidth = (mfxU16)config.Read<mfxU32>("MaxWidth", 0);
+    pParams->nMaxHeight = (mfxU16)config.Read<mfxU32>("MaxHeight", 0);
+
     if (0 == msdk_strlen(pParams->strSrcFile))
     {
         msdk_printf(MSDK_STRING("error: source file name not found"));
@@ -234,6 +265,112 @@ mfxStatus ParseInputString(sInputParams* pParams)
     return MFX_ERR_NONE;
 }
 
+// feeds the source file to the decoder in push mode, the way a network receiver would
+class CPushFeeder
+{
+public:
+    CPushFeeder(CDecodingPipeline& pipeline)
+        : m_pipeline(pipeline)
+        , m_bStop(false)
+    {
+    }
+
+    ~CPushFeeder()
+    {
+        Stop();
+    }
+
+    mfxStatus Start(const msdk_char *strFileName)
+    {
+        FILE *fSource = NULL;
+        MSDK_FOPEN(fSource, strFileName, MSDK_STRING("rb"));
+        MSDK_CHECK_POINTER(fSource, MFX_ERR_NULL_PTR);
+
+        m_thread = std::thread([this, fSource]()
+        {
+            msdk_thread_apply_role(MSDK_THREAD_ROLE_FEEDER);
+
+            std::vector<mfxU8> chunk(64 * 1024);
+            mfxStatus sts = MFX_ERR_NONE;
+
+            while (!m_bStop && MFX_ERR_NONE == sts)
+            {
+                mfxU32 nRead = (mfxU32)fread(chunk.data(), 1, chunk.size(), fSource);
+                if (!nRead)
+                    break;
+                sts = m_pipeline.SubmitPacket(chunk.data(), nRead, 0, MSDK_PACKET_FLAG_NONE);
+            }
+            fclose(fSource);
+
+            if (MFX_ERR_NONE == sts)
+                m_pipeline.SubmitPacket(NULL, 0, 0, MSDK_PACKET_FLAG_END_OF_STREAM);
+        });
+
+        return MFX_ERR_NONE;
+    }
+
+    void Stop()
+    {
+        m_bStop = true;
+        m_pipeline.StopPushMode();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+private:
+    CDecodingPipeline& m_pipeline;
+    std::thread        m_thread;
+    std::atomic<bool>  m_bStop;
+
+    DISALLOW_COPY_AND_ASSIGN(CPushFeeder);
+};
+
+// decodes nChannels copies of the source on a shared pool of worker threads
+int RunDecodingHost(sInputParams *pParams)
+{
+    // all channels read the same file, dumping them would only overwrite the output
+    pParams->mode = MODE_PERFORMANCE;
+
+    // without a worker count the channels share the process task pool
+    mfxU32 nWorkers = pParams->nWorkers;
+
+    CDecodingHost Host;
+    mfxStatus sts = Host.Init(nWorkers);
+    MSDK_CHECK_STATUS(sts, "Host.Init failed");
+
+    // declared after Host to be stopped before the pipelines are destroyed
+    std::vector<std::unique_ptr<CPushFeeder> > Feeders;
+
+    for (mfxU32 i = 0; i < pParams->nChannels; ++i)
+    {
+        mfxU32 nChannelId = 0;
+        sts = Host.AddChannel(pParams, &nChannelId);
+        MSDK_CHECK_STATUS(sts, "Host.AddChannel failed");
+        if (pParams->bPushMode)
+        {
+            // every channel gets its own feeder, StartChannel reads the header from its packets
+            Feeders.push_back(std::unique_ptr<CPushFeeder>(new CPushFeeder(*Host.GetPipeline(nChannelId))));
+            sts = Feeders.back()->Start(pParams->strSrcFile);
+            MSDK_CHECK_STATUS(sts, "Feeder.Start failed");
+        }
+        sts = Host.StartChannel(nChannelId);
+        MSDK_CHECK_STATUS(sts, "Host.StartChannel failed");
+    }
+
+    msdk_printf(MSDK_STRING("Decoding started: %d channels on %d workers\n"), pParams->nChannels,
+        nWorkers ? nWorkers : MSDKTaskPool::GetInstance().GetWorkerCount());
+
+    while (!Host.WaitAll(1000))
+    {
+        Host.PrintStatistics();
+    }
+
+    msdk_printf(MSDK_STRING("\nDecoding finished\n"));
+    Host.PrintStatistics();
+
+    return 0;
+}
+
 #if defined(_WIN32) || defined(_WIN64)
 int _tmain(int argc, TCHAR *argv[])
 #else
@@ -256,9 +393,22 @@ int main(int argc, char *argv[])
 	printf("[debug][main]--------------------src[wchar_t]=%ls\r\n", Params.strSrcFile);
 	printf("[debug][main]--------------------dst[wchar_t]=%ls\r\n", Params.strDstFile);
 
+    if (Params.nChannels)
+        return RunDecodingHost(&Params);
+
     if (Params.bIsMVC)
         Pipeline.SetMultiView();
 
+    // declared after Pipeline to be stopped before it is destroyed
+    CPushFeeder Feeder(Pipeline);
+    if (Params.bPushMode)
+    {
+        sts = Pipeline.SetPushMode(16, 1024 * 1024);
+        MSDK_CHECK_STATUS(sts, "Pipeline.SetPushMode failed");
+        sts = Feeder.Start(Params.strSrcFile);
+        MSDK_CHECK_STATUS(sts, "Feeder.Start failed");
+    }
+
     sts = Pipeline.Init(&Params);
     MSDK_CHECK_STATUS(sts, "Pipeline.Init failed");
 
@@ -23,6 +23,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "pipeline_encode.h"
 #include "pipeline_user.h"
 #include "pipeline_region_encode.h"
+#include "vm/task_pool_defs.h"
 #include <stdarg.h>
 #include <string>
 #include "version.h"
@@ -322,14 +323,167 @@ mfxStatus ParseInputString(sInputParams* pParams)
 		//pParams->dstFileBuff.push_back(ws);
 		//printf("[debug][CSmplBitstreamWriter::Init]--------------------size=%d **** dstFileBuff[wchar_t]=%ls\r\n", pParams->dstFileBuff.size(), pParams->dstFileBuff[0]);
 	}
+
+	// output container: empty for raw elementary stream, "ts" or "mp4" (fragmented)
+	std::string muxFormat = config.Read<std::string>("MuxFormat", "");
+	if (muxFormat == "ts")
+	{
+		pParams->MuxFormat = MUX_FORMAT_TS;
+	}
+	else if (muxFormat == "mp4")
+	{
+		pParams->MuxFormat = MUX_FORMAT_FMP4;
+	}
+	else if (!muxFormat.empty())
+	{
+		msdk_printf(MSDK_STRING("[DEBUG]Unknown MuxFormat %hs\n"), muxFormat.c_str());
+		return MFX_ERR_UNSUPPORTED;
+	}
+
+	// frames from another process: name of the shared memory ring it created
+	if (!config.Read<std::string>("ShmRing", "").empty())
+	{
+		memset(ws, 0x0, sizeof(wchar_t) * 256);
+		swprintf(ws, 256, L"%hs", config.Read<std::string>("ShmRing", "").c_str());
+		msdk_strncopy_s(pParams->ShmRingName, MSDK_MAX_FILENAME_LEN, ws, MSDK_MAX_FILENAME_LEN - 1);
+	}
+
+	// encoded frames to another process: name of the shared memory ring to create and its size in bytes
+	if (!config.Read<std::string>("ShmEgress", "").empty())
+	{
+		memset(ws, 0x0, sizeof(wchar_t) * 256);
+		swprintf(ws, 256, L"%hs", config.Read<std::string>("ShmEgress", "").c_str());
+		msdk_strncopy_s(pParams->ShmEgressName, MSDK_MAX_FILENAME_LEN, ws, MSDK_MAX_FILENAME_LEN - 1);
+	}
+	int shmEgressSize = config.Read<int>("ShmEgressSize", 0);
+	pParams->nShmEgressSize = (shmEgressSize > 0) ? shmEgressSize : 0;
+
+	// system memory frames from huge page slabs, kept across resets
+	pParams->bSysMemArena = (0 != config.Read<int>("SysMemArena", 0));
+
+	// NUMA node the frames and pipeline threads are kept on, -1 leaves placement to the OS
+	pParams->nNumaNode = config.Read<mfxI32>("NumaNode", MSDK_NUMA_NODE_ANY);
+
+	// Thread<Role>Cpus, Thread<Role>Policy and Thread<Role>Priority, see msdk_thread_read_role_policies
+	sts = msdk_thread_read_role_policies([&config](const std::string &key, std::string &value)
+	{
+	    if (!config.KeyExists(key))
+	        return false;
+	    value = config.Read<std::string>(key, "");
+	    return true;
+	});
+	MSDK_CHECK_STATUS(sts, "msdk_thread_read_role_policies failed");
+	// threads of the task pool, one per CPU by default
+	MSDKTaskPool::SetDefaultWorkerCount(config.Read<mfxU32>("PoolWorkers", 0));
+
+	// segmented output: a new file every SegmentFrames frames or SegmentSeconds seconds
+	int segmentFrames = config.Read<int>("SegmentFrames", 0);
+	pParams->nSegmentFrames = (segmentFrames > 0) ? segmentFrames : 0;
+	pParams->dSegmentSeconds = config.Read<double>("SegmentSeconds", 0);
+
+	// CPU analysis of the next LookAhead frames: QP hints to the sample BRC, and IDR frames at scene cuts with SceneCutIDR
+	pParams->nCpuLookAhead = config.Read<mfxU16>("LookAhead", 0);
+	pParams->bSceneCutIDR = config.Read<bool>("SceneCutIDR", false);
+
+	// input frames identical to the previous one: encode, skip (dummy frames) or drop (gaps in the time stamps of ts/mp4
+	// output), with at most MaxStaticFrames of them in a row
+	std::string staticFrames = config.Read<std::string>("StaticFrames", "");
+	if (staticFrames == "skip")
+		pParams->StaticFrameMode = STATIC_FRAME_SKIP;
+	else if (staticFrames == "drop")
+		pParams->StaticFrameMode = STATIC_FRAME_DROP;
+	else if (staticFrames == "encode" || staticFrames.empty())
+		pParams->StaticFrameMode = STATIC_FRAME_ENCODE;
+	else
+	{
+		msdk_printf(MSDK_STRING("[DEBUG]Unknown StaticFrames %hs\n"), staticFrames.c_str());
+		return MFX_ERR_UNSUPPORTED;
+	}
+	pParams->nMaxStaticFrames = config.Read<mfxU16>("MaxStaticFrames", 0);
+
+	// per-frame controls sent with frame_desc_t::pCtrl: FrameCtrl for ROI, reference hints and frame type,
+	// MBQP for block QP maps (constant QP only)
+	pParams->bFrameCtrl = config.Read<bool>("FrameCtrl", false);
+	pParams->bEnableMBQP = config.Read<bool>("MBQP", false);
+
+	// rate control limits, 0 leaves them to the library
+	pParams->MaxKbps = config.Read<mfxU16>("MaxBitrate", 0);
+	pParams->BufferSizeInKB = config.Read<mfxU16>("BufferSizeKB", 0);
+	pParams->InitialDelayInKB = config.Read<mfxU16>("InitialDelayKB", 0);
+	pParams->nMaxFrameSize = config.Read<mfxU32>("MaxFrameSize", 0);
+	pParams->WinBRCSize = config.Read<mfxU16>("WinBRCSize", 0);
+	pParams->WinBRCMaxAvgKbps = config.Read<mfxU16>("WinBRCMaxAvgKbps", 0);
+
+	// encoding changed while running, before input frame ReconfigFrame: bit rates, GOP and frame rate, 0 keeps a value
+	pParams->nReconfigFrame = config.Read<mfxU32>("ReconfigFrame", 0);
+	pParams->Reconfig.nBitRate = config.Read<mfxU32>("ReconfigBitrate", 0);
+	pParams->Reconfig.nMaxKbps = config.Read<mfxU32>("ReconfigMaxBitrate", 0);
+	pParams->Reconfig.nGopPicSize = config.Read<mfxU16>("ReconfigGopPicSize", 0);
+	pParams->Reconfig.nGopRefDist = config.Read<mfxU16>("ReconfigGopRefDist", 0);
+	pParams->Reconfig.dFrameRate = config.Read<double>("ReconfigFrameRate", 0);
+
+	// BRC of the sample instead of the one of the library: on, off or implicit
+	std::string extBRC = config.Read<std::string>("ExtBRC", "");
+	if (extBRC == "on")
+		pParams->nExtBRC = EXTBRC_ON;
+	else if (extBRC == "off")
+		pParams->nExtBRC = EXTBRC_OFF;
+	else if (extBRC == "implicit")
+		pParams->nExtBRC = EXTBRC_IMPLICIT;
+	else if (!extBRC.empty())
+	{
+		msdk_printf(MSDK_STRING("[DEBUG]Unknown ExtBRC %hs\n"), extBRC.c_str());
+		return MFX_ERR_UNSUPPORTED;
+	}
+
+	// per-frame rounding offsets, QP changes and frame types by input frame order, see frame_ctrl_table.h
+	if (!config.Read<std::string>("FrameCtrlTable", "").empty())
+	{
+		memset(ws, 0x0, sizeof(wchar_t) * 256);
+		swprintf(ws, 256, L"%hs", config.Read<std::string>("FrameCtrlTable", "").c_str());
+		msdk_strncopy_s(pParams->FrameCtrlTableFile, MSDK_MAX_FILENAME_LEN, ws, MSDK_MAX_FILENAME_LEN - 1);
+	}
+
+	// frame by frame record of the sample BRC, for BRCReplay
+	if (!config.Read<std::string>("BRCTrace", "").empty())
+	{
+		memset(ws, 0x0, sizeof(wchar_t) * 256);
+		swprintf(ws, 256, L"%hs", config.Read<std::string>("BRCTrace", "").c_str());
+		msdk_strncopy_s(pParams->BRCTraceFile, MSDK_MAX_FILENAME_LEN, ws, MSDK_MAX_FILENAME_LEN - 1);
+		if (pParams->nExtBRC != EXTBRC_ON)
+		{
+			msdk_printf(MSDK_STRING("BRCTrace records the sample BRC, ExtBRC is switched on\n"));
+			pParams->nExtBRC = EXTBRC_ON;
+		}
+	}
+
+	// no encoding: the rate control above is replayed on a BRC trace, the curves go to BRCReplayCurves as CSV
+	if (!config.Read<std::string>("BRCReplay", "").empty())
+	{
+		memset(ws, 0x0, sizeof(wchar_t) * 256);
+		swprintf(ws, 256, L"%hs", config.Read<std::string>("BRCReplay", "").c_str());
+		msdk_strncopy_s(pParams->BRCReplayFile, MSDK_MAX_FILENAME_LEN, ws, MSDK_MAX_FILENAME_LEN - 1);
+
+		memset(ws, 0x0, sizeof(wchar_t) * 256);
+		swprintf(ws, 256, L"%hs", config.Read<std::string>("BRCReplayCurves", "").c_str());
+		msdk_strncopy_s(pParams->BRCReplayCurvesFile, MSDK_MAX_FILENAME_LEN, ws, MSDK_MAX_FILENAME_LEN - 1);
+		return MFX_ERR_NONE;
+	}
 	
     // check if all mandatory parameters were set
-    if (!pParams->InputFiles.size())
+    if (!pParams->InputFiles.size() && !*pParams->ShmRingName)
     {
 		msdk_printf(MSDK_STRING("Source file name not found"));
         return MFX_ERR_UNSUPPORTED;
     };
 
+	// frames of the shared memory ring are not counted by the application
+	if (pParams->nReconfigFrame && *pParams->ShmRingName)
+	{
+		msdk_printf(MSDK_STRING("ReconfigFrame is not supported with ShmRing input\n"));
+		return MFX_ERR_UNSUPPORTED;
+	}
+
 	pParams->nWidth = config.Read<int>("InputWidth");
 	pParams->nHeight = config.Read<int>("InputHeight");
     if (0 == pParams->nWidth || 0 == pParams->nHeight)
@@ -498,6 +652,50 @@ mfxStatus ParseInputString(sInputParams* pParams)
 }
 
 
+#if (MFX_VERSION >= 1024)
+// replays a BRC trace with the configured rate control, without an encoder
+mfxStatus RunBRCReplay(const sInputParams& params)
+{
+    CBRCReplay replay;
+    mfxStatus sts = replay.Load(params.BRCReplayFile);
+    MSDK_CHECK_STATUS(sts, "replay.Load failed");
+
+    // bitrates of the trace are in units of BRCParamMultiplier kbps
+    sBRCTraceParams& brcParams = replay.GetParams();
+    mfxU16 k = brcParams.mfx.BRCParamMultiplier ? brcParams.mfx.BRCParamMultiplier : 1;
+    if (params.nRateControlMethod == MFX_RATECONTROL_CBR || params.nRateControlMethod == MFX_RATECONTROL_VBR)
+        brcParams.mfx.RateControlMethod = params.nRateControlMethod;
+    if (params.nBitRate)
+        brcParams.mfx.TargetKbps = (mfxU16)(params.nBitRate / k);
+    if (params.MaxKbps)
+        brcParams.mfx.MaxKbps = (mfxU16)(params.MaxKbps / k);
+    if (params.BufferSizeInKB)
+        brcParams.mfx.BufferSizeInKB = (mfxU16)(params.BufferSizeInKB / k);
+    if (params.InitialDelayInKB)
+        brcParams.mfx.InitialDelayInKB = (mfxU16)(params.InitialDelayInKB / k);
+    if (params.nMaxFrameSize)
+    {
+        brcParams.bCO2 = 1;
+        brcParams.CO2.MaxFrameSize = params.nMaxFrameSize;
+    }
+    if (params.WinBRCSize)
+    {
+        brcParams.bCO3 = 1;
+        brcParams.CO3.WinBRCSize = params.WinBRCSize;
+        brcParams.CO3.WinBRCMaxAvgKbps = (mfxU16)(params.WinBRCMaxAvgKbps / k);
+    }
+
+    msdk_printf(MSDK_STRING("BRC replay of %u frames, %u kbps\n"), replay.GetFrameCount(), (mfxU32)brcParams.mfx.TargetKbps * k);
+
+    sBRCReplayStats stats;
+    sts = replay.Run(&stats, params.BRCReplayCurvesFile);
+    MSDK_CHECK_STATUS(sts, "replay.Run failed");
+
+    CBRCReplay::PrintStats(stats);
+    return MFX_ERR_NONE;
+}
+#endif
+
 void ModifyParamsUsingPresets(sInputParams& params)
 {
     COutputPresetParameters presetParams = CPresetManager::Inst.GetPreset(params.PresetMode, params.CodecId,params.dFrameRate, params.nWidth, params.nHeight, params.bUseHWLib);
@@ -631,6 +829,14 @@ int main(int argc, char *argv[])
 
     MSDK_CHECK_PARSE_RESULT(sts, MFX_ERR_NONE, 1);
 
+#if (MFX_VERSION >= 1024)
+    if (*Params.BRCReplayFile)
+    {
+        sts = RunBRCReplay(Params);
+        return (MFX_ERR_NONE == sts) ? 0 : 1;
+    }
+#endif
+
     // Choosing which pipeline to use
     pPipeline.reset(CreatePipeline(Params));
     MSDK_CHECK_POINTER(pPipeline.get(), MFX_ERR_MEMORY_ALLOC);
@@ -648,6 +854,14 @@ int main(int argc, char *argv[])
 #if 1
 	std::thread sndFrameThread([&]() {
 
+		// the pipeline reads from the shared memory ring itself
+		if (*Params.ShmRingName)
+			return;
+
+		if (MSDK_NUMA_NODE_ANY != Params.nNumaNode)
+			msdk_numa_bind_thread(Params.nNumaNode);
+		msdk_thread_apply_role(MSDK_THREAD_ROLE_FEEDER);
+
 		printf("\r\n----debug][main]--------------------size=%d dstFileBuff[wchar_t]=%ls\r\n", Params.dstFileBuff.size(), Params.dstFileBuff[0]);
 		FILE* fp = fopen("D:\\work\\test\\intel_qsv\\intel_qsv\\_build\\x64\\Debug\\sc_desktop_1920x1080_60_8bit_420.yuv","rb");
 		if (fp == NULL)
@@ -656,9 +870,18 @@ int main(int argc, char *argv[])
 			perror("fopen()");
 			exit(1);
 		}
+		mfxU32 nFramesSent = 0;
 		do {
+			// the frames sent before are encoded with the old parameters
+			if (Params.nReconfigFrame && nFramesSent == Params.nReconfigFrame)
+			{
+				mfxStatus sts = pPipeline->Reconfigure(Params.Reconfig);
+				if (MFX_ERR_NONE != sts)
+					msdk_printf(MSDK_STRING("pPipeline->Reconfigure failed: %d\n"), sts);
+			}
+
 			//@@@ new frame;
-			frame_desc_t* inputFrame = new frame_desc_t;
+			frame_desc_t* inputFrame = new frame_desc_t(); // no controls: pCtrl is NULL
 			if (inputFrame)
 			{
 				int iLen = 1920 * 1080;
@@ -675,6 +898,7 @@ int main(int argc, char *argv[])
 			{
 				///@@@ snd frame
 				pPipeline->SndFrame(inputFrame);
+				nFramesSent++;
 			}else {
 				if (inputFrame->yuvBuf[0]) delete inputFrame->yuvBuf[0];
 				if (inputFrame->yuvBuf[1]) delete inputFrame->yuvBuf[1];
@@ -691,6 +915,14 @@ int main(int argc, char *argv[])
 
 	std::thread getBitstreamThread([&]() {
 
+		// the writer hands frames to the shared memory ring, nothing is queued
+		if (*Params.ShmEgressName)
+			return;
+
+		if (MSDK_NUMA_NODE_ANY != Params.nNumaNode)
+			msdk_numa_bind_thread(Params.nNumaNode);
+		msdk_thread_apply_role(MSDK_THREAD_ROLE_DRAIN);
+
 		mfxStatus sts = MFX_ERR_NONE;
 		
 		FILE* fp = fopen("D:\\work\\test\\intel_qsv\\intel_qsv\\_build\\x64\\Debug\\saveEnc.h265","wb");
@@ -23,9 +23,33 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "avc_structures.h"
 #include "avc_headers.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace ProtectedLibrary
 {
 
+// number of leading zero bits, x must not be zero
+inline mfxU32 avcCountLeadingZeros(mfxU32 x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return 31 - index;
+#elif defined(__GNUC__)
+    return __builtin_clz(x);
+#else
+    mfxU32 n = 0;
+    while (!(x & 0x80000000))
+    {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
 #define AVCPeek1Bit(current_data, offset) \
     ((current_data[0] >> (offset)) & 1)
 
@@ -79,9 +103,15 @@ public:
     void AlignPointerRight(void);
 
 protected:
+    // Returns the current dword and the next one, bit 63 of the result is bit 31 of m_pbs[0].
+    inline mfxU64 PeekDwords();
+    // Moves the position forward by nbits (up to 32).
+    inline void SkipBits(mfxU32 nbits);
+
     mfxU32 *m_pbs;                                              // pointer to the current position of the buffer.
     mfxI32 m_bitOffset;                                         // the bit position (0 to 31) in the dword pointed by m_pbs.
     mfxU32 *m_pbsBase;                                          // pointer to the first byte of the buffer.
+    mfxU32 *m_pbsEnd;                                           // pointer past the last dword of the buffer.
     mfxU32 m_maxBsSize;                                         // maximum buffer size in bytes.
 };
 
@@ -200,11 +230,37 @@ extern const mfxU32 bits_data[];
 #define avcGetNBits( current_data, offset, nbits, data) \
     _avcGetBits(current_data, offset, nbits, data);
 
+inline mfxU64 AVCBaseBitstream::PeekDwords()
+{
+    mfxU64 w = (mfxU64)m_pbs[0] << 32;
+
+    // past the end of the buffer the stream reads as zeros
+    if (m_pbs + 1 < m_pbsEnd)
+        w |= m_pbs[1];
+    return w;
+}
+
+inline void AVCBaseBitstream::SkipBits(mfxU32 nbits)
+{
+    SAMPLE_ASSERT(nbits <= 32);
+
+    m_bitOffset -= nbits;
+    if (m_bitOffset < 0)
+    {
+        m_bitOffset += 32;
+        m_pbs++;
+    }
+}
+
 inline mfxU32 AVCBaseBitstream::GetBits(mfxU32 nbits)
 {
-    mfxU32 w, n = nbits;
+    SAMPLE_ASSERT(nbits > 0 && nbits <= 32);
+    SAMPLE_ASSERT(m_bitOffset >= 0 && m_bitOffset <= 31);
+
+    // both dwords at once instead of the split read of avcGetNBits
+    mfxU32 w = (mfxU32)(PeekDwords() >> (m_bitOffset + 33 - nbits)) & bits_data[nbits];
 
-    avcGetNBits(m_pbs, m_bitOffset, n, w);
+    SkipBits(nbits);
     return w;
 }
 
@@ -0,0 +1,103 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __BITSTREAM_SEGMENTER_H__
+#define __BITSTREAM_SEGMENTER_H__
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "sample_utils.h"
+
+/** \brief Splits the output of one encoder into segment files at IDR frames.
+ *
+ * The encoding thread asks IsBoundary for every input frame and forces an IDR
+ * frame where a new segment starts. The bitstream writer passes every encoded
+ * frame to PrepareFrame, which switches the writer to the next file when that
+ * IDR frame arrives. The next file is opened ahead of time and finished files
+ * are closed on a background thread, so a switch doesn't wait for the disk.
+ * Segments are named after the output file, out.ts gives out_00000.ts,
+ * out_00001.ts and so on, and every finished segment is added to the HLS
+ * media playlist out.m3u8.
+ */
+class CBitstreamSegmenter
+{
+public:
+    CBitstreamSegmenter();
+    virtual ~CBitstreamSegmenter();
+
+    mfxStatus Init(const msdk_char *strFileName, mfxU32 nSegmentFrames, mfxF64 dFrameRate);
+    // must be called after the writer closed its file, completes the playlist
+    void      Close();
+
+    // name of the file the writer starts with
+    const msdk_char* GetFirstSegmentName() const { return m_sFirstSegment.c_str(); }
+
+    // encoding thread, once per input frame in display order, true if the frame has to be an IDR frame
+    bool      IsBoundary(mfxU64 nTimeStamp);
+
+    // writer, once per encoded frame before it's written, replaces pFile and sFile when the frame starts a segment
+    mfxStatus PrepareFrame(const mfxBitstream *pBS, FILE *&pFile, msdk_string &sFile);
+
+protected:
+    struct sSegment
+    {
+        msdk_string name;
+        mfxU32      nFrames;
+    };
+
+    msdk_string SegmentName(mfxU32 nIndex) const;
+    void        WorkerLoop();
+    void        WriteManifest(const std::vector<sSegment> &segments, bool bFinal);
+
+    msdk_string m_sPrefix;    // output file name up to the extension
+    msdk_string m_sExtension;
+    msdk_string m_sManifest;
+    msdk_string m_sFirstSegment;
+    mfxU32      m_nSegmentFrames;
+    mfxF64      m_dFrameRate;
+
+    // encoding thread: time stamps of the forced IDR frames not yet seen by the writer
+    mfxU32             m_nInputFrames;
+    std::deque<mfxU64> m_Boundaries;
+
+    // writer: the segment being written
+    mfxU32      m_nIndex;
+    mfxU32      m_nFrames;
+
+    // shared with the background thread, guarded by m_mutex
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_cond;
+    bool                    m_bStop;
+    bool                    m_bOpenPending;
+    FILE                   *m_pNextFile;   // opened ahead for segment m_nIndex + 1
+    std::vector<FILE*>      m_CloseQueue;
+    std::vector<sSegment>   m_Segments;    // finished segments
+    bool                    m_bManifestDirty;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CBitstreamSegmenter);
+};
+
+#endif // __BITSTREAM_SEGMENTER_H__
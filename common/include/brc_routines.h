@@ -24,6 +24,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #if (MFX_VERSION >= 1024)
 #include "mfxbrc.h"
+#include "lookahead.h"
+#include "vm/thread_defs.h"
 
 #ifndef __PIPELINE_ENCODE_BRC_H__
 #define __PIPELINE_ENCODE_BRC_H__
@@ -42,6 +44,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #define MFX_CHECK_STS(sts) MFX_CHECK(sts == MFX_ERR_NONE, sts)
 
 
+mfxExtBuffer* Hevc_GetExtBuffer(mfxExtBuffer** extBuf, mfxU32 numExtBuf, mfxU32 id);
+
 class cBRCParams
 {
 public:
@@ -216,7 +220,9 @@ public:
         m_maxWinBitsLim(0),
         m_avgBitPerFrame(IPP_MIN(avgBitPerFrame, maxBitPerFrame)),
         m_currPosInWindow(0),
-        m_lastFrameOrder(0)
+        m_lastFrameOrder(0),
+        m_winBits(0),
+        m_winBitsSkip(0)
 
     {
         windowSize = windowSize > 0 ? windowSize : 1; // kw
@@ -224,6 +230,8 @@ public:
         for (mfxU32 i = 0; i < windowSize; i++)
         {
             m_slidingWindow[i] = maxBitPerFrame / 3; //initial value to prevent big first frames
+            m_winBits += m_slidingWindow[i];
+            m_winBitsSkip += GetSkipClamped(m_slidingWindow[i]);
         }
         m_maxWinBitsLim = GetMaxWinBitsLim();
     }
@@ -241,7 +249,7 @@ public:
             m_lastFrameOrder = FrameOrder;
             m_currPosInWindow = (m_currPosInWindow + 1) % windowSize;
         }
-        m_slidingWindow[m_currPosInWindow] = sizeInBits;
+        SetFrameBits(m_currPosInWindow, sizeInBits);
 
         if (bNextFrame)
         {
@@ -295,10 +303,39 @@ protected:
     mfxU32                      m_lastFrameOrder;
     std::vector<mfxU32>         m_slidingWindow;
 
+    // running sums of the window, as is and with skipped frames counted as m_avgBitPerFrame / 3;
+    // unsigned wrap-around keeps them equal to the sums over the window
+    mfxU32                      m_winBits;
+    mfxU32                      m_winBitsSkip;
 
+    mfxU32 GetSkipClamped(mfxU32 frameBits)
+    {
+        return frameBits < m_avgBitPerFrame / 3 ? m_avgBitPerFrame / 3 : frameBits;
+    }
+    void SetFrameBits(mfxU32 pos, mfxU32 frameBits)
+    {
+        mfxU32 &slot = m_slidingWindow[pos];
+        m_winBits += frameBits - slot;
+        m_winBitsSkip += GetSkipClamped(frameBits) - GetSkipClamped(slot);
+        slot = frameBits;
+    }
 
+    // bits of the last numFrames frames, the current one included;
+    // the whole window and all but its oldest frame come from the running sums
     mfxU32 GetLastFrameBits(mfxU32 numFrames, bool bCheckSkip)
     {
+        mfxU32 windowSize = (mfxU32)m_slidingWindow.size();
+        if (numFrames + 1 >= windowSize)
+        {
+            mfxU32 size = bCheckSkip ? m_winBitsSkip : m_winBits;
+            if (numFrames < windowSize)
+            {
+                mfxU32 oldest = m_slidingWindow[(m_currPosInWindow + 1) % windowSize];
+                size -= bCheckSkip ? GetSkipClamped(oldest) : oldest;
+            }
+            return size;
+        }
+
         mfxU32 size = 0;
         numFrames = numFrames < m_slidingWindow.size() ? numFrames : (mfxU32)m_slidingWindow.size();
         for (mfxU32 i = 0; i < numFrames; i++)
@@ -334,11 +371,16 @@ private:
     BRC_Ctx    m_ctx;
     std::unique_ptr<AVGBitrate> m_avg;
 
+    std::vector<sFrameComplexity> m_LA; // lookahead results by display order, filled by the encoder thread
+    MSDKMutex  m_LAMutex;
+    mfxU32     m_nRecodes;
+
 public:
     ExtBRC():
         m_par(),
         m_hrd(),
-        m_bInit(false)
+        m_bInit(false),
+        m_nRecodes(0)
     {
         memset(&m_ctx, 0, sizeof(m_ctx));
 
@@ -348,8 +390,14 @@ public:
     mfxStatus Close () {m_bInit = false; return MFX_ERR_NONE;}
     mfxStatus GetFrameCtrl (mfxBRCFrameParam* par, mfxBRCFrameCtrl* ctrl);
     mfxStatus Update (mfxBRCFrameParam* par, mfxBRCFrameCtrl* ctrl, mfxBRCFrameStatus* status);
+
+    // lookahead side channel: complexity of the frame that will be encoded with the given display order
+    void   SetFrameComplexity(mfxU32 displayOrder, const sFrameComplexity &frame);
+    mfxU32 GetRecodeCount() const { return m_nRecodes; }
 protected:
     mfxI32 GetCurQP (mfxU32 type, mfxI32 layer);
+    bool   GetFrameComplexity(mfxU32 displayOrder, sFrameComplexity *frame);
+    mfxI32 GetComplexityQPDelta(mfxU32 displayOrder, mfxU32 type);
 };
 
 namespace HEVCExtBRC
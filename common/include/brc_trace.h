@@ -0,0 +1,175 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __BRC_TRACE_H__
+#define __BRC_TRACE_H__
+
+#include "sample_utils.h"
+#include "brc_routines.h"
+
+#if (MFX_VERSION >= 1024)
+
+#include <vector>
+
+/** \brief BRC trace file: the parameters and per-frame results of an mfxExtBRC.
+ *
+ * The file starts with a magic and the sizes of the recorded SDK structures, so
+ * a trace is only read back by a build using the same SDK headers. It is
+ * followed by records, each starting with a tag: a parameter block on every
+ * Init and Reset of the BRC, and a fixed 32 byte frame record for every Update
+ * call, recodes included.
+ */
+#define MSDK_BRC_TRACE_TAG_INIT   MFX_MAKEFOURCC('I','N','I','T')
+#define MSDK_BRC_TRACE_TAG_RESET  MFX_MAKEFOURCC('R','S','E','T')
+#define MSDK_BRC_TRACE_TAG_FRAME  MFX_MAKEFOURCC('F','R','M','E')
+
+// BRC parameters which cBRCParams reads, as a plain copy
+struct sBRCTraceParams
+{
+    mfxU16              bCO;  // the coding option buffers below were attached
+    mfxU16              bCO2;
+    mfxU16              bCO3;
+    mfxU16              reserved;
+    mfxInfoMFX          mfx;
+    mfxExtCodingOption  CO;
+    mfxExtCodingOption2 CO2;
+    mfxExtCodingOption3 CO3;
+};
+
+// one Update call: the frame as encoded and the BRC decision on it
+struct sBRCTraceFrame
+{
+    mfxU32 nEncodedOrder;
+    mfxU32 nDisplayOrder;
+    mfxU32 nCodedFrameSize; // bytes
+    mfxU16 nFrameType;
+    mfxU16 nPyramidLayer;
+    mfxU16 nNumRecode;
+    mfxI16 nQpY;            // QP the frame was encoded with
+    mfxU16 nBRCStatus;
+    mfxU16 reserved;
+    mfxU32 nMinFrameSize;   // bits, with MFX_BRC_PANIC_SMALL_FRAME
+};
+
+/** \brief Records the calls of an mfxExtBRC to a trace file.
+ *
+ * Attach() puts the writer between the encoder and the BRC in the mfxExtBRC
+ * buffer; Detach() gives the buffer back its callbacks before the BRC is destroyed.
+ */
+class CBRCTraceWriter
+{
+public:
+    CBRCTraceWriter();
+    virtual ~CBRCTraceWriter();
+
+    mfxStatus Attach(mfxExtBRC &brc, const msdk_char *strFileName);
+    void      Detach(mfxExtBRC &brc);
+
+    mfxU32 GetFrameCount() const { return m_nFrames; }
+
+protected:
+    static mfxStatus Init(mfxHDL pthis, mfxVideoParam *par);
+    static mfxStatus Reset(mfxHDL pthis, mfxVideoParam *par);
+    static mfxStatus Close(mfxHDL pthis);
+    static mfxStatus GetFrameCtrl(mfxHDL pthis, mfxBRCFrameParam *par, mfxBRCFrameCtrl *ctrl);
+    static mfxStatus Update(mfxHDL pthis, mfxBRCFrameParam *par, mfxBRCFrameCtrl *ctrl, mfxBRCFrameStatus *status);
+
+    void WriteParams(mfxU32 nTag, const mfxVideoParam *par);
+    void WriteFrame(const mfxBRCFrameParam *par, const mfxBRCFrameCtrl *ctrl, const mfxBRCFrameStatus *status);
+    void Write(const void *pData, size_t nSize);
+
+    mfxExtBRC m_Inner;  // callbacks of the traced BRC
+    FILE     *m_pFile;
+    mfxU32    m_nFrames;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CBRCTraceWriter);
+};
+
+// results of a replay
+struct sBRCReplayStats
+{
+    mfxU32 nFrames;
+    mfxU32 nRecodes;         // extra Update calls on recoded frames
+    mfxU32 nPanicFrames;     // frames left with a panic status
+    mfxU32 nHRDUnderflows;   // frames which emptied the CPB
+    mfxU32 nHRDOverflows;    // frames after which a CBR CPB overflowed
+    mfxU32 nErrors;          // Update calls which failed
+    bool   bHRD;             // the CPB was simulated, the stream has HRD parameters
+    mfxF64 dAvgKbps;
+    mfxF64 dMaxWindowKbps;   // highest bitrate over one second of frames
+    mfxF64 dMinCpbFullness;  // lowest CPB fullness before a frame is removed, share of the buffer
+    mfxF64 dAvgQP;
+    mfxI32 nMinQP;
+    mfxI32 nMaxQP;
+};
+
+/** \brief Replays a BRC trace through ExtBRC, without an SDK session.
+ *
+ * The recorded frames give the frame types and the size each frame had at the
+ * QP it was encoded with. A frame replayed at another QP is given the size
+ * size * 2^((QPrecorded - QP) / 6), the usual rate model of H.264 and HEVC
+ * where six QP steps double the quantizer. Recodes and padding requested by
+ * the BRC are replayed the way the encoder handles them. A CPB is simulated
+ * next to the BRC, so HRD compliance is judged independently of cHRD.
+ *
+ * The recorded parameters can be changed before Run() to evaluate another BRC
+ * configuration on the same content; recorded resets are then not applied.
+ */
+class CBRCReplay
+{
+public:
+    CBRCReplay();
+    virtual ~CBRCReplay();
+
+    mfxStatus Load(const msdk_char *strFileName);
+
+    // parameters of the first Init, to be changed before Run()
+    sBRCTraceParams &GetParams() { return m_Params; }
+
+    // curves are written as CSV, one line per frame, if strCurvesFile is set
+    mfxStatus Run(sBRCReplayStats *pStats, const msdk_char *strCurvesFile = NULL);
+
+    mfxU32 GetFrameCount() const { return (mfxU32)m_Frames.size(); }
+
+    static void PrintStats(const sBRCReplayStats &stats);
+
+protected:
+    struct sEvent
+    {
+        mfxU32 nFrame;  // index of the first frame it applies to
+        mfxU32 nTag;
+        mfxU32 nParams; // index into m_EventParams
+    };
+
+    static void MakeVideoParam(sBRCTraceParams &params, mfxVideoParam &par, mfxExtBuffer *buffers[3]);
+
+    sBRCTraceParams              m_Params;
+    sBRCTraceParams              m_Recorded;
+    std::vector<sBRCTraceFrame>  m_Frames; // final Update of every frame
+    std::vector<sEvent>          m_Events; // Init and Reset after the first Init
+    std::vector<sBRCTraceParams> m_EventParams;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CBRCReplay);
+};
+
+#endif // MFX_VERSION >= 1024
+
+#endif // __BRC_TRACE_H__
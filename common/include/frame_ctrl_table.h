@@ -0,0 +1,103 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __FRAME_CTRL_TABLE_H__
+#define __FRAME_CTRL_TABLE_H__
+
+#include <vector>
+
+#include "sample_utils.h"
+
+/** \brief Frame control table file: encoder controls indexed by input frame order.
+ *
+ * The file starts with an sFrameCtrlTableHeader followed by NumFrames entries,
+ * all little endian. A file without the header is read as the older rounding
+ * offset file: four mfxU16 per field, in the order of sRoundingOffset.
+ */
+#define MSDK_FRAME_CTRL_TABLE_MAGIC   MFX_MAKEFOURCC('M','F','C','T')
+#define MSDK_FRAME_CTRL_TABLE_VERSION 1
+
+// sFrameCtrlEntry::Flags
+#define MSDK_FRAME_CTRL_ROUNDING   0x0001
+#define MSDK_FRAME_CTRL_QP_DELTA   0x0002
+#define MSDK_FRAME_CTRL_FRAME_TYPE 0x0004
+
+struct sFrameCtrlTableHeader
+{
+    mfxU32 Magic;
+    mfxU16 Version;
+    mfxU16 NumFields;  // fields with rounding offsets of their own, 1 or 2
+    mfxU32 NumFrames;
+    mfxU32 EntrySize;  // sizeof(sFrameCtrlEntry)
+};
+
+// as in mfxExtAVCRoundingOffset
+struct sRoundingOffset
+{
+    mfxU16 EnableIntra;
+    mfxU16 OffsetIntra;
+    mfxU16 EnableInter;
+    mfxU16 OffsetInter;
+};
+
+struct sFrameCtrlEntry
+{
+    mfxU16          Flags;       // MSDK_FRAME_CTRL_* of the controls below which apply
+    mfxU16          FrameType;   // MFX_FRAMETYPE_* the frame is encoded as
+    mfxI16          QPDelta;     // change of QP over the whole frame
+    mfxU16          reserved;
+    sRoundingOffset Rounding[2]; // per field, the first one for progressive frames
+};
+
+/** \brief A frame control table, read and checked once before encoding.
+ *
+ * Looking up the controls of a frame is an index into memory, nothing is read
+ * from the file while encoding.
+ */
+class CFrameCtrlTable
+{
+public:
+    CFrameCtrlTable();
+    virtual ~CFrameCtrlTable();
+
+    // nFields: fields per frame of the encoded stream, to read an older rounding offset file
+    mfxStatus Load(const msdk_char *strFileName, mfxU16 nFields);
+    void Close();
+
+    // controls of the frame with this input order, NULL past the end of the table
+    const sFrameCtrlEntry* Get(mfxU32 nFrameOrder) const
+    {
+        return nFrameOrder < m_Entries.size() ? &m_Entries[nFrameOrder] : NULL;
+    }
+
+    mfxU32 GetFrameCount() const { return (mfxU32)m_Entries.size(); }
+    // MSDK_FRAME_CTRL_* used by any frame of the table
+    mfxU16 GetFlags() const { return m_nFlags; }
+
+protected:
+    mfxStatus Check(const sFrameCtrlEntry &entry, mfxU32 nFrame) const;
+
+    std::vector<sFrameCtrlEntry> m_Entries;
+    mfxU16                       m_nFlags;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CFrameCtrlTable);
+};
+
+#endif //__FRAME_CTRL_TABLE_H__
@@ -0,0 +1,88 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __FRAME_DIFF_H__
+#define __FRAME_DIFF_H__
+
+#include <vector>
+
+#include "sample_defs.h"
+
+// side of the square luma tiles compared between frames
+#define MSDK_FRAME_DIFF_TILE 16
+
+/** \brief Finds the luma tiles that changed since the previous frame.
+ *
+ * Every 16x16 tile is reduced to a 128 bit hash and only the hashes of the
+ * previous frame are kept, so a frame is read once. A frame with no changed
+ * tile is a duplicate of the previous one.
+ */
+class CFrameDiff
+{
+public:
+    CFrameDiff();
+    virtual ~CFrameDiff();
+
+    void Close();
+
+    // hashes the 8 bit luma plane of the next frame and returns the number of tiles that changed,
+    // all of them for the first frame and after a change of size
+    mfxU32 Compare(const mfxU8 *pY, mfxU32 nWidth, mfxU32 nHeight, mfxU32 nPitch);
+
+    // 1 for every tile of the last frame that changed, row by row
+    const std::vector<mfxU8>& GetDirtyMap() const { return m_Dirty; }
+    mfxU32 GetTilesX() const { return m_nTilesX; }
+    mfxU32 GetTilesY() const { return m_nTilesY; }
+    // smallest rectangle of whole tiles covering the changes, in pixels; false if nothing changed
+    bool GetDirtyRect(mfxU32 *pLeft, mfxU32 *pTop, mfxU32 *pRight, mfxU32 *pBottom) const;
+
+    mfxU32 GetFrameCount() const { return m_nFrames; }
+    mfxU32 GetDuplicateCount() const { return m_nDuplicates; }
+    // average share of changed tiles per frame
+    mfxF64 GetAvgDirtyRatio() const;
+    // average compare time per frame
+    mfxF64 GetAvgTimeMs() const;
+
+protected:
+    struct sTileHash
+    {
+        mfxU64 lo;
+        mfxU64 hi;
+    };
+
+    mfxU32 m_nWidth;
+    mfxU32 m_nHeight;
+    mfxU32 m_nTilesX;
+    mfxU32 m_nTilesY;
+
+    std::vector<sTileHash> m_Hash; // hashes of the last frame
+    std::vector<mfxU8>     m_Dirty;
+    mfxU32                 m_nDirty;
+
+    mfxU32    m_nFrames;
+    mfxU32    m_nDuplicates;
+    mfxU64    m_nDirtyTotal;
+    mfxU64    m_nTilesTotal;
+    msdk_tick m_nTicks;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CFrameDiff);
+};
+
+#endif // __FRAME_DIFF_H__
@@ -0,0 +1,102 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __LOOKAHEAD_H__
+#define __LOOKAHEAD_H__
+
+#include <deque>
+#include <vector>
+
+#include "sample_defs.h"
+
+/** \brief Complexity of an input frame, measured on its downscaled luma.
+ *
+ * Costs are sums over 8x8 blocks of the downscaled frame. The intra cost of a
+ * block is its SAD to the block mean, the inter cost the smaller of that and
+ * the best SAD against the previous frame in a small search window.
+ */
+struct sFrameComplexity
+{
+    mfxU32 nOrder;           // input order of the frame
+    mfxU32 nIntraCost;
+    mfxU32 nInterCost;
+    mfxF64 dAvgIntraCost;    // running averages over the frames of the scene before this one
+    mfxF64 dAvgInterCost;
+    mfxF64 dFutureInterCost; // mean inter cost of the frames behind it in the window, 0 if none
+    bool   bSceneCut;        // first frame of a new scene
+};
+
+/** \brief CPU lookahead: analyzes input frames before they are encoded.
+ *
+ * Frames are downscaled 4x, or 8x above 1920 pixels of width, and costed as
+ * they enter the window. A frame leaves the window with what the frames after
+ * it tell about the content ahead, so scene cuts are known before encoding.
+ */
+class CLookAhead
+{
+public:
+    CLookAhead();
+    virtual ~CLookAhead();
+
+    mfxStatus Init(mfxU32 nDepth);
+    void      Close();
+
+    // analyzes the 8 bit luma plane of the next input frame and appends it to the window
+    void Push(const mfxU8 *pY, mfxU32 nWidth, mfxU32 nHeight, mfxU32 nPitch);
+    // takes the oldest frame out of the window
+    bool Pop(sFrameComplexity *pFrame);
+
+    mfxU32 GetDepth() const { return m_nDepth; }
+    mfxU32 GetCount() const { return (mfxU32)m_Window.size(); }
+
+    mfxU32 GetFrameCount() const { return m_nFrames; }
+    mfxU32 GetSceneCutCount() const { return m_nSceneCuts; }
+    // average analysis time per frame
+    mfxF64 GetAvgTimeMs() const;
+
+protected:
+    void   Resize(mfxU32 nWidth, mfxU32 nHeight);
+    void   Downscale(const mfxU8 *pY, mfxU32 nPitch, mfxU8 *pDst);
+    void   GetCosts(const mfxU8 *pCur, const mfxU8 *pRef, mfxU32 *pIntra, mfxU32 *pInter);
+
+    mfxU32 m_nDepth;
+    mfxU32 m_nWidth;       // input size the buffers are set up for
+    mfxU32 m_nHeight;
+    mfxU32 m_nScale;
+    mfxU32 m_nLowWidth;    // downscaled size, in whole 8x8 blocks
+    mfxU32 m_nLowHeight;
+
+    std::vector<mfxU8> m_Low[2]; // downscaled current and previous frame
+    mfxU32             m_nCur;
+    bool               m_bHaveRef;
+
+    std::deque<sFrameComplexity> m_Window;
+    mfxF64 m_dAvgIntra;
+    mfxF64 m_dAvgInter;
+    mfxU32 m_nSceneFrames; // frames of the current scene
+
+    mfxU32    m_nFrames;
+    mfxU32    m_nSceneCuts;
+    msdk_tick m_nTicks;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CLookAhead);
+};
+
+#endif // __LOOKAHEAD_H__
@@ -42,6 +42,7 @@ struct msdkOutputSurface
 {
     msdkFrameSurface* surface;
     mfxSyncPoint syncp;
+    msdk_tick posted; // when it was handed to the deliver thread
     msdkOutputSurface* next;
 };
 
@@ -310,6 +311,13 @@ protected: // functions
     void ResetBuffers();
     void ResetVppBuffers();
 
+    /** \brief The function returns all surfaces to the pools without reallocating them.
+     *
+     * Used when the decoder is reinitialized on the same frames: pending outputs are dropped,
+     * surfaces still locked by Media SDK go to the used array, the rest become free.
+     */
+    void RecycleBuffers();
+
     /** \brief The function syncs arrays of free and used surfaces.
      *
      * If Media SDK used surface for internal needs and unlocked it, the function moves such a surface
@@ -404,6 +412,10 @@ protected: // variables
 private:
     CBuffering(const CBuffering&);
     void operator=(const CBuffering&);
+
+    // RecycleBuffers for one surface array and its pools
+    void RecycleSurfaces(msdkFrameSurface* pSurfaces, mfxU32 SurfaceNumber,
+        msdkFreeSurfacesPool& FreePool, msdkUsedSurfacesPool& UsedPool);
 };
 
 #endif // __MFX_BUFFERING_H__
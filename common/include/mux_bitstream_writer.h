@@ -0,0 +1,111 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __MUX_BITSTREAM_WRITER_H__
+#define __MUX_BITSTREAM_WRITER_H__
+
+#include <vector>
+
+#include "sample_utils.h"
+#include "mfxvideo.h"
+
+enum eMuxFormat
+{
+    MUX_FORMAT_NONE = 0, // raw elementary stream
+    MUX_FORMAT_TS,       // MPEG-2 transport stream
+    MUX_FORMAT_FMP4      // fragmented MP4, one fragment per frame
+};
+
+/** \brief Bitstream writer which packages encoded H.264/HEVC frames into a container.
+ *
+ * Drop-in replacement for CSmplBitstreamWriter: every frame passed to WriteNextFrame
+ * or SndBitstream leaves the writer already muxed, with PTS/DTS taken from the
+ * bitstream TimeStamp/DecodeTimeStamp (or the frame rate if the encoder input had
+ * no time stamps) and random access points taken from FrameType.
+ * Transport streams repeat PAT/PMT before every IDR frame and fragmented MP4
+ * output starts every file with an init segment built from the parameter sets,
+ * so a Reset at an IDR frame starts a segment which plays on its own.
+ */
+class CMuxBitstreamWriter : public CSmplBitstreamWriter
+{
+public:
+    CMuxBitstreamWriter(eMuxFormat format = MUX_FORMAT_TS);
+    virtual ~CMuxBitstreamWriter();
+
+    virtual mfxStatus Init(const msdk_char *strFileName);
+    virtual mfxStatus WriteNextFrame(mfxBitstream *pMfxBitstream, bool isPrint = true);
+    virtual mfxStatus SndBitstream(mfxBitstream *pMfxBitstream);
+
+    /** \brief Sets the stream description, must be called after the encoder is initialized.
+     *
+     * @param par Encoder parameters, codec, frame size and frame rate are used.
+     * @param pSPSPPS Parameter sets from GetVideoParam, required for fragmented MP4.
+     * @param pVPS VPS from GetVideoParam, required for HEVC in fragmented MP4.
+     */
+    mfxStatus SetStreamInfo(const mfxVideoParam &par, const mfxExtCodingOptionSPSPPS *pSPSPPS, const mfxExtCodingOptionVPS *pVPS = NULL);
+
+    eMuxFormat GetFormat() const { return m_format; }
+
+protected:
+    virtual mfxStatus SelectSegment(const mfxBitstream *pMfxBitstream);
+
+    // builds the container data of one frame in m_muxed
+    mfxStatus Mux(const mfxBitstream *pBS);
+
+    void WriteTSTables();
+    void WriteTSFrame(const mfxU8 *pData, mfxU32 nSize, mfxI64 nPTS, mfxI64 nDTS, bool bRandomAccess);
+    // one 188 byte packet, returns number of payload bytes consumed
+    mfxU32 WriteTSPacket(mfxU16 nPid, bool bUnitStart, bool bRandomAccess, bool bPCR, mfxI64 nPCR, const mfxU8 *pPayload, mfxU32 nSize);
+
+    void WriteInitSegment();
+    void WriteSampleEntry();
+    void WriteFragment(const mfxU8 *pData, mfxU32 nSize, mfxI64 nPTS, mfxI64 nDTS, bool bRandomAccess);
+
+    eMuxFormat m_format;
+    mfxU32     m_nCodecId;
+    mfxU16     m_nWidth;
+    mfxU16     m_nHeight;
+    mfxU16     m_nChromaFormat;
+    mfxU16     m_nBitDepthLuma;
+    mfxU16     m_nBitDepthChroma;
+    mfxU32     m_nFrameDuration; // 90 kHz ticks
+
+    // parameter sets without start codes
+    std::vector<mfxU8> m_vps;
+    std::vector<mfxU8> m_sps;
+    std::vector<mfxU8> m_pps;
+
+    // state of the current output file
+    bool   m_bHeaderWritten;
+    mfxU8  m_nContinuity[3]; // PAT, PMT, video
+
+    // time line continues over Reset, so segments of one stream line up
+    mfxU32 m_nMuxedFrames;
+    bool   m_bFirstDTS;
+    mfxI64 m_nFirstDTS;
+    mfxU32 m_nSequenceNumber;
+
+    // output of Mux, reused from frame to frame
+    std::vector<mfxU8> m_muxed;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CMuxBitstreamWriter);
+};
+
+#endif // __MUX_BITSTREAM_WRITER_H__
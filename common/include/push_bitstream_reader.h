@@ -0,0 +1,109 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __PUSH_BITSTREAM_READER_H__
+#define __PUSH_BITSTREAM_READER_H__
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include "sample_utils.h"
+#include "blockingconcurrentqueue.h"
+
+// flags accepted by CPushBitstreamReader::SubmitPacket
+enum
+{
+    MSDK_PACKET_FLAG_NONE           = 0x0,
+    MSDK_PACKET_FLAG_COMPLETE_FRAME = 0x1, // packet holds exactly one complete frame
+    MSDK_PACKET_FLAG_END_OF_STREAM  = 0x2, // no packets will follow this one
+    MSDK_PACKET_FLAG_DISCONTINUITY  = 0x4, // packet does not continue the previous one (e.g. loss, splice)
+};
+
+/** \brief Bitstream source fed by an external producer (demuxer, network receiver).
+ *
+ * Packets are copied once into a fixed pool of mfxBitstream buffers and handed to
+ * the decoder through a bounded queue. SubmitPacket blocks while all buffers are
+ * in flight, ReadNextFrame blocks until a packet arrives, so neither side polls.
+ * The reader is intended for a single producer thread and a single consumer thread.
+ */
+class CPushBitstreamReader : public CSmplBitstreamReader
+{
+public:
+    CPushBitstreamReader(mfxU32 nPoolSize = 16, mfxU32 nBufferSize = 1024 * 1024);
+    virtual ~CPushBitstreamReader();
+
+    // push source cannot be rewound, Reset does nothing
+    virtual void      Reset();
+    virtual void      Close();
+    // file name is ignored, allocates the buffer pool
+    virtual mfxStatus Init(const msdk_char *strFileName);
+    virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+
+    /** \brief Queues a packet for decoding.
+     *
+     * @return MFX_ERR_NONE Packet was queued.
+     * @return MFX_ERR_ABORTED Reader was aborted or closed while waiting for a free buffer.
+     * @return MFX_ERR_UNDEFINED_BEHAVIOR Packet submitted after end of stream.
+     *
+     * @note May be called from any thread while the reader is used; Close waits for calls in progress.
+     * Init must not run concurrently with it.
+     */
+    mfxStatus SubmitPacket(const mfxU8 *pData, mfxU32 nSize, mfxU64 nTimeStamp, mfxU16 nFlags);
+
+    // true if ReadNextFrame won't wait
+    bool HasPacket() { return m_ReadyQueue.size_approx() > 0 || m_bEosReached || m_bStop; }
+
+    // wakes up both sides, pending and later calls return without waiting
+    void Abort();
+
+    // called on the producer's thread after a packet is queued and on Abort,
+    // e.g. to reschedule a parked consumer; must be set before packets are submitted
+    void SetPacketNotify(const std::function<void()> &notify) { m_PacketNotify = notify; }
+
+    mfxU32 GetDiscontinuityCount() const { return m_nDiscontinuities; }
+
+protected:
+    mfxStatus QueuePacket(const mfxU8 *pData, mfxU32 nSize, mfxU64 nTimeStamp, mfxU16 nFlags);
+
+    struct sPacket
+    {
+        mfxBitstream bs;
+        mfxU16       flags;
+    };
+
+    mfxU32                  m_nPoolSize;
+    mfxU32                  m_nBufferSize;
+    std::vector<sPacket>    m_Packets;
+
+    moodycamel::BlockingConcurrentQueue<sPacket*> m_FreeQueue;
+    moodycamel::BlockingConcurrentQueue<sPacket*> m_ReadyQueue;
+
+    std::atomic<bool>       m_bStop;
+    std::atomic<bool>       m_bEosSubmitted; // producer side
+    bool                    m_bEosReached;   // consumer side
+    std::atomic<mfxU32>     m_nSubmitters;   // SubmitPacket calls in progress, Close waits for them
+    mfxU32                  m_nDiscontinuities;
+    std::function<void()>   m_PacketNotify;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CPushBitstreamReader);
+};
+
+#endif //__PUSH_BITSTREAM_READER_H__
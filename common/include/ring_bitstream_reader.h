@@ -0,0 +1,67 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __RING_BITSTREAM_READER_H__
+#define __RING_BITSTREAM_READER_H__
+
+#include "sample_utils.h"
+
+/** \brief File bitstream source backed by a mirrored ring buffer.
+ *
+ * The same physical pages are mapped twice, back to back, so any window of up
+ * to the ring size starting inside the first mapping is contiguous in memory.
+ * The decoder consumes by advancing DataOffset, refills only append behind the
+ * unconsumed data, and nothing is ever moved to the buffer start.
+ *
+ * The ring owns the bitstream memory: after Init the decoder bitstream must be
+ * attached with AttachBitstream and detached before it is released. A bitstream
+ * which is not attached is served the regular way.
+ */
+class CRingBitstreamReader : public CSmplBitstreamReader
+{
+public:
+    CRingBitstreamReader(mfxU32 nRingSize = 8 * 1024 * 1024);
+    virtual ~CRingBitstreamReader();
+
+    virtual void      Close();
+    virtual mfxStatus Init(const msdk_char *strFileName);
+    virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+
+    // points pBS at the ring, pBS must not own a buffer
+    mfxStatus AttachBitstream(mfxBitstream *pBS);
+    // gives pBS its own buffer back (none), must be called before WipeMfxBitstream
+    void      DetachBitstream(mfxBitstream *pBS);
+
+protected:
+    mfxStatus MapRing(mfxU32 nSize);
+    void      UnmapRing();
+    // rebuilds the ring twice as big, the only case when data is copied
+    mfxStatus GrowRing(mfxBitstream *pBS);
+
+    mfxU8*    m_pRing;      // first of the two mappings, m_nRingSize * 2 bytes are addressable
+    mfxU32    m_nRingSize;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE    m_hMapping;
+#endif
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CRingBitstreamReader);
+};
+
+#endif // __RING_BITSTREAM_READER_H__
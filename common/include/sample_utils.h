@@ -27,6 +27,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <map>
 #include <stdexcept>
 #include <mutex>
+#include <atomic>
 
 #include "mfxstructures.h"
 #include "mfxvideo.h"
@@ -39,6 +40,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "vm/time_defs.h"
 #include "vm/atomic_defs.h"
 #include "vm/thread_defs.h"
+#include "vm/numa_defs.h"
 
 #include "sample_types.h"
 
@@ -158,6 +160,44 @@ private:
 	Mutex& _lock;
 };
 
+#define MSDK_FRAME_CTRL_MAX_ROI		32
+#define MSDK_FRAME_CTRL_MAX_REFS	8
+#define MSDK_FRAME_CTRL_QP_BLOCK	16
+
+// encoding controls of one input frame, all of them optional
+typedef struct frame_ctrl
+{
+	mfxU16	frameType;	// MFX_FRAMETYPE_* the frame is coded as, 0 leaves it to the encoder
+
+	mfxU16	numROI;
+	struct
+	{
+		mfxU32	left, top, right, bottom;	// pixels
+		mfxI16	deltaQP;	// negative for better quality
+	} roi[MSDK_FRAME_CTRL_MAX_ROI];
+
+	// QP of every 16x16 block, row by row; needs constant QP and MBQP, empty for none
+	std::vector<mfxU8>	qpMap;
+
+	// reference hints: input order of frames, counted from 0 over all frames sent
+	mfxU16	numPreferredRefs;
+	mfxU32	preferredRefs[MSDK_FRAME_CTRL_MAX_REFS];
+	mfxU16	numRejectedRefs;
+	mfxU32	rejectedRefs[MSDK_FRAME_CTRL_MAX_REFS];
+	bool	longTermRef;	// the frame is kept as a long term reference
+
+} frame_ctrl_t;
+
+inline void ClearFrameCtrl(frame_ctrl_t *pCtrl)
+{
+	pCtrl->frameType = 0;
+	pCtrl->numROI = 0;
+	pCtrl->qpMap.clear(); // keeps the storage for the next frame
+	pCtrl->numPreferredRefs = 0;
+	pCtrl->numRejectedRefs = 0;
+	pCtrl->longTermRef = false;
+}
+
 typedef struct frame_desc
 {
 	unsigned char*	yuvBuf[3];
@@ -168,6 +208,8 @@ typedef struct frame_desc
 	unsigned long   lumaStride;
 	unsigned long   chromaStride;
 
+	frame_ctrl_t*	pCtrl;	// owned by the frame, NULL for none
+
 } frame_desc_t;
 
 class CSmplYUVReader
@@ -191,6 +233,8 @@ protected:
     bool m_bInited;
 };
 
+class CBitstreamSegmenter;
+
 class CSmplBitstreamWriter
 {
 public :
@@ -204,14 +248,24 @@ public :
 	virtual mfxStatus SndBitstream(mfxBitstream* pMfxBitstream);
 	virtual mfxStatus GetBitstream(mfxBitstream*& pBitstream);
     virtual void Close();
+    // frames go to segment files, including those passed to SndBitstream, the segmenter must outlive the writer's file
+    void SetSegmenter(CBitstreamSegmenter *pSegmenter) { m_pSegmenter = pSegmenter; }
     mfxU32 m_nProcessedFramesNum;
 	moodycamel::ConcurrentQueue<mfxBitstream*> m_outQueue;
 
 protected:
+    // moves to the next segment file if the frame starts one
+    virtual mfxStatus SelectSegment(const mfxBitstream *pMfxBitstream);
+    mfxStatus WriteData(mfxBitstream *pMfxBitstream, bool isPrint);
+    mfxStatus QueueData(mfxBitstream *pMfxBitstream);
+    // copy of the queued data when segments are written
+    mfxStatus WriteToSegment(const mfxBitstream *pMfxBitstream);
+
     FILE*       m_fSource;
     bool        m_bInited;
     msdk_string m_sFile;
 	Mutex   m_lock;
+    CBitstreamSegmenter *m_pSegmenter;
 
 };
 
@@ -238,6 +292,8 @@ protected:
     mfxU32       m_nViews;
 };
 
+class CStreamIndex;
+
 class CSmplBitstreamReader
 {
 public :
@@ -251,9 +307,25 @@ public :
     virtual mfxStatus Init(const msdk_char *strFileName);
     virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
 
+    // bytes shifted inside bitstream buffers to make room for new data
+    mfxU64 GetMovedBytes() const { return m_nMovedBytes; }
+    // access units dropped by readers which filter the stream
+    mfxU32 GetSkippedFrames() const { return m_nSkippedFrames; }
+
+    // index of the source file, not owned by the reader
+    void SetIndex(const CStreamIndex *pIndex) { m_pIndex = pIndex; }
+    // moves to the nearest random access point at or before nFrame, returns its number in pKeyFrame
+    virtual mfxStatus Seek(mfxU32 nFrame, mfxU32 *pKeyFrame);
+
 protected:
+    // next read starts at nOffset of the file, readers with own buffers drop them
+    virtual mfxStatus SeekToOffset(mfxU64 nOffset);
+
     FILE*     m_fSource;
-    bool      m_bInited;
+    std::atomic<bool> m_bInited; // checked by producer threads of push readers
+    mfxU64    m_nMovedBytes;
+    mfxU32    m_nSkippedFrames;
+    const CStreamIndex *m_pIndex;
 };
 
 class CH264FrameReader : public CSmplBitstreamReader
@@ -267,6 +339,13 @@ public:
     virtual mfxStatus Init(const msdk_char *strFileName);
     virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
 
+    // drop every access unit which has non-intra slices,
+    // parameter sets of dropped units are passed on with the next kept one
+    void SetKeyFramesOnly(bool bEnable) { m_bKeyFramesOnly = bEnable; }
+
+protected:
+    virtual mfxStatus SeekToOffset(mfxU64 nOffset);
+
 private:
     mfxBitstream *m_processedBS;
     // input bit stream
@@ -282,6 +361,48 @@ private:
     mfxU8 *m_plainBuffer;
     mfxU32 m_plainBufferSize;
     mfxBitstream m_outBS;
+    bool m_bKeyFramesOnly;
+    // parameter sets of dropped access units
+    std::vector<mfxU8> m_pendingParamSets;
+};
+
+//provides output bitstream with exactly one HEVC access unit
+class CHEVCFrameReader : public CSmplBitstreamReader
+{
+public:
+    CHEVCFrameReader();
+    virtual ~CHEVCFrameReader();
+
+    virtual void      Reset();
+    virtual void      Close();
+    virtual mfxStatus Init(const msdk_char *strFileName);
+    virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+
+    // drop every access unit which is not an IRAP picture,
+    // parameter sets of dropped units are passed on with the next kept one
+    void SetKeyFramesOnly(bool bEnable) { m_bKeyFramesOnly = bEnable; }
+
+protected:
+    // next NAL unit without start code, points into m_originalBS until the next call
+    mfxStatus GetNalUnit(mfxU8 **ppNal, mfxU32 *pSize);
+    // hands the collected access unit over (if kept) and starts the next one
+    mfxStatus FinishAccessUnit(mfxBitstream *pBS, bool *pbOutput);
+    void      ResetState();
+    virtual mfxStatus SeekToOffset(mfxU64 nOffset);
+
+    std::unique_ptr<mfxBitstream> m_originalBS;
+    bool m_isEndOfStream;
+    bool m_bKeyFramesOnly;
+
+    // access unit being collected and NAL units after its last slice which start the next one
+    std::vector<mfxU8> m_au;
+    std::vector<mfxU8> m_auParamSets;
+    std::vector<mfxU8> m_next;
+    std::vector<mfxU8> m_nextParamSets;
+    // parameter sets of dropped access units
+    std::vector<mfxU8> m_pendingParamSets;
+    bool m_bAuHasSlices;
+    bool m_bAuIsIrap;
 };
 
 //provides output bistream with at least 1 frame, reports about error
@@ -563,6 +684,39 @@ mfxStatus MoveMfxBitstream(mfxBitstream *pTarget, mfxBitstream *pSrc, mfxU32 nBy
 mfxStatus ExtendMfxBitstream(mfxBitstream* pBitstream, mfxU32 nSize);
 void WipeMfxBitstream(mfxBitstream* pBitstream);
 
+//offset of the next 00 00 01 start code at or after pos, size if there is none
+mfxU32 FindAnnexBStartCode(const mfxU8 *data, mfxU32 size, mfxU32 pos);
+
+// HEVC NAL unit types used to find access unit boundaries, H.264 ones are NAL_UT_* of avc_structures.h
+enum
+{
+    HEVC_NAL_BLA_W_LP       = 16,
+    HEVC_NAL_RSV_IRAP_23    = 23,
+    HEVC_NAL_VPS            = 32,
+    HEVC_NAL_SPS            = 33,
+    HEVC_NAL_PPS            = 34,
+    HEVC_NAL_AUD            = 35,
+    HEVC_NAL_PREFIX_SEI     = 39,
+    HEVC_NAL_RSV_NVCL_41    = 41,
+    HEVC_NAL_RSV_NVCL_44    = 44,
+    HEVC_NAL_UNSPEC_48      = 48,
+    HEVC_NAL_UNSPEC_55      = 55,
+};
+
+// what the header of an H.264 or HEVC NAL unit tells about access unit boundaries
+struct sNalUnitInfo
+{
+    mfxU8  nType;
+    bool   bSlice;        // VCL unit
+    bool   bFirstSlice;   // first slice of a picture, starts an access unit
+    bool   bRandomAccess; // H.264 IDR or HEVC IRAP slice
+    bool   bPrefix;       // non-VCL unit which may only precede the first slice of an access unit
+    bool   bParamSet;     // SPS or PPS, or HEVC VPS
+};
+
+//classifies a NAL unit without start code from its header and the first slice header byte
+void ClassifyNalUnit(bool bHEVC, const mfxU8 *nal, mfxU32 size, sNalUnitInfo *pInfo);
+
 mfxU16 CalculateDefaultBitrate(mfxU32 nCodecId, mfxU32 nTargetUsage, mfxU32 nWidth, mfxU32 nHeight, mfxF64 dFrameRate);
 
 //serialization fnc set
@@ -793,6 +947,10 @@ void WaitForDeviceToBecomeFree(MFXVideoSession& session, mfxSyncPoint& syncPoint
 
 mfxU16 FourCCToChroma(mfxU32 fourCC);
 
+// adds the pages of a locked system memory surface found on node and on other nodes to the counters,
+// sampled over the first plane
+mfxStatus CountSurfacePages(const mfxFrameSurface1 *pSurface, mfxI32 node, mfxU32 *pLocal, mfxU32 *pRemote);
+
 // class is used as custom exception
 class mfxError
 {
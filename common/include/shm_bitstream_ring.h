@@ -0,0 +1,164 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __SHM_BITSTREAM_RING_H__
+#define __SHM_BITSTREAM_RING_H__
+
+#include "shm_ring.h"
+
+#define MSDK_SHM_BITSTREAM_RING_MAGIC    0x42504D53 // "SMPB"
+#define MSDK_SHM_BITSTREAM_RING_VERSION  1
+
+#define MSDK_SHM_NO_PACKET ((mfxU64)-1)
+
+// Layout of the shared memory: this header, then Capacity bytes of packets
+// starting at DataOffset. Positions count bytes since the ring was created,
+// a packet at position P is at offset P % Capacity.
+struct msdkShmBitstreamHeader
+{
+    mfxU32 Magic;       // msdkShmRingPrefix
+    mfxU32 Version;
+    mfxU32 Size;
+    mfxU32 Capacity;
+    mfxU32 DataOffset;
+    mfxU32 reserved;
+
+    std::atomic<mfxU64> ReservePos; // end of the packet being written
+    std::atomic<mfxU64> WritePos;   // end of the last complete packet
+    std::atomic<mfxU64> KeyPos;     // start of the last IDR frame packet, MSDK_SHM_NO_PACKET if none
+    std::atomic<mfxU32> PacketSeq;  // packets written
+    std::atomic<mfxU32> Closed;     // set by the writer after its last packet
+};
+
+// rest of the buffer is unused, the next packet is at offset 0; that's also
+// the case without a marker if less than a packet header is left
+#define MSDK_SHM_PACKET_WRAP 0x1
+
+// precedes every packet, packets are 8 byte aligned
+struct msdkShmPacketHeader
+{
+    mfxU32 Size;      // of the payload
+    mfxU32 Flags;
+    mfxU32 Seq;
+    mfxU16 FrameType;
+    mfxU16 PicStruct;
+    mfxU64 TimeStamp;
+    mfxI64 DecodeTimeStamp;
+};
+
+// a packet in the ring, Data points straight into the shared memory
+struct msdkShmPacket
+{
+    msdkShmPacketHeader Header;
+    const mfxU8 *Data;
+};
+
+/** \brief Ring of encoded packets in shared memory, written by the encoder
+ * process and read by another process.
+ *
+ * The writer never waits for the reader, a live encoder must not stall on a
+ * slow consumer. The reader follows the writer on its own position and finds
+ * out when the writer has overwritten data it hasn't read yet. It then
+ * continues at the last key frame still in the ring, or at the newest packet
+ * if there's none, and counts the overrun.
+ * Packets are read in place with AcquirePacket/ReleasePacket, ReleasePacket
+ * tells whether the data was still intact while it was used. ReadPacket
+ * copies the packet into an mfxBitstream instead.
+ */
+class CShmBitstreamRing : public CShmRing
+{
+public:
+    CShmBitstreamRing();
+    virtual ~CShmBitstreamRing();
+
+    // writer side, nCapacity bytes for packets and their headers
+    mfxStatus Create(const msdk_char *strName, mfxU32 nCapacity);
+    // reader side, waits up to nTimeoutMs for the writer to create the ring
+    mfxStatus Open(const msdk_char *strName, mfxU32 nTimeoutMs);
+    virtual void Close();
+
+    mfxStatus WritePacket(const mfxBitstream *pBS);
+    // no more packets will be written
+    void      SetEndOfStream();
+
+    // MFX_ERR_MORE_DATA if no packet arrived within nTimeoutMs or the stream is over,
+    // MFX_WRN_OUT_OF_RANGE if packets were lost to an overrun before this one
+    mfxStatus AcquirePacket(msdkShmPacket *pPacket, mfxU32 nTimeoutMs);
+    // MFX_ERR_ABORTED if the writer overwrote the packet while it was used
+    mfxStatus ReleasePacket();
+    // same as Acquire/ReleasePacket with the payload appended to pBS, extended if needed
+    mfxStatus ReadPacket(mfxBitstream *pBS, mfxU32 nTimeoutMs);
+
+    // true once the writer finished and all packets were read
+    bool      IsEndOfStream() const;
+    mfxU32    GetOverruns() const { return m_nOverruns; }
+    mfxU32    GetLostPackets() const { return m_nLostPackets; }
+
+protected:
+    // true if the data from nPos on may have been overwritten
+    bool      IsOverwritten(mfxU64 nPos) const;
+    // moves the reader past an overrun
+    void      Resync();
+
+    msdkShmBitstreamHeader *m_pHeader;
+    mfxU8                  *m_pData;
+
+    mfxU64  m_nWritePos;   // writer: end of the last packet
+    mfxU32  m_nWriteSeq;
+
+    mfxU64  m_nReadPos;    // reader: next packet
+    mfxU64  m_nAcquiredPos; // reader: packet being used, or MSDK_SHM_NO_PACKET
+    mfxU32  m_nNextSeq;    // reader: expected sequence number of the next packet
+    bool    m_bSeqKnown;   // reader: m_nNextSeq is valid, false until the first packet
+    mfxU32  m_nOverruns;
+    mfxU32  m_nLostPackets;
+    bool    m_bOverrun;    // reader: the next packet follows an overrun
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CShmBitstreamRing);
+};
+
+/** \brief Bitstream writer which hands encoded frames to another process through
+ * a CShmBitstreamRing instead of a file.
+ *
+ * Init takes the name of the ring rather than a file name. WriteNextFrame and
+ * SndBitstream both write the frame with its time stamps and frame type to the
+ * ring, nothing is queued for GetBitstream.
+ */
+class CShmBitstreamWriter : public CSmplBitstreamWriter
+{
+public:
+    CShmBitstreamWriter(mfxU32 nCapacity);
+    virtual ~CShmBitstreamWriter();
+
+    virtual mfxStatus Init(const msdk_char *strRingName);
+    virtual mfxStatus Reset();
+    virtual mfxStatus WriteNextFrame(mfxBitstream *pMfxBitstream, bool isPrint = true);
+    virtual mfxStatus SndBitstream(mfxBitstream *pMfxBitstream);
+    virtual void Close();
+
+protected:
+    CShmBitstreamRing m_Ring;
+    mfxU32            m_nCapacity;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CShmBitstreamWriter);
+};
+
+#endif // __SHM_BITSTREAM_RING_H__
@@ -0,0 +1,120 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __SHM_FRAME_RING_H__
+#define __SHM_FRAME_RING_H__
+
+#include <vector>
+
+#include "shm_ring.h"
+
+#define MSDK_SHM_FRAME_RING_MAGIC    0x52464D53 // "SMFR"
+#define MSDK_SHM_FRAME_RING_VERSION  1
+
+// Layout of the shared memory: this header, NumSlots slot headers, then the
+// slots themselves starting at DataOffset, SlotSize bytes each.
+struct msdkShmRingHeader
+{
+    mfxU32 Magic;         // msdkShmRingPrefix
+    mfxU32 Version;
+    mfxU32 Size;
+    mfxU32 FourCC;        // MFX_FOURCC_NV12, or MFX_FOURCC_I420 with U before V
+    mfxU16 Width;
+    mfxU16 Height;
+    mfxU32 Pitch;         // of the luma plane, chroma rows of I420 take half of it
+    mfxU32 AlignedHeight; // rows of luma in a slot, chroma follows
+    mfxU32 NumSlots;
+    mfxU32 SlotSize;
+    mfxU32 DataOffset;
+
+    std::atomic<mfxU32> WriteSeq; // frames committed by the producer
+    std::atomic<mfxU32> ReadSeq;  // frames released by the consumer
+    std::atomic<mfxU32> Closed;   // set by the producer after its last frame
+    mfxU32 reserved;              // slot headers which follow are 8 byte aligned
+};
+
+struct msdkShmSlotHeader
+{
+    mfxU32 Seq;       // sequence number of the frame in the slot
+    mfxU32 reserved;
+    mfxU64 TimeStamp; // 90 kHz, MFX_TIMESTAMP_UNKNOWN if the producer has none
+};
+
+// a frame in the ring, planes point straight into the shared memory
+struct msdkShmFrame
+{
+    mfxU32 Seq;
+    mfxU64 TimeStamp;
+    mfxU8  *Y;
+    mfxU8  *U;     // interleaved UV for NV12
+    mfxU8  *V;     // U + 1 for NV12
+    mfxU32 Pitch;  // luma pitch, also chroma pitch for NV12
+};
+
+/** \brief Frame ring in shared memory between a producer and a consumer process.
+ *
+ * The producer creates the ring, fills the slot returned by AcquireWriteSlot
+ * and publishes it with CommitWriteSlot. The consumer opens the ring by name
+ * and gets the frames in order from AcquireReadSlot. A slot is handed back
+ * with ReleaseReadSlot once the frame isn't used any more, which may happen
+ * out of order. Pixels are never copied by the ring, the slots are pitched
+ * and page aligned so they can be used as system memory surfaces.
+ * Sequence numbers live in the shared header.
+ */
+class CShmFrameRing : public CShmRing
+{
+public:
+    CShmFrameRing();
+    virtual ~CShmFrameRing();
+
+    // producer side, nFourCC is MFX_FOURCC_NV12 or MFX_FOURCC_I420
+    mfxStatus Create(const msdk_char *strName, mfxU32 nFourCC, mfxU16 nWidth, mfxU16 nHeight, mfxU32 nSlots);
+    // consumer side, waits up to nTimeoutMs for the producer to create the ring
+    mfxStatus Open(const msdk_char *strName, mfxU32 nTimeoutMs);
+    virtual void Close();
+
+    // MFX_WRN_IN_EXECUTION if no slot got free within nTimeoutMs
+    mfxStatus AcquireWriteSlot(msdkShmFrame *pFrame, mfxU32 nTimeoutMs);
+    mfxStatus CommitWriteSlot(mfxU64 nTimeStamp);
+    // no more frames will be written
+    void      SetEndOfStream();
+
+    // MFX_ERR_MORE_DATA if no frame arrived within nTimeoutMs or the stream is over
+    mfxStatus AcquireReadSlot(msdkShmFrame *pFrame, mfxU32 nTimeoutMs);
+    mfxStatus ReleaseReadSlot(mfxU32 nSeq);
+    // true once the producer finished and all frames were read
+    bool      IsEndOfStream() const;
+
+    const msdkShmRingHeader* GetHeader() const { return m_pHeader; }
+
+protected:
+    void      GetFrame(mfxU32 nSeq, msdkShmFrame *pFrame);
+
+    msdkShmRingHeader *m_pHeader;
+    msdkShmSlotHeader *m_pSlots;
+    mfxU8             *m_pData;
+
+    mfxU32             m_nReadCursor;  // consumer: next frame to acquire
+    std::vector<bool>  m_Released;     // consumer: released frames ahead of ReadSeq, by slot
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CShmFrameRing);
+};
+
+#endif // __SHM_FRAME_RING_H__
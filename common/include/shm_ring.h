@@ -0,0 +1,87 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include <atomic>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#include "sample_utils.h"
+
+#define MSDK_SHM_RING_ALIGN 4096
+
+// every ring header in shared memory starts with these fields
+struct msdkShmRingPrefix
+{
+    mfxU32 Magic;   // written last by the creator, the ring is valid once it's there
+    mfxU32 Version;
+    mfxU32 Size;    // of the whole mapping
+};
+
+/** \brief Named shared memory mapping with wait/wake on words inside it.
+ *
+ * Base of the rings which pass data between processes. The creator maps the
+ * memory and publishes the header, the other side maps it by name once the
+ * header is there. Waiting on a word of the mapping is done with a shared
+ * futex on Linux and with named auto-reset events on Windows, one for each
+ * direction, so every ring has one waiter per direction.
+ */
+class CShmRing
+{
+public:
+    CShmRing();
+    virtual ~CShmRing();
+
+    virtual void Close();
+
+protected:
+    mfxStatus CreateMapping(const msdk_char *strName, mfxU32 nSize);
+    // makes the header visible to OpenMapping
+    void      Publish(mfxU32 nMagic, mfxU32 nVersion);
+    // waits up to nTimeoutMs for the creator
+    mfxStatus OpenMapping(const msdk_char *strName, mfxU32 nMagic, mfxU32 nVersion, mfxU32 nTimeoutMs);
+
+    // waits until word changes from nValue, false on timeout
+    bool      Wait(std::atomic<mfxU32> &word, mfxU32 nValue, mfxU32 nTimeoutMs, bool bFilled);
+    void      Wake(std::atomic<mfxU32> &word, bool bFilled);
+
+    mfxU8  *m_pMapped;
+    mfxU32  m_nMappedSize;
+    bool    m_bCreator;
+
+private:
+    mfxStatus Map(const msdk_char *strName, mfxU32 nSize, bool bCreate);
+
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE  m_hMapping;
+    HANDLE  m_hFilled;  // producer to consumer
+    HANDLE  m_hFreed;   // consumer to producer
+#else
+    int         m_fd;
+    msdk_string m_sName;
+#endif
+
+    DISALLOW_COPY_AND_ASSIGN(CShmRing);
+};
+
+#endif // __SHM_RING_H__
@@ -0,0 +1,74 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __STREAM_INDEX_H__
+#define __STREAM_INDEX_H__
+
+#include <vector>
+
+#include "sample_utils.h"
+
+/** \brief Random access points of an elementary stream file.
+ *
+ * A single scan records the byte offset and decode order number of every access
+ * unit decoding can start from: H.264 IDR and HEVC IRAP pictures which carry their
+ * parameter sets, every VP8/VP9 key frame of an IVF file and every MJPEG frame.
+ * The result is kept in a sidecar file next to the stream, so later runs look
+ * a frame up with a binary search instead of scanning the stream again.
+ */
+class CStreamIndex
+{
+public:
+    struct sEntry
+    {
+        mfxU64 nOffset; // first byte of the access unit, including its parameter sets
+        mfxU32 nFrame;  // decode order number of the access unit
+    };
+
+    CStreamIndex();
+    virtual ~CStreamIndex();
+
+    // loads <strFileName>.idx if it matches the stream, otherwise scans the stream and writes it
+    mfxStatus LoadOrBuild(const msdk_char *strFileName, mfxU32 nCodecId);
+    mfxStatus Build(const msdk_char *strFileName, mfxU32 nCodecId);
+    mfxStatus Load(const msdk_char *strIndexName, mfxU32 nCodecId, mfxU64 nStreamSize);
+    mfxStatus Save(const msdk_char *strIndexName);
+    void      Clear();
+
+    // nearest random access point at or before nFrame
+    mfxStatus Find(mfxU32 nFrame, sEntry *pEntry) const;
+
+    mfxU32 GetFrameCount() const { return m_nFrames; }
+    mfxU32 GetEntryCount() const { return (mfxU32)m_Entries.size(); }
+
+protected:
+    mfxStatus ScanNalStream(FILE *pFile, bool bHEVC);
+    mfxStatus ScanIVF(FILE *pFile);
+    mfxStatus ScanMJPEG(FILE *pFile);
+
+    mfxU32              m_nCodecId;
+    mfxU64              m_nStreamSize;
+    mfxU32              m_nFrames;
+    std::vector<sEntry> m_Entries;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CStreamIndex);
+};
+
+#endif // __STREAM_INDEX_H__
@@ -21,13 +21,29 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #define __SYSMEM_ALLOCATOR_H__
 
 #include <stdlib.h>
+#include <vector>
 #include "base_allocator.h"
 
+struct sArenaSlab;
+
 struct sBuffer
 {
     mfxU32      id;
     mfxU32      nbytes;
     mfxU16      type;
+    sArenaSlab *slab; // slab the buffer was carved from, NULL if it was allocated on its own
+};
+
+// one large mapping the buffers of a frame pool are carved from
+struct sArenaSlab
+{
+    mfxU8  *pMapped;
+    size_t  nMappedSize;
+    mfxU8  *pData;      // pMapped aligned to a huge page
+    size_t  nSize;
+    size_t  nUsed;      // bytes carved so far
+    mfxU32  nBuffers;   // carved buffers not freed yet, the slab is idle at 0
+    bool    bHugePages; // backed by explicit huge pages rather than transparent ones or none
 };
 
 struct sFrame
@@ -39,8 +55,9 @@ struct sFrame
 struct SysMemAllocatorParams : mfxAllocatorParams
 {
     SysMemAllocatorParams()
-        : mfxAllocatorParams(), pBufferAllocator(NULL) { }
+        : mfxAllocatorParams(), pBufferAllocator(NULL), bUseArena(false) { }
     MFXBufferAllocator *pBufferAllocator;
+    bool bUseArena; // own buffer allocator carves frames from slabs, ignored with pBufferAllocator
 };
 
 class SysMemFrameAllocator: public BaseFrameAllocator
@@ -64,15 +81,39 @@ protected:
     bool m_bOwnBufferAllocator;
 };
 
+/** \brief System memory buffers, each one allocated on its own or, in arena
+ * mode, carved from a slab.
+ *
+ * A slab holds a whole frame pool, see ReserveArena. It is backed by 2 MB
+ * huge pages where the system allows it and touched when it's created, so
+ * frames neither page fault nor thrash the TLB during processing. Slabs are
+ * kept when all their buffers are freed and reused by the next pool which
+ * fits, a reset with the same or a smaller resolution maps no new memory.
+ * Idle slabs too small for a new pool are unmapped when it is reserved, and
+ * only a few larger ones are kept.
+ * Unlike the buffers allocated on their own, reused slab memory isn't zeroed.
+ */
 class SysMemBufferAllocator : public MFXBufferAllocator
 {
 public:
-    SysMemBufferAllocator();
+    SysMemBufferAllocator(bool bUseArena = false);
     virtual ~SysMemBufferAllocator();
     virtual mfxStatus AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemId *mid);
     virtual mfxStatus LockBuffer(mfxMemId mid, mfxU8 **ptr);
     virtual mfxStatus UnlockBuffer(mfxMemId mid);
     virtual mfxStatus FreeBuffer(mfxMemId mid);
+
+    // the next nCount buffers of up to nbytes come from one slab, no-op without arena mode
+    mfxStatus ReserveArena(mfxU32 nbytes, mfxU32 nCount);
+
+protected:
+    static size_t BufferSize(mfxU32 nbytes);
+    mfxStatus CreateSlab(size_t nSize, sArenaSlab **ppSlab);
+    void      DestroySlab(sArenaSlab *pSlab);
+
+    bool                      m_bUseArena;
+    std::vector<sArenaSlab *> m_Slabs;
+    sArenaSlab               *m_pActiveSlab; // picked by ReserveArena for the pool being allocated
 };
 
 #endif // __SYSMEM_ALLOCATOR_H__
\ No newline at end of file
@@ -0,0 +1,83 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __TS_BITSTREAM_READER_H__
+#define __TS_BITSTREAM_READER_H__
+
+#include <vector>
+
+#include "sample_utils.h"
+
+#define MSDK_TS_PACKET_SIZE 188
+#define MSDK_TS_NULL_PID    0x1FFF
+
+/** \brief Reads one elementary stream out of an MPEG-2 transport stream file.
+ *
+ * The stream is the first one of the codec listed in the PMT of the first program,
+ * unless a PID is selected explicitly. Every PES packet of it is returned as a
+ * complete frame with its PTS/DTS set, so broadcast streams must carry one access
+ * unit per PES packet. Payload bytes are copied once, from the packet buffer
+ * straight into the caller's bitstream, which is grown when a PES does not fit.
+ */
+class CTSBitstreamReader : public CSmplBitstreamReader
+{
+public:
+    CTSBitstreamReader();
+    virtual ~CTSBitstreamReader();
+
+    virtual void      Reset();
+    virtual void      Close();
+    virtual mfxStatus Init(const msdk_char *strFileName);
+    virtual mfxStatus ReadNextFrame(mfxBitstream *pBS);
+
+    // called before Init, nPid 0 takes the first stream of nCodecId from the PMT
+    void SelectStream(mfxU32 nCodecId, mfxU16 nPid = 0);
+
+    // PID of the demuxed stream, MSDK_TS_NULL_PID until the PMT is found
+    mfxU16 GetPid() const { return m_nPid; }
+    // packets lost or reordered in transport, detected via continuity_counter; duplicates and
+    // packets flagged with discontinuity_indicator are not counted
+    mfxU32 GetContinuityErrors() const { return m_nContinuityErrors; }
+
+protected:
+    // next packet starting with a sync byte, stays in the buffer until m_nBufferPos moves on
+    const mfxU8* PeekPacket();
+    void         ParsePAT(const mfxU8 *pSection, mfxU32 nSize);
+    void         ParsePMT(const mfxU8 *pSection, mfxU32 nSize);
+    // sets time stamps of pBS, MFX_ERR_MORE_DATA if the PES header continues past nSize
+    mfxStatus    ParsePESHeader(const mfxU8 *pData, mfxU32 nSize, mfxU32 *pHeaderSize, mfxBitstream *pBS);
+    void         ResetState();
+
+    std::vector<mfxU8> m_buffer;
+    mfxU32 m_nBufferPos;
+    mfxU32 m_nBufferSize;
+
+    mfxU32 m_nCodecId;
+    mfxU16 m_nSelectedPid;
+    mfxU16 m_nPmtPid;
+    mfxU16 m_nPid;
+    mfxU8  m_nContinuity; // expected continuity_counter of the next packet, 0xFF if unknown
+    mfxU32 m_nContinuityErrors;
+    std::vector<mfxU8> m_PESHeader; // start of a PES whose header is split across packets
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CTSBitstreamReader);
+};
+
+#endif // __TS_BITSTREAM_READER_H__
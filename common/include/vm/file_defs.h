@@ -27,14 +27,20 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #if defined(_WIN32) || defined(_WIN64)
 
 #define MSDK_FOPEN(file, name, mode) _tfopen_s(&file, name, mode)
+#define MSDK_FSEEK64(file, offset, origin) _fseeki64(file, offset, origin)
+#define MSDK_FTELL64(file) _ftelli64(file)
 
 #define msdk_fgets  _fgetts
+#define msdk_remove _tremove
 #else // #if defined(_WIN32) || defined(_WIN64)
 #include <unistd.h>
 
 #define MSDK_FOPEN(file, name, mode) !(file = fopen(name, mode))
+#define MSDK_FSEEK64(file, offset, origin) fseeko(file, offset, origin)
+#define MSDK_FTELL64(file) ftello(file)
 
 #define msdk_fgets  fgets
+#define msdk_remove remove
 #endif // #if defined(_WIN32) || defined(_WIN64)
 
 #endif // #ifndef __FILE_DEFS_H__
@@ -0,0 +1,72 @@
+/******************************************************************************\
+Copyright (c) 2005-2018, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __NUMA_DEFS_H__
+#define __NUMA_DEFS_H__
+
+#include "mfxdefs.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+
+#include <windows.h>
+
+typedef GROUP_AFFINITY msdk_cpu_affinity;
+
+#else // #if defined(_WIN32) || defined(_WIN64)
+
+#include <sched.h>
+
+typedef cpu_set_t msdk_cpu_affinity;
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
+
+#define MSDK_NUMA_NODE_ANY (-1)
+
+mfxU32    msdk_numa_get_node_count();
+// node of the CPU the calling thread runs on
+mfxI32    msdk_numa_get_current_node();
+// CPUs of node, in the form the thread affinity calls take
+mfxStatus msdk_numa_get_node_affinity(mfxI32 node, msdk_cpu_affinity *pAffinity);
+// restricts the calling thread to the CPUs of node, pPrevious receives the affinity it had
+mfxStatus msdk_numa_bind_thread(mfxI32 node, msdk_cpu_affinity *pPrevious = NULL);
+mfxStatus msdk_numa_restore_thread(const msdk_cpu_affinity *pAffinity);
+// counts the resident pages of [ptr, ptr + size) on node and on other nodes,
+// looking at every nStep-th page only
+mfxStatus msdk_numa_count_pages(const void *ptr, size_t size, mfxI32 node, mfxU32 nStep, mfxU32 *pLocal, mfxU32 *pRemote);
+
+/** \brief Keeps the calling thread on a NUMA node for the lifetime of the
+ * object, e.g. while a pipeline allocates its memory. Pages get their node
+ * when they're first touched, so that memory ends up on the node too.
+ * Does nothing for MSDK_NUMA_NODE_ANY.
+ */
+class MSDKNumaNodeScope
+{
+public:
+    MSDKNumaNodeScope(mfxI32 node);
+    ~MSDKNumaNodeScope(void);
+
+private:
+    msdk_cpu_affinity m_previous;
+    bool              m_bBound;
+
+    MSDKNumaNodeScope(const MSDKNumaNodeScope&);
+    void operator=(const MSDKNumaNodeScope&);
+};
+
+#endif // #ifndef __NUMA_DEFS_H__
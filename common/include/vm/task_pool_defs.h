@@ -0,0 +1,121 @@
+/******************************************************************************\
+Copyright (c) 2005-2018, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __TASK_POOL_DEFS_H__
+#define __TASK_POOL_DEFS_H__
+
+#include "mfxdefs.h"
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+typedef std::function<void()> msdk_task;
+
+class MSDKTaskGroup;
+
+/** \brief Fixed set of worker threads running short tasks.
+ * Every worker has its own deque: it takes its newest task first and, when
+ * the deque runs dry, steals the oldest task of another worker. Tasks
+ * submitted from within a task go to the submitting worker's deque, so
+ * nested work stays on the same core unless somebody is idle.
+ * The workers run with the MSDK_THREAD_ROLE_POOL thread policy.
+ */
+class MSDKTaskPool
+{
+public:
+    MSDKTaskPool(mfxU32 nWorkers);
+    ~MSDKTaskPool(void);
+
+    // pool shared by the process, started on first use with one worker per CPU
+    static MSDKTaskPool& GetInstance();
+    // worker count of the shared pool, has to be called before its first use
+    static void SetDefaultWorkerCount(mfxU32 nWorkers);
+
+    mfxU32 GetWorkerCount() const { return (mfxU32)m_Workers.size(); }
+    void   Submit(const msdk_task &task, MSDKTaskGroup *pGroup = NULL);
+    // runs one queued task of pGroup on the calling thread, false if there was none
+    bool   RunPendingTask(MSDKTaskGroup *pGroup);
+
+private:
+    struct sTaskItem
+    {
+        msdk_task      task;
+        MSDKTaskGroup *pGroup;
+    };
+
+    struct sWorker
+    {
+        std::mutex            mutex;
+        std::deque<sTaskItem> tasks;
+        std::thread           thread;
+    };
+
+    void WorkerLoop(mfxU32 nIndex);
+    // pGroup limits the search to the tasks of that group, NULL takes any task
+    bool PopTask(mfxU32 nIndex, sTaskItem &item, MSDKTaskGroup *pGroup = NULL);
+    void RunTask(sTaskItem &item);
+
+    std::vector<std::unique_ptr<sWorker> > m_Workers;
+    std::atomic<mfxU32>     m_nQueued;
+    std::atomic<mfxU32>     m_nNext;  // round robin for tasks from outside the pool
+    std::atomic<bool>       m_bStop;
+    std::mutex              m_sleepMutex;
+    std::condition_variable m_wakeUp;
+
+    MSDKTaskPool(const MSDKTaskPool&);
+    void operator=(const MSDKTaskPool&);
+};
+
+/** \brief Tasks which are waited for together. Wait() runs the group's own
+ * queued tasks while the group isn't done, so it may be called from a task,
+ * and never picks up unrelated work which could block the waiting thread.
+ */
+class MSDKTaskGroup
+{
+public:
+    MSDKTaskGroup(MSDKTaskPool &pool = MSDKTaskPool::GetInstance());
+    ~MSDKTaskGroup(void);
+
+    void Run(const msdk_task &task);
+    void Wait(void);
+
+private:
+    friend class MSDKTaskPool;
+    void Done(void);
+
+    MSDKTaskPool&           m_pool;
+    std::atomic<mfxU32>     m_nPending;
+    std::mutex              m_mutex;
+    std::condition_variable m_done;
+
+    MSDKTaskGroup(const MSDKTaskGroup&);
+    void operator=(const MSDKTaskGroup&);
+};
+
+// splits [begin, end) into ranges of at least nGrain and runs body(first, last + 1)
+// on them on the shared pool, returns when all are done
+void msdk_parallel_for(mfxU32 begin, mfxU32 end, const std::function<void(mfxU32, mfxU32)> &body, mfxU32 nGrain = 1);
+
+#endif // #ifndef __TASK_POOL_DEFS_H__
@@ -23,6 +23,10 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "mfxdefs.h"
 #include "vm/strings_defs.h"
 
+#include <atomic>
+#include <functional>
+#include <string>
+
 typedef unsigned int (MFX_STDCALL * msdk_thread_callback)(void*);
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -170,6 +174,55 @@ private:
     void operator=(const MSDKEvent&);
 };
 
+/** \brief Semaphore with the interface of MSDKSemaphore which spins for a
+ * while and then parks on its count word (futex on Linux, WaitOnAddress on
+ * Windows). A post without a sleeping waiter is a single atomic operation,
+ * no system call, which matters at high frame rates.
+ */
+class MSDKFutexSemaphore
+{
+public:
+    MSDKFutexSemaphore(mfxStatus &sts, mfxU32 count = 0);
+    ~MSDKFutexSemaphore(void);
+
+    mfxStatus Post(void);
+    mfxStatus Wait(void);
+
+private:
+    bool TryWait(void);
+
+    std::atomic<mfxU32> m_count;
+    std::atomic<mfxU32> m_waiters;
+
+    MSDKFutexSemaphore(const MSDKFutexSemaphore&);
+    void operator=(const MSDKFutexSemaphore&);
+};
+
+/** \brief Event with the interface of MSDKEvent, spin-then-park like
+ * MSDKFutexSemaphore.
+ */
+class MSDKFutexEvent
+{
+public:
+    MSDKFutexEvent(mfxStatus &sts, bool manual, bool state);
+    ~MSDKFutexEvent(void);
+
+    mfxStatus Signal(void);
+    mfxStatus Reset(void);
+    mfxStatus Wait(void);
+    mfxStatus TimedWait(mfxU32 msec);
+
+private:
+    bool TryWait(void);
+
+    bool                m_manual;
+    std::atomic<mfxU32> m_state;
+    std::atomic<mfxU32> m_waiters;
+
+    MSDKFutexEvent(const MSDKFutexEvent&);
+    void operator=(const MSDKFutexEvent&);
+};
+
 class MSDKThread: public msdkThreadHandle
 {
 public:
@@ -189,6 +242,45 @@ private:
     void operator=(const MSDKThread&);
 };
 
+// threads the samples create, each role can be given its own policy so that
+// e.g. the threads of live channels get isolated cores
+enum msdk_thread_role
+{
+    MSDK_THREAD_ROLE_PIPELINE = 0, // runs a pipeline's main loop
+    MSDK_THREAD_ROLE_DELIVER,      // delivers decoded frames in rendering mode
+    MSDK_THREAD_ROLE_WORKER,       // decoding host workers
+    MSDK_THREAD_ROLE_FEEDER,       // application threads feeding the input
+    MSDK_THREAD_ROLE_DRAIN,        // application threads taking the output
+    MSDK_THREAD_ROLE_CAPTURE,      // V4L2 polling
+    MSDK_THREAD_ROLE_SEGMENTER,    // closes output segments
+    MSDK_THREAD_ROLE_POOL,         // task pool workers
+    MSDK_THREAD_ROLE_COUNT
+};
+
+#define MSDK_THREAD_MAX_CPUS 1024
+
+struct msdk_thread_policy
+{
+    mfxU64 cpus[MSDK_THREAD_MAX_CPUS / 64]; // CPU set, an empty one leaves the affinity alone
+    bool   bRealtime; // SCHED_FIFO, time critical priority on Windows
+    mfxI32 priority;  // 1..99 with bRealtime, a nice level -20..19 otherwise, 0 leaves it alone
+};
+
+const char* msdk_thread_get_role_name(msdk_thread_role role);
+// adds the CPUs of a list like "0-3,8" to the policy's CPU set
+mfxStatus msdk_thread_parse_cpu_list(const char *list, msdk_thread_policy *pPolicy);
+// policies are set up once before the pipelines start their threads
+void      msdk_thread_set_role_policy(msdk_thread_role role, const msdk_thread_policy *pPolicy);
+// sets the policies of the roles named in a configuration, lookup gives the value of a key
+// and returns false for a missing one, e.g. for the decoding host workers:
+//   ThreadWorkerCpus : 0-3,8
+//   ThreadWorkerPolicy : fifo         (or normal)
+//   ThreadWorkerPriority : 50         (SCHED_FIFO priority, or the nice level with normal)
+mfxStatus msdk_thread_read_role_policies(const std::function<bool(const std::string &key, std::string &value)> &lookup);
+// names the calling thread after its role and applies the role's policy to it.
+// A CPU set replaces the NUMA binding made before.
+mfxStatus msdk_thread_apply_role(msdk_thread_role role);
+
 mfxU32 msdk_get_current_pid();
 mfxStatus msdk_setrlimit_vmem(mfxU64 size);
 mfxStatus msdk_thread_get_schedtype(const msdk_char*, mfxI32 &type);
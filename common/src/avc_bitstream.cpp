@@ -354,6 +354,7 @@ void AVCBaseBitstream::Reset(mfxU8 * const pb, const mfxU32 maxsize)
 {
     m_pbs       = (mfxU32*)pb;
     m_pbsBase   = (mfxU32*)pb;
+    m_pbsEnd    = (mfxU32*)pb + ((maxsize + 3) >> 2);
     m_bitOffset = 31;
     m_maxBsSize    = maxsize;
 
@@ -363,6 +364,7 @@ void AVCBaseBitstream::Reset(mfxU8 * const pb, mfxI32 offset, const mfxU32 maxsi
 {
     m_pbs       = (mfxU32*)pb;
     m_pbsBase   = (mfxU32*)pb;
+    m_pbsEnd    = (mfxU32*)pb + ((maxsize + 3) >> 2);
     m_bitOffset = offset;
     m_maxBsSize = maxsize;
 
@@ -382,6 +384,23 @@ mfxI32 AVCBaseBitstream::GetVLCElement(bool bIsSigned)
 {
     mfxI32 sval = 0;
 
+    // at least 33 valid bits with the current one at bit 63
+    mfxU64 w = PeekDwords() << (31 - m_bitOffset);
+    mfxU32 top = (mfxU32)(w >> 32);
+
+    if (top >= 0x00010000)
+    {
+        // up to 15 leading zeros: the whole code word is in the window
+        mfxU32 length = 2 * avcCountLeadingZeros(top) + 1;
+        mfxU32 code = (mfxU32)(w >> (64 - length)) - 1;
+
+        SkipBits(length);
+
+        if (!bIsSigned)
+            return (mfxI32)code;
+        return (code & 1) ? (mfxI32)((code + 1) >> 1) : -(mfxI32)(code >> 1);
+    }
+
     mfxStatus ippRes = DecodeExpGolombOne(&m_pbs, &m_bitOffset, &sval, bIsSigned);
 
     if (ippRes < MFX_ERR_NONE)
@@ -0,0 +1,254 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include "bitstream_segmenter.h"
+
+CBitstreamSegmenter::CBitstreamSegmenter()
+    : m_nSegmentFrames(0)
+    , m_dFrameRate(30.0)
+    , m_nInputFrames(0)
+    , m_nIndex(0)
+    , m_nFrames(0)
+    , m_bStop(false)
+    , m_bOpenPending(false)
+    , m_pNextFile(NULL)
+    , m_bManifestDirty(false)
+{
+}
+
+CBitstreamSegmenter::~CBitstreamSegmenter()
+{
+    Close();
+}
+
+mfxStatus CBitstreamSegmenter::Init(const msdk_char *strFileName, mfxU32 nSegmentFrames, mfxF64 dFrameRate)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(nSegmentFrames, 0, MFX_ERR_INVALID_VIDEO_PARAM);
+
+    Close();
+
+    msdk_string sFile(strFileName);
+    size_t nDot = sFile.rfind(MSDK_CHAR('.'));
+    size_t nSlash = sFile.find_last_of(MSDK_STRING("/\\"));
+    if (msdk_string::npos == nDot || (msdk_string::npos != nSlash && nDot < nSlash))
+        nDot = sFile.size();
+
+    m_sPrefix = sFile.substr(0, nDot);
+    m_sExtension = sFile.substr(nDot);
+    m_sManifest = m_sPrefix + MSDK_STRING(".m3u8");
+    m_sFirstSegment = SegmentName(0);
+    m_nSegmentFrames = nSegmentFrames;
+    m_dFrameRate = (dFrameRate > 0) ? dFrameRate : 30.0;
+
+    m_nInputFrames = 0;
+    m_Boundaries.clear();
+    m_nIndex = 0;
+    m_nFrames = 0;
+
+    m_bStop = false;
+    m_bManifestDirty = false;
+    m_Segments.clear();
+    // the second segment is opened right away
+    m_bOpenPending = true;
+    m_thread = std::thread(&CBitstreamSegmenter::WorkerLoop, this);
+
+    return MFX_ERR_NONE;
+}
+
+void CBitstreamSegmenter::Close()
+{
+    if (!m_thread.joinable())
+        return;
+
+    // the worker closes everything queued before it stops
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_bStop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+
+    if (m_pNextFile)
+    {
+        // opened ahead but never used
+        fclose(m_pNextFile);
+        m_pNextFile = NULL;
+        msdk_remove(SegmentName(m_nIndex + 1).c_str());
+    }
+
+    if (m_nFrames)
+    {
+        sSegment last = { SegmentName(m_nIndex), m_nFrames };
+        m_Segments.push_back(last);
+    }
+    WriteManifest(m_Segments, true);
+    m_Segments.clear();
+    m_nFrames = 0;
+}
+
+msdk_string CBitstreamSegmenter::SegmentName(mfxU32 nIndex) const
+{
+    msdk_stringstream name;
+    name << m_sPrefix << MSDK_CHAR('_');
+    name.width(5);
+    name.fill(MSDK_CHAR('0'));
+    name << nIndex;
+    name << m_sExtension;
+    return name.str();
+}
+
+bool CBitstreamSegmenter::IsBoundary(mfxU64 nTimeStamp)
+{
+    if (!m_nSegmentFrames)
+        return false;
+
+    bool bBoundary = m_nInputFrames && !(m_nInputFrames % m_nSegmentFrames);
+    m_nInputFrames++;
+
+    if (bBoundary)
+        m_Boundaries.push_back(nTimeStamp);
+
+    return bBoundary;
+}
+
+mfxStatus CBitstreamSegmenter::PrepareFrame(const mfxBitstream *pBS, FILE *&pFile, msdk_string &sFile)
+{
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    // frames in decode order: the forced IDR frame starts the segment, frames
+    // which precede it in display order were encoded before it
+    bool bStart = !m_Boundaries.empty() && (pBS->FrameType & MFX_FRAMETYPE_IDR) &&
+        ((mfxU64)MFX_TIMESTAMP_UNKNOWN == pBS->TimeStamp || (mfxU64)MFX_TIMESTAMP_UNKNOWN == m_Boundaries.front() ||
+         pBS->TimeStamp >= m_Boundaries.front());
+
+    if (bStart)
+    {
+        m_Boundaries.pop_front();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // normally the file is open long before it's needed
+        m_cond.wait(lock, [this] { return !m_bOpenPending; });
+        if (!m_pNextFile)
+        {
+            msdk_printf(MSDK_STRING("error: failed to open segment %s\n"), SegmentName(m_nIndex + 1).c_str());
+            return MFX_ERR_NULL_PTR;
+        }
+
+        sSegment finished = { sFile, m_nFrames };
+        m_Segments.push_back(finished);
+        m_bManifestDirty = true;
+        m_CloseQueue.push_back(pFile);
+
+        pFile = m_pNextFile;
+        m_pNextFile = NULL;
+        m_nIndex++;
+        sFile = SegmentName(m_nIndex);
+        m_nFrames = 0;
+
+        m_bOpenPending = true;
+        lock.unlock();
+        m_cond.notify_all();
+    }
+
+    m_nFrames++;
+    return MFX_ERR_NONE;
+}
+
+void CBitstreamSegmenter::WorkerLoop()
+{
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_SEGMENTER);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_cond.wait(lock, [this] { return m_bStop || m_bOpenPending || !m_CloseQueue.empty(); });
+
+        if (!m_CloseQueue.empty())
+        {
+            std::vector<FILE*> files;
+            files.swap(m_CloseQueue);
+            std::vector<sSegment> segments(m_Segments);
+            bool bManifest = m_bManifestDirty;
+            m_bManifestDirty = false;
+            lock.unlock();
+
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                if (files[i])
+                    fclose(files[i]);
+            }
+            // the playlist only lists files which are complete on disk
+            if (bManifest)
+                WriteManifest(segments, false);
+
+            lock.lock();
+        }
+
+        if (m_bOpenPending)
+        {
+            msdk_string sName = SegmentName(m_nIndex + 1);
+            lock.unlock();
+
+            FILE *pFile = NULL;
+            MSDK_FOPEN(pFile, sName.c_str(), MSDK_STRING("wb+"));
+
+            lock.lock();
+            m_pNextFile = pFile;
+            m_bOpenPending = false;
+            m_cond.notify_all();
+        }
+
+        if (m_bStop && m_CloseQueue.empty())
+            break;
+    }
+}
+
+void CBitstreamSegmenter::WriteManifest(const std::vector<sSegment> &segments, bool bFinal)
+{
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, m_sManifest.c_str(), MSDK_STRING("w"));
+    if (!pFile)
+        return;
+
+    mfxF64 dMaxDuration = 0;
+    for (size_t i = 0; i < segments.size(); i++)
+        dMaxDuration = (std::max)(dMaxDuration, segments[i].nFrames / m_dFrameRate);
+
+    fprintf(pFile, "#EXTM3U\n");
+    fprintf(pFile, "#EXT-X-VERSION:3\n");
+    fprintf(pFile, "#EXT-X-TARGETDURATION:%u\n", (mfxU32)ceil(dMaxDuration));
+    fprintf(pFile, "#EXT-X-MEDIA-SEQUENCE:0\n");
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        fprintf(pFile, "#EXTINF:%.3f,\n", segments[i].nFrames / m_dFrameRate);
+        // segments are next to the playlist
+        const msdk_string &name = segments[i].name;
+        msdk_fprintf(pFile, MSDK_STRING("%s\n"), name.substr(name.find_last_of(MSDK_STRING("/\\")) + 1).c_str());
+    }
+    if (bFinal)
+        fprintf(pFile, "#EXT-X-ENDLIST\n");
+
+    fclose(pFile);
+}
@@ -31,6 +31,12 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #define BRC_SCENE_CHANGE_RATIO1 20.0
 #define BRC_SCENE_CHANGE_RATIO2 5.0
 
+// lookahead: frames kept, weight of the complexity ratio in QP and QP delta limits
+#define BRC_LA_HISTORY      256
+#define BRC_LA_QP_WEIGHT    0.5
+#define BRC_LA_QP_DELTA_MIN (-2)
+#define BRC_LA_QP_DELTA_MAX 4
+
 #define IPP_MAX( a, b ) ( ((a) > (b)) ? (a) : (b) )
 #define IPP_MIN( a, b ) ( ((a) < (b)) ? (a) : (b) )
 
@@ -432,6 +438,14 @@ mfxStatus ExtBRC::Init (mfxVideoParam* par)
 
     m_ctx.dQuantAb = qp > 0 ? 1./qp : 1.0; //kw
 
+    {
+        AutomaticMutex lock(m_LAMutex);
+        sFrameComplexity empty;
+        memset(&empty, 0, sizeof(empty));
+        empty.nOrder = mfxU32(-1);
+        m_LA.assign(BRC_LA_HISTORY, empty);
+    }
+
     if (m_par.WinBRCSize)
     {
         m_avg.reset(new AVGBitrate(m_par.WinBRCSize, (mfxU32)(m_par.WinBRCMaxAvgKbps*1000.0/m_par.frameRate), (mfxU32)m_par.inputBitsPerFrame) );
@@ -612,6 +626,9 @@ mfxStatus ExtBRC::Update(mfxBRCFrameParam* frame_par, mfxBRCFrameCtrl* frame_ctr
     mfxU16 &brcSts       = status->BRCStatus;
     status->MinFrameSize  = 0;
 
+    if (frame_par->NumRecode)
+        m_nRecodes++;
+
     //printf("ExtBRC::Update:  m_ctx.encOrder %d , frame_par->EncodedOrder %d, frame_par->NumRecode %d, frame_par->CodedFrameSize %d, qp %d\n", m_ctx.encOrder , frame_par->EncodedOrder, frame_par->NumRecode, frame_par->CodedFrameSize, frame_ctrl->QpY);
 
     mfxI32 bitsEncoded  = frame_par->CodedFrameSize*8;
@@ -682,7 +699,11 @@ mfxStatus ExtBRC::Update(mfxBRCFrameParam* frame_par, mfxBRCFrameCtrl* frame_ctr
 
         //printf("m_ctx.SceneChange %d, m_ctx.poc %d, m_ctx.SChPoc, m_ctx.poc %d \n", m_ctx.SceneChange, m_ctx.poc, m_ctx.SChPoc, m_ctx.poc);
     }
-    if (e2pe > BRC_SCENE_CHANGE_RATIO2 )
+    // lookahead saw the cut before the frame was coded, no need to wait for the rate to jump
+    sFrameComplexity la;
+    bool bLASceneCut = GetFrameComplexity(frame_par->DisplayOrder, &la) && la.bSceneCut && frame_par->DisplayOrder;
+
+    if (e2pe > BRC_SCENE_CHANGE_RATIO2 || bLASceneCut)
     {
       // scene change, resetting BRC statistics
         fAbLong =  m_ctx.fAbLong  = m_par.inputBitsPerFrame;
@@ -947,12 +968,66 @@ mfxStatus ExtBRC::GetFrameCtrl (mfxBRCFrameParam* par, mfxBRCFrameCtrl* ctrl)
     {
         mfxU16 type = GetFrameType(par->FrameType,par->PyramidLayer, m_par.gopRefDist);
         qp = GetCurQP (type, par->PyramidLayer);
+
+        mfxI32 delta = GetComplexityQPDelta(par->DisplayOrder, type);
+        if (delta)
+        {
+            if (type == MFX_FRAMETYPE_I)
+                qp = mfx::clamp(qp + delta, m_par.quantMinI, m_par.quantMaxI);
+            else if (type == MFX_FRAMETYPE_P)
+                qp = mfx::clamp(qp + delta, m_par.quantMinP, m_par.quantMaxP);
+            else
+                qp = mfx::clamp(qp + delta, m_par.quantMinB, m_par.quantMaxB);
+        }
     }
     ctrl->QpY = qp - m_par.quantOffset;
     //printf("ctrl->QpY %d, qp %d quantOffset %d\n", ctrl->QpY , qp , m_par.quantOffset);
     return MFX_ERR_NONE;
 }
 
+void ExtBRC::SetFrameComplexity(mfxU32 displayOrder, const sFrameComplexity &frame)
+{
+    AutomaticMutex lock(m_LAMutex);
+    if (m_LA.empty())
+        return;
+
+    sFrameComplexity &entry = m_LA[displayOrder % m_LA.size()];
+    entry = frame;
+    entry.nOrder = displayOrder;
+}
+
+bool ExtBRC::GetFrameComplexity(mfxU32 displayOrder, sFrameComplexity *frame)
+{
+    AutomaticMutex lock(m_LAMutex);
+    if (m_LA.empty() || m_LA[displayOrder % m_LA.size()].nOrder != displayOrder)
+        return false;
+
+    *frame = m_LA[displayOrder % m_LA.size()];
+    return true;
+}
+
+// QP correction for a frame that is harder or easier than the scene so far:
+// coding cost roughly doubles every 6 QP, half of the cost ratio is given back to the frame
+mfxI32 ExtBRC::GetComplexityQPDelta(mfxU32 displayOrder, mfxU32 type)
+{
+    sFrameComplexity la;
+    if (!GetFrameComplexity(displayOrder, &la))
+        return 0;
+
+    mfxF64 cost = (type == MFX_FRAMETYPE_I) ? la.nIntraCost : la.nInterCost;
+    mfxF64 avg  = (type == MFX_FRAMETYPE_I) ? la.dAvgIntraCost : la.dAvgInterCost;
+
+    if (cost <= 0 || avg <= 0)
+        return 0;
+
+    mfxI32 delta = (mfxI32)floor(6.0 * BRC_LA_QP_WEIGHT * log(cost / avg) / log(2.0) + 0.5);
+
+    // nearly static content ahead is predicted from this I frame, it is worth a bit more
+    if (type == MFX_FRAMETYPE_I && la.dFutureInterCost > 0 && la.dFutureInterCost * 8 < cost)
+        delta--;
+    return mfx::clamp(delta, BRC_LA_QP_DELTA_MIN, BRC_LA_QP_DELTA_MAX);
+}
+
 mfxStatus ExtBRC::Reset(mfxVideoParam *par )
 {
     mfxStatus sts = MFX_ERR_NONE;
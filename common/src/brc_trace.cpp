@@ -0,0 +1,549 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "brc_trace.h"
+
+#if (MFX_VERSION >= 1024)
+
+#include <math.h>
+#include <algorithm>
+
+// a frame is encoded at most this many more times when the BRC asks for it
+#define MSDK_BRC_REPLAY_MAX_RECODES 4
+
+static const mfxU8 g_TraceMagic[8] = { 'M', 'S', 'D', 'K', 'B', 'R', 'C', 'T' };
+
+CBRCTraceWriter::CBRCTraceWriter()
+    : m_pFile(NULL)
+    , m_nFrames(0)
+{
+    MSDK_ZERO_MEMORY(m_Inner);
+}
+
+CBRCTraceWriter::~CBRCTraceWriter()
+{
+    if (m_pFile)
+        fclose(m_pFile);
+}
+
+mfxStatus CBRCTraceWriter::Attach(mfxExtBRC &brc, const msdk_char *strFileName)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(brc.pthis, MFX_ERR_NOT_INITIALIZED);
+
+    // Init of the encoder is called again on resets
+    if (brc.pthis == this)
+        return MFX_ERR_NONE;
+    if (m_pFile)
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+    MSDK_FOPEN(m_pFile, strFileName, MSDK_STRING("wb"));
+    MSDK_CHECK_POINTER(m_pFile, MFX_ERR_NULL_PTR);
+
+    mfxU32 sizes[2] = { sizeof(sBRCTraceParams), sizeof(sBRCTraceFrame) };
+    Write(g_TraceMagic, sizeof(g_TraceMagic));
+    Write(sizes, sizeof(sizes));
+    MSDK_CHECK_POINTER(m_pFile, MFX_ERR_UNKNOWN);
+
+    m_Inner = brc;
+    m_nFrames = 0;
+
+    brc.pthis = this;
+    brc.Init = Init;
+    brc.Reset = Reset;
+    brc.Close = Close;
+    brc.GetFrameCtrl = GetFrameCtrl;
+    brc.Update = Update;
+
+    msdk_printf(MSDK_STRING("BRC trace: %s\n"), strFileName);
+    return MFX_ERR_NONE;
+}
+
+void CBRCTraceWriter::Detach(mfxExtBRC &brc)
+{
+    if (brc.pthis != this)
+        return;
+
+    brc.pthis = m_Inner.pthis;
+    brc.Init = m_Inner.Init;
+    brc.Reset = m_Inner.Reset;
+    brc.Close = m_Inner.Close;
+    brc.GetFrameCtrl = m_Inner.GetFrameCtrl;
+    brc.Update = m_Inner.Update;
+    MSDK_ZERO_MEMORY(m_Inner);
+
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+        msdk_printf(MSDK_STRING("BRC trace: %u frame updates recorded\n"), m_nFrames);
+    }
+}
+
+mfxStatus CBRCTraceWriter::Init(mfxHDL pthis, mfxVideoParam *par)
+{
+    MFX_CHECK_NULL_PTR2(pthis, par);
+    CBRCTraceWriter *pWriter = (CBRCTraceWriter*)pthis;
+
+    pWriter->WriteParams(MSDK_BRC_TRACE_TAG_INIT, par);
+    return pWriter->m_Inner.Init(pWriter->m_Inner.pthis, par);
+}
+
+mfxStatus CBRCTraceWriter::Reset(mfxHDL pthis, mfxVideoParam *par)
+{
+    MFX_CHECK_NULL_PTR2(pthis, par);
+    CBRCTraceWriter *pWriter = (CBRCTraceWriter*)pthis;
+
+    // a reset starting a new sequence reinitializes the BRC
+    mfxExtEncoderResetOption *pRO = (mfxExtEncoderResetOption*)Hevc_GetExtBuffer(par->ExtParam, par->NumExtParam, MFX_EXTBUFF_ENCODER_RESET_OPTION);
+    bool bNewSequence = pRO && pRO->StartNewSequence == MFX_CODINGOPTION_ON;
+
+    pWriter->WriteParams(bNewSequence ? MSDK_BRC_TRACE_TAG_INIT : MSDK_BRC_TRACE_TAG_RESET, par);
+    return pWriter->m_Inner.Reset(pWriter->m_Inner.pthis, par);
+}
+
+mfxStatus CBRCTraceWriter::Close(mfxHDL pthis)
+{
+    MFX_CHECK_NULL_PTR1(pthis);
+    CBRCTraceWriter *pWriter = (CBRCTraceWriter*)pthis;
+
+    if (pWriter->m_pFile)
+        fflush(pWriter->m_pFile);
+    return pWriter->m_Inner.Close(pWriter->m_Inner.pthis);
+}
+
+mfxStatus CBRCTraceWriter::GetFrameCtrl(mfxHDL pthis, mfxBRCFrameParam *par, mfxBRCFrameCtrl *ctrl)
+{
+    MFX_CHECK_NULL_PTR1(pthis);
+    CBRCTraceWriter *pWriter = (CBRCTraceWriter*)pthis;
+
+    return pWriter->m_Inner.GetFrameCtrl(pWriter->m_Inner.pthis, par, ctrl);
+}
+
+mfxStatus CBRCTraceWriter::Update(mfxHDL pthis, mfxBRCFrameParam *par, mfxBRCFrameCtrl *ctrl, mfxBRCFrameStatus *status)
+{
+    MFX_CHECK_NULL_PTR1(pthis);
+    CBRCTraceWriter *pWriter = (CBRCTraceWriter*)pthis;
+
+    mfxStatus sts = pWriter->m_Inner.Update(pWriter->m_Inner.pthis, par, ctrl, status);
+    if (MFX_ERR_NONE == sts)
+        pWriter->WriteFrame(par, ctrl, status);
+    return sts;
+}
+
+void CBRCTraceWriter::WriteParams(mfxU32 nTag, const mfxVideoParam *par)
+{
+    sBRCTraceParams params;
+    MSDK_ZERO_MEMORY(params);
+    params.mfx = par->mfx;
+
+    mfxExtBuffer *pCO = Hevc_GetExtBuffer(par->ExtParam, par->NumExtParam, MFX_EXTBUFF_CODING_OPTION);
+    mfxExtBuffer *pCO2 = Hevc_GetExtBuffer(par->ExtParam, par->NumExtParam, MFX_EXTBUFF_CODING_OPTION2);
+    mfxExtBuffer *pCO3 = Hevc_GetExtBuffer(par->ExtParam, par->NumExtParam, MFX_EXTBUFF_CODING_OPTION3);
+    if (pCO)
+    {
+        params.bCO = 1;
+        params.CO = *(mfxExtCodingOption*)pCO;
+    }
+    if (pCO2)
+    {
+        params.bCO2 = 1;
+        params.CO2 = *(mfxExtCodingOption2*)pCO2;
+    }
+    if (pCO3)
+    {
+        params.bCO3 = 1;
+        params.CO3 = *(mfxExtCodingOption3*)pCO3;
+    }
+
+    Write(&nTag, sizeof(nTag));
+    Write(&params, sizeof(params));
+}
+
+void CBRCTraceWriter::WriteFrame(const mfxBRCFrameParam *par, const mfxBRCFrameCtrl *ctrl, const mfxBRCFrameStatus *status)
+{
+    if (!par || !ctrl || !status)
+        return;
+
+    sBRCTraceFrame frame;
+    MSDK_ZERO_MEMORY(frame);
+    frame.nEncodedOrder = par->EncodedOrder;
+    frame.nDisplayOrder = par->DisplayOrder;
+    frame.nCodedFrameSize = par->CodedFrameSize;
+    frame.nFrameType = par->FrameType;
+    frame.nPyramidLayer = par->PyramidLayer;
+    frame.nNumRecode = par->NumRecode;
+    frame.nQpY = (mfxI16)ctrl->QpY;
+    frame.nBRCStatus = status->BRCStatus;
+    frame.nMinFrameSize = status->MinFrameSize;
+
+    mfxU32 nTag = MSDK_BRC_TRACE_TAG_FRAME;
+    Write(&nTag, sizeof(nTag));
+    Write(&frame, sizeof(frame));
+    m_nFrames++;
+}
+
+void CBRCTraceWriter::Write(const void *pData, size_t nSize)
+{
+    if (m_pFile && fwrite(pData, nSize, 1, m_pFile) != 1)
+    {
+        msdk_printf(MSDK_STRING("BRC trace: write failed, tracing stopped\n"));
+        fclose(m_pFile);
+        m_pFile = NULL;
+    }
+}
+
+// rates of the stream and its CPB, in bits
+struct sBRCReplayRates
+{
+    mfxF64 dFrameRate;
+    mfxF64 dBitsPerFrame;   // CPB input per frame, the maximum rate with VBR
+    mfxF64 dCpbSize;
+    mfxF64 dInitialDelay;
+    bool   bHRD;
+    bool   bCBR;
+};
+
+static void GetReplayRates(const sBRCTraceParams &params, sBRCReplayRates &rates)
+{
+    const mfxInfoMFX &mfx = params.mfx;
+    mfxF64 k = mfx.BRCParamMultiplier ? mfx.BRCParamMultiplier : 1;
+
+    rates.bCBR = mfx.RateControlMethod == MFX_RATECONTROL_CBR;
+    rates.dFrameRate = mfx.FrameInfo.FrameRateExtD ? (mfxF64)mfx.FrameInfo.FrameRateExtN / mfx.FrameInfo.FrameRateExtD : 30;
+    if (rates.dFrameRate <= 0)
+        rates.dFrameRate = 30;
+
+    mfxF64 bps = k * mfx.TargetKbps * 1000;
+    if (!rates.bCBR)
+        bps = (std::max)(bps, k * mfx.MaxKbps * 1000);
+    rates.dBitsPerFrame = bps / rates.dFrameRate;
+
+    rates.dCpbSize = k * mfx.BufferSizeInKB * 8000;
+    rates.dInitialDelay = k * mfx.InitialDelayInKB * 8000;
+    rates.bHRD = rates.dCpbSize > 0 && !(params.bCO && params.CO.NalHrdConformance == MFX_CODINGOPTION_OFF);
+}
+
+CBRCReplay::CBRCReplay()
+{
+    MSDK_ZERO_MEMORY(m_Params);
+    MSDK_ZERO_MEMORY(m_Recorded);
+}
+
+CBRCReplay::~CBRCReplay()
+{
+}
+
+mfxStatus CBRCReplay::Load(const msdk_char *strFileName)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+
+    m_Frames.clear();
+    m_Events.clear();
+    m_EventParams.clear();
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strFileName, MSDK_STRING("rb"));
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+
+    mfxU8 magic[sizeof(g_TraceMagic)];
+    mfxU32 sizes[2] = {};
+    bool bOk = fread(magic, sizeof(magic), 1, pFile) == 1 && 0 == memcmp(magic, g_TraceMagic, sizeof(magic)) &&
+        fread(sizes, sizeof(sizes), 1, pFile) == 1;
+    if (!bOk || sizes[0] != sizeof(sBRCTraceParams) || sizes[1] != sizeof(sBRCTraceFrame))
+    {
+        fclose(pFile);
+        msdk_printf(MSDK_STRING("BRC replay: %s is not a trace of this build\n"), strFileName);
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    bool bInit = false;
+    mfxU32 nTag = 0;
+    while (fread(&nTag, sizeof(nTag), 1, pFile) == 1)
+    {
+        if (MSDK_BRC_TRACE_TAG_INIT == nTag || MSDK_BRC_TRACE_TAG_RESET == nTag)
+        {
+            sBRCTraceParams params;
+            if (fread(&params, sizeof(params), 1, pFile) != 1)
+                break;
+
+            // resets before the first frame only change the starting parameters
+            if (m_Frames.empty())
+            {
+                m_Recorded = params;
+                bInit = true;
+                continue;
+            }
+
+            sEvent event = { (mfxU32)m_Frames.size(), nTag, (mfxU32)m_EventParams.size() };
+            m_Events.push_back(event);
+            m_EventParams.push_back(params);
+        }
+        else if (MSDK_BRC_TRACE_TAG_FRAME == nTag)
+        {
+            sBRCTraceFrame frame;
+            if (fread(&frame, sizeof(frame), 1, pFile) != 1)
+                break;
+            if (!bInit)
+                continue;
+
+            // recodes of a frame replace its earlier updates, the last one was kept by the encoder
+            bool bRecode = !m_Frames.empty() && frame.nNumRecode != 0 &&
+                m_Frames.back().nEncodedOrder == frame.nEncodedOrder &&
+                (m_Events.empty() || m_Events.back().nFrame < m_Frames.size());
+            if (bRecode)
+                m_Frames.back() = frame;
+            else
+                m_Frames.push_back(frame);
+        }
+        else
+        {
+            fclose(pFile);
+            msdk_printf(MSDK_STRING("BRC replay: unknown record in %s\n"), strFileName);
+            return MFX_ERR_UNSUPPORTED;
+        }
+    }
+
+    // a trace of an encode which did not finish ends with a partial record
+    if (!feof(pFile))
+        msdk_printf(MSDK_STRING("BRC replay: %s is truncated, %u frames read\n"), strFileName, (mfxU32)m_Frames.size());
+    fclose(pFile);
+
+    if (!bInit)
+    {
+        msdk_printf(MSDK_STRING("BRC replay: no BRC parameters in %s\n"), strFileName);
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    m_Params = m_Recorded;
+    return MFX_ERR_NONE;
+}
+
+void CBRCReplay::MakeVideoParam(sBRCTraceParams &params, mfxVideoParam &par, mfxExtBuffer *buffers[3])
+{
+    MSDK_ZERO_MEMORY(par);
+    par.mfx = params.mfx;
+
+    mfxU16 n = 0;
+    if (params.bCO)
+    {
+        params.CO.Header.BufferId = MFX_EXTBUFF_CODING_OPTION;
+        params.CO.Header.BufferSz = sizeof(params.CO);
+        buffers[n++] = &params.CO.Header;
+    }
+    if (params.bCO2)
+    {
+        params.CO2.Header.BufferId = MFX_EXTBUFF_CODING_OPTION2;
+        params.CO2.Header.BufferSz = sizeof(params.CO2);
+        buffers[n++] = &params.CO2.Header;
+    }
+    if (params.bCO3)
+    {
+        params.CO3.Header.BufferId = MFX_EXTBUFF_CODING_OPTION3;
+        params.CO3.Header.BufferSz = sizeof(params.CO3);
+        buffers[n++] = &params.CO3.Header;
+    }
+    par.ExtParam = n ? buffers : NULL;
+    par.NumExtParam = n;
+}
+
+mfxStatus CBRCReplay::Run(sBRCReplayStats *pStats, const msdk_char *strCurvesFile)
+{
+    MSDK_CHECK_POINTER(pStats, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(m_Frames.empty(), true, MFX_ERR_NOT_INITIALIZED);
+
+    MSDK_ZERO_MEMORY(*pStats);
+    pStats->nMinQP = 0x7fffffff;
+    pStats->dMinCpbFullness = 1;
+
+    // recorded resets would undo the changed parameters
+    bool bApplyEvents = 0 == memcmp(&m_Params, &m_Recorded, sizeof(m_Params));
+    if (!bApplyEvents && !m_Events.empty())
+        msdk_printf(MSDK_STRING("BRC replay: parameters changed, %u recorded resets not applied\n"), (mfxU32)m_Events.size());
+
+    sBRCTraceParams params = m_Params;
+    mfxVideoParam par;
+    mfxExtBuffer *buffers[3];
+    MakeVideoParam(params, par, buffers);
+
+    ExtBRC brc;
+    mfxStatus sts = brc.Init(&par);
+    MSDK_CHECK_STATUS(sts, "ExtBRC Init failed");
+
+    sBRCReplayRates rates;
+    GetReplayRates(params, rates);
+    mfxF64 fullness = rates.dInitialDelay;
+
+    FILE *pCurves = NULL;
+    if (strCurvesFile && *strCurvesFile)
+    {
+        MSDK_FOPEN(pCurves, strCurvesFile, MSDK_STRING("w"));
+        MSDK_CHECK_POINTER(pCurves, MFX_ERR_NULL_PTR);
+        fprintf(pCurves, "frame,type,layer,qp,bytes,recodes,status,window_kbps,cpb_fullness\n");
+    }
+
+    // bits of the last second of frames
+    std::vector<mfxU64> window((std::max)(1, (int)(rates.dFrameRate + 0.5)), 0);
+    mfxU64 nWindowBits = 0;
+    mfxU64 nTotalBits = 0;
+    mfxF64 dSumQP = 0;
+    size_t nEvent = 0;
+
+    for (mfxU32 i = 0; i < (mfxU32)m_Frames.size(); i++)
+    {
+        for (; nEvent < m_Events.size() && m_Events[nEvent].nFrame == i; nEvent++)
+        {
+            if (!bApplyEvents)
+                continue;
+
+            params = m_EventParams[m_Events[nEvent].nParams];
+            MakeVideoParam(params, par, buffers);
+            bool bNewSequence = MSDK_BRC_TRACE_TAG_INIT == m_Events[nEvent].nTag;
+            if (bNewSequence)
+            {
+                brc.Close();
+                sts = brc.Init(&par);
+            }
+            else
+            {
+                sts = brc.Reset(&par);
+            }
+            if (MFX_ERR_NONE != sts)
+            {
+                if (pCurves)
+                    fclose(pCurves);
+                MSDK_CHECK_STATUS(sts, "ExtBRC Init/Reset failed");
+            }
+
+            GetReplayRates(params, rates);
+            if (bNewSequence)
+                fullness = rates.dInitialDelay;
+        }
+
+        const sBRCTraceFrame &frame = m_Frames[i];
+
+        mfxBRCFrameParam frameParam;
+        MSDK_ZERO_MEMORY(frameParam);
+        frameParam.EncodedOrder = frame.nEncodedOrder;
+        frameParam.DisplayOrder = frame.nDisplayOrder;
+        frameParam.FrameType = frame.nFrameType;
+        frameParam.PyramidLayer = frame.nPyramidLayer;
+
+        mfxI32 qp = 0;
+        mfxU32 nBytes = 0;
+        mfxU32 nMinBytes = 0;
+        mfxU16 brcStatus = MFX_BRC_OK;
+        for (;; frameParam.NumRecode++)
+        {
+            mfxBRCFrameCtrl ctrl;
+            MSDK_ZERO_MEMORY(ctrl);
+            sts = brc.GetFrameCtrl(&frameParam, &ctrl);
+            if (MFX_ERR_NONE != sts)
+                break;
+
+            // the encoder pads a frame the CPB would overflow on
+            qp = ctrl.QpY;
+            mfxF64 size = frame.nCodedFrameSize * pow(2.0, (frame.nQpY - qp) / 6.0);
+            nBytes = (std::max)((mfxU32)(size + 0.5), (std::max)(nMinBytes, (mfxU32)1));
+            frameParam.CodedFrameSize = nBytes;
+
+            mfxBRCFrameStatus status;
+            MSDK_ZERO_MEMORY(status);
+            sts = brc.Update(&frameParam, &ctrl, &status);
+            if (MFX_ERR_NONE != sts)
+                break;
+
+            brcStatus = status.BRCStatus;
+            if (MFX_BRC_OK == brcStatus || frameParam.NumRecode >= MSDK_BRC_REPLAY_MAX_RECODES)
+                break;
+            if (MFX_BRC_PANIC_SMALL_FRAME == brcStatus)
+                nMinBytes = (status.MinFrameSize + 7) >> 3;
+            pStats->nRecodes++;
+        }
+        if (MFX_ERR_NONE != sts)
+            pStats->nErrors++;
+        else if (MFX_BRC_OK != brcStatus)
+            pStats->nPanicFrames++;
+
+        mfxU64 nBits = (mfxU64)nBytes * 8;
+        if (rates.bHRD)
+        {
+            pStats->bHRD = true;
+            pStats->dMinCpbFullness = (std::min)(pStats->dMinCpbFullness, fullness / rates.dCpbSize);
+            if (nBits > fullness)
+            {
+                pStats->nHRDUnderflows++;
+                fullness = 0;
+            }
+            else
+            {
+                fullness -= nBits;
+            }
+
+            fullness += rates.dBitsPerFrame;
+            if (fullness > rates.dCpbSize)
+            {
+                if (rates.bCBR)
+                    pStats->nHRDOverflows++;
+                fullness = rates.dCpbSize;
+            }
+        }
+
+        mfxU64 &slot = window[i % window.size()];
+        nWindowBits += nBits - slot;
+        slot = nBits;
+        mfxF64 dWindowKbps = nWindowBits * rates.dFrameRate / (std::min)((mfxU32)window.size(), i + 1) / 1000;
+        if (i + 1 >= window.size())
+            pStats->dMaxWindowKbps = (std::max)(pStats->dMaxWindowKbps, dWindowKbps);
+
+        nTotalBits += nBits;
+        dSumQP += qp;
+        pStats->nMinQP = (std::min)(pStats->nMinQP, qp);
+        pStats->nMaxQP = (std::max)(pStats->nMaxQP, qp);
+        pStats->nFrames++;
+
+        if (pCurves)
+        {
+            char type = (frame.nFrameType & (MFX_FRAMETYPE_I | MFX_FRAMETYPE_IDR)) ? 'I' : (frame.nFrameType & MFX_FRAMETYPE_P) ? 'P' : 'B';
+            fprintf(pCurves, "%u,%c,%u,%d,%u,%u,%u,%.1f,%.3f\n", i, type, frame.nPyramidLayer, qp, nBytes,
+                frameParam.NumRecode, brcStatus, dWindowKbps, rates.bHRD ? fullness / rates.dCpbSize : 1.0);
+        }
+    }
+
+    if (pCurves)
+        fclose(pCurves);
+    brc.Close();
+
+    pStats->dAvgKbps = nTotalBits * rates.dFrameRate / pStats->nFrames / 1000;
+    pStats->dAvgQP = dSumQP / pStats->nFrames;
+    return MFX_ERR_NONE;
+}
+
+void CBRCReplay::PrintStats(const sBRCReplayStats &stats)
+{
+    msdk_printf(MSDK_STRING("BRC replay: %u frames, %u recodes, %u panic frames, %u errors\n"),
+        stats.nFrames, stats.nRecodes, stats.nPanicFrames, stats.nErrors);
+    msdk_printf(MSDK_STRING("  bitrate %.1f kbps, max over 1 s %.1f kbps\n"), stats.dAvgKbps, stats.dMaxWindowKbps);
+    msdk_printf(MSDK_STRING("  QP avg %.2f, min %d, max %d\n"), stats.dAvgQP, stats.nMinQP, stats.nMaxQP);
+    if (stats.bHRD)
+        msdk_printf(MSDK_STRING("  HRD underflows %u, overflows %u, lowest CPB fullness %.1f%%\n"),
+            stats.nHRDUnderflows, stats.nHRDOverflows, stats.dMinCpbFullness * 100);
+}
+
+#endif // MFX_VERSION >= 1024
@@ -0,0 +1,95 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "emulation_prevention.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MSDK_EPB_SSE2
+#include <emmintrin.h>
+#endif
+
+// Escapes need two zero bytes, so a block without any zero byte is copied as it is,
+// only its first byte may complete an escape started in the previous block.
+#define MSDK_EPB_BLOCK 32
+
+static inline bool HasZeroByte(const mfxU8 *p)
+{
+#ifdef MSDK_EPB_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero);
+    __m128i hi = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), zero);
+    return 0 != _mm_movemask_epi8(_mm_or_si128(lo, hi));
+#else
+    const mfxU64 lsb = 0x0101010101010101ULL;
+    const mfxU64 msb = 0x8080808080808080ULL;
+    mfxU64 v[MSDK_EPB_BLOCK / 8];
+    mfxU64 acc = 0;
+
+    memcpy(v, p, sizeof(v));
+    for (mfxU32 i = 0; i < MSDK_EPB_BLOCK / 8; i++)
+        acc |= (v[i] - lsb) & ~v[i] & msb;
+    return 0 != acc;
+#endif
+}
+
+static inline void CopyBlock(mfxU8 *pDst, const mfxU8 *pSrc)
+{
+#ifdef MSDK_EPB_SSE2
+    _mm_storeu_si128((__m128i*)pDst, _mm_loadu_si128((const __m128i*)pSrc));
+    _mm_storeu_si128((__m128i*)(pDst + 16), _mm_loadu_si128((const __m128i*)(pSrc + 16)));
+#else
+    memcpy(pDst, pSrc, MSDK_EPB_BLOCK);
+#endif
+}
+
+mfxU32 RemoveEmulationPrevention(mfxU8 *pDst, const mfxU8 *pSrc, mfxU32 nSize)
+{
+    mfxU32 nZeros = 0; // zero bytes right before pSrc[i]
+    mfxU32 i = 0, n = 0;
+
+    while (i < nSize)
+    {
+        if (i + MSDK_EPB_BLOCK <= nSize && (nZeros < 2 || pSrc[i] != 3) && !HasZeroByte(pSrc + i))
+        {
+            CopyBlock(pDst + n, pSrc + i);
+            i += MSDK_EPB_BLOCK;
+            n += MSDK_EPB_BLOCK;
+            nZeros = 0;
+            continue;
+        }
+
+        mfxU32 nEnd = MSDK_MIN(nSize, i + MSDK_EPB_BLOCK);
+        for (; i < nEnd; i++)
+        {
+            mfxU8 b = pSrc[i];
+
+            if (nZeros >= 2 && 3 == b)
+            {
+                nZeros = 0;
+                continue;
+            }
+            pDst[n++] = b;
+            nZeros = b ? 0 : nZeros + 1;
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,160 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "frame_ctrl_table.h"
+
+CFrameCtrlTable::CFrameCtrlTable()
+    : m_nFlags(0)
+{
+}
+
+CFrameCtrlTable::~CFrameCtrlTable()
+{
+    Close();
+}
+
+void CFrameCtrlTable::Close()
+{
+    m_Entries.clear();
+    m_nFlags = 0;
+}
+
+static bool IsRoundingValid(mfxU16 nEnable, mfxU16 nOffset)
+{
+    if (MFX_CODINGOPTION_ON == nEnable)
+        return nOffset <= 7;
+    return MFX_CODINGOPTION_UNKNOWN == nEnable || MFX_CODINGOPTION_OFF == nEnable;
+}
+
+mfxStatus CFrameCtrlTable::Check(const sFrameCtrlEntry &entry, mfxU32 nFrame) const
+{
+    bool bOk = !(entry.Flags & ~(MSDK_FRAME_CTRL_ROUNDING | MSDK_FRAME_CTRL_QP_DELTA | MSDK_FRAME_CTRL_FRAME_TYPE));
+
+    if (bOk && (entry.Flags & MSDK_FRAME_CTRL_ROUNDING))
+    {
+        for (mfxU32 i = 0; i < MSDK_ARRAY_LEN(entry.Rounding); i++)
+        {
+            bOk = bOk && IsRoundingValid(entry.Rounding[i].EnableIntra, entry.Rounding[i].OffsetIntra) &&
+                IsRoundingValid(entry.Rounding[i].EnableInter, entry.Rounding[i].OffsetInter);
+        }
+    }
+    if (bOk && (entry.Flags & MSDK_FRAME_CTRL_QP_DELTA))
+        bOk = entry.QPDelta >= -51 && entry.QPDelta <= 51;
+    if (bOk && (entry.Flags & MSDK_FRAME_CTRL_FRAME_TYPE))
+    {
+        // exactly one of I, P and B, IDR only with I
+        mfxU16 type = entry.FrameType & (MFX_FRAMETYPE_I | MFX_FRAMETYPE_P | MFX_FRAMETYPE_B);
+        bOk = (MFX_FRAMETYPE_I == type || MFX_FRAMETYPE_P == type || MFX_FRAMETYPE_B == type) &&
+            !(entry.FrameType & ~(type | MFX_FRAMETYPE_REF | MFX_FRAMETYPE_IDR)) &&
+            (MFX_FRAMETYPE_I == type || !(entry.FrameType & MFX_FRAMETYPE_IDR));
+    }
+
+    if (!bOk)
+    {
+        msdk_printf(MSDK_STRING("Frame control table: invalid entry of frame %u\n"), nFrame);
+        return MFX_ERR_INVALID_VIDEO_PARAM;
+    }
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CFrameCtrlTable::Load(const msdk_char *strFileName, mfxU16 nFields)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+    if (nFields < 1 || nFields > 2)
+        return MFX_ERR_UNSUPPORTED;
+
+    Close();
+
+    // the whole file at once, the table is small next to a single frame
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strFileName, MSDK_STRING("rb"));
+    if (!pFile)
+    {
+        msdk_printf(MSDK_STRING("ERROR: Can't open file %s\n"), strFileName);
+        return MFX_ERR_NOT_FOUND;
+    }
+    std::vector<mfxU8> data;
+    mfxU8 buf[64 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pFile)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(pFile);
+
+    sFrameCtrlTableHeader header;
+    MSDK_ZERO_MEMORY(header);
+    if (data.size() >= sizeof(header))
+        memcpy(&header, data.data(), sizeof(header));
+
+    if (MSDK_FRAME_CTRL_TABLE_MAGIC == header.Magic)
+    {
+        bool bOk = MSDK_FRAME_CTRL_TABLE_VERSION == header.Version && sizeof(sFrameCtrlEntry) == header.EntrySize &&
+            (1 == header.NumFields || 2 == header.NumFields) &&
+            data.size() == sizeof(header) + (mfxU64)header.NumFrames * header.EntrySize;
+        if (!bOk)
+        {
+            msdk_printf(MSDK_STRING("Frame control table: %s has a wrong header or size\n"), strFileName);
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        m_Entries.resize(header.NumFrames);
+        if (header.NumFrames)
+            memcpy(m_Entries.data(), data.data() + sizeof(header), header.NumFrames * sizeof(sFrameCtrlEntry));
+        // a table with one set of rounding offsets per frame is used for both fields
+        if (1 == header.NumFields)
+        {
+            for (size_t i = 0; i < m_Entries.size(); i++)
+                m_Entries[i].Rounding[1] = m_Entries[i].Rounding[0];
+        }
+    }
+    else
+    {
+        // the older rounding offset file: it cannot start with the magic, that is no valid EnableRoundingIntra
+        const size_t nFrameSize = nFields * sizeof(sRoundingOffset);
+        if (data.empty() || data.size() % nFrameSize)
+        {
+            msdk_printf(MSDK_STRING("Frame control table: %s is not a whole number of rounding offset frames\n"), strFileName);
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        m_Entries.resize(data.size() / nFrameSize);
+        for (size_t i = 0; i < m_Entries.size(); i++)
+        {
+            sFrameCtrlEntry &entry = m_Entries[i];
+            MSDK_ZERO_MEMORY(entry);
+            entry.Flags = MSDK_FRAME_CTRL_ROUNDING;
+            memcpy(entry.Rounding, data.data() + i * nFrameSize, nFrameSize);
+            if (1 == nFields)
+                entry.Rounding[1] = entry.Rounding[0];
+        }
+    }
+
+    for (size_t i = 0; i < m_Entries.size(); i++)
+    {
+        mfxStatus sts = Check(m_Entries[i], (mfxU32)i);
+        if (MFX_ERR_NONE != sts)
+        {
+            Close();
+            return sts;
+        }
+        m_nFlags |= m_Entries[i].Flags;
+    }
+
+    msdk_printf(MSDK_STRING("Frame control table: %u frames from %s\n"), GetFrameCount(), strFileName);
+    return MFX_ERR_NONE;
+}
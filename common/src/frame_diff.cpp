@@ -0,0 +1,202 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "frame_diff.h"
+#include "vm/task_pool_defs.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MSDK_FRAME_DIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+// Hash of a tile: four 32 bit lanes take a row of 16 pixels each step, and every step
+// is invertible, so a change in one row always changes the hash of the tile.
+static const mfxU32 g_HashSeed[4] = { 0x9E3779B9, 0x85EBCA6B, 0xC2B2AE35, 0x27D4EB2F };
+
+static void HashTile(const mfxU8 *pSrc, mfxU32 nPitch, mfxU32 nWidth, mfxU32 nRows, mfxU64 *pLo, mfxU64 *pHi)
+{
+    mfxU8 row[MSDK_FRAME_DIFF_TILE] = {};
+#ifdef MSDK_FRAME_DIFF_SSE2
+    __m128i h = _mm_loadu_si128((const __m128i*)g_HashSeed);
+    for (mfxU32 y = 0; y < nRows; y++)
+    {
+        __m128i v;
+        if (nWidth == MSDK_FRAME_DIFF_TILE)
+        {
+            v = _mm_loadu_si128((const __m128i*)(pSrc + y * nPitch));
+        }
+        else
+        {
+            // the right edge is padded with zeros
+            memcpy(row, pSrc + y * nPitch, nWidth);
+            v = _mm_loadu_si128((const __m128i*)row);
+        }
+        h = _mm_xor_si128(h, v);
+        h = _mm_add_epi32(h, _mm_slli_epi32(h, 10));
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 6));
+        h = _mm_shuffle_epi32(h, _MM_SHUFFLE(0, 3, 2, 1));
+    }
+    mfxU32 lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, h);
+#else
+    mfxU32 lanes[4] = { g_HashSeed[0], g_HashSeed[1], g_HashSeed[2], g_HashSeed[3] };
+    for (mfxU32 y = 0; y < nRows; y++)
+    {
+        memcpy(row, pSrc + y * nPitch, nWidth);
+        mfxU32 h[4];
+        for (mfxU32 l = 0; l < 4; l++)
+        {
+            mfxU32 v = row[4 * l] | (row[4 * l + 1] << 8) | (row[4 * l + 2] << 16) | ((mfxU32)row[4 * l + 3] << 24);
+            h[l] = lanes[l] ^ v;
+            h[l] += h[l] << 10;
+            h[l] ^= h[l] >> 6;
+        }
+        for (mfxU32 l = 0; l < 4; l++)
+            lanes[l] = h[(l + 1) & 3];
+    }
+#endif
+    *pLo = lanes[0] | ((mfxU64)lanes[1] << 32);
+    *pHi = lanes[2] | ((mfxU64)lanes[3] << 32);
+}
+
+CFrameDiff::CFrameDiff()
+    : m_nWidth(0)
+    , m_nHeight(0)
+    , m_nTilesX(0)
+    , m_nTilesY(0)
+    , m_nDirty(0)
+    , m_nFrames(0)
+    , m_nDuplicates(0)
+    , m_nDirtyTotal(0)
+    , m_nTilesTotal(0)
+    , m_nTicks(0)
+{
+}
+
+CFrameDiff::~CFrameDiff()
+{
+    Close();
+}
+
+void CFrameDiff::Close()
+{
+    m_Hash.clear();
+    m_Dirty.clear();
+    m_nWidth = m_nHeight = 0;
+    m_nTilesX = m_nTilesY = 0;
+    m_nDirty = 0;
+    m_nFrames = 0;
+    m_nDuplicates = 0;
+    m_nDirtyTotal = 0;
+    m_nTilesTotal = 0;
+    m_nTicks = 0;
+}
+
+mfxU32 CFrameDiff::Compare(const mfxU8 *pY, mfxU32 nWidth, mfxU32 nHeight, mfxU32 nPitch)
+{
+    MSDK_CHECK_POINTER(pY, 0);
+    msdk_tick start = msdk_time_get_tick();
+
+    bool bNewSize = (nWidth != m_nWidth || nHeight != m_nHeight);
+    if (bNewSize)
+    {
+        m_nWidth = nWidth;
+        m_nHeight = nHeight;
+        m_nTilesX = (nWidth + MSDK_FRAME_DIFF_TILE - 1) / MSDK_FRAME_DIFF_TILE;
+        m_nTilesY = (nHeight + MSDK_FRAME_DIFF_TILE - 1) / MSDK_FRAME_DIFF_TILE;
+        m_Hash.resize(m_nTilesX * m_nTilesY);
+        m_Dirty.resize(m_nTilesX * m_nTilesY);
+    }
+
+    std::atomic<mfxU32> dirty(0);
+    msdk_parallel_for(0, m_nTilesY, [&](mfxU32 first, mfxU32 last)
+    {
+        mfxU32 count = 0;
+        for (mfxU32 ty = first; ty < last; ty++)
+        {
+            const mfxU32 rows = (std::min)(nHeight - ty * MSDK_FRAME_DIFF_TILE, (mfxU32)MSDK_FRAME_DIFF_TILE);
+            for (mfxU32 tx = 0; tx < m_nTilesX; tx++)
+            {
+                const mfxU32 cols = (std::min)(nWidth - tx * MSDK_FRAME_DIFF_TILE, (mfxU32)MSDK_FRAME_DIFF_TILE);
+                sTileHash hash;
+                HashTile(pY + (size_t)ty * MSDK_FRAME_DIFF_TILE * nPitch + tx * MSDK_FRAME_DIFF_TILE, nPitch, cols, rows, &hash.lo, &hash.hi);
+
+                sTileHash &prev = m_Hash[ty * m_nTilesX + tx];
+                mfxU8 bDirty = bNewSize || hash.lo != prev.lo || hash.hi != prev.hi;
+                m_Dirty[ty * m_nTilesX + tx] = bDirty;
+                prev = hash;
+                count += bDirty;
+            }
+        }
+        dirty += count;
+    });
+
+    m_nDirty = dirty;
+    m_nFrames++;
+    if (!m_nDirty)
+        m_nDuplicates++;
+    m_nDirtyTotal += m_nDirty;
+    m_nTilesTotal += m_nTilesX * m_nTilesY;
+    m_nTicks += msdk_time_get_tick() - start;
+
+    return m_nDirty;
+}
+
+bool CFrameDiff::GetDirtyRect(mfxU32 *pLeft, mfxU32 *pTop, mfxU32 *pRight, mfxU32 *pBottom) const
+{
+    MSDK_CHECK_POINTER(pLeft, false);
+    MSDK_CHECK_POINTER(pTop, false);
+    MSDK_CHECK_POINTER(pRight, false);
+    MSDK_CHECK_POINTER(pBottom, false);
+    if (!m_nDirty)
+        return false;
+
+    mfxU32 x0 = m_nTilesX, y0 = m_nTilesY, x1 = 0, y1 = 0;
+    for (mfxU32 ty = 0; ty < m_nTilesY; ty++)
+    {
+        for (mfxU32 tx = 0; tx < m_nTilesX; tx++)
+        {
+            if (!m_Dirty[ty * m_nTilesX + tx])
+                continue;
+            x0 = (std::min)(x0, tx);
+            y0 = (std::min)(y0, ty);
+            x1 = (std::max)(x1, tx + 1);
+            y1 = (std::max)(y1, ty + 1);
+        }
+    }
+
+    *pLeft = x0 * MSDK_FRAME_DIFF_TILE;
+    *pTop = y0 * MSDK_FRAME_DIFF_TILE;
+    *pRight = (std::min)(x1 * MSDK_FRAME_DIFF_TILE, m_nWidth);
+    *pBottom = (std::min)(y1 * MSDK_FRAME_DIFF_TILE, m_nHeight);
+    return true;
+}
+
+mfxF64 CFrameDiff::GetAvgDirtyRatio() const
+{
+    return m_nTilesTotal ? (mfxF64)m_nDirtyTotal / m_nTilesTotal : 0;
+}
+
+mfxF64 CFrameDiff::GetAvgTimeMs() const
+{
+    return m_nFrames ? 1000.0 * m_nTicks / msdk_time_get_frequency() / m_nFrames : 0;
+}
@@ -68,8 +68,11 @@ mfxStatus GeneralAllocator::Init(mfxAllocatorParams *pParams)
         MSDK_CHECK_STATUS(sts, "m_D3DAllocator.get failed");
     }
 
+    // system memory only: its parameters go to the system memory allocator
+    SysMemAllocatorParams *sysMemAllocParams = dynamic_cast<SysMemAllocatorParams*>(pParams);
+
     m_SYSAllocator.reset(new SysMemFrameAllocator);
-    sts = m_SYSAllocator.get()->Init(0);
+    sts = m_SYSAllocator.get()->Init(sysMemAllocParams);
     MSDK_CHECK_STATUS(sts, "m_SYSAllocator.get failed");
 
     return sts;
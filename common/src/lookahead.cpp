@@ -0,0 +1,320 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "lookahead.h"
+#include "vm/task_pool_defs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MSDK_LA_SSE2
+#include <emmintrin.h>
+#endif
+
+// inter search at the downscaled size, in pixels each way
+#define MSDK_LA_SEARCH_RANGE 3
+// a scene cut: the previous frame predicts little and the frame costs well above
+// the average of the scene so far, or it predicts nothing and the cost still jumps
+#define MSDK_LA_SCENECUT_INTRA_RATIO  0.6
+#define MSDK_LA_SCENECUT_AVG_RATIO    3.0
+#define MSDK_LA_SCENECUT_INTRA_RATIO2 0.85
+#define MSDK_LA_SCENECUT_AVG_RATIO2   1.2
+// frames in the running averages
+#define MSDK_LA_AVG_PERIOD 8
+
+static inline mfxU32 Sad8x8(const mfxU8 *a, const mfxU8 *b, mfxU32 pitch)
+{
+#ifdef MSDK_LA_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for (mfxU32 y = 0; y < 8; y += 2)
+    {
+        __m128i va = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(a + y * pitch)), _mm_loadl_epi64((const __m128i*)(a + (y + 1) * pitch)));
+        __m128i vb = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(b + y * pitch)), _mm_loadl_epi64((const __m128i*)(b + (y + 1) * pitch)));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    return (mfxU32)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#else
+    mfxU32 sad = 0;
+    for (mfxU32 y = 0; y < 8; y++)
+        for (mfxU32 x = 0; x < 8; x++)
+            sad += (mfxU32)abs(a[y * pitch + x] - b[y * pitch + x]);
+    return sad;
+#endif
+}
+
+// SAD of a block to its mean
+static inline mfxU32 DcSad8x8(const mfxU8 *a, mfxU32 pitch)
+{
+#ifdef MSDK_LA_SSE2
+    __m128i rows[4];
+    __m128i sum = _mm_setzero_si128();
+    for (mfxU32 y = 0; y < 4; y++)
+    {
+        rows[y] = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(a + 2 * y * pitch)), _mm_loadl_epi64((const __m128i*)(a + (2 * y + 1) * pitch)));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(rows[y], _mm_setzero_si128()));
+    }
+    mfxU32 mean = ((mfxU32)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8))) + 32) >> 6;
+
+    __m128i dc = _mm_set1_epi8((char)mean);
+    __m128i acc = _mm_setzero_si128();
+    for (mfxU32 y = 0; y < 4; y++)
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(rows[y], dc));
+    return (mfxU32)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#else
+    mfxU32 sum = 0;
+    for (mfxU32 y = 0; y < 8; y++)
+        for (mfxU32 x = 0; x < 8; x++)
+            sum += a[y * pitch + x];
+    mfxI32 mean = (mfxI32)((sum + 32) >> 6);
+
+    mfxU32 sad = 0;
+    for (mfxU32 y = 0; y < 8; y++)
+        for (mfxU32 x = 0; x < 8; x++)
+            sad += (mfxU32)abs(a[y * pitch + x] - mean);
+    return sad;
+#endif
+}
+
+CLookAhead::CLookAhead()
+    : m_nDepth(0)
+    , m_nWidth(0)
+    , m_nHeight(0)
+    , m_nScale(4)
+    , m_nLowWidth(0)
+    , m_nLowHeight(0)
+    , m_nCur(0)
+    , m_bHaveRef(false)
+    , m_dAvgIntra(0)
+    , m_dAvgInter(0)
+    , m_nSceneFrames(0)
+    , m_nFrames(0)
+    , m_nSceneCuts(0)
+    , m_nTicks(0)
+{
+}
+
+CLookAhead::~CLookAhead()
+{
+    Close();
+}
+
+mfxStatus CLookAhead::Init(mfxU32 nDepth)
+{
+    MSDK_CHECK_ERROR(nDepth, 0, MFX_ERR_INVALID_VIDEO_PARAM);
+
+    Close();
+    m_nDepth = nDepth;
+    return MFX_ERR_NONE;
+}
+
+void CLookAhead::Close()
+{
+    m_nDepth = 0;
+    m_Window.clear();
+    m_Low[0].clear();
+    m_Low[1].clear();
+    m_nWidth = m_nHeight = 0;
+    m_nLowWidth = m_nLowHeight = 0;
+    m_bHaveRef = false;
+    m_dAvgIntra = m_dAvgInter = 0;
+    m_nSceneFrames = 0;
+    m_nFrames = 0;
+    m_nSceneCuts = 0;
+    m_nTicks = 0;
+}
+
+mfxF64 CLookAhead::GetAvgTimeMs() const
+{
+    return m_nFrames ? 1000.0 * m_nTicks / msdk_time_get_frequency() / m_nFrames : 0;
+}
+
+void CLookAhead::Resize(mfxU32 nWidth, mfxU32 nHeight)
+{
+    m_nWidth = nWidth;
+    m_nHeight = nHeight;
+    m_nScale = nWidth > 1920 ? 8 : 4;
+    m_nLowWidth = (nWidth / m_nScale) & ~7;
+    m_nLowHeight = (nHeight / m_nScale) & ~7;
+    m_Low[0].assign(m_nLowWidth * m_nLowHeight, 0);
+    m_Low[1].assign(m_nLowWidth * m_nLowHeight, 0);
+    m_bHaveRef = false;
+}
+
+void CLookAhead::Downscale(const mfxU8 *pY, mfxU32 nPitch, mfxU8 *pDst)
+{
+    const mfxU32 scale = m_nScale;
+    const mfxU32 shift = (scale == 8) ? 6 : 4;
+    const mfxU32 width = m_nLowWidth;
+
+    msdk_parallel_for(0, m_nLowHeight, [&](mfxU32 first, mfxU32 last)
+    {
+        for (mfxU32 y = first; y < last; y++)
+        {
+            const mfxU8 *src = pY + (size_t)y * scale * nPitch;
+            mfxU8 *dst = pDst + y * width;
+            mfxU32 x = 0;
+#ifdef MSDK_LA_SSE2
+            // 16 source pixels a step: 2 output pixels at 8x, 4 at 4x, summed with SAD against zero
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i even = _mm_set_epi32(0, -1, 0, -1);
+            const __m128i odd = _mm_set_epi32(-1, 0, -1, 0);
+            const mfxU32 step = 16 / scale;
+            for (; x + step <= width; x += step)
+            {
+                const mfxU8 *s = src + x * scale;
+                __m128i acc0 = _mm_setzero_si128();
+                __m128i acc1 = _mm_setzero_si128();
+                for (mfxU32 r = 0; r < scale; r++)
+                {
+                    __m128i v = _mm_loadu_si128((const __m128i*)(s + r * nPitch));
+                    if (scale == 8)
+                    {
+                        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(v, zero));
+                    }
+                    else
+                    {
+                        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_and_si128(v, even), zero));
+                        acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(_mm_and_si128(v, odd), zero));
+                    }
+                }
+                const mfxU32 round = 1 << (shift - 1);
+                if (scale == 8)
+                {
+                    dst[x + 0] = (mfxU8)(((mfxU32)_mm_cvtsi128_si32(acc0) + round) >> shift);
+                    dst[x + 1] = (mfxU8)(((mfxU32)_mm_cvtsi128_si32(_mm_srli_si128(acc0, 8)) + round) >> shift);
+                }
+                else
+                {
+                    dst[x + 0] = (mfxU8)(((mfxU32)_mm_cvtsi128_si32(acc0) + round) >> shift);
+                    dst[x + 1] = (mfxU8)(((mfxU32)_mm_cvtsi128_si32(acc1) + round) >> shift);
+                    dst[x + 2] = (mfxU8)(((mfxU32)_mm_cvtsi128_si32(_mm_srli_si128(acc0, 8)) + round) >> shift);
+                    dst[x + 3] = (mfxU8)(((mfxU32)_mm_cvtsi128_si32(_mm_srli_si128(acc1, 8)) + round) >> shift);
+                }
+            }
+#endif
+            for (; x < width; x++)
+            {
+                mfxU32 sum = 0;
+                for (mfxU32 r = 0; r < scale; r++)
+                    for (mfxU32 c = 0; c < scale; c++)
+                        sum += src[r * nPitch + x * scale + c];
+                dst[x] = (mfxU8)((sum + (1 << (shift - 1))) >> shift);
+            }
+        }
+    });
+}
+
+void CLookAhead::GetCosts(const mfxU8 *pCur, const mfxU8 *pRef, mfxU32 *pIntra, mfxU32 *pInter)
+{
+    const mfxI32 width = (mfxI32)m_nLowWidth;
+    const mfxI32 height = (mfxI32)m_nLowHeight;
+    std::atomic<mfxU64> intra(0), inter(0);
+
+    msdk_parallel_for(0, m_nLowHeight / 8, [&](mfxU32 first, mfxU32 last)
+    {
+        mfxU64 sumIntra = 0, sumInter = 0;
+        for (mfxI32 by = (mfxI32)first * 8; by < (mfxI32)last * 8; by += 8)
+        {
+            for (mfxI32 bx = 0; bx < width; bx += 8)
+            {
+                const mfxU8 *blk = pCur + by * width + bx;
+                mfxU32 costIntra = DcSad8x8(blk, width);
+                mfxU32 costInter = costIntra;
+                if (pRef)
+                {
+                    mfxI32 y0 = (std::max)(by - MSDK_LA_SEARCH_RANGE, 0), y1 = (std::min)(by + MSDK_LA_SEARCH_RANGE, height - 8);
+                    mfxI32 x0 = (std::max)(bx - MSDK_LA_SEARCH_RANGE, 0), x1 = (std::min)(bx + MSDK_LA_SEARCH_RANGE, width - 8);
+                    for (mfxI32 y = y0; y <= y1 && costInter; y++)
+                        for (mfxI32 x = x0; x <= x1; x++)
+                            costInter = (std::min)(costInter, Sad8x8(blk, pRef + y * width + x, width));
+                }
+                sumIntra += costIntra;
+                sumInter += costInter;
+            }
+        }
+        intra += sumIntra;
+        inter += sumInter;
+    });
+
+    *pIntra = (mfxU32)(std::min)(intra.load(), (mfxU64)0xFFFFFFFF);
+    *pInter = (mfxU32)(std::min)(inter.load(), (mfxU64)0xFFFFFFFF);
+}
+
+void CLookAhead::Push(const mfxU8 *pY, mfxU32 nWidth, mfxU32 nHeight, mfxU32 nPitch)
+{
+    msdk_tick start = msdk_time_get_tick();
+
+    sFrameComplexity frame;
+    MSDK_ZERO_MEMORY(frame);
+    frame.nOrder = m_nFrames++;
+
+    if (nWidth != m_nWidth || nHeight != m_nHeight)
+        Resize(nWidth, nHeight);
+
+    if (pY && m_nLowWidth >= 16 && m_nLowHeight >= 16)
+    {
+        m_nCur ^= 1;
+        Downscale(pY, nPitch, &m_Low[m_nCur][0]);
+        GetCosts(&m_Low[m_nCur][0], m_bHaveRef ? &m_Low[m_nCur ^ 1][0] : NULL, &frame.nIntraCost, &frame.nInterCost);
+
+        frame.dAvgIntraCost = m_dAvgIntra;
+        frame.dAvgInterCost = m_dAvgInter;
+        frame.bSceneCut = !m_bHaveRef ||
+            (frame.nInterCost > MSDK_LA_SCENECUT_INTRA_RATIO * frame.nIntraCost &&
+             frame.nInterCost > MSDK_LA_SCENECUT_AVG_RATIO * m_dAvgInter) ||
+            (frame.nInterCost > MSDK_LA_SCENECUT_INTRA_RATIO2 * frame.nIntraCost &&
+             frame.nInterCost > MSDK_LA_SCENECUT_AVG_RATIO2 * m_dAvgInter);
+        m_bHaveRef = true;
+
+        // a new scene starts its own averages
+        if (frame.bSceneCut)
+        {
+            if (frame.nOrder)
+                m_nSceneCuts++;
+            m_nSceneFrames = 0;
+        }
+        mfxF64 weight = 1.0 / (std::min)(++m_nSceneFrames, (mfxU32)MSDK_LA_AVG_PERIOD);
+        m_dAvgIntra += (frame.nIntraCost - m_dAvgIntra) * weight;
+        m_dAvgInter += (frame.nInterCost - m_dAvgInter) * weight;
+    }
+
+    m_Window.push_back(frame);
+    m_nTicks += msdk_time_get_tick() - start;
+}
+
+bool CLookAhead::Pop(sFrameComplexity *pFrame)
+{
+    MSDK_CHECK_POINTER(pFrame, false);
+    if (m_Window.empty())
+        return false;
+
+    *pFrame = m_Window.front();
+    m_Window.pop_front();
+
+    // the frames behind it, up to the next scene cut
+    mfxF64 sum = 0;
+    mfxU32 n = 0;
+    for (size_t i = 0; i < m_Window.size() && !m_Window[i].bSceneCut; i++, n++)
+        sum += m_Window[i].nInterCost;
+    pFrame->dFutureInterCost = n ? sum / n : 0;
+
+    return true;
+}
@@ -157,6 +157,48 @@ CBuffering::ResetVppBuffers()
     }
 }
 
+void
+CBuffering::RecycleSurfaces(msdkFrameSurface* pSurfaces, mfxU32 SurfaceNumber,
+    msdkFreeSurfacesPool& FreePool, msdkUsedSurfacesPool& UsedPool)
+{
+    FreePool.m_pSurfaces = NULL;
+    UsedPool.m_pSurfacesHead = NULL;
+    UsedPool.m_pSurfacesTail = NULL;
+
+    if (!pSurfaces) return;
+
+    // walking backwards keeps the first surface at the head of the free list, as ResetBuffers does
+    for (mfxU32 i = SurfaceNumber; i > 0; --i) {
+        msdkFrameSurface* surface = &(pSurfaces[i-1]);
+
+        surface->prev = surface->next = NULL;
+        surface->render_lock = 0;
+        if (surface->frame.Data.Locked) {
+            UsedPool.AddSurfaceUnsafe(surface);
+        } else {
+            FreePool.AddSurfaceUnsafe(surface);
+        }
+    }
+}
+
+void
+CBuffering::RecycleBuffers()
+{
+    AutomaticMutex lock(m_Mutex);
+    msdkOutputSurface* output;
+
+    // outputs which were not delivered give their descriptors back
+    while ((output = m_OutputSurfacesPool.GetSurfaceUnsafe()) != NULL ||
+           (output = m_DeliveredSurfacesPool.GetSurfaceUnsafe()) != NULL) {
+        output->surface = NULL;
+        output->syncp = NULL;
+        AddFreeOutputSurfaceUnsafe(output);
+    }
+
+    RecycleSurfaces(m_pSurfaces, m_SurfacesNumber, m_FreeSurfacesPool, m_UsedSurfacesPool);
+    RecycleSurfaces(m_pVppSurfaces, m_OutputSurfacesNumber, m_FreeVppSurfacesPool, m_UsedVppSurfacesPool);
+}
+
 void
 CBuffering::SyncFrameSurfaces()
 {
@@ -0,0 +1,742 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include "sample_defs.h"
+#include "mux_bitstream_writer.h"
+#include "ts_bitstream_reader.h"
+
+#define MSDK_MUX_PMT_PID      0x1000
+#define MSDK_MUX_VIDEO_PID    0x0100
+#define MSDK_MUX_TS_PAYLOAD   (MSDK_TS_PACKET_SIZE - 4)
+// PTS/DTS run ahead of PCR by this many 90 kHz ticks, time for the decoder buffer to fill
+#define MSDK_MUX_TS_DELAY     63000
+#define MSDK_MUX_TS_MASK      0x1FFFFFFFFULL
+#define MSDK_MUX_TIMESCALE    90000
+
+static void Put8(std::vector<mfxU8> &v, mfxU32 x)
+{
+    v.push_back((mfxU8)x);
+}
+
+static void Put16(std::vector<mfxU8> &v, mfxU32 x)
+{
+    Put8(v, x >> 8);
+    Put8(v, x);
+}
+
+static void Put32(std::vector<mfxU8> &v, mfxU32 x)
+{
+    Put16(v, x >> 16);
+    Put16(v, x);
+}
+
+static void Put64(std::vector<mfxU8> &v, mfxU64 x)
+{
+    Put32(v, (mfxU32)(x >> 32));
+    Put32(v, (mfxU32)x);
+}
+
+static void PutTag(std::vector<mfxU8> &v, const char *tag)
+{
+    v.insert(v.end(), tag, tag + 4);
+}
+
+static void Patch32(mfxU8 *p, mfxU32 x)
+{
+    p[0] = (mfxU8)(x >> 24);
+    p[1] = (mfxU8)(x >> 16);
+    p[2] = (mfxU8)(x >> 8);
+    p[3] = (mfxU8)x;
+}
+
+// box size is filled in by EndBox
+static size_t BeginBox(std::vector<mfxU8> &v, const char *type)
+{
+    size_t pos = v.size();
+    Put32(v, 0);
+    PutTag(v, type);
+    return pos;
+}
+
+static size_t BeginFullBox(std::vector<mfxU8> &v, const char *type, mfxU32 version, mfxU32 flags)
+{
+    size_t pos = BeginBox(v, type);
+    Put32(v, (version << 24) | flags);
+    return pos;
+}
+
+static void EndBox(std::vector<mfxU8> &v, size_t pos)
+{
+    Patch32(&v[pos], (mfxU32)(v.size() - pos));
+}
+
+static void PutMatrix(std::vector<mfxU8> &v)
+{
+    static const mfxU32 unity[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for (mfxU32 i = 0; i < 9; i++)
+        Put32(v, unity[i]);
+}
+
+// CRC_32 of PSI sections, ISO/IEC 13818-1 annex A, stored right after the data
+static void PutSectionCRC(mfxU8 *p, mfxU32 n)
+{
+    mfxU32 crc = 0xFFFFFFFF;
+    for (mfxU32 i = 0; i < n; i++)
+    {
+        crc ^= (mfxU32)p[i] << 24;
+        for (mfxU32 bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+    }
+    Patch32(p + n, crc);
+}
+
+// PES time stamp: 4 bit prefix, then 33 bits in 3, 15 and 15 bit parts each followed by a marker bit
+static void PutPESTimeStamp(mfxU8 *p, mfxU8 prefix, mfxU64 ts)
+{
+    p[0] = (mfxU8)((prefix << 4) | (((ts >> 30) & 0x7) << 1) | 1);
+    p[1] = (mfxU8)(ts >> 22);
+    p[2] = (mfxU8)((((ts >> 15) & 0x7F) << 1) | 1);
+    p[3] = (mfxU8)(ts >> 7);
+    p[4] = (mfxU8)(((ts & 0x7F) << 1) | 1);
+}
+
+static mfxU64 ToTSTime(mfxI64 ts)
+{
+    return (ts > 0) ? ((mfxU64)ts & MSDK_MUX_TS_MASK) : 0;
+}
+
+static mfxU8 GetNalType(mfxU32 nCodecId, mfxU8 header)
+{
+    return (MFX_CODEC_HEVC == nCodecId) ? (header >> 1) & 0x3F : header & 0x1F;
+}
+
+// access unit delimiter and parameter sets are not part of MP4 samples
+static bool IsSampleNalUnit(mfxU32 nCodecId, mfxU8 type)
+{
+    if (MFX_CODEC_HEVC == nCodecId)
+        return type < 32 || type > 35;
+    return type != 7 && type != 8 && type != 9;
+}
+
+// parameter sets from the encoder may come with start codes, container headers need them without
+static void CopyNalUnit(const mfxU8 *pData, mfxU32 nSize, std::vector<mfxU8> &dst)
+{
+    dst.clear();
+    if (!pData)
+        return;
+
+    mfxU32 start = FindAnnexBStartCode(pData, nSize, 0);
+    start = (start < nSize) ? start + 3 : 0;
+
+    mfxU32 end = nSize;
+    while (end > start && !pData[end - 1])
+        end--;
+
+    dst.assign(pData + start, pData + end);
+}
+
+CMuxBitstreamWriter::CMuxBitstreamWriter(eMuxFormat format)
+    : CSmplBitstreamWriter()
+    , m_format(format)
+    , m_nCodecId(0)
+    , m_nWidth(0)
+    , m_nHeight(0)
+    , m_nChromaFormat(MFX_CHROMAFORMAT_YUV420)
+    , m_nBitDepthLuma(8)
+    , m_nBitDepthChroma(8)
+    , m_nFrameDuration(MSDK_MUX_TIMESCALE / 30)
+    , m_bHeaderWritten(false)
+    , m_nMuxedFrames(0)
+    , m_bFirstDTS(false)
+    , m_nFirstDTS(0)
+    , m_nSequenceNumber(0)
+{
+    MSDK_ZERO_MEMORY(m_nContinuity);
+}
+
+CMuxBitstreamWriter::~CMuxBitstreamWriter()
+{
+}
+
+mfxStatus CMuxBitstreamWriter::Init(const msdk_char *strFileName)
+{
+    mfxStatus sts = CSmplBitstreamWriter::Init(strFileName);
+    MSDK_CHECK_STATUS(sts, "CSmplBitstreamWriter::Init failed");
+
+    // every file gets its own tables or init segment
+    m_bHeaderWritten = false;
+    MSDK_ZERO_MEMORY(m_nContinuity);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CMuxBitstreamWriter::SetStreamInfo(const mfxVideoParam &par, const mfxExtCodingOptionSPSPPS *pSPSPPS, const mfxExtCodingOptionVPS *pVPS)
+{
+    if (MFX_CODEC_AVC != par.mfx.CodecId && MFX_CODEC_HEVC != par.mfx.CodecId)
+        return MFX_ERR_UNSUPPORTED;
+
+    const mfxFrameInfo &info = par.mfx.FrameInfo;
+    m_nCodecId = par.mfx.CodecId;
+    m_nWidth = info.CropW ? info.CropW : info.Width;
+    m_nHeight = info.CropH ? info.CropH : info.Height;
+    m_nChromaFormat = info.ChromaFormat;
+    m_nBitDepthLuma = info.BitDepthLuma ? info.BitDepthLuma : 8;
+    m_nBitDepthChroma = info.BitDepthChroma ? info.BitDepthChroma : m_nBitDepthLuma;
+    if (info.FrameRateExtN && info.FrameRateExtD)
+        m_nFrameDuration = (mfxU32)((mfxU64)MSDK_MUX_TIMESCALE * info.FrameRateExtD / info.FrameRateExtN);
+
+    CopyNalUnit(pSPSPPS ? pSPSPPS->SPSBuffer : NULL, pSPSPPS ? pSPSPPS->SPSBufSize : 0, m_sps);
+    CopyNalUnit(pSPSPPS ? pSPSPPS->PPSBuffer : NULL, pSPSPPS ? pSPSPPS->PPSBufSize : 0, m_pps);
+    CopyNalUnit(pVPS ? pVPS->VPSBuffer : NULL, pVPS ? pVPS->VPSBufSize : 0, m_vps);
+
+    // MP4 sample entry can't be built without parameter sets, TS carries them in-band
+    if (MUX_FORMAT_FMP4 == m_format &&
+        (m_sps.size() < 4 || m_pps.empty() || (MFX_CODEC_HEVC == m_nCodecId && m_vps.empty())))
+    {
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // headers of the current file are written again with the new parameters
+    m_bHeaderWritten = false;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CMuxBitstreamWriter::Mux(const mfxBitstream *pBS)
+{
+    MSDK_CHECK_ERROR(m_nCodecId, 0, MFX_ERR_NOT_INITIALIZED);
+
+    m_muxed.clear();
+    if (!pBS->DataLength)
+        return MFX_ERR_NONE;
+
+    mfxI64 nPTS = 0, nDTS = 0;
+    if (pBS->TimeStamp != (mfxU64)MFX_TIMESTAMP_UNKNOWN)
+    {
+        nPTS = (mfxI64)pBS->TimeStamp;
+        nDTS = pBS->DecodeTimeStamp;
+    }
+    else
+    {
+        // input frames had no time stamps, frames are evenly spaced in decode order
+        nPTS = nDTS = (mfxI64)m_nMuxedFrames * m_nFrameDuration;
+    }
+
+    if (!m_bFirstDTS)
+    {
+        m_nFirstDTS = nDTS;
+        m_bFirstDTS = true;
+    }
+
+    bool bRandomAccess = !!(pBS->FrameType & MFX_FRAMETYPE_IDR);
+    const mfxU8 *pData = pBS->Data + pBS->DataOffset;
+
+    if (MUX_FORMAT_TS == m_format)
+    {
+        // tables before every IDR frame, so playback can start there
+        if (bRandomAccess || !m_bHeaderWritten)
+        {
+            WriteTSTables();
+            m_bHeaderWritten = true;
+        }
+        WriteTSFrame(pData, pBS->DataLength, nPTS, nDTS, bRandomAccess);
+    }
+    else
+    {
+        if (!m_bHeaderWritten)
+        {
+            WriteInitSegment();
+            m_bHeaderWritten = true;
+        }
+        WriteFragment(pData, pBS->DataLength, nPTS, nDTS, bRandomAccess);
+    }
+
+    m_nMuxedFrames++;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CMuxBitstreamWriter::WriteNextFrame(mfxBitstream *pMfxBitstream, bool isPrint)
+{
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_POINTER(pMfxBitstream, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = SelectSegment(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "SelectSegment failed");
+
+    sts = Mux(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "Mux failed");
+
+    mfxBitstream muxed;
+    MSDK_ZERO_MEMORY(muxed);
+    muxed.Data = m_muxed.empty() ? NULL : &m_muxed[0];
+    muxed.DataLength = muxed.MaxLength = (mfxU32)m_muxed.size();
+
+    sts = WriteData(&muxed, isPrint);
+    MSDK_CHECK_STATUS(sts, "WriteData failed");
+
+    pMfxBitstream->DataLength = 0;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CMuxBitstreamWriter::SndBitstream(mfxBitstream *pMfxBitstream)
+{
+    MSDK_CHECK_POINTER(pMfxBitstream, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = SelectSegment(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "SelectSegment failed");
+
+    sts = Mux(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "Mux failed");
+
+    // consumer of the queue gets container data, ready to be written or sent
+    mfxBitstream muxed;
+    MSDK_ZERO_MEMORY(muxed);
+    muxed.Data = m_muxed.empty() ? NULL : &m_muxed[0];
+    muxed.DataLength = muxed.MaxLength = (mfxU32)m_muxed.size();
+
+    sts = WriteToSegment(&muxed);
+    MSDK_CHECK_STATUS(sts, "WriteToSegment failed");
+
+    sts = QueueData(&muxed);
+    pMfxBitstream->DataLength = 0;
+    return sts;
+}
+
+mfxStatus CMuxBitstreamWriter::SelectSegment(const mfxBitstream *pMfxBitstream)
+{
+    FILE *pCurrent = m_fSource;
+
+    mfxStatus sts = CSmplBitstreamWriter::SelectSegment(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "CSmplBitstreamWriter::SelectSegment failed");
+
+    // a new segment starts with its own tables or init segment, like a new file
+    if (m_fSource != pCurrent)
+    {
+        m_bHeaderWritten = false;
+        MSDK_ZERO_MEMORY(m_nContinuity);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxU32 CMuxBitstreamWriter::WriteTSPacket(mfxU16 nPid, bool bUnitStart, bool bRandomAccess, bool bPCR, mfxI64 nPCR, const mfxU8 *pPayload, mfxU32 nSize)
+{
+    size_t pos = m_muxed.size();
+    m_muxed.resize(pos + MSDK_TS_PACKET_SIZE);
+    mfxU8 *p = &m_muxed[pos];
+
+    mfxU8 &nContinuity = m_nContinuity[(0 == nPid) ? 0 : (MSDK_MUX_PMT_PID == nPid) ? 1 : 2];
+
+    // adaptation field with its length byte, it also stuffs the last packet of a unit
+    mfxU32 nAdaptation = (bRandomAccess || bPCR) ? 2 + (bPCR ? 6 : 0) : 0;
+    mfxU32 nPayload = MSDK_MIN(nSize, MSDK_MUX_TS_PAYLOAD - nAdaptation);
+    nAdaptation = MSDK_MUX_TS_PAYLOAD - nPayload;
+
+    p[0] = 0x47;
+    p[1] = (mfxU8)((bUnitStart ? 0x40 : 0) | (nPid >> 8));
+    p[2] = (mfxU8)nPid;
+    p[3] = (mfxU8)((nAdaptation ? 0x30 : 0x10) | nContinuity);
+    nContinuity = (nContinuity + 1) & 0x0F;
+
+    if (nAdaptation)
+    {
+        p[4] = (mfxU8)(nAdaptation - 1);
+        if (nAdaptation > 1)
+        {
+            mfxU8 *af = p + 5;
+            *af++ = (mfxU8)((bRandomAccess ? 0x40 : 0) | (bPCR ? 0x10 : 0));
+            if (bPCR)
+            {
+                // program_clock_reference_base, 6 reserved bits, extension 0
+                mfxU64 base = ToTSTime(nPCR);
+                *af++ = (mfxU8)(base >> 25);
+                *af++ = (mfxU8)(base >> 17);
+                *af++ = (mfxU8)(base >> 9);
+                *af++ = (mfxU8)(base >> 1);
+                *af++ = (mfxU8)(((base & 1) << 7) | 0x7E);
+                *af++ = 0;
+            }
+            memset(af, 0xFF, p + 4 + nAdaptation - af);
+        }
+    }
+
+    memcpy(p + 4 + nAdaptation, pPayload, nPayload);
+    return nPayload;
+}
+
+void CMuxBitstreamWriter::WriteTSTables()
+{
+    mfxU8 pat[] =
+    {
+        0x00,                               // pointer_field
+        0x00, 0xB0, 13,                     // table_id, section_length
+        0x00, 0x01, 0xC1, 0x00, 0x00,       // transport_stream_id, version 0, current
+        0x00, 0x01,                         // program_number
+        0xE0 | (MSDK_MUX_PMT_PID >> 8), MSDK_MUX_PMT_PID & 0xFF,
+        0, 0, 0, 0                          // CRC_32
+    };
+    mfxU8 pmt[] =
+    {
+        0x00,
+        0x02, 0xB0, 18,
+        0x00, 0x01, 0xC1, 0x00, 0x00,       // program_number, version 0, current
+        0xE0 | (MSDK_MUX_VIDEO_PID >> 8), MSDK_MUX_VIDEO_PID & 0xFF, // PCR_PID
+        0xF0, 0x00,                         // program_info_length
+        (mfxU8)((MFX_CODEC_HEVC == m_nCodecId) ? 0x24 : 0x1B),
+        0xE0 | (MSDK_MUX_VIDEO_PID >> 8), MSDK_MUX_VIDEO_PID & 0xFF,
+        0xF0, 0x00,                         // ES_info_length
+        0, 0, 0, 0
+    };
+
+    PutSectionCRC(pat + 1, sizeof(pat) - 5);
+    PutSectionCRC(pmt + 1, sizeof(pmt) - 5);
+
+    WriteTSPacket(0, true, false, false, 0, pat, sizeof(pat));
+    WriteTSPacket(MSDK_MUX_PMT_PID, true, false, false, 0, pmt, sizeof(pmt));
+}
+
+void CMuxBitstreamWriter::WriteTSFrame(const mfxU8 *pData, mfxU32 nSize, mfxI64 nPTS, mfxI64 nDTS, bool bRandomAccess)
+{
+    static const mfxU8 avcAUD[] = { 0, 0, 0, 1, 0x09, 0xF0 };
+    static const mfxU8 hevcAUD[] = { 0, 0, 0, 1, 0x46, 0x01, 0x50 };
+
+    // first packet: PES header, access unit delimiter if the encoder didn't put one, start of the frame
+    mfxU8 first[MSDK_MUX_TS_PAYLOAD];
+    mfxU32 nPrefix = 0;
+
+    bool bDTS = (nDTS != nPTS);
+    first[nPrefix++] = 0x00;
+    first[nPrefix++] = 0x00;
+    first[nPrefix++] = 0x01;
+    first[nPrefix++] = 0xE0;   // stream_id
+    first[nPrefix++] = 0x00;   // PES_packet_length 0, unbounded video PES
+    first[nPrefix++] = 0x00;
+    first[nPrefix++] = 0x84;   // data_alignment_indicator
+    first[nPrefix++] = bDTS ? 0xC0 : 0x80;
+    first[nPrefix++] = bDTS ? 10 : 5;
+    PutPESTimeStamp(first + nPrefix, bDTS ? 0x3 : 0x2, ToTSTime(nPTS + MSDK_MUX_TS_DELAY));
+    nPrefix += 5;
+    if (bDTS)
+    {
+        PutPESTimeStamp(first + nPrefix, 0x1, ToTSTime(nDTS + MSDK_MUX_TS_DELAY));
+        nPrefix += 5;
+    }
+
+    mfxU32 nStart = FindAnnexBStartCode(pData, nSize, 0);
+    bool bHasAUD = nStart + 3 < nSize &&
+        GetNalType(m_nCodecId, pData[nStart + 3]) == ((MFX_CODEC_HEVC == m_nCodecId) ? 35 : 9);
+    if (!bHasAUD)
+    {
+        const mfxU8 *aud = (MFX_CODEC_HEVC == m_nCodecId) ? hevcAUD : avcAUD;
+        mfxU32 nAUD = (MFX_CODEC_HEVC == m_nCodecId) ? sizeof(hevcAUD) : sizeof(avcAUD);
+        memcpy(first + nPrefix, aud, nAUD);
+        nPrefix += nAUD;
+    }
+
+    mfxU32 nFirst = MSDK_MIN(nSize, (mfxU32)sizeof(first) - nPrefix);
+    memcpy(first + nPrefix, pData, nFirst);
+
+    // PCR on the first packet of every frame keeps the PCR interval within a frame
+    mfxU32 nUsed = WriteTSPacket(MSDK_MUX_VIDEO_PID, true, bRandomAccess, true, nDTS, first, nPrefix + nFirst) - nPrefix;
+    while (nUsed < nSize)
+        nUsed += WriteTSPacket(MSDK_MUX_VIDEO_PID, false, false, false, 0, pData + nUsed, nSize - nUsed);
+}
+
+void CMuxBitstreamWriter::WriteSampleEntry()
+{
+    std::vector<mfxU8> &v = m_muxed;
+    bool bHEVC = (MFX_CODEC_HEVC == m_nCodecId);
+
+    size_t entry = BeginBox(v, bHEVC ? "hvc1" : "avc1");
+    Put32(v, 0);                // reserved
+    Put16(v, 0);
+    Put16(v, 1);                // data_reference_index
+    Put16(v, 0);                // pre_defined, reserved
+    Put16(v, 0);
+    Put32(v, 0);
+    Put32(v, 0);
+    Put32(v, 0);
+    Put16(v, m_nWidth);
+    Put16(v, m_nHeight);
+    Put32(v, 0x00480000);       // 72 dpi
+    Put32(v, 0x00480000);
+    Put32(v, 0);
+    Put16(v, 1);                // frame_count
+    v.insert(v.end(), 32, 0);   // compressorname
+    Put16(v, 0x0018);           // depth
+    Put16(v, 0xFFFF);
+
+    if (!bHEVC)
+    {
+        // AVCDecoderConfigurationRecord, ISO/IEC 14496-15 5.3.3.1
+        size_t avcC = BeginBox(v, "avcC");
+        Put8(v, 1);
+        Put8(v, m_sps[1]);      // profile_idc, constraint flags, level_idc
+        Put8(v, m_sps[2]);
+        Put8(v, m_sps[3]);
+        Put8(v, 0xFF);          // 4 byte NAL unit lengths
+        Put8(v, 0xE1);          // one SPS
+        Put16(v, (mfxU32)m_sps.size());
+        v.insert(v.end(), m_sps.begin(), m_sps.end());
+        Put8(v, 1);             // one PPS
+        Put16(v, (mfxU32)m_pps.size());
+        v.insert(v.end(), m_pps.begin(), m_pps.end());
+        if (m_sps[1] == 100 || m_sps[1] == 110 || m_sps[1] == 122 || m_sps[1] == 244 ||
+            m_sps[1] == 144 || m_sps[1] == 118 || m_sps[1] == 128)
+        {
+            Put8(v, 0xFC | m_nChromaFormat);
+            Put8(v, 0xF8 | (m_nBitDepthLuma - 8));
+            Put8(v, 0xF8 | (m_nBitDepthChroma - 8));
+            Put8(v, 0);         // no SPS extensions
+        }
+        EndBox(v, avcC);
+    }
+    else
+    {
+        // profile_tier_level of the SPS starts 3 bytes in, emulation prevention bytes removed
+        mfxU8 rbsp[13];
+        mfxU32 n = 0, zeros = 0;
+        for (mfxU32 i = 2; i < m_sps.size() && n < sizeof(rbsp); i++)
+        {
+            if (zeros >= 2 && m_sps[i] == 0x03)
+            {
+                zeros = 0;
+                continue;
+            }
+            zeros = m_sps[i] ? 0 : zeros + 1;
+            rbsp[n++] = m_sps[i];
+        }
+        if (n < sizeof(rbsp))
+            memset(rbsp + n, 0, sizeof(rbsp) - n);
+
+        // HEVCDecoderConfigurationRecord, ISO/IEC 14496-15 8.3.3.1
+        size_t hvcC = BeginBox(v, "hvcC");
+        Put8(v, 1);
+        v.insert(v.end(), rbsp + 1, rbsp + 13); // profile, compatibility and constraint flags, level
+        Put16(v, 0xF000);       // min_spatial_segmentation_idc
+        Put8(v, 0xFC);          // parallelismType
+        Put8(v, 0xFC | m_nChromaFormat);
+        Put8(v, 0xF8 | (m_nBitDepthLuma - 8));
+        Put8(v, 0xF8 | (m_nBitDepthChroma - 8));
+        Put16(v, 0);            // avgFrameRate
+        // numTemporalLayers, temporalIdNested, 4 byte NAL unit lengths
+        Put8(v, ((((rbsp[0] >> 1) & 0x7) + 1) << 3) | ((rbsp[0] & 1) << 2) | 0x3);
+        Put8(v, 3);
+
+        const std::vector<mfxU8> *arrays[3] = { &m_vps, &m_sps, &m_pps };
+        for (mfxU32 i = 0; i < 3; i++)
+        {
+            Put8(v, 0x80 | (32 + i)); // array_completeness, NAL unit type
+            Put16(v, 1);
+            Put16(v, (mfxU32)arrays[i]->size());
+            v.insert(v.end(), arrays[i]->begin(), arrays[i]->end());
+        }
+        EndBox(v, hvcC);
+    }
+
+    EndBox(v, entry);
+}
+
+void CMuxBitstreamWriter::WriteInitSegment()
+{
+    std::vector<mfxU8> &v = m_muxed;
+
+    size_t ftyp = BeginBox(v, "ftyp");
+    PutTag(v, "iso6");
+    Put32(v, 0);
+    PutTag(v, "iso6");
+    PutTag(v, "mp41");
+    EndBox(v, ftyp);
+
+    size_t moov = BeginBox(v, "moov");
+    {
+        size_t mvhd = BeginFullBox(v, "mvhd", 0, 0);
+        Put32(v, 0);                    // creation and modification time
+        Put32(v, 0);
+        Put32(v, MSDK_MUX_TIMESCALE);
+        Put32(v, 0);                    // duration is given by the fragments
+        Put32(v, 0x00010000);           // rate
+        Put16(v, 0x0100);               // volume
+        Put16(v, 0);
+        Put32(v, 0);
+        Put32(v, 0);
+        PutMatrix(v);
+        for (mfxU32 i = 0; i < 6; i++)
+            Put32(v, 0);                // pre_defined
+        Put32(v, 2);                    // next_track_ID
+        EndBox(v, mvhd);
+
+        size_t trak = BeginBox(v, "trak");
+        {
+            size_t tkhd = BeginFullBox(v, "tkhd", 0, 0x3); // enabled, in movie
+            Put32(v, 0);
+            Put32(v, 0);
+            Put32(v, 1);                // track_ID
+            Put32(v, 0);
+            Put32(v, 0);                // duration
+            Put32(v, 0);
+            Put32(v, 0);
+            Put16(v, 0);                // layer
+            Put16(v, 0);                // alternate_group
+            Put16(v, 0);                // volume
+            Put16(v, 0);
+            PutMatrix(v);
+            Put32(v, (mfxU32)m_nWidth << 16);
+            Put32(v, (mfxU32)m_nHeight << 16);
+            EndBox(v, tkhd);
+
+            size_t mdia = BeginBox(v, "mdia");
+            {
+                size_t mdhd = BeginFullBox(v, "mdhd", 0, 0);
+                Put32(v, 0);
+                Put32(v, 0);
+                Put32(v, MSDK_MUX_TIMESCALE);
+                Put32(v, 0);
+                Put16(v, 0x55C4);       // language 'und'
+                Put16(v, 0);
+                EndBox(v, mdhd);
+
+                size_t hdlr = BeginFullBox(v, "hdlr", 0, 0);
+                Put32(v, 0);
+                PutTag(v, "vide");
+                Put32(v, 0);
+                Put32(v, 0);
+                Put32(v, 0);
+                static const char name[] = "VideoHandler";
+                v.insert(v.end(), name, name + sizeof(name));
+                EndBox(v, hdlr);
+
+                size_t minf = BeginBox(v, "minf");
+                {
+                    size_t vmhd = BeginFullBox(v, "vmhd", 0, 0x1);
+                    Put16(v, 0);        // graphicsmode, opcolor
+                    Put16(v, 0);
+                    Put16(v, 0);
+                    Put16(v, 0);
+                    EndBox(v, vmhd);
+
+                    size_t dinf = BeginBox(v, "dinf");
+                    size_t dref = BeginFullBox(v, "dref", 0, 0);
+                    Put32(v, 1);
+                    EndBox(v, BeginFullBox(v, "url ", 0, 0x1)); // media data is in this file
+                    EndBox(v, dref);
+                    EndBox(v, dinf);
+
+                    size_t stbl = BeginBox(v, "stbl");
+                    {
+                        size_t stsd = BeginFullBox(v, "stsd", 0, 0);
+                        Put32(v, 1);
+                        WriteSampleEntry();
+                        EndBox(v, stsd);
+
+                        // samples are described by the fragments only
+                        size_t box = BeginFullBox(v, "stts", 0, 0);
+                        Put32(v, 0);
+                        EndBox(v, box);
+                        box = BeginFullBox(v, "stsc", 0, 0);
+                        Put32(v, 0);
+                        EndBox(v, box);
+                        box = BeginFullBox(v, "stsz", 0, 0);
+                        Put32(v, 0);
+                        Put32(v, 0);
+                        EndBox(v, box);
+                        box = BeginFullBox(v, "stco", 0, 0);
+                        Put32(v, 0);
+                        EndBox(v, box);
+                    }
+                    EndBox(v, stbl);
+                }
+                EndBox(v, minf);
+            }
+            EndBox(v, mdia);
+        }
+        EndBox(v, trak);
+
+        size_t mvex = BeginBox(v, "mvex");
+        size_t trex = BeginFullBox(v, "trex", 0, 0);
+        Put32(v, 1);                    // track_ID
+        Put32(v, 1);                    // default_sample_description_index
+        Put32(v, m_nFrameDuration);
+        Put32(v, 0);
+        Put32(v, 0);
+        EndBox(v, trex);
+        EndBox(v, mvex);
+    }
+    EndBox(v, moov);
+}
+
+void CMuxBitstreamWriter::WriteFragment(const mfxU8 *pData, mfxU32 nSize, mfxI64 nPTS, mfxI64 nDTS, bool bRandomAccess)
+{
+    std::vector<mfxU8> &v = m_muxed;
+
+    size_t moof = BeginBox(v, "moof");
+
+    size_t mfhd = BeginFullBox(v, "mfhd", 0, 0);
+    Put32(v, ++m_nSequenceNumber);
+    EndBox(v, mfhd);
+
+    size_t traf = BeginBox(v, "traf");
+
+    size_t tfhd = BeginFullBox(v, "tfhd", 0, 0x020000); // default-base-is-moof
+    Put32(v, 1);
+    EndBox(v, tfhd);
+
+    size_t tfdt = BeginFullBox(v, "tfdt", 1, 0);
+    Put64(v, (mfxU64)(nDTS - m_nFirstDTS));
+    EndBox(v, tfdt);
+
+    // one sample with data offset, duration, size, flags and signed composition offset
+    size_t trun = BeginFullBox(v, "trun", 1, 0x000F01);
+    Put32(v, 1);
+    size_t nDataOffsetPos = v.size();
+    Put32(v, 0);
+    Put32(v, m_nFrameDuration);
+    size_t nSampleSizePos = v.size();
+    Put32(v, 0);
+    // sample_depends_on 2 for sync samples, otherwise 1 and sample_is_non_sync_sample
+    Put32(v, bRandomAccess ? 0x02000000 : 0x01010000);
+    Put32(v, (mfxU32)(nPTS - nDTS));
+    EndBox(v, trun);
+
+    EndBox(v, traf);
+    EndBox(v, moof);
+
+    // Annex B start codes are replaced by NAL unit lengths
+    size_t mdat = BeginBox(v, "mdat");
+    for (mfxU32 pos = FindAnnexBStartCode(pData, nSize, 0); pos < nSize; )
+    {
+        mfxU32 start = pos + 3;
+        mfxU32 next = FindAnnexBStartCode(pData, nSize, start);
+        mfxU32 end = next;
+        while (end > start && !pData[end - 1])
+            end--;
+
+        if (end > start && IsSampleNalUnit(m_nCodecId, GetNalType(m_nCodecId, pData[start])))
+        {
+            Put32(v, end - start);
+            v.insert(v.end(), pData + start, pData + end);
+        }
+        pos = next;
+    }
+    EndBox(v, mdat);
+
+    Patch32(&v[nDataOffsetPos], (mfxU32)(mdat - moof + 8));
+    Patch32(&v[nSampleSizePos], (mfxU32)(v.size() - mdat - 8));
+}
@@ -0,0 +1,251 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <algorithm>
+
+#include "sample_defs.h"
+#include "push_bitstream_reader.h"
+
+// interval to re-check the stop flag while blocked on a queue, in microseconds
+#define MSDK_PUSH_WAIT_INTERVAL_US 100000
+
+CPushBitstreamReader::CPushBitstreamReader(mfxU32 nPoolSize, mfxU32 nBufferSize)
+    : CSmplBitstreamReader()
+    , m_nPoolSize(nPoolSize)
+    , m_nBufferSize(nBufferSize)
+    , m_FreeQueue(nPoolSize)
+    , m_ReadyQueue(nPoolSize)
+    , m_bStop(false)
+    , m_bEosSubmitted(false)
+    , m_bEosReached(false)
+    , m_nSubmitters(0)
+    , m_nDiscontinuities(0)
+{
+}
+
+CPushBitstreamReader::~CPushBitstreamReader()
+{
+    Close();
+}
+
+void CPushBitstreamReader::Reset()
+{
+}
+
+void CPushBitstreamReader::Abort()
+{
+    m_bStop = true;
+    if (m_PacketNotify)
+        m_PacketNotify();
+}
+
+void CPushBitstreamReader::Close()
+{
+    Abort();
+
+    // producers see the stop flag within MSDK_PUSH_WAIT_INTERVAL_US, none may touch a packet after this
+    while (m_nSubmitters)
+    {
+        MSDK_SLEEP(1);
+    }
+
+    // drain both queues so that no stale pointers survive re-initialization
+    sPacket* pPacket = NULL;
+    while (m_FreeQueue.try_dequeue(pPacket)) {}
+    while (m_ReadyQueue.try_dequeue(pPacket)) {}
+
+    for (std::vector<sPacket>::iterator it = m_Packets.begin(); it != m_Packets.end(); ++it)
+    {
+        WipeMfxBitstream(&it->bs);
+    }
+    m_Packets.clear();
+
+    m_bInited = false;
+}
+
+mfxStatus CPushBitstreamReader::Init(const msdk_char *strFileName)
+{
+    MSDK_CHECK_ERROR(m_nPoolSize, 0, MFX_ERR_NOT_INITIALIZED);
+
+    Close();
+
+    m_bStop = false;
+    m_bEosSubmitted = false;
+    m_bEosReached = false;
+    m_nDiscontinuities = 0;
+    m_nMovedBytes = 0;
+
+    m_Packets.resize(m_nPoolSize);
+    for (mfxU32 i = 0; i < m_nPoolSize; ++i)
+    {
+        MSDK_ZERO_MEMORY(m_Packets[i].bs);
+        m_Packets[i].flags = MSDK_PACKET_FLAG_NONE;
+
+        mfxStatus sts = InitMfxBitstream(&m_Packets[i].bs, m_nBufferSize);
+        MSDK_CHECK_STATUS(sts, "InitMfxBitstream failed");
+
+        m_FreeQueue.enqueue(&m_Packets[i]);
+    }
+
+    m_bInited = true;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CPushBitstreamReader::SubmitPacket(const mfxU8 *pData, mfxU32 nSize, mfxU64 nTimeStamp, mfxU16 nFlags)
+{
+    // counted before the stop flag is checked, so Close either sees this call or the call sees the stop
+    ++m_nSubmitters;
+    mfxStatus sts = QueuePacket(pData, nSize, nTimeStamp, nFlags);
+    --m_nSubmitters;
+
+    return sts;
+}
+
+mfxStatus CPushBitstreamReader::QueuePacket(const mfxU8 *pData, mfxU32 nSize, mfxU64 nTimeStamp, mfxU16 nFlags)
+{
+    if (m_bStop)
+        return MFX_ERR_ABORTED;
+    if (!m_bInited)
+        return MFX_ERR_NOT_INITIALIZED;
+    if (m_bEosSubmitted)
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+    if (nSize && !pData)
+        return MFX_ERR_NULL_PTR;
+
+    sPacket* pPacket = NULL;
+    while (!m_FreeQueue.wait_dequeue_timed(pPacket, MSDK_PUSH_WAIT_INTERVAL_US))
+    {
+        if (m_bStop)
+            return MFX_ERR_ABORTED;
+    }
+
+    mfxBitstream& bs = pPacket->bs;
+    if (nSize > bs.MaxLength)
+    {
+        mfxStatus sts = ExtendMfxBitstream(&bs, nSize);
+        if (MFX_ERR_NONE != sts)
+        {
+            m_FreeQueue.enqueue(pPacket);
+            return sts;
+        }
+    }
+
+    if (nSize)
+    {
+        MSDK_MEMCPY_BITSTREAM(bs, 0, pData, nSize);
+    }
+    bs.DataOffset = 0;
+    bs.DataLength = nSize;
+    bs.TimeStamp  = nTimeStamp;
+    pPacket->flags = nFlags;
+
+    if (nFlags & MSDK_PACKET_FLAG_END_OF_STREAM)
+        m_bEosSubmitted = true;
+
+    m_ReadyQueue.enqueue(pPacket);
+    if (m_PacketNotify)
+        m_PacketNotify();
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CPushBitstreamReader::ReadNextFrame(mfxBitstream *pBS)
+{
+    if (!m_bInited)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    if (m_bEosReached || m_bStop)
+        return MFX_ERR_MORE_DATA;
+
+    sPacket* pPacket = NULL;
+    while (!m_ReadyQueue.wait_dequeue_timed(pPacket, MSDK_PUSH_WAIT_INTERVAL_US))
+    {
+        if (m_bStop)
+            return MFX_ERR_MORE_DATA;
+    }
+
+    mfxBitstream& src = pPacket->bs;
+
+    if (pPacket->flags & MSDK_PACKET_FLAG_DISCONTINUITY)
+    {
+        // leftover of the previous packet can't be continued by this one
+        pBS->DataOffset = 0;
+        pBS->DataLength = 0;
+        ++m_nDiscontinuities;
+    }
+
+    // a leftover partial packet in front of this one means the data is no longer a single complete frame
+    bool bCompleteFrame = !pBS->DataLength && (pPacket->flags & MSDK_PACKET_FLAG_COMPLETE_FRAME);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    if (!pBS->DataLength)
+    {
+        // nothing left to keep: hand the pooled buffer to the decoder as is
+        // and recycle the decoder's previous buffer instead of copying the payload
+        std::swap(pBS->Data, src.Data);
+        std::swap(pBS->MaxLength, src.MaxLength);
+        pBS->DataOffset = src.DataOffset;
+        pBS->DataLength = src.DataLength;
+        pBS->TimeStamp  = src.TimeStamp;
+    }
+    else
+    {
+        mfxU32 nRequired = pBS->DataLength + src.DataLength;
+        if (nRequired > pBS->MaxLength)
+        {
+            sts = ExtendMfxBitstream(pBS, nRequired);
+        }
+        else if (nRequired > pBS->MaxLength - pBS->DataOffset)
+        {
+            memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+            m_nMovedBytes += pBS->DataLength;
+            pBS->DataOffset = 0;
+        }
+
+        if (MFX_ERR_NONE == sts && src.DataLength)
+        {
+            MSDK_MEMCPY_BITSTREAM(*pBS, pBS->DataOffset + pBS->DataLength, src.Data + src.DataOffset, src.DataLength);
+            pBS->DataLength = nRequired;
+        }
+    }
+
+    pBS->DataFlag = bCompleteFrame ? MFX_BITSTREAM_COMPLETE_FRAME : 0;
+
+    bool bEndOfStream = (pPacket->flags & MSDK_PACKET_FLAG_END_OF_STREAM) != 0;
+    bool bEmpty = (0 == src.DataLength);
+
+    src.DataOffset = 0;
+    src.DataLength = 0;
+    pPacket->flags = MSDK_PACKET_FLAG_NONE;
+    m_FreeQueue.enqueue(pPacket);
+
+    MSDK_CHECK_STATUS(sts, "ExtendMfxBitstream failed");
+
+    if (bEndOfStream)
+    {
+        m_bEosReached = true;
+        if (bEmpty && !pBS->DataLength)
+            return MFX_ERR_MORE_DATA;
+    }
+
+    return MFX_ERR_NONE;
+}
@@ -0,0 +1,288 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "sample_defs.h"
+#include "ring_bitstream_reader.h"
+
+// address space for the double mapping may be taken by another thread between
+// the probe and the mapping itself, so mapping is retried a few times
+#define MSDK_RING_MAP_ATTEMPTS 8
+
+CRingBitstreamReader::CRingBitstreamReader(mfxU32 nRingSize)
+    : CSmplBitstreamReader()
+    , m_pRing(NULL)
+    , m_nRingSize(nRingSize)
+#if defined(_WIN32) || defined(_WIN64)
+    , m_hMapping(NULL)
+#endif
+{
+}
+
+CRingBitstreamReader::~CRingBitstreamReader()
+{
+    Close();
+}
+
+void CRingBitstreamReader::Close()
+{
+    UnmapRing();
+    CSmplBitstreamReader::Close();
+}
+
+mfxStatus CRingBitstreamReader::Init(const msdk_char *strFileName)
+{
+    mfxStatus sts = CSmplBitstreamReader::Init(strFileName);
+    MSDK_CHECK_STATUS(sts, "CSmplBitstreamReader::Init failed");
+
+    return MapRing(m_nRingSize);
+}
+
+mfxStatus CRingBitstreamReader::AttachBitstream(mfxBitstream *pBS)
+{
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(m_pRing, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_ERROR(pBS->Data == NULL, false, MFX_ERR_UNDEFINED_BEHAVIOR);
+
+    pBS->Data       = m_pRing;
+    pBS->MaxLength  = m_nRingSize * 2;
+    pBS->DataOffset = 0;
+    pBS->DataLength = 0;
+
+    return MFX_ERR_NONE;
+}
+
+void CRingBitstreamReader::DetachBitstream(mfxBitstream *pBS)
+{
+    if (pBS && m_pRing && pBS->Data == m_pRing)
+    {
+        pBS->Data       = NULL;
+        pBS->MaxLength  = 0;
+        pBS->DataOffset = 0;
+        pBS->DataLength = 0;
+    }
+}
+
+mfxStatus CRingBitstreamReader::ReadNextFrame(mfxBitstream *pBS)
+{
+    if (!m_bInited)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    if (!m_pRing || pBS->Data != m_pRing)
+        return CSmplBitstreamReader::ReadNextFrame(pBS);
+
+    // a window starting in the mirror is the same bytes one ring size earlier
+    if (pBS->DataOffset >= m_nRingSize)
+        pBS->DataOffset -= m_nRingSize;
+
+    if (pBS->DataLength >= m_nRingSize)
+    {
+        // unconsumed data fills the whole ring, decoder needs a bigger window
+        mfxStatus sts = GrowRing(pBS);
+        MSDK_CHECK_STATUS(sts, "GrowRing failed");
+    }
+
+    // append right behind the data, the window may run into the mirror but never past it
+    mfxU32 nBytesRead = (mfxU32)fread(pBS->Data + pBS->DataOffset + pBS->DataLength, 1, m_nRingSize - pBS->DataLength, m_fSource);
+
+    if (0 == nBytesRead)
+    {
+        return MFX_ERR_MORE_DATA;
+    }
+
+    pBS->DataLength += nBytesRead;
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CRingBitstreamReader::GrowRing(mfxBitstream *pBS)
+{
+    // both views together must stay addressable by mfxBitstream::MaxLength
+    MSDK_CHECK_ERROR(m_nRingSize > 0x3FFFFFFF, true, MFX_ERR_NOT_ENOUGH_BUFFER);
+
+    mfxU8* pOldRing   = m_pRing;
+    mfxU32 nOldSize   = m_nRingSize;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE hOldMapping = m_hMapping;
+    m_hMapping = NULL;
+#endif
+
+    m_pRing = NULL;
+    mfxStatus sts = MapRing(nOldSize * 2);
+    if (MFX_ERR_NONE == sts)
+    {
+        MSDK_MEMCPY(m_pRing, pOldRing + pBS->DataOffset, pBS->DataLength);
+        m_nMovedBytes += pBS->DataLength;
+
+        pBS->Data       = m_pRing;
+        pBS->MaxLength  = m_nRingSize * 2;
+        pBS->DataOffset = 0;
+    }
+
+    // release the old ring, or restore it if the new one could not be mapped
+    mfxU8* pNewRing = m_pRing;
+    m_pRing     = pOldRing;
+    m_nRingSize = nOldSize;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE hNewMapping = m_hMapping;
+    m_hMapping = hOldMapping;
+#endif
+    if (MFX_ERR_NONE != sts)
+        return sts;
+
+    UnmapRing();
+    m_pRing     = pNewRing;
+    m_nRingSize = nOldSize * 2;
+#if defined(_WIN32) || defined(_WIN64)
+    m_hMapping  = hNewMapping;
+#endif
+
+    return MFX_ERR_NONE;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+mfxStatus CRingBitstreamReader::MapRing(mfxU32 nSize)
+{
+    UnmapRing();
+
+    // views must start on allocation granularity boundaries
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    mfxU32 nGranularity = info.dwAllocationGranularity;
+    nSize = (nSize + nGranularity - 1) / nGranularity * nGranularity;
+
+    m_hMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, nSize, NULL);
+    MSDK_CHECK_POINTER(m_hMapping, MFX_ERR_MEMORY_ALLOC);
+
+    for (int i = 0; i < MSDK_RING_MAP_ATTEMPTS && !m_pRing; ++i)
+    {
+        // find a free range big enough for both views, then map the views over it
+        mfxU8* pRange = (mfxU8*)VirtualAlloc(NULL, (SIZE_T)nSize * 2, MEM_RESERVE, PAGE_NOACCESS);
+        if (!pRange)
+            break;
+        VirtualFree(pRange, 0, MEM_RELEASE);
+
+        mfxU8* pFirst  = (mfxU8*)MapViewOfFileEx(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, nSize, pRange);
+        mfxU8* pSecond = pFirst ? (mfxU8*)MapViewOfFileEx(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, nSize, pRange + nSize) : NULL;
+
+        if (pFirst && pSecond)
+        {
+            m_pRing = pFirst;
+        }
+        else if (pFirst)
+        {
+            UnmapViewOfFile(pFirst);
+        }
+    }
+
+    if (!m_pRing)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    m_nRingSize = nSize;
+    return MFX_ERR_NONE;
+}
+
+void CRingBitstreamReader::UnmapRing()
+{
+    if (m_pRing)
+    {
+        UnmapViewOfFile(m_pRing + m_nRingSize);
+        UnmapViewOfFile(m_pRing);
+        m_pRing = NULL;
+    }
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+}
+
+#else // #if defined(_WIN32) || defined(_WIN64)
+
+mfxStatus CRingBitstreamReader::MapRing(mfxU32 nSize)
+{
+    UnmapRing();
+
+    mfxU32 nPage = (mfxU32)sysconf(_SC_PAGESIZE);
+    nSize = (nSize + nPage - 1) / nPage * nPage;
+
+    // anonymous shared memory object, unlinked right away so it goes with the last mapping
+    static volatile mfxU32 counter = 0;
+    char name[64];
+    snprintf(name, sizeof(name), "/msdk_ring_%d_%u", (int)getpid(), msdk_atomic_inc32(&counter));
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        return MFX_ERR_MEMORY_ALLOC;
+    shm_unlink(name);
+
+    if (ftruncate(fd, nSize))
+    {
+        close(fd);
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    // reserve the whole range first so the second view can be placed with MAP_FIXED safely
+    mfxU8* pRange = (mfxU8*)mmap(NULL, (size_t)nSize * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED != pRange)
+    {
+        if (MAP_FAILED != mmap(pRange, nSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) &&
+            MAP_FAILED != mmap(pRange + nSize, nSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0))
+        {
+            m_pRing = pRange;
+        }
+        else
+        {
+            munmap(pRange, (size_t)nSize * 2);
+        }
+    }
+    close(fd);
+
+    MSDK_CHECK_POINTER(m_pRing, MFX_ERR_MEMORY_ALLOC);
+
+    m_nRingSize = nSize;
+    return MFX_ERR_NONE;
+}
+
+void CRingBitstreamReader::UnmapRing()
+{
+    if (m_pRing)
+    {
+        munmap(m_pRing, (size_t)m_nRingSize * 2);
+        m_pRing = NULL;
+    }
+}
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
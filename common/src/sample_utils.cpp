@@ -29,6 +29,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "time_statistics.h"
 #include "sample_defs.h"
 #include "sample_utils.h"
+#include "stream_index.h"
+#include "bitstream_segmenter.h"
 #include "mfxcommon.h"
 #include "mfxjpeg.h"
 #include "mfxvp8.h"
@@ -425,6 +427,7 @@ CSmplBitstreamWriter::CSmplBitstreamWriter()
     m_fSource = NULL;
     m_bInited = false;
     m_nProcessedFramesNum = 0;
+    m_pSegmenter = NULL;
 }
 
 CSmplBitstreamWriter::~CSmplBitstreamWriter()
@@ -473,6 +476,34 @@ mfxStatus CSmplBitstreamWriter::WriteNextFrame(mfxBitstream *pMfxBitstream, bool
     MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
     MSDK_CHECK_POINTER(pMfxBitstream, MFX_ERR_NULL_PTR);
 
+    mfxStatus sts = SelectSegment(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "SelectSegment failed");
+
+    return WriteData(pMfxBitstream, isPrint);
+}
+
+mfxStatus CSmplBitstreamWriter::SelectSegment(const mfxBitstream *pMfxBitstream)
+{
+    if (!m_pSegmenter)
+        return MFX_ERR_NONE;
+
+    return m_pSegmenter->PrepareFrame(pMfxBitstream, m_fSource, m_sFile);
+}
+
+mfxStatus CSmplBitstreamWriter::WriteToSegment(const mfxBitstream *pMfxBitstream)
+{
+    if (!m_pSegmenter || !pMfxBitstream->DataLength)
+        return MFX_ERR_NONE;
+
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+    mfxU32 nBytesWritten = (mfxU32)fwrite(pMfxBitstream->Data + pMfxBitstream->DataOffset, 1, pMfxBitstream->DataLength, m_fSource);
+    MSDK_CHECK_NOT_EQUAL(nBytesWritten, pMfxBitstream->DataLength, MFX_ERR_UNDEFINED_BEHAVIOR);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CSmplBitstreamWriter::WriteData(mfxBitstream *pMfxBitstream, bool isPrint)
+{
     mfxU32 nBytesWritten = 0;
 
     nBytesWritten = (mfxU32)fwrite(pMfxBitstream->Data + pMfxBitstream->DataOffset, 1, pMfxBitstream->DataLength, m_fSource);
@@ -501,7 +532,17 @@ mfxStatus CSmplBitstreamWriter::WriteNextFrame(mfxBitstream *pMfxBitstream, bool
 mfxStatus CSmplBitstreamWriter::SndBitstream(mfxBitstream* pMfxBitstream)
 {
 	MSDK_CHECK_POINTER(pMfxBitstream, MFX_ERR_NULL_PTR);
-	mfxU32 nBytesWritten = 0;
+
+	mfxStatus sts = SelectSegment(pMfxBitstream);
+	MSDK_CHECK_STATUS(sts, "SelectSegment failed");
+	sts = WriteToSegment(pMfxBitstream);
+	MSDK_CHECK_STATUS(sts, "WriteToSegment failed");
+
+	return QueueData(pMfxBitstream);
+}
+
+mfxStatus CSmplBitstreamWriter::QueueData(mfxBitstream* pMfxBitstream)
+{
 	mfxBitstream* pBitstream = new mfxBitstream();
 	if(pBitstream != nullptr)
 	{
@@ -619,6 +660,9 @@ CSmplBitstreamReader::CSmplBitstreamReader()
 {
     m_fSource = NULL;
     m_bInited = false;
+    m_nMovedBytes = 0;
+    m_nSkippedFrames = 0;
+    m_pIndex = NULL;
 }
 
 CSmplBitstreamReader::~CSmplBitstreamReader()
@@ -657,6 +701,8 @@ mfxStatus CSmplBitstreamReader::Init(const msdk_char *strFileName)
     MSDK_FOPEN(m_fSource, strFileName, MSDK_STRING("rb"));
     MSDK_CHECK_POINTER(m_fSource, MFX_ERR_NULL_PTR);
 
+    m_nMovedBytes = 0;
+    m_nSkippedFrames = 0;
     m_bInited = true;
     return MFX_ERR_NONE;
 }
@@ -670,7 +716,11 @@ mfxStatus CSmplBitstreamReader::ReadNextFrame(mfxBitstream *pBS)
 
     mfxU32 nBytesRead = 0;
 
-    memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+    if (pBS->DataOffset)
+    {
+        memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+        m_nMovedBytes += pBS->DataLength;
+    }
     pBS->DataOffset = 0;
     nBytesRead = (mfxU32)fread(pBS->Data + pBS->DataLength, 1, pBS->MaxLength - pBS->DataLength, m_fSource);
 
@@ -684,6 +734,35 @@ mfxStatus CSmplBitstreamReader::ReadNextFrame(mfxBitstream *pBS)
     return MFX_ERR_NONE;
 }
 
+mfxStatus CSmplBitstreamReader::Seek(mfxU32 nFrame, mfxU32 *pKeyFrame)
+{
+    if (!m_bInited)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    MSDK_CHECK_POINTER(m_pIndex, MFX_ERR_NOT_INITIALIZED);
+
+    CStreamIndex::sEntry entry;
+    mfxStatus sts = m_pIndex->Find(nFrame, &entry);
+    MSDK_CHECK_STATUS(sts, "m_pIndex->Find failed");
+
+    sts = SeekToOffset(entry.nOffset);
+    MSDK_CHECK_STATUS(sts, "SeekToOffset failed");
+
+    if (pKeyFrame)
+        *pKeyFrame = entry.nFrame;
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CSmplBitstreamReader::SeekToOffset(mfxU64 nOffset)
+{
+    // readers fed from memory have no file to seek in
+    MSDK_CHECK_POINTER(m_fSource, MFX_ERR_UNSUPPORTED);
+    MSDK_CHECK_NOT_EQUAL(MSDK_FSEEK64(m_fSource, (mfxI64)nOffset, SEEK_SET), 0, MFX_ERR_UNDEFINED_BEHAVIOR);
+
+    return MFX_ERR_NONE;
+}
+
 
 mfxU32 CJPEGFrameReader::FindMarker(mfxBitstream *pBS,mfxU32 startOffset,CJPEGFrameReader::JPEGMarker marker)
 {
@@ -765,6 +844,7 @@ mfxStatus CIVFFrameReader::ReadNextFrame(mfxBitstream *pBS)
     MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
 
     memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+    m_nMovedBytes += pBS->DataLength;
     pBS->DataOffset = 0;
     pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
 
@@ -2396,6 +2476,7 @@ CH264FrameReader::CH264FrameReader()
 , m_frame(0)
 , m_plainBuffer(0)
 , m_plainBufferSize(0)
+, m_bKeyFramesOnly(false)
 {
 }
 
@@ -2437,10 +2518,28 @@ mfxStatus CH264FrameReader::Init(const msdk_char *strFileName)
     m_frame = 0;
     m_plainBuffer = 0;
     m_plainBufferSize = 0;
+    m_pendingParamSets.clear();
 
     return sts;
 }
 
+mfxStatus CH264FrameReader::SeekToOffset(mfxU64 nOffset)
+{
+    mfxStatus sts = CSmplBitstreamReader::SeekToOffset(nOffset);
+    MSDK_CHECK_STATUS(sts, "CSmplBitstreamReader::SeekToOffset failed");
+
+    // data read ahead belongs to the old position
+    m_originalBS->DataOffset = 0;
+    m_originalBS->DataLength = 0;
+    m_pNALSplitter->Reset();
+    m_frame = NULL;
+    m_processedBS = NULL;
+    m_isEndOfStream = false;
+    m_pendingParamSets.clear();
+
+    return MFX_ERR_NONE;
+}
+
 mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
 {
     mfxStatus sts = MFX_ERR_NONE;
@@ -2493,6 +2592,32 @@ mfxStatus CH264FrameReader::ReadNextFrame(mfxBitstream *pBS)
     return sts;
 }
 
+static bool IsIntraFrame(const FrameSplitterInfo *frame)
+{
+    for (mfxU32 i = 0; i < frame->SliceNum; i++)
+    {
+        if (frame->Slice[i].SliceType != TYPE_I)
+            return false;
+    }
+    return frame->SliceNum != 0;
+}
+
+// appends the SPS and PPS units of an Annex B buffer, start codes included
+static void CollectParamSets(std::vector<mfxU8> &dst, const mfxU8 *data, mfxU32 size)
+{
+    for (mfxU32 pos = FindAnnexBStartCode(data, size, 0); pos < size; )
+    {
+        mfxU32 next = FindAnnexBStartCode(data, size, pos + 3);
+
+        sNalUnitInfo info;
+        ClassifyNalUnit(false, data + pos + 3, next - pos - 3, &info);
+        if (info.bParamSet)
+            dst.insert(dst.end(), data + pos, data + next);
+
+        pos = next;
+    }
+}
+
 mfxStatus CH264FrameReader::PrepareNextFrame(mfxBitstream *in, mfxBitstream **out)
 {
     mfxStatus sts = MFX_ERR_NONE;
@@ -2502,15 +2627,32 @@ mfxStatus CH264FrameReader::PrepareNextFrame(mfxBitstream *in, mfxBitstream **ou
 
     *out = NULL;
 
-    // get frame if it is not ready yet
-    if (NULL == m_frame)
+    for (;;)
     {
-        sts = m_pNALSplitter->GetFrame(in, &m_frame);
-        if (sts != MFX_ERR_NONE)
-            return sts;
+        // get frame if it is not ready yet
+        if (NULL == m_frame)
+        {
+            sts = m_pNALSplitter->GetFrame(in, &m_frame);
+            if (sts != MFX_ERR_NONE)
+                return sts;
+        }
+
+        if (!m_bKeyFramesOnly || IsIntraFrame(m_frame))
+            break;
+
+        // inter frame is never submitted to decoder in key frames mode,
+        // its parameter sets are passed on with the next key frame
+        CollectParamSets(m_pendingParamSets, m_frame->Data, m_frame->DataLength);
+        m_pNALSplitter->ResetCurrentState();
+        m_frame = NULL;
+        m_nSkippedFrames++;
     }
 
-    if (m_plainBufferSize < m_frame->DataLength)
+    // parameter sets of dropped frames go first, the decoder might not have seen them
+    mfxU32 nPending = (mfxU32)m_pendingParamSets.size();
+    mfxU32 nDataLength = nPending + m_frame->DataLength;
+
+    if (m_plainBufferSize < nDataLength)
     {
         if (NULL != m_plainBuffer)
         {
@@ -2518,19 +2660,22 @@ mfxStatus CH264FrameReader::PrepareNextFrame(mfxBitstream *in, mfxBitstream **ou
             m_plainBuffer = NULL;
             m_plainBufferSize = 0;
         }
-        m_plainBuffer = (mfxU8*)malloc(m_frame->DataLength);
+        m_plainBuffer = (mfxU8*)malloc(nDataLength);
         if (NULL == m_plainBuffer)
             return MFX_ERR_MEMORY_ALLOC;
-        m_plainBufferSize = m_frame->DataLength;
+        m_plainBufferSize = nDataLength;
     }
 
-    MSDK_MEMCPY_BUF(m_plainBuffer, 0, m_plainBufferSize, m_frame->Data, m_frame->DataLength);
+    if (nPending)
+        MSDK_MEMCPY_BUF(m_plainBuffer, 0, m_plainBufferSize, &m_pendingParamSets[0], nPending);
+    MSDK_MEMCPY_BUF(m_plainBuffer, nPending, m_plainBufferSize, m_frame->Data, m_frame->DataLength);
+    m_pendingParamSets.clear();
 
     memset(&m_outBS, 0, sizeof(mfxBitstream));
     m_outBS.Data = m_plainBuffer;
     m_outBS.DataOffset = 0;
-    m_outBS.DataLength = m_frame->DataLength;
-    m_outBS.MaxLength = m_frame->DataLength;
+    m_outBS.DataLength = nDataLength;
+    m_outBS.MaxLength = nDataLength;
     m_outBS.DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
     m_outBS.TimeStamp = m_frame->TimeStamp;
 
@@ -2543,6 +2688,303 @@ mfxStatus CH264FrameReader::PrepareNextFrame(mfxBitstream *in, mfxBitstream **ou
 }
 
 
+mfxU32 FindAnnexBStartCode(const mfxU8 *data, mfxU32 size, mfxU32 pos)
+{
+    for (; pos + 3 <= size; pos++)
+    {
+        if (data[pos + 2] > 1)
+            pos += 2; // none of the next three positions can start a start code
+        else if (!data[pos] && !data[pos + 1] && data[pos + 2] == 1)
+            return pos;
+    }
+    return size;
+}
+
+void ClassifyNalUnit(bool bHEVC, const mfxU8 *nal, mfxU32 size, sNalUnitInfo *pInfo)
+{
+    using namespace ProtectedLibrary;
+
+    MSDK_ZERO_MEMORY(*pInfo);
+
+    if (!bHEVC)
+    {
+        if (size < 1)
+            return;
+
+        mfxU8 type = nal[0] & NAL_UNITTYPE_BITS;
+        pInfo->nType         = type;
+        pInfo->bSlice        = (NAL_UT_SLICE == type || NAL_UT_IDR_SLICE == type);
+        // first_mb_in_slice is ue(v), a leading 1 bit codes 0
+        pInfo->bFirstSlice   = pInfo->bSlice && size > 1 && (nal[1] & 0x80);
+        pInfo->bRandomAccess = (NAL_UT_IDR_SLICE == type);
+        // SEI to AUD, and SPS extension to the reserved types before auxiliary slices
+        pInfo->bPrefix       = (type >= NAL_UT_SEI && type <= NAL_UT_AUD) || (type >= NAL_UT_SPS_EX && type < NAL_UT_AUXILIARY);
+        pInfo->bParamSet     = (NAL_UT_SPS == type || NAL_UT_PPS == type);
+    }
+    else
+    {
+        if (size < 2)
+            return;
+
+        mfxU8 type = (nal[0] >> 1) & 0x3F;
+        pInfo->nType         = type;
+        pInfo->bSlice        = (type < HEVC_NAL_VPS);
+        pInfo->bFirstSlice   = pInfo->bSlice && size > 2 && (nal[2] & 0x80); // first_slice_segment_in_pic_flag
+        pInfo->bRandomAccess = (type >= HEVC_NAL_BLA_W_LP && type <= HEVC_NAL_RSV_IRAP_23);
+        pInfo->bPrefix       = (type >= HEVC_NAL_VPS && type <= HEVC_NAL_AUD) || type == HEVC_NAL_PREFIX_SEI ||
+            (type >= HEVC_NAL_RSV_NVCL_41 && type <= HEVC_NAL_RSV_NVCL_44) ||
+            (type >= HEVC_NAL_UNSPEC_48 && type <= HEVC_NAL_UNSPEC_55);
+        pInfo->bParamSet     = (type >= HEVC_NAL_VPS && type <= HEVC_NAL_PPS);
+    }
+}
+
+static void AppendNalUnit(std::vector<mfxU8> &dst, const mfxU8 *nal, mfxU32 size)
+{
+    static const mfxU8 start_code_prefix[] = {0, 0, 0, 1};
+
+    dst.insert(dst.end(), start_code_prefix, start_code_prefix + sizeof(start_code_prefix));
+    dst.insert(dst.end(), nal, nal + size);
+}
+
+CHEVCFrameReader::CHEVCFrameReader()
+    : CSmplBitstreamReader()
+    , m_isEndOfStream(false)
+    , m_bKeyFramesOnly(false)
+    , m_bAuHasSlices(false)
+    , m_bAuIsIrap(false)
+{
+}
+
+CHEVCFrameReader::~CHEVCFrameReader()
+{
+    Close();
+}
+
+void CHEVCFrameReader::ResetState()
+{
+    if (m_originalBS.get())
+    {
+        m_originalBS->DataOffset = 0;
+        m_originalBS->DataLength = 0;
+    }
+    m_isEndOfStream = false;
+
+    m_au.clear();
+    m_auParamSets.clear();
+    m_next.clear();
+    m_nextParamSets.clear();
+    m_pendingParamSets.clear();
+    m_bAuHasSlices = false;
+    m_bAuIsIrap = false;
+}
+
+void CHEVCFrameReader::Reset()
+{
+    CSmplBitstreamReader::Reset();
+    ResetState();
+}
+
+mfxStatus CHEVCFrameReader::SeekToOffset(mfxU64 nOffset)
+{
+    mfxStatus sts = CSmplBitstreamReader::SeekToOffset(nOffset);
+    MSDK_CHECK_STATUS(sts, "CSmplBitstreamReader::SeekToOffset failed");
+
+    ResetState();
+    return MFX_ERR_NONE;
+}
+
+void CHEVCFrameReader::Close()
+{
+    WipeMfxBitstream(m_originalBS.get());
+    m_originalBS.reset();
+    ResetState();
+    CSmplBitstreamReader::Close();
+}
+
+mfxStatus CHEVCFrameReader::Init(const msdk_char *strFileName)
+{
+    mfxStatus sts = CSmplBitstreamReader::Init(strFileName);
+    if (sts != MFX_ERR_NONE)
+        return sts;
+
+    m_originalBS.reset(new mfxBitstream());
+    sts = InitMfxBitstream(m_originalBS.get(), 1024 * 1024);
+    if (sts != MFX_ERR_NONE)
+        return sts;
+
+    ResetState();
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CHEVCFrameReader::GetNalUnit(mfxU8 **ppNal, mfxU32 *pSize)
+{
+    mfxBitstream *bs = m_originalBS.get();
+
+    for (;;)
+    {
+        mfxU8 *data = bs->Data + bs->DataOffset;
+        mfxU32 start = FindAnnexBStartCode(data, bs->DataLength, 0);
+        mfxU32 next = (start < bs->DataLength) ? FindAnnexBStartCode(data, bs->DataLength, start + 3) : bs->DataLength;
+
+        // NAL unit is complete when the next one has started or the file is over
+        if (next < bs->DataLength || (m_isEndOfStream && start < bs->DataLength))
+        {
+            mfxU32 end = next;
+            while (end > start + 3 && !data[end - 1])
+                end--; // trailing_zero_8bits or the leading zero of a 4 byte start code
+
+            *ppNal = data + start + 3;
+            *pSize = end - start - 3;
+
+            bs->DataOffset += next;
+            bs->DataLength -= next;
+            return MFX_ERR_NONE;
+        }
+
+        if (m_isEndOfStream)
+        {
+            bs->DataLength = 0;
+            return MFX_ERR_MORE_DATA;
+        }
+
+        // drop garbage before the start code, then make room for the rest of the NAL unit
+        if (start < bs->DataLength)
+        {
+            bs->DataOffset += start;
+            bs->DataLength -= start;
+        }
+        else if (bs->DataLength > 2)
+        {
+            bs->DataOffset += bs->DataLength - 2;
+            bs->DataLength = 2;
+        }
+        if (bs->DataLength == bs->MaxLength)
+        {
+            mfxStatus sts = ExtendMfxBitstream(bs, bs->MaxLength * 2);
+            MSDK_CHECK_STATUS(sts, "ExtendMfxBitstream failed");
+        }
+
+        mfxStatus sts = CSmplBitstreamReader::ReadNextFrame(bs);
+        if (MFX_ERR_MORE_DATA == sts)
+            m_isEndOfStream = true;
+        else if (MFX_ERR_NONE != sts)
+            return sts;
+    }
+}
+
+mfxStatus CHEVCFrameReader::FinishAccessUnit(mfxBitstream *pBS, bool *pbOutput)
+{
+    *pbOutput = false;
+
+    if (m_bAuHasSlices)
+    {
+        if (!m_bKeyFramesOnly || m_bAuIsIrap)
+        {
+            // parameter sets of dropped units go first, the decoder might not have seen them
+            m_pendingParamSets.insert(m_pendingParamSets.end(), m_au.begin(), m_au.end());
+            m_pendingParamSets.swap(m_au);
+            m_pendingParamSets.clear();
+
+            mfxBitstream au;
+            MSDK_ZERO_MEMORY(au);
+            au.Data = &m_au[0];
+            au.DataLength = au.MaxLength = (mfxU32)m_au.size();
+            au.DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+
+            if (au.DataLength > pBS->MaxLength - pBS->DataLength)
+            {
+                mfxStatus sts = ExtendMfxBitstream(pBS, pBS->DataLength + au.DataLength);
+                MSDK_CHECK_STATUS(sts, "ExtendMfxBitstream failed");
+            }
+            mfxStatus sts = CopyBitstream2(pBS, &au);
+            MSDK_CHECK_STATUS(sts, "CopyBitstream2 failed");
+
+            *pbOutput = true;
+        }
+        else
+        {
+            m_pendingParamSets.insert(m_pendingParamSets.end(), m_auParamSets.begin(), m_auParamSets.end());
+            m_nSkippedFrames++;
+        }
+    }
+
+    m_au.swap(m_next);
+    m_auParamSets.swap(m_nextParamSets);
+    m_next.clear();
+    m_nextParamSets.clear();
+    m_bAuHasSlices = false;
+    m_bAuIsIrap = false;
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CHEVCFrameReader::ReadNextFrame(mfxBitstream *pBS)
+{
+    if (!m_bInited)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    for (;;)
+    {
+        mfxU8 *nal = NULL;
+        mfxU32 size = 0;
+        bool bOutput = false;
+
+        mfxStatus sts = GetNalUnit(&nal, &size);
+        if (MFX_ERR_MORE_DATA == sts)
+        {
+            // end of file completes the last access unit
+            sts = FinishAccessUnit(pBS, &bOutput);
+            MSDK_CHECK_STATUS(sts, "FinishAccessUnit failed");
+            return bOutput ? MFX_ERR_NONE : MFX_ERR_MORE_DATA;
+        }
+        MSDK_CHECK_STATUS(sts, "GetNalUnit failed");
+
+        if (size < 2)
+            continue;
+
+        sNalUnitInfo info;
+        ClassifyNalUnit(true, nal, size, &info);
+
+        if (info.bSlice)
+        {
+            // first_slice_segment_in_pic_flag starts a new picture
+            if (m_bAuHasSlices && info.bFirstSlice)
+            {
+                sts = FinishAccessUnit(pBS, &bOutput);
+                MSDK_CHECK_STATUS(sts, "FinishAccessUnit failed");
+            }
+            else if (!m_next.empty())
+            {
+                // non-VCL units between slices of one picture
+                m_au.insert(m_au.end(), m_next.begin(), m_next.end());
+                m_auParamSets.insert(m_auParamSets.end(), m_nextParamSets.begin(), m_nextParamSets.end());
+                m_next.clear();
+                m_nextParamSets.clear();
+            }
+
+            AppendNalUnit(m_au, nal, size);
+            m_bAuHasSlices = true;
+            m_bAuIsIrap = m_bAuIsIrap || info.bRandomAccess;
+
+            if (bOutput)
+                return MFX_ERR_NONE;
+        }
+        else
+        {
+            // these can only precede the first slice of an access unit
+            bool bToNext = m_bAuHasSlices && (info.bPrefix || !m_next.empty());
+
+            AppendNalUnit(bToNext ? m_next : m_au, nal, size);
+            if (info.bParamSet)
+                AppendNalUnit(bToNext ? m_nextParamSets : m_auParamSets, nal, size);
+        }
+    }
+}
+
+
 // 1 ms provides better result in range [0..5] ms
 #define DEVICE_WAIT_TIME 1
 
@@ -2588,3 +3030,18 @@ mfxU16 FourCCToChroma(mfxU32 fourCC)
 
     return MFX_CHROMAFORMAT_YUV420;
 }
+
+// every 8th page is enough to see where a pool ended up
+#define MSDK_NUMA_PAGE_SAMPLE_STEP 8
+
+mfxStatus CountSurfacePages(const mfxFrameSurface1 *pSurface, mfxI32 node, mfxU32 *pLocal, mfxU32 *pRemote)
+{
+    MSDK_CHECK_POINTER(pSurface, MFX_ERR_NULL_PTR);
+
+    const mfxU8 *pPlane = pSurface->Data.Y ? pSurface->Data.Y : pSurface->Data.B;
+    if (!pPlane)
+        return MFX_ERR_NONE; // video memory or not locked
+
+    size_t nSize = (size_t)pSurface->Data.Pitch * pSurface->Info.Height;
+    return msdk_numa_count_pages(pPlane, nSize, node, MSDK_NUMA_PAGE_SAMPLE_STEP, pLocal, pRemote);
+}
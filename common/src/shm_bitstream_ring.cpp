@@ -0,0 +1,395 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include "shm_bitstream_ring.h"
+
+#define MSDK_SHM_PACKET_SIZE(payload) ((sizeof(msdkShmPacketHeader) + (payload) + 7) & ~(mfxU64)7)
+
+CShmBitstreamRing::CShmBitstreamRing()
+    : m_pHeader(NULL)
+    , m_pData(NULL)
+    , m_nWritePos(0)
+    , m_nWriteSeq(0)
+    , m_nReadPos(0)
+    , m_nAcquiredPos(MSDK_SHM_NO_PACKET)
+    , m_nNextSeq(0)
+    , m_bSeqKnown(false)
+    , m_nOverruns(0)
+    , m_nLostPackets(0)
+    , m_bOverrun(false)
+{
+}
+
+CShmBitstreamRing::~CShmBitstreamRing()
+{
+    Close();
+}
+
+mfxStatus CShmBitstreamRing::Create(const msdk_char *strName, mfxU32 nCapacity)
+{
+    MSDK_CHECK_POINTER(strName, MFX_ERR_NULL_PTR);
+
+    Close();
+
+    nCapacity = (nCapacity + MSDK_SHM_RING_ALIGN - 1) & ~(MSDK_SHM_RING_ALIGN - 1);
+    MSDK_CHECK_ERROR(nCapacity, 0, MFX_ERR_INVALID_VIDEO_PARAM);
+    mfxU32 nDataOffset = (sizeof(msdkShmBitstreamHeader) + MSDK_SHM_RING_ALIGN - 1) & ~(MSDK_SHM_RING_ALIGN - 1);
+
+    mfxStatus sts = CreateMapping(strName, nDataOffset + nCapacity);
+    MSDK_CHECK_STATUS(sts, "CreateMapping failed");
+
+    m_pHeader = (msdkShmBitstreamHeader*)m_pMapped;
+    m_pHeader->Capacity = nCapacity;
+    m_pHeader->DataOffset = nDataOffset;
+    m_pHeader->ReservePos.store(0);
+    m_pHeader->WritePos.store(0);
+    m_pHeader->KeyPos.store(MSDK_SHM_NO_PACKET);
+    m_pHeader->PacketSeq.store(0);
+    m_pHeader->Closed.store(0);
+    m_pData = m_pMapped + nDataOffset;
+
+    m_nWritePos = 0;
+    m_nWriteSeq = 0;
+
+    Publish(MSDK_SHM_BITSTREAM_RING_MAGIC, MSDK_SHM_BITSTREAM_RING_VERSION);
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmBitstreamRing::Open(const msdk_char *strName, mfxU32 nTimeoutMs)
+{
+    Close();
+
+    mfxStatus sts = OpenMapping(strName, MSDK_SHM_BITSTREAM_RING_MAGIC, MSDK_SHM_BITSTREAM_RING_VERSION, nTimeoutMs);
+    MSDK_CHECK_STATUS(sts, "OpenMapping failed");
+
+    m_pHeader = (msdkShmBitstreamHeader*)m_pMapped;
+    m_pData = m_pMapped + m_pHeader->DataOffset;
+
+    m_nAcquiredPos = MSDK_SHM_NO_PACKET;
+    m_nNextSeq = 0;
+    m_bSeqKnown = false;
+    m_nOverruns = 0;
+    m_nLostPackets = 0;
+    m_bOverrun = false;
+
+    // from the start if nothing was overwritten yet, otherwise a reader
+    // joining a running stream starts at a key frame if there is one
+    mfxU64 nKeyPos = m_pHeader->KeyPos.load(std::memory_order_acquire);
+    if (!IsOverwritten(0))
+        m_nReadPos = 0;
+    else if (MSDK_SHM_NO_PACKET != nKeyPos && !IsOverwritten(nKeyPos))
+        m_nReadPos = nKeyPos;
+    else
+        m_nReadPos = m_pHeader->WritePos.load(std::memory_order_acquire);
+
+    return MFX_ERR_NONE;
+}
+
+void CShmBitstreamRing::Close()
+{
+    m_pHeader = NULL;
+    m_pData = NULL;
+
+    CShmRing::Close();
+}
+
+mfxStatus CShmBitstreamRing::WritePacket(const mfxBitstream *pBS)
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    mfxU32 nCapacity = m_pHeader->Capacity;
+    mfxU64 nSize = MSDK_SHM_PACKET_SIZE(pBS->DataLength);
+    if (nSize > nCapacity)
+        return MFX_ERR_NOT_ENOUGH_BUFFER;
+
+    mfxU64 nStart = m_nWritePos;
+    mfxU32 nOffset = (mfxU32)(nStart % nCapacity);
+    mfxU32 nLeft = nCapacity - nOffset;
+    if (nSize > nLeft)
+        nStart += nLeft; // doesn't fit before the end of the buffer
+
+    // readers see the range being overwritten before any byte of it changes
+    m_pHeader->ReservePos.store(nStart + nSize, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (nSize > nLeft && nLeft >= sizeof(msdkShmPacketHeader))
+    {
+        msdkShmPacketHeader wrap;
+        MSDK_ZERO_MEMORY(wrap);
+        wrap.Flags = MSDK_SHM_PACKET_WRAP;
+        memcpy(m_pData + nOffset, &wrap, sizeof(wrap));
+    }
+
+    msdkShmPacketHeader header;
+    MSDK_ZERO_MEMORY(header);
+    header.Size = pBS->DataLength;
+    header.Seq = m_nWriteSeq;
+    header.FrameType = pBS->FrameType;
+    header.PicStruct = pBS->PicStruct;
+    header.TimeStamp = pBS->TimeStamp;
+    header.DecodeTimeStamp = pBS->DecodeTimeStamp;
+
+    mfxU8 *pDst = m_pData + nStart % nCapacity;
+    memcpy(pDst, &header, sizeof(header));
+    memcpy(pDst + sizeof(header), pBS->Data + pBS->DataOffset, pBS->DataLength);
+
+    m_nWritePos = nStart + nSize;
+    m_nWriteSeq++;
+    m_pHeader->WritePos.store(m_nWritePos, std::memory_order_release);
+    // after WritePos, a reader never finds a key frame which isn't complete
+    if (pBS->FrameType & MFX_FRAMETYPE_IDR)
+        m_pHeader->KeyPos.store(nStart, std::memory_order_release);
+    m_pHeader->PacketSeq.store(m_nWriteSeq, std::memory_order_release);
+    Wake(m_pHeader->PacketSeq, true);
+
+    return MFX_ERR_NONE;
+}
+
+void CShmBitstreamRing::SetEndOfStream()
+{
+    if (!m_pHeader)
+        return;
+
+    m_pHeader->Closed.store(1, std::memory_order_release);
+    Wake(m_pHeader->PacketSeq, true);
+}
+
+bool CShmBitstreamRing::IsOverwritten(mfxU64 nPos) const
+{
+    // orders the reads of the packet before the check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_pHeader->ReservePos.load(std::memory_order_relaxed) > nPos + m_pHeader->Capacity;
+}
+
+void CShmBitstreamRing::Resync()
+{
+    m_nOverruns++;
+    m_bOverrun = true;
+
+    mfxU64 nWritePos = m_pHeader->WritePos.load(std::memory_order_acquire);
+    mfxU64 nKeyPos = m_pHeader->KeyPos.load(std::memory_order_acquire);
+    m_nReadPos = (MSDK_SHM_NO_PACKET != nKeyPos && !IsOverwritten(nKeyPos)) ? nKeyPos : nWritePos;
+}
+
+mfxStatus CShmBitstreamRing::AcquirePacket(msdkShmPacket *pPacket, mfxU32 nTimeoutMs)
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_POINTER(pPacket, MFX_ERR_NULL_PTR);
+    // the previous packet must be released first
+    if (MSDK_SHM_NO_PACKET != m_nAcquiredPos)
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+    mfxU32 nCapacity = m_pHeader->Capacity;
+    for (;;)
+    {
+        mfxU32 nSeq = m_pHeader->PacketSeq.load(std::memory_order_acquire);
+        if (m_pHeader->WritePos.load(std::memory_order_acquire) == m_nReadPos)
+        {
+            if (m_pHeader->Closed.load(std::memory_order_acquire))
+                return MFX_ERR_MORE_DATA;
+            if (!Wait(m_pHeader->PacketSeq, nSeq, nTimeoutMs, true))
+                return MFX_ERR_MORE_DATA;
+            continue;
+        }
+
+        if (IsOverwritten(m_nReadPos))
+        {
+            Resync();
+            continue;
+        }
+
+        mfxU32 nOffset = (mfxU32)(m_nReadPos % nCapacity);
+        mfxU32 nLeft = nCapacity - nOffset;
+        if (nLeft < sizeof(msdkShmPacketHeader))
+        {
+            m_nReadPos += nLeft;
+            continue;
+        }
+
+        msdkShmPacketHeader header;
+        memcpy(&header, m_pData + nOffset, sizeof(header));
+        // the header may have changed while it was copied
+        if (IsOverwritten(m_nReadPos))
+        {
+            Resync();
+            continue;
+        }
+
+        if (header.Flags & MSDK_SHM_PACKET_WRAP)
+        {
+            m_nReadPos += nLeft;
+            continue;
+        }
+        mfxU64 nSize = MSDK_SHM_PACKET_SIZE(header.Size);
+        MSDK_CHECK_ERROR(nSize > nLeft, true, MFX_ERR_ABORTED);
+
+        if (m_bSeqKnown && header.Seq != m_nNextSeq)
+            m_nLostPackets += header.Seq - m_nNextSeq;
+        m_nNextSeq = header.Seq + 1;
+        m_bSeqKnown = true;
+
+        pPacket->Header = header;
+        pPacket->Data = m_pData + nOffset + sizeof(header);
+        m_nAcquiredPos = m_nReadPos;
+        m_nReadPos += nSize;
+
+        mfxStatus sts = m_bOverrun ? MFX_WRN_OUT_OF_RANGE : MFX_ERR_NONE;
+        m_bOverrun = false;
+        return sts;
+    }
+}
+
+mfxStatus CShmBitstreamRing::ReleasePacket()
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_ERROR(m_nAcquiredPos, MSDK_SHM_NO_PACKET, MFX_ERR_UNDEFINED_BEHAVIOR);
+
+    bool bOverwritten = IsOverwritten(m_nAcquiredPos);
+    m_nAcquiredPos = MSDK_SHM_NO_PACKET;
+    if (bOverwritten)
+    {
+        // the caller drops the packet, the next one follows a gap
+        m_nLostPackets++;
+        m_bOverrun = true;
+        return MFX_ERR_ABORTED;
+    }
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmBitstreamRing::ReadPacket(mfxBitstream *pBS, mfxU32 nTimeoutMs)
+{
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    for (;;)
+    {
+        msdkShmPacket packet;
+        mfxStatus sts = AcquirePacket(&packet, nTimeoutMs);
+        if (sts < MFX_ERR_NONE)
+            return sts;
+
+        if (pBS->MaxLength - pBS->DataOffset - pBS->DataLength < packet.Header.Size)
+        {
+            if (pBS->MaxLength - pBS->DataLength >= packet.Header.Size)
+            {
+                memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+                pBS->DataOffset = 0;
+            }
+            else
+            {
+                mfxStatus extSts = ExtendMfxBitstream(pBS, pBS->DataLength + packet.Header.Size);
+                if (MFX_ERR_NONE != extSts)
+                {
+                    ReleasePacket();
+                    MSDK_CHECK_STATUS(extSts, "ExtendMfxBitstream failed");
+                }
+            }
+        }
+
+        mfxU32 nDataLength = pBS->DataLength;
+        memcpy(pBS->Data + pBS->DataOffset + pBS->DataLength, packet.Data, packet.Header.Size);
+        pBS->DataLength += packet.Header.Size;
+
+        if (MFX_ERR_ABORTED == ReleasePacket())
+        {
+            // overwritten while it was copied, drop it
+            pBS->DataLength = nDataLength;
+            continue;
+        }
+
+        pBS->TimeStamp = packet.Header.TimeStamp;
+        pBS->DecodeTimeStamp = packet.Header.DecodeTimeStamp;
+        pBS->FrameType = packet.Header.FrameType;
+        pBS->PicStruct = packet.Header.PicStruct;
+        return m_bOverrun ? MFX_WRN_OUT_OF_RANGE : sts;
+    }
+}
+
+bool CShmBitstreamRing::IsEndOfStream() const
+{
+    return m_pHeader && m_pHeader->Closed.load(std::memory_order_acquire) &&
+        m_pHeader->WritePos.load(std::memory_order_acquire) == m_nReadPos;
+}
+
+CShmBitstreamWriter::CShmBitstreamWriter(mfxU32 nCapacity)
+    : m_nCapacity(nCapacity)
+{
+}
+
+CShmBitstreamWriter::~CShmBitstreamWriter()
+{
+    Close();
+}
+
+mfxStatus CShmBitstreamWriter::Init(const msdk_char *strRingName)
+{
+    MSDK_CHECK_POINTER(strRingName, MFX_ERR_NULL_PTR);
+    if (!msdk_strlen(strRingName))
+        return MFX_ERR_NONE;
+
+    Close();
+
+    mfxStatus sts = m_Ring.Create(strRingName, m_nCapacity);
+    MSDK_CHECK_STATUS(sts, "m_Ring.Create failed");
+
+    m_sFile = msdk_string(strRingName);
+    m_bInited = true;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmBitstreamWriter::Reset()
+{
+    // the reader keeps following the same ring
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmBitstreamWriter::WriteNextFrame(mfxBitstream *pMfxBitstream, bool isPrint)
+{
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_POINTER(pMfxBitstream, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = m_Ring.WritePacket(pMfxBitstream);
+    MSDK_CHECK_STATUS(sts, "m_Ring.WritePacket failed");
+
+    pMfxBitstream->DataLength = 0;
+    m_nProcessedFramesNum++;
+
+    if (isPrint && (1 == m_nProcessedFramesNum || (m_nProcessedFramesNum % 100) == 0))
+    {
+        msdk_printf(MSDK_STRING("Frame number: %u\r"), m_nProcessedFramesNum);
+    }
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmBitstreamWriter::SndBitstream(mfxBitstream *pMfxBitstream)
+{
+    return WriteNextFrame(pMfxBitstream, false);
+}
+
+void CShmBitstreamWriter::Close()
+{
+    if (m_bInited)
+        m_Ring.SetEndOfStream();
+    m_Ring.Close();
+
+    m_bInited = false;
+    m_nProcessedFramesNum = 0;
+}
@@ -0,0 +1,235 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include "shm_frame_ring.h"
+
+#define MSDK_SHM_ALIGN(value, alignment) (((value) + (alignment) - 1) & ~((alignment) - 1))
+
+CShmFrameRing::CShmFrameRing()
+    : m_pHeader(NULL)
+    , m_pSlots(NULL)
+    , m_pData(NULL)
+    , m_nReadCursor(0)
+{
+}
+
+CShmFrameRing::~CShmFrameRing()
+{
+    Close();
+}
+
+mfxStatus CShmFrameRing::Create(const msdk_char *strName, mfxU32 nFourCC, mfxU16 nWidth, mfxU16 nHeight, mfxU32 nSlots)
+{
+    MSDK_CHECK_POINTER(strName, MFX_ERR_NULL_PTR);
+    if (MFX_FOURCC_NV12 != nFourCC && MFX_FOURCC_I420 != nFourCC)
+        return MFX_ERR_UNSUPPORTED;
+    if (!nWidth || !nHeight || !nSlots)
+        return MFX_ERR_INVALID_VIDEO_PARAM;
+
+    Close();
+
+    // pitch and height aligned like the surfaces of the encoder
+    mfxU32 nPitch = MSDK_SHM_ALIGN((mfxU32)nWidth, 64);
+    mfxU32 nAlignedHeight = MSDK_SHM_ALIGN((mfxU32)nHeight, 32);
+    mfxU32 nSlotSize = MSDK_SHM_ALIGN(nPitch * nAlignedHeight * 3 / 2, MSDK_SHM_RING_ALIGN);
+    mfxU32 nDataOffset = MSDK_SHM_ALIGN((mfxU32)(sizeof(msdkShmRingHeader) + nSlots * sizeof(msdkShmSlotHeader)), MSDK_SHM_RING_ALIGN);
+
+    mfxStatus sts = CreateMapping(strName, nDataOffset + nSlots * nSlotSize);
+    MSDK_CHECK_STATUS(sts, "CreateMapping failed");
+
+    m_pHeader = (msdkShmRingHeader*)m_pMapped;
+    m_pHeader->FourCC = nFourCC;
+    m_pHeader->Width = nWidth;
+    m_pHeader->Height = nHeight;
+    m_pHeader->Pitch = nPitch;
+    m_pHeader->AlignedHeight = nAlignedHeight;
+    m_pHeader->NumSlots = nSlots;
+    m_pHeader->SlotSize = nSlotSize;
+    m_pHeader->DataOffset = nDataOffset;
+    m_pHeader->WriteSeq.store(0);
+    m_pHeader->ReadSeq.store(0);
+    m_pHeader->Closed.store(0);
+
+    m_pSlots = (msdkShmSlotHeader*)(m_pHeader + 1);
+    m_pData = (mfxU8*)m_pHeader + nDataOffset;
+
+    Publish(MSDK_SHM_FRAME_RING_MAGIC, MSDK_SHM_FRAME_RING_VERSION);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmFrameRing::Open(const msdk_char *strName, mfxU32 nTimeoutMs)
+{
+    Close();
+
+    mfxStatus sts = OpenMapping(strName, MSDK_SHM_FRAME_RING_MAGIC, MSDK_SHM_FRAME_RING_VERSION, nTimeoutMs);
+    MSDK_CHECK_STATUS(sts, "OpenMapping failed");
+
+    m_pHeader = (msdkShmRingHeader*)m_pMapped;
+    m_pSlots = (msdkShmSlotHeader*)(m_pHeader + 1);
+    m_pData = m_pMapped + m_pHeader->DataOffset;
+
+    // the consumer starts with the oldest frame not released yet
+    m_nReadCursor = m_pHeader->ReadSeq.load(std::memory_order_acquire);
+    m_Released.assign(m_pHeader->NumSlots, false);
+
+    return MFX_ERR_NONE;
+}
+
+void CShmFrameRing::Close()
+{
+    m_pHeader = NULL;
+    m_pSlots = NULL;
+    m_pData = NULL;
+    m_Released.clear();
+
+    CShmRing::Close();
+}
+
+void CShmFrameRing::GetFrame(mfxU32 nSeq, msdkShmFrame *pFrame)
+{
+    mfxU32 nSlot = nSeq % m_pHeader->NumSlots;
+    mfxU8 *pSlot = m_pData + (size_t)nSlot * m_pHeader->SlotSize;
+    mfxU32 nLumaSize = m_pHeader->Pitch * m_pHeader->AlignedHeight;
+
+    pFrame->Seq = nSeq;
+    pFrame->TimeStamp = m_pSlots[nSlot].TimeStamp;
+    pFrame->Pitch = m_pHeader->Pitch;
+    pFrame->Y = pSlot;
+    pFrame->U = pSlot + nLumaSize;
+    if (MFX_FOURCC_NV12 == m_pHeader->FourCC)
+        pFrame->V = pFrame->U + 1;
+    else
+        pFrame->V = pFrame->U + nLumaSize / 4;
+}
+
+mfxStatus CShmFrameRing::AcquireWriteSlot(msdkShmFrame *pFrame, mfxU32 nTimeoutMs)
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_POINTER(pFrame, MFX_ERR_NULL_PTR);
+
+    mfxU32 nWrite = m_pHeader->WriteSeq.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        mfxU32 nRead = m_pHeader->ReadSeq.load(std::memory_order_acquire);
+        if (nWrite - nRead < m_pHeader->NumSlots)
+            break;
+        // all slots are held by the consumer
+        if (!Wait(m_pHeader->ReadSeq, nRead, nTimeoutMs, false))
+            return MFX_WRN_IN_EXECUTION;
+    }
+
+    GetFrame(nWrite, pFrame);
+    pFrame->TimeStamp = (mfxU64)MFX_TIMESTAMP_UNKNOWN;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmFrameRing::CommitWriteSlot(mfxU64 nTimeStamp)
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+
+    mfxU32 nWrite = m_pHeader->WriteSeq.load(std::memory_order_relaxed);
+    msdkShmSlotHeader &slot = m_pSlots[nWrite % m_pHeader->NumSlots];
+    slot.Seq = nWrite;
+    slot.TimeStamp = nTimeStamp;
+
+    // pixels and slot header become visible together with the new sequence number
+    m_pHeader->WriteSeq.store(nWrite + 1, std::memory_order_release);
+    Wake(m_pHeader->WriteSeq, true);
+
+    return MFX_ERR_NONE;
+}
+
+void CShmFrameRing::SetEndOfStream()
+{
+    if (!m_pHeader)
+        return;
+
+    m_pHeader->Closed.store(1, std::memory_order_release);
+    // a consumer waits on WriteSeq, wake it to see the flag
+    Wake(m_pHeader->WriteSeq, true);
+}
+
+mfxStatus CShmFrameRing::AcquireReadSlot(msdkShmFrame *pFrame, mfxU32 nTimeoutMs)
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+    MSDK_CHECK_POINTER(pFrame, MFX_ERR_NULL_PTR);
+
+    for (;;)
+    {
+        mfxU32 nWrite = m_pHeader->WriteSeq.load(std::memory_order_acquire);
+        if (nWrite != m_nReadCursor)
+            break;
+        if (m_pHeader->Closed.load(std::memory_order_acquire))
+        {
+            // frames committed right before closing are still read
+            if (m_pHeader->WriteSeq.load(std::memory_order_acquire) != m_nReadCursor)
+                continue;
+            return MFX_ERR_MORE_DATA;
+        }
+        if (!Wait(m_pHeader->WriteSeq, nWrite, nTimeoutMs, true))
+            return MFX_ERR_MORE_DATA;
+    }
+
+    GetFrame(m_nReadCursor, pFrame);
+    if (m_pSlots[m_nReadCursor % m_pHeader->NumSlots].Seq != m_nReadCursor)
+    {
+        msdk_printf(MSDK_STRING("error: shared memory ring slot %u has sequence %u\n"),
+            m_nReadCursor, m_pSlots[m_nReadCursor % m_pHeader->NumSlots].Seq);
+        return MFX_ERR_ABORTED;
+    }
+
+    m_nReadCursor++;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CShmFrameRing::ReleaseReadSlot(mfxU32 nSeq)
+{
+    MSDK_CHECK_POINTER(m_pHeader, MFX_ERR_NOT_INITIALIZED);
+
+    mfxU32 nRead = m_pHeader->ReadSeq.load(std::memory_order_relaxed);
+    if (nSeq - nRead >= m_nReadCursor - nRead || m_Released[nSeq % m_pHeader->NumSlots])
+        return MFX_ERR_UNDEFINED_BEHAVIOR; // not acquired or already released
+
+    m_Released[nSeq % m_pHeader->NumSlots] = true;
+
+    // ReadSeq moves over the frames released in a row, the producer only reuses those
+    mfxU32 nNewRead = nRead;
+    while (nNewRead != m_nReadCursor && m_Released[nNewRead % m_pHeader->NumSlots])
+    {
+        m_Released[nNewRead % m_pHeader->NumSlots] = false;
+        nNewRead++;
+    }
+
+    if (nNewRead != nRead)
+    {
+        m_pHeader->ReadSeq.store(nNewRead, std::memory_order_release);
+        Wake(m_pHeader->ReadSeq, false);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+bool CShmFrameRing::IsEndOfStream() const
+{
+    return m_pHeader && m_pHeader->Closed.load(std::memory_order_acquire) &&
+        m_pHeader->WriteSeq.load(std::memory_order_acquire) == m_nReadCursor;
+}
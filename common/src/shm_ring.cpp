@@ -0,0 +1,261 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include "shm_ring.h"
+#include "vm/time_defs.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#endif
+
+CShmRing::CShmRing()
+    : m_pMapped(NULL)
+    , m_nMappedSize(0)
+    , m_bCreator(false)
+#if defined(_WIN32) || defined(_WIN64)
+    , m_hMapping(NULL)
+    , m_hFilled(NULL)
+    , m_hFreed(NULL)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+CShmRing::~CShmRing()
+{
+    CShmRing::Close();
+}
+
+mfxStatus CShmRing::CreateMapping(const msdk_char *strName, mfxU32 nSize)
+{
+    MSDK_CHECK_POINTER(strName, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = Map(strName, nSize, true);
+    MSDK_CHECK_STATUS(sts, "Map failed");
+
+    m_bCreator = true;
+    ((msdkShmRingPrefix*)m_pMapped)->Size = nSize;
+    return MFX_ERR_NONE;
+}
+
+void CShmRing::Publish(mfxU32 nMagic, mfxU32 nVersion)
+{
+    msdkShmRingPrefix *pPrefix = (msdkShmRingPrefix*)m_pMapped;
+    pPrefix->Version = nVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    pPrefix->Magic = nMagic;
+}
+
+mfxStatus CShmRing::OpenMapping(const msdk_char *strName, mfxU32 nMagic, mfxU32 nVersion, mfxU32 nTimeoutMs)
+{
+    MSDK_CHECK_POINTER(strName, MFX_ERR_NULL_PTR);
+
+    msdk_tick start = msdk_time_get_tick();
+    msdk_tick frequency = msdk_time_get_frequency();
+    for (;;)
+    {
+        // the prefix first, the full size is known from it
+        mfxStatus sts = Map(strName, sizeof(msdkShmRingPrefix), false);
+        if (MFX_ERR_NONE == sts && nMagic == ((msdkShmRingPrefix*)m_pMapped)->Magic)
+            break;
+
+        CShmRing::Close();
+        if (MSDK_GET_TIME(msdk_time_get_tick(), start, frequency) * 1000 >= nTimeoutMs)
+        {
+            msdk_printf(MSDK_STRING("error: shared memory ring %s not found\n"), strName);
+            return MFX_ERR_NOT_FOUND;
+        }
+        MSDK_SLEEP(10);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    msdkShmRingPrefix prefix = *(msdkShmRingPrefix*)m_pMapped;
+    CShmRing::Close();
+    if (nVersion != prefix.Version)
+        return MFX_ERR_UNSUPPORTED;
+
+    mfxStatus sts = Map(strName, prefix.Size, false);
+    MSDK_CHECK_STATUS(sts, "Map failed");
+
+    m_bCreator = false;
+    return MFX_ERR_NONE;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+mfxStatus CShmRing::Map(const msdk_char *strName, mfxU32 nSize, bool bCreate)
+{
+    msdk_string sFilled = msdk_string(strName) + MSDK_STRING("_filled");
+    msdk_string sFreed = msdk_string(strName) + MSDK_STRING("_freed");
+
+    if (bCreate)
+    {
+        m_hMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, nSize, strName);
+        if (m_hMapping && ERROR_ALREADY_EXISTS == GetLastError())
+        {
+            CShmRing::Close();
+            return MFX_ERR_UNSUPPORTED;
+        }
+        m_hFilled = CreateEvent(NULL, FALSE, FALSE, sFilled.c_str());
+        m_hFreed = CreateEvent(NULL, FALSE, FALSE, sFreed.c_str());
+    }
+    else
+    {
+        m_hMapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, strName);
+        m_hFilled = OpenEvent(EVENT_ALL_ACCESS, FALSE, sFilled.c_str());
+        m_hFreed = OpenEvent(EVENT_ALL_ACCESS, FALSE, sFreed.c_str());
+    }
+
+    if (!m_hMapping || !m_hFilled || !m_hFreed)
+    {
+        CShmRing::Close();
+        return MFX_ERR_NOT_FOUND;
+    }
+
+    m_pMapped = (mfxU8*)MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, nSize);
+    if (!m_pMapped)
+    {
+        CShmRing::Close();
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+    m_nMappedSize = nSize;
+
+    return MFX_ERR_NONE;
+}
+
+void CShmRing::Close()
+{
+    if (m_pMapped)
+        UnmapViewOfFile(m_pMapped);
+    if (m_hMapping)
+        CloseHandle(m_hMapping);
+    if (m_hFilled)
+        CloseHandle(m_hFilled);
+    if (m_hFreed)
+        CloseHandle(m_hFreed);
+
+    m_hMapping = m_hFilled = m_hFreed = NULL;
+    m_pMapped = NULL;
+    m_nMappedSize = 0;
+    m_bCreator = false;
+}
+
+bool CShmRing::Wait(std::atomic<mfxU32> &word, mfxU32 nValue, mfxU32 nTimeoutMs, bool bFilled)
+{
+    // auto reset events, a signal between the check of the caller and this wait isn't lost
+    if (word.load(std::memory_order_acquire) != nValue)
+        return true;
+    return WAIT_OBJECT_0 == WaitForSingleObject(bFilled ? m_hFilled : m_hFreed, nTimeoutMs);
+}
+
+void CShmRing::Wake(std::atomic<mfxU32> &word, bool bFilled)
+{
+    (void)word;
+    SetEvent(bFilled ? m_hFilled : m_hFreed);
+}
+
+#else // #if defined(_WIN32) || defined(_WIN64)
+
+mfxStatus CShmRing::Map(const msdk_char *strName, mfxU32 nSize, bool bCreate)
+{
+    // shm_open wants a single leading slash
+    m_sName = (strName[0] == '/') ? msdk_string(strName) : msdk_string("/") + strName;
+
+    m_fd = shm_open(m_sName.c_str(), bCreate ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+    if (m_fd < 0)
+        return bCreate ? MFX_ERR_UNSUPPORTED : MFX_ERR_NOT_FOUND;
+    // the name is removed again by Close of the creator
+    m_bCreator = bCreate;
+
+    if (bCreate && ftruncate(m_fd, nSize))
+    {
+        CShmRing::Close();
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) || (mfxU64)st.st_size < nSize)
+    {
+        // the creator didn't size it yet
+        CShmRing::Close();
+        return MFX_ERR_NOT_FOUND;
+    }
+
+    void *p = mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == p)
+    {
+        CShmRing::Close();
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+    m_pMapped = (mfxU8*)p;
+    m_nMappedSize = nSize;
+
+    return MFX_ERR_NONE;
+}
+
+void CShmRing::Close()
+{
+    if (m_pMapped)
+        munmap(m_pMapped, m_nMappedSize);
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        // the name goes away with the creator, mappings stay valid until unmapped
+        if (m_bCreator)
+            shm_unlink(m_sName.c_str());
+    }
+
+    m_fd = -1;
+    m_pMapped = NULL;
+    m_nMappedSize = 0;
+    m_bCreator = false;
+}
+
+bool CShmRing::Wait(std::atomic<mfxU32> &word, mfxU32 nValue, mfxU32 nTimeoutMs, bool bFilled)
+{
+    (void)bFilled;
+    struct timespec timeout;
+    timeout.tv_sec = nTimeoutMs / 1000;
+    timeout.tv_nsec = (nTimeoutMs % 1000) * 1000000;
+
+    // shared futex, the word lives in memory mapped by both processes
+    long res = syscall(SYS_futex, (mfxU32*)&word, FUTEX_WAIT, nValue, &timeout, NULL, 0);
+    if (res && ETIMEDOUT == errno)
+        return word.load(std::memory_order_acquire) != nValue;
+    return true;
+}
+
+void CShmRing::Wake(std::atomic<mfxU32> &word, bool bFilled)
+{
+    (void)bFilled;
+    syscall(SYS_futex, (mfxU32*)&word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
@@ -0,0 +1,583 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <algorithm>
+
+#include "sample_defs.h"
+#include "stream_index.h"
+#include "emulation_prevention.h"
+
+#define MSDK_INDEX_CHUNK_SIZE (1024 * 1024)
+// bytes looked at from a start code on: enough for an H.264 SPS up to frame_mbs_only_flag
+#define MSDK_INDEX_NAL_PEEK 1024
+// H.264 slice header bytes read up to bottom_field_flag, emulation prevention included
+#define MSDK_INDEX_SLICE_HEADER_SIZE 32
+// H.264 parameter set ids
+#define MSDK_INDEX_MAX_SPS 32
+#define MSDK_INDEX_MAX_PPS 256
+
+static const char  g_IndexMagic[8] = { 'M', 'S', 'D', 'K', 'I', 'D', 'X', '1' };
+
+enum
+{
+    PARAM_SET_VPS = 0x1,
+    PARAM_SET_SPS = 0x2,
+    PARAM_SET_PPS = 0x4,
+};
+
+// picture structure of an H.264 picture
+enum
+{
+    AVC_PIC_FRAME,
+    AVC_PIC_TOP_FIELD,
+    AVC_PIC_BOTTOM_FIELD,
+};
+
+// what's needed from an H.264 SPS to find field_pic_flag in a slice header
+struct sAvcSpsInfo
+{
+    bool   bValid;
+    bool   bSeparateColourPlane;
+    bool   bFrameMbsOnly;
+    mfxU32 nLog2MaxFrameNum;
+};
+
+static mfxU32 GetParamSetBit(bool bHEVC, mfxU8 type)
+{
+    if (bHEVC)
+        return (HEVC_NAL_VPS == type) ? PARAM_SET_VPS : (HEVC_NAL_SPS == type) ? PARAM_SET_SPS : (HEVC_NAL_PPS == type) ? PARAM_SET_PPS : 0;
+    return (ProtectedLibrary::NAL_UT_SPS == type) ? PARAM_SET_SPS : (ProtectedLibrary::NAL_UT_PPS == type) ? PARAM_SET_PPS : 0;
+}
+
+// reads the start of an RBSP MSB first, reading past its end gives zeros and sets the error flag
+class CRbspReader
+{
+public:
+    CRbspReader(const mfxU8 *pPayload, mfxU32 nSize)
+        : m_nSize(RemoveEmulationPrevention(m_rbsp, pPayload, (std::min)(nSize, (mfxU32)sizeof(m_rbsp))))
+        , m_nPos(0)
+        , m_bError(false)
+    {
+    }
+
+    mfxU32 GetBits(mfxU32 n)
+    {
+        mfxU32 value = 0;
+        for (; n; n--, m_nPos++)
+        {
+            if (m_nPos >= m_nSize * 8)
+            {
+                m_bError = true;
+                return 0;
+            }
+            value = (value << 1) | ((m_rbsp[m_nPos >> 3] >> (7 - (m_nPos & 7))) & 1);
+        }
+        return value;
+    }
+
+    mfxU32 GetUE()
+    {
+        mfxU32 nZeros = 0;
+        while (!GetBits(1) && !m_bError)
+        {
+            if (++nZeros > 31)
+            {
+                m_bError = true;
+                return 0;
+            }
+        }
+        return ((1u << nZeros) - 1) + GetBits(nZeros);
+    }
+
+    mfxI32 GetSE()
+    {
+        mfxU32 code = GetUE();
+        return (code & 1) ? (mfxI32)((code + 1) >> 1) : -(mfxI32)(code >> 1);
+    }
+
+    bool IsError() const { return m_bError; }
+
+private:
+    mfxU8  m_rbsp[MSDK_INDEX_NAL_PEEK];
+    mfxU32 m_nSize;
+    mfxU32 m_nPos;
+    bool   m_bError;
+};
+
+static void ParseAvcSps(const mfxU8 *nal, mfxU32 size, std::vector<sAvcSpsInfo> &sps)
+{
+    CRbspReader bs(nal + 1, size - 1);
+
+    mfxU32 profile = bs.GetBits(8);
+    bs.GetBits(16); // constraint flags, level_idc
+    mfxU32 id = bs.GetUE();
+
+    sAvcSpsInfo info;
+    MSDK_ZERO_MEMORY(info);
+
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244 || profile == 44 ||
+        profile == 83 || profile == 86 || profile == 118 || profile == 128 || profile == 138 ||
+        profile == 139 || profile == 134 || profile == 135)
+    {
+        mfxU32 chroma_format_idc = bs.GetUE();
+        if (3 == chroma_format_idc)
+            info.bSeparateColourPlane = (0 != bs.GetBits(1));
+        bs.GetUE(); // bit_depth_luma_minus8
+        bs.GetUE(); // bit_depth_chroma_minus8
+        bs.GetBits(1); // qpprime_y_zero_transform_bypass_flag
+        if (bs.GetBits(1)) // seq_scaling_matrix_present_flag
+        {
+            for (mfxU32 i = 0; i < ((3 != chroma_format_idc) ? 8u : 12u) && !bs.IsError(); i++)
+            {
+                if (!bs.GetBits(1))
+                    continue;
+                // a zero next scale ends the list
+                mfxI32 lastScale = 8, nextScale = 8;
+                for (mfxU32 j = 0; j < ((i < 6) ? 16u : 64u) && nextScale && !bs.IsError(); j++)
+                {
+                    nextScale = (lastScale + bs.GetSE() + 256) % 256;
+                    lastScale = nextScale ? nextScale : lastScale;
+                }
+            }
+        }
+    }
+
+    info.nLog2MaxFrameNum = bs.GetUE() + 4;
+    mfxU32 pic_order_cnt_type = bs.GetUE();
+    if (0 == pic_order_cnt_type)
+    {
+        bs.GetUE(); // log2_max_pic_order_cnt_lsb_minus4
+    }
+    else if (1 == pic_order_cnt_type)
+    {
+        bs.GetBits(1); // delta_pic_order_always_zero_flag
+        bs.GetSE(); // offset_for_non_ref_pic
+        bs.GetSE(); // offset_for_top_to_bottom_field
+        mfxU32 nCycle = bs.GetUE();
+        for (mfxU32 i = 0; i < nCycle && !bs.IsError(); i++)
+            bs.GetSE();
+    }
+    bs.GetUE(); // max_num_ref_frames
+    bs.GetBits(1); // gaps_in_frame_num_value_allowed_flag
+    bs.GetUE(); // pic_width_in_mbs_minus1
+    bs.GetUE(); // pic_height_in_map_units_minus1
+    info.bFrameMbsOnly = (0 != bs.GetBits(1));
+
+    if (bs.IsError() || id >= MSDK_INDEX_MAX_SPS)
+        return;
+    info.bValid = (info.nLog2MaxFrameNum <= 16);
+    sps[id] = info;
+}
+
+static void ParseAvcPps(const mfxU8 *nal, mfxU32 size, std::vector<mfxU8> &ppsToSps)
+{
+    CRbspReader bs(nal + 1, size - 1);
+
+    mfxU32 id = bs.GetUE();
+    mfxU32 spsId = bs.GetUE();
+    if (!bs.IsError() && id < MSDK_INDEX_MAX_PPS && spsId < MSDK_INDEX_MAX_SPS)
+        ppsToSps[id] = (mfxU8)spsId;
+}
+
+// AVC_PIC_* of a slice, a frame if its parameter sets weren't seen
+static mfxU32 ParseAvcPicStruct(const mfxU8 *nal, mfxU32 size, const std::vector<sAvcSpsInfo> &sps, const std::vector<mfxU8> &ppsToSps)
+{
+    CRbspReader bs(nal + 1, (std::min)(size - 1, (mfxU32)MSDK_INDEX_SLICE_HEADER_SIZE));
+
+    bs.GetUE(); // first_mb_in_slice
+    bs.GetUE(); // slice_type
+    mfxU32 ppsId = bs.GetUE();
+    if (bs.IsError() || ppsId >= MSDK_INDEX_MAX_PPS || ppsToSps[ppsId] >= MSDK_INDEX_MAX_SPS)
+        return AVC_PIC_FRAME;
+
+    const sAvcSpsInfo &info = sps[ppsToSps[ppsId]];
+    if (!info.bValid || info.bFrameMbsOnly)
+        return AVC_PIC_FRAME;
+
+    if (info.bSeparateColourPlane)
+        bs.GetBits(2); // colour_plane_id
+    bs.GetBits(info.nLog2MaxFrameNum); // frame_num
+    if (!bs.GetBits(1)) // field_pic_flag
+        return AVC_PIC_FRAME;
+    mfxU32 bottom_field_flag = bs.GetBits(1);
+
+    return bs.IsError() ? AVC_PIC_FRAME : (bottom_field_flag ? AVC_PIC_BOTTOM_FIELD : AVC_PIC_TOP_FIELD);
+}
+
+// VP9 uncompressed header: frame_marker(2), profile(2), [reserved_zero(1)], show_existing_frame(1), frame_type(1)
+static bool IsVP9KeyFrame(const mfxU8 *data, mfxU32 size)
+{
+    if (!size)
+        return false;
+
+    mfxU32 bits = (data[0] << 8) | (size > 1 ? data[1] : 0);
+    mfxU32 pos = 2;
+    mfxU32 profile = ((bits >> (15 - pos)) & 1) | (((bits >> (14 - pos)) & 1) << 1);
+    pos += 2;
+    if (profile == 3)
+        pos++;
+    if ((bits >> (15 - pos)) & 1)
+        return false; // show_existing_frame
+    pos++;
+    return 0 == ((bits >> (15 - pos)) & 1); // KEY_FRAME is 0
+}
+
+CStreamIndex::CStreamIndex()
+    : m_nCodecId(0)
+    , m_nStreamSize(0)
+    , m_nFrames(0)
+{
+}
+
+CStreamIndex::~CStreamIndex()
+{
+}
+
+void CStreamIndex::Clear()
+{
+    m_nCodecId = 0;
+    m_nStreamSize = 0;
+    m_nFrames = 0;
+    m_Entries.clear();
+}
+
+mfxStatus CStreamIndex::LoadOrBuild(const msdk_char *strFileName, mfxU32 nCodecId)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strFileName, MSDK_STRING("rb"));
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+    MSDK_FSEEK64(pFile, 0, SEEK_END);
+    mfxU64 nStreamSize = (mfxU64)MSDK_FTELL64(pFile);
+    fclose(pFile);
+
+    msdk_tstring strIndexName = msdk_tstring(strFileName) + MSDK_STRING(".idx");
+    if (MFX_ERR_NONE == Load(strIndexName.c_str(), nCodecId, nStreamSize))
+        return MFX_ERR_NONE;
+
+    mfxStatus sts = Build(strFileName, nCodecId);
+    MSDK_CHECK_STATUS(sts, "Build failed");
+
+    // index still works for this run if the sidecar can't be written
+    if (MFX_ERR_NONE != Save(strIndexName.c_str()))
+        msdk_printf(MSDK_STRING("WARNING: failed to write stream index %s\n"), strIndexName.c_str());
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CStreamIndex::Build(const msdk_char *strFileName, mfxU32 nCodecId)
+{
+    MSDK_CHECK_POINTER(strFileName, MFX_ERR_NULL_PTR);
+
+    Clear();
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strFileName, MSDK_STRING("rb"));
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+
+    mfxStatus sts = MFX_ERR_NONE;
+    switch (nCodecId)
+    {
+    case MFX_CODEC_AVC:
+        sts = ScanNalStream(pFile, false);
+        break;
+    case MFX_CODEC_HEVC:
+        sts = ScanNalStream(pFile, true);
+        break;
+    case MFX_CODEC_VP8:
+    case MFX_CODEC_VP9:
+        sts = ScanIVF(pFile);
+        break;
+    case MFX_CODEC_JPEG:
+        sts = ScanMJPEG(pFile);
+        break;
+    default:
+        sts = MFX_ERR_UNSUPPORTED;
+        break;
+    }
+
+    MSDK_FSEEK64(pFile, 0, SEEK_END);
+    m_nStreamSize = (mfxU64)MSDK_FTELL64(pFile);
+    m_nCodecId = nCodecId;
+    fclose(pFile);
+
+    if (MFX_ERR_NONE != sts)
+        Clear();
+
+    return sts;
+}
+
+mfxStatus CStreamIndex::ScanNalStream(FILE *pFile, bool bHEVC)
+{
+    const mfxU32 nRequired = bHEVC ? (PARAM_SET_VPS | PARAM_SET_SPS | PARAM_SET_PPS) : (PARAM_SET_SPS | PARAM_SET_PPS);
+
+    // H.264 parameter sets are followed to tell the two fields of a frame apart from two frames
+    std::vector<sAvcSpsInfo> sps(MSDK_INDEX_MAX_SPS);
+    std::vector<mfxU8> ppsToSps(MSDK_INDEX_MAX_PPS, MSDK_INDEX_MAX_SPS);
+    // first field still waiting for its second one, AVC_PIC_FRAME if none
+    mfxU32 nOpenField = AVC_PIC_FRAME;
+    bool   bOpenFieldRef = false;
+
+    std::vector<mfxU8> buf(MSDK_INDEX_CHUNK_SIZE);
+    mfxU64 base = 0; // file offset of buf[0]
+    mfxU32 len = 0;
+    mfxU32 start = 0; // buf[0] was examined before when it is kept from the previous read
+    bool   bEof = false;
+
+    // non-VCL units after the last slice belong to the next access unit
+    bool   bPrefix = false;
+    mfxU64 nPrefixOffset = 0;
+    mfxU32 nParamSets = 0;
+
+    while (!bEof)
+    {
+        len += (mfxU32)fread(&buf[len], 1, buf.size() - len, pFile);
+        bEof = (len < buf.size());
+
+        // start codes too close to the end are examined after the next read
+        mfxU32 limit = bEof ? len : len - MSDK_INDEX_NAL_PEEK + 1;
+
+        for (mfxU32 pos = FindAnnexBStartCode(&buf[0], len, start); pos < limit; pos = FindAnnexBStartCode(&buf[0], len, pos + 3))
+        {
+            const mfxU8 *nal = &buf[pos + 3];
+            mfxU32 size = (std::min)(len - pos - 3, (mfxU32)MSDK_INDEX_NAL_PEEK - 3);
+
+            sNalUnitInfo info;
+            ClassifyNalUnit(bHEVC, nal, size, &info);
+
+            // zero_byte of a four byte start code belongs to the unit
+            mfxU64 nOffset = base + pos - ((pos && !buf[pos - 1]) ? 1 : 0);
+
+            if (info.bSlice)
+            {
+                if (info.bFirstSlice)
+                {
+                    // both fields of a frame start with slices of first_mb_in_slice 0,
+                    // the second one continues the frame of the first as in AVC_Spl
+                    mfxU32 nPicStruct = bHEVC ? (mfxU32)AVC_PIC_FRAME : ParseAvcPicStruct(nal, size, sps, ppsToSps);
+                    bool bRef = (0 != (nal[0] & ProtectedLibrary::NAL_STORAGE_IDC_BITS));
+                    bool bSecondField = AVC_PIC_FRAME != nPicStruct && AVC_PIC_FRAME != nOpenField &&
+                        nPicStruct != nOpenField && bRef == bOpenFieldRef;
+                    nOpenField = bSecondField ? (mfxU32)AVC_PIC_FRAME : nPicStruct;
+                    bOpenFieldRef = bRef;
+
+                    if (!bSecondField)
+                    {
+                        if (info.bRandomAccess && (nParamSets & nRequired) == nRequired)
+                        {
+                            sEntry entry = { bPrefix ? nPrefixOffset : nOffset, m_nFrames };
+                            m_Entries.push_back(entry);
+                        }
+                        m_nFrames++;
+                    }
+                }
+                bPrefix = false;
+                nParamSets = 0;
+            }
+            else if (info.bPrefix)
+            {
+                if (!bPrefix)
+                {
+                    bPrefix = true;
+                    nPrefixOffset = nOffset;
+                }
+                nParamSets |= GetParamSetBit(bHEVC, info.nType);
+
+                if (!bHEVC && ProtectedLibrary::NAL_UT_SPS == info.nType)
+                    ParseAvcSps(nal, size, sps);
+                else if (!bHEVC && ProtectedLibrary::NAL_UT_PPS == info.nType)
+                    ParseAvcPps(nal, size, ppsToSps);
+            }
+        }
+
+        if (!bEof)
+        {
+            // one byte more is kept for the zero_byte check
+            memmove(&buf[0], &buf[limit - 1], len - limit + 1);
+            base += limit - 1;
+            len -= limit - 1;
+            start = 1;
+        }
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CStreamIndex::ScanIVF(FILE *pFile)
+{
+    /* 32 bytes file header: 'DKIF', version, header length, FourCC, ...
+       then per frame: frame size (4 bytes), time stamp (8 bytes), frame data */
+    mfxU8 hdr[32];
+    if (fread(hdr, 1, sizeof(hdr), pFile) != sizeof(hdr))
+        return MFX_ERR_UNSUPPORTED;
+    MSDK_CHECK_NOT_EQUAL(memcmp(hdr, "DKIF", 4), 0, MFX_ERR_UNSUPPORTED);
+
+    mfxU32 nHeaderLength = hdr[6] | (hdr[7] << 8);
+    bool bVP9 = (0 == memcmp(hdr + 8, "VP90", 4));
+    MSDK_CHECK_NOT_EQUAL(MSDK_FSEEK64(pFile, nHeaderLength, SEEK_SET), 0, MFX_ERR_UNSUPPORTED);
+
+    for (;;)
+    {
+        mfxU64 nOffset = (mfxU64)MSDK_FTELL64(pFile);
+
+        mfxU8 frameHdr[12];
+        if (fread(frameHdr, 1, sizeof(frameHdr), pFile) != sizeof(frameHdr))
+            break;
+        mfxU32 nFrameSize = frameHdr[0] | (frameHdr[1] << 8) | (frameHdr[2] << 16) | ((mfxU32)frameHdr[3] << 24);
+
+        mfxU8 data[2] = { 0 };
+        mfxU32 nRead = (mfxU32)fread(data, 1, (std::min)(nFrameSize, (mfxU32)sizeof(data)), pFile);
+
+        // VP8 frame tag starts with the inverted key frame flag
+        bool bKey = bVP9 ? IsVP9KeyFrame(data, nRead) : (nRead && !(data[0] & 1));
+        if (bKey)
+        {
+            sEntry entry = { nOffset, m_nFrames };
+            m_Entries.push_back(entry);
+        }
+        m_nFrames++;
+
+        if (nRead < (std::min)(nFrameSize, (mfxU32)sizeof(data)) || MSDK_FSEEK64(pFile, nFrameSize - nRead, SEEK_CUR))
+            break;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CStreamIndex::ScanMJPEG(FILE *pFile)
+{
+    std::vector<mfxU8> buf(MSDK_INDEX_CHUNK_SIZE);
+    mfxU64 base = 0;
+    mfxU8  prev = 0;
+    bool   bInFrame = false; // SOI of an embedded thumbnail is not a frame start
+
+    for (;;)
+    {
+        mfxU32 len = (mfxU32)fread(&buf[0], 1, buf.size(), pFile);
+        if (!len)
+            break;
+
+        for (mfxU32 i = 0; i < len; i++)
+        {
+            if (prev == 0xFF)
+            {
+                if (buf[i] == 0xD8 && !bInFrame)
+                {
+                    sEntry entry = { base + i - 1, m_nFrames++ };
+                    m_Entries.push_back(entry);
+                    bInFrame = true;
+                }
+                else if (buf[i] == 0xD9)
+                {
+                    bInFrame = false;
+                }
+            }
+            prev = buf[i];
+        }
+        base += len;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CStreamIndex::Save(const msdk_char *strIndexName)
+{
+    MSDK_CHECK_POINTER(strIndexName, MFX_ERR_NULL_PTR);
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strIndexName, MSDK_STRING("wb"));
+    MSDK_CHECK_POINTER(pFile, MFX_ERR_NULL_PTR);
+
+    mfxU32 nEntries = (mfxU32)m_Entries.size();
+    bool bOk = fwrite(g_IndexMagic, sizeof(g_IndexMagic), 1, pFile) == 1 &&
+        fwrite(&m_nCodecId, sizeof(m_nCodecId), 1, pFile) == 1 &&
+        fwrite(&m_nStreamSize, sizeof(m_nStreamSize), 1, pFile) == 1 &&
+        fwrite(&m_nFrames, sizeof(m_nFrames), 1, pFile) == 1 &&
+        fwrite(&nEntries, sizeof(nEntries), 1, pFile) == 1;
+
+    for (mfxU32 i = 0; i < nEntries && bOk; i++)
+    {
+        bOk = fwrite(&m_Entries[i].nOffset, sizeof(m_Entries[i].nOffset), 1, pFile) == 1 &&
+            fwrite(&m_Entries[i].nFrame, sizeof(m_Entries[i].nFrame), 1, pFile) == 1;
+    }
+
+    fclose(pFile);
+    return bOk ? MFX_ERR_NONE : MFX_ERR_UNKNOWN;
+}
+
+mfxStatus CStreamIndex::Load(const msdk_char *strIndexName, mfxU32 nCodecId, mfxU64 nStreamSize)
+{
+    MSDK_CHECK_POINTER(strIndexName, MFX_ERR_NULL_PTR);
+
+    Clear();
+
+    FILE *pFile = NULL;
+    MSDK_FOPEN(pFile, strIndexName, MSDK_STRING("rb"));
+    if (!pFile)
+        return MFX_ERR_NOT_FOUND;
+
+    char magic[sizeof(g_IndexMagic)];
+    mfxU32 nEntries = 0;
+    bool bOk = fread(magic, sizeof(magic), 1, pFile) == 1 && 0 == memcmp(magic, g_IndexMagic, sizeof(magic)) &&
+        fread(&m_nCodecId, sizeof(m_nCodecId), 1, pFile) == 1 &&
+        fread(&m_nStreamSize, sizeof(m_nStreamSize), 1, pFile) == 1 &&
+        fread(&m_nFrames, sizeof(m_nFrames), 1, pFile) == 1 &&
+        fread(&nEntries, sizeof(nEntries), 1, pFile) == 1;
+
+    // index of another stream or of an older version of this one is rebuilt
+    bOk = bOk && m_nCodecId == nCodecId && m_nStreamSize == nStreamSize && nEntries <= m_nFrames;
+
+    if (bOk)
+    {
+        m_Entries.resize(nEntries);
+        for (mfxU32 i = 0; i < nEntries && bOk; i++)
+        {
+            bOk = fread(&m_Entries[i].nOffset, sizeof(m_Entries[i].nOffset), 1, pFile) == 1 &&
+                fread(&m_Entries[i].nFrame, sizeof(m_Entries[i].nFrame), 1, pFile) == 1 &&
+                (!i || m_Entries[i].nFrame > m_Entries[i - 1].nFrame);
+        }
+    }
+
+    fclose(pFile);
+
+    if (!bOk)
+    {
+        Clear();
+        return MFX_ERR_NOT_FOUND;
+    }
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CStreamIndex::Find(mfxU32 nFrame, sEntry *pEntry) const
+{
+    MSDK_CHECK_POINTER(pEntry, MFX_ERR_NULL_PTR);
+
+    // first entry which starts after nFrame, the one before it is the answer
+    std::vector<sEntry>::const_iterator it = std::upper_bound(m_Entries.begin(), m_Entries.end(), nFrame,
+        [](mfxU32 frame, const sEntry &entry) { return frame < entry.nFrame; });
+
+    if (it == m_Entries.begin())
+        return MFX_ERR_NOT_FOUND;
+
+    *pEntry = *(it - 1);
+    return MFX_ERR_NONE;
+}
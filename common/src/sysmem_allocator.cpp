@@ -20,7 +20,18 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "sysmem_allocator.h"
 #include "sample_utils.h"
 
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #define MSDK_ALIGN32(X) (((mfxU32)((X)+31)) & (~ (mfxU32)31))
+#define MSDK_ALIGN64(X) (((mfxU32)((X)+63)) & (~ (mfxU32)63))
+#define MSDK_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+#define MSDK_PAGE_SIZE      4096
+// idle slabs kept for later pools besides the one a reservation picks
+#define MSDK_ARENA_MAX_IDLE_SLABS 2
 #define ID_BUFFER MFX_MAKEFOURCC('B','U','F','F')
 #define ID_FRAME  MFX_MAKEFOURCC('F','R','M','E')
 
@@ -49,11 +60,12 @@ mfxStatus SysMemFrameAllocator::Init(mfxAllocatorParams *pParams)
         m_pBufferAllocator = pSysMemParams->pBufferAllocator;
         m_bOwnBufferAllocator = false;
     }
+    bool bUseArena = pSysMemParams && pSysMemParams->bUseArena;
 
     // if buffer allocator wasn't passed from application create own
     if (!m_pBufferAllocator)
     {
-        m_pBufferAllocator = new SysMemBufferAllocator;
+        m_pBufferAllocator = new SysMemBufferAllocator(bUseArena);
         if (!m_pBufferAllocator)
             return MFX_ERR_MEMORY_ALLOC;
 
@@ -101,7 +113,7 @@ mfxStatus SysMemFrameAllocator::LockFrame(mfxMemId mid, mfxFrameData *ptr)
 
     mfxU16 Width2 = (mfxU16)MSDK_ALIGN32(fs->info.Width);
     mfxU16 Height2 = (mfxU16)MSDK_ALIGN32(fs->info.Height);
-    ptr->B = ptr->Y = (mfxU8 *)fs + MSDK_ALIGN32(sizeof(sFrame));
+    ptr->B = ptr->Y = (mfxU8 *)fs + MSDK_ALIGN64(sizeof(sFrame));
 
     switch (fs->info.FourCC)
     {
@@ -331,11 +343,19 @@ mfxStatus SysMemFrameAllocator::AllocImpl(mfxFrameAllocRequest *request, mfxFram
 
     std::unique_ptr<mfxMemId[]> mids(new mfxMemId[request->NumFrameSuggested]);
 
+    // the whole pool in one slab if the buffer allocator is in arena mode
+    SysMemBufferAllocator *pSysMemBufferAllocator = dynamic_cast<SysMemBufferAllocator *>(m_pBufferAllocator);
+    if (pSysMemBufferAllocator)
+    {
+        mfxStatus sts = pSysMemBufferAllocator->ReserveArena(nbytes + MSDK_ALIGN64(sizeof(sFrame)), request->NumFrameSuggested);
+        MSDK_CHECK_STATUS(sts, "ReserveArena failed");
+    }
+
     // allocate frames
     for (numAllocated = 0; numAllocated < request->NumFrameSuggested; numAllocated ++)
     {
         mfxStatus sts = m_pBufferAllocator->Alloc(m_pBufferAllocator->pthis,
-            nbytes + MSDK_ALIGN32(sizeof(sFrame)), request->Type, &(mids[numAllocated]));
+            nbytes + MSDK_ALIGN64(sizeof(sFrame)), request->Type, &(mids[numAllocated]));
 
         if (MFX_ERR_NONE != sts)
             break;
@@ -395,14 +415,156 @@ mfxStatus SysMemFrameAllocator::ReleaseResponse(mfxFrameAllocResponse *response)
     return sts;
 }
 
-SysMemBufferAllocator::SysMemBufferAllocator()
+SysMemBufferAllocator::SysMemBufferAllocator(bool bUseArena)
+    : m_bUseArena(bUseArena)
+    , m_pActiveSlab(NULL)
 {
-
 }
 
 SysMemBufferAllocator::~SysMemBufferAllocator()
 {
+    // buffers still carved from a slab become invalid
+    for (size_t i = 0; i < m_Slabs.size(); i++)
+        DestroySlab(m_Slabs[i]);
+    m_Slabs.clear();
+}
+
+size_t SysMemBufferAllocator::BufferSize(mfxU32 nbytes)
+{
+    // header and data aligned to 64 bytes, see LockBuffer
+    return MSDK_ALIGN64(MSDK_ALIGN32(sizeof(sBuffer)) + nbytes + 64);
+}
+
+mfxStatus SysMemBufferAllocator::CreateSlab(size_t nSize, sArenaSlab **ppSlab)
+{
+    sArenaSlab *pSlab = new sArenaSlab;
+    MSDK_ZERO_MEMORY(*pSlab);
+    nSize = (nSize + MSDK_HUGE_PAGE_SIZE - 1) & ~(MSDK_HUGE_PAGE_SIZE - 1);
+
+#if defined(_WIN32) || defined(_WIN64)
+    // large pages need the "Lock pages in memory" privilege, fall back to normal pages without it
+    SIZE_T nLargePage = GetLargePageMinimum();
+    if (nLargePage)
+    {
+        pSlab->nMappedSize = (nSize + nLargePage - 1) & ~(nLargePage - 1);
+        pSlab->pMapped = (mfxU8 *)VirtualAlloc(NULL, pSlab->nMappedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        pSlab->bHugePages = (NULL != pSlab->pMapped);
+    }
+    if (!pSlab->pMapped)
+    {
+        pSlab->nMappedSize = nSize;
+        pSlab->pMapped = (mfxU8 *)VirtualAlloc(NULL, pSlab->nMappedSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (!pSlab->pMapped)
+    {
+        delete pSlab;
+        return MFX_ERR_MEMORY_ALLOC;
+    }
+    pSlab->pData = pSlab->pMapped;
+#else
+    // explicit huge pages come from the pool reserved in vm.nr_hugepages
+    pSlab->nMappedSize = nSize;
+    pSlab->pMapped = (mfxU8 *)mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != pSlab->pMapped)
+    {
+        pSlab->bHugePages = true;
+        pSlab->pData = pSlab->pMapped;
+    }
+    else
+    {
+        // transparent huge pages only back 2 MB aligned ranges
+        pSlab->nMappedSize = nSize + MSDK_HUGE_PAGE_SIZE;
+        pSlab->pMapped = (mfxU8 *)mmap(NULL, pSlab->nMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == pSlab->pMapped)
+        {
+            delete pSlab;
+            return MFX_ERR_MEMORY_ALLOC;
+        }
+        pSlab->pData = (mfxU8 *)(((size_t)pSlab->pMapped + MSDK_HUGE_PAGE_SIZE - 1) & ~(MSDK_HUGE_PAGE_SIZE - 1));
+#ifdef MADV_HUGEPAGE
+        madvise(pSlab->pData, nSize, MADV_HUGEPAGE);
+#endif
+    }
+#endif
+    pSlab->nSize = nSize;
+
+    // fault the pages in now rather than on the first frames
+    for (size_t i = 0; i < nSize; i += MSDK_PAGE_SIZE)
+        pSlab->pData[i] = 0;
+
+    *ppSlab = pSlab;
+    return MFX_ERR_NONE;
+}
+
+void SysMemBufferAllocator::DestroySlab(sArenaSlab *pSlab)
+{
+    if (!pSlab)
+        return;
 
+#if defined(_WIN32) || defined(_WIN64)
+    VirtualFree(pSlab->pMapped, 0, MEM_RELEASE);
+#else
+    munmap(pSlab->pMapped, pSlab->nMappedSize);
+#endif
+    delete pSlab;
+}
+
+mfxStatus SysMemBufferAllocator::ReserveArena(mfxU32 nbytes, mfxU32 nCount)
+{
+    m_pActiveSlab = NULL;
+    if (!m_bUseArena || !nCount)
+        return MFX_ERR_NONE;
+
+    size_t nSize = BufferSize(nbytes) * nCount;
+
+    // idle slabs too small for this pool are unmapped, after a resolution increase
+    // they would only wait for a smaller pool which may never come
+    for (size_t i = 0; i < m_Slabs.size(); )
+    {
+        sArenaSlab *pSlab = m_Slabs[i];
+        if (!pSlab->nBuffers && pSlab->nSize < nSize)
+        {
+            DestroySlab(pSlab);
+            m_Slabs.erase(m_Slabs.begin() + i);
+            continue;
+        }
+        i++;
+    }
+
+    // the smallest idle slab which fits
+    size_t nIdle = 0;
+    for (size_t i = 0; i < m_Slabs.size(); i++)
+    {
+        sArenaSlab *pSlab = m_Slabs[i];
+        if (pSlab->nBuffers)
+            continue;
+        nIdle++;
+        if (!m_pActiveSlab || pSlab->nSize < m_pActiveSlab->nSize)
+            m_pActiveSlab = pSlab;
+    }
+
+    // of the other idle slabs the largest ones go first
+    for (; m_pActiveSlab && nIdle > MSDK_ARENA_MAX_IDLE_SLABS + 1; nIdle--)
+    {
+        std::vector<sArenaSlab *>::iterator largest = m_Slabs.end();
+        for (std::vector<sArenaSlab *>::iterator it = m_Slabs.begin(); it != m_Slabs.end(); ++it)
+        {
+            if (!(*it)->nBuffers && *it != m_pActiveSlab && (largest == m_Slabs.end() || (*it)->nSize > (*largest)->nSize))
+                largest = it;
+        }
+        DestroySlab(*largest);
+        m_Slabs.erase(largest);
+    }
+
+    if (!m_pActiveSlab)
+    {
+        mfxStatus sts = CreateSlab(nSize, &m_pActiveSlab);
+        MSDK_CHECK_STATUS(sts, "CreateSlab failed");
+        m_Slabs.push_back(m_pActiveSlab);
+    }
+    m_pActiveSlab->nUsed = 0;
+
+    return MFX_ERR_NONE;
 }
 
 mfxStatus SysMemBufferAllocator::AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemId *mid)
@@ -413,13 +575,24 @@ mfxStatus SysMemBufferAllocator::AllocBuffer(mfxU32 nbytes, mfxU16 type, mfxMemI
     if (0 == (type & MFX_MEMTYPE_SYSTEM_MEMORY))
         return MFX_ERR_UNSUPPORTED;
 
-    mfxU32 header_size = MSDK_ALIGN32(sizeof(sBuffer));
-    mfxU8 *buffer_ptr = (mfxU8 *)calloc(header_size + nbytes + 32, 1);
-
-    if (!buffer_ptr)
-        return MFX_ERR_MEMORY_ALLOC;
+    sBuffer *bs = NULL;
+    size_t nSize = BufferSize(nbytes);
+    if (m_pActiveSlab && m_pActiveSlab->nUsed + nSize <= m_pActiveSlab->nSize)
+    {
+        bs = (sBuffer *)(m_pActiveSlab->pData + m_pActiveSlab->nUsed);
+        bs->slab = m_pActiveSlab;
+        m_pActiveSlab->nUsed += nSize;
+        m_pActiveSlab->nBuffers++;
+    }
+    else
+    {
+        // buffers which weren't reserved, or without arena mode
+        bs = (sBuffer *)calloc(nSize, 1);
+        if (!bs)
+            return MFX_ERR_MEMORY_ALLOC;
+        bs->slab = NULL;
+    }
 
-    sBuffer *bs = (sBuffer *)buffer_ptr;
     bs->id = ID_BUFFER;
     bs->type = type;
     bs->nbytes = nbytes;
@@ -439,7 +612,7 @@ mfxStatus SysMemBufferAllocator::LockBuffer(mfxMemId mid, mfxU8 **ptr)
     if (ID_BUFFER != bs->id)
         return MFX_ERR_INVALID_HANDLE;
 
-    *ptr = (mfxU8*)((size_t)((mfxU8 *)bs+MSDK_ALIGN32(sizeof(sBuffer))+31)&(~((size_t)31)));
+    *ptr = (mfxU8*)((size_t)((mfxU8 *)bs+MSDK_ALIGN32(sizeof(sBuffer))+63)&(~((size_t)63)));
     return MFX_ERR_NONE;
 }
 
@@ -459,6 +632,16 @@ mfxStatus SysMemBufferAllocator::FreeBuffer(mfxMemId mid)
     if (!bs || ID_BUFFER != bs->id)
         return MFX_ERR_INVALID_HANDLE;
 
+    if (bs->slab)
+    {
+        // the slab stays mapped for the next pool
+        bs->id = 0;
+        bs->slab->nBuffers--;
+        if (m_pActiveSlab == bs->slab && !bs->slab->nBuffers)
+            m_pActiveSlab = NULL;
+        return MFX_ERR_NONE;
+    }
+
     free(bs);
     return MFX_ERR_NONE;
 }
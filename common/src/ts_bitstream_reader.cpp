@@ -0,0 +1,328 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <algorithm>
+
+#include "sample_defs.h"
+#include "ts_bitstream_reader.h"
+
+#define MSDK_TS_SYNC_BYTE     0x47
+#define MSDK_TS_BUFFER_SIZE   (MSDK_TS_PACKET_SIZE * 1024)
+
+// stream_type values of ISO/IEC 13818-1 table 2-34 and the SMPTE RP 227 one for VC-1
+static mfxU32 GetCodecOfStreamType(mfxU8 streamType)
+{
+    switch (streamType)
+    {
+    case 0x02: return MFX_CODEC_MPEG2;
+    case 0x1B: return MFX_CODEC_AVC;
+    case 0x24: return MFX_CODEC_HEVC;
+    case 0xEA: return MFX_CODEC_VC1;
+    default:   return 0;
+    }
+}
+
+// 33 bit time stamp in 3, 15 and 15 bit parts, each followed by a marker bit
+static mfxU64 ReadTimeStamp(const mfxU8 *p)
+{
+    return ((mfxU64)(p[0] & 0x0E) << 29) | ((mfxU64)p[1] << 22) | ((mfxU64)(p[2] & 0xFE) << 14) |
+        ((mfxU64)p[3] << 7) | (p[4] >> 1);
+}
+
+// end of section data without CRC_32, 0 if the section header does not fit
+static mfxU32 GetSectionEnd(const mfxU8 *pSection, mfxU32 nSize)
+{
+    if (nSize < 3)
+        return 0;
+
+    mfxU32 nSectionLength = ((pSection[1] & 0x0F) << 8) | pSection[2];
+    if (nSectionLength < 4)
+        return 0;
+
+    // sections longer than one packet are not collected, their tail is ignored
+    return (std::min)(3 + nSectionLength - 4, nSize);
+}
+
+CTSBitstreamReader::CTSBitstreamReader()
+    : CSmplBitstreamReader()
+    , m_nBufferPos(0)
+    , m_nBufferSize(0)
+    , m_nCodecId(MFX_CODEC_AVC)
+    , m_nSelectedPid(0)
+    , m_nPmtPid(MSDK_TS_NULL_PID)
+    , m_nPid(MSDK_TS_NULL_PID)
+    , m_nContinuity(0xFF)
+    , m_nContinuityErrors(0)
+{
+}
+
+CTSBitstreamReader::~CTSBitstreamReader()
+{
+    Close();
+}
+
+void CTSBitstreamReader::SelectStream(mfxU32 nCodecId, mfxU16 nPid)
+{
+    m_nCodecId = nCodecId;
+    m_nSelectedPid = nPid;
+}
+
+void CTSBitstreamReader::ResetState()
+{
+    m_nBufferPos = 0;
+    m_nBufferSize = 0;
+    m_nPmtPid = MSDK_TS_NULL_PID;
+    m_nPid = m_nSelectedPid ? m_nSelectedPid : MSDK_TS_NULL_PID;
+    m_nContinuity = 0xFF;
+    m_PESHeader.clear();
+}
+
+mfxStatus CTSBitstreamReader::Init(const msdk_char *strFileName)
+{
+    mfxStatus sts = CSmplBitstreamReader::Init(strFileName);
+    MSDK_CHECK_STATUS(sts, "CSmplBitstreamReader::Init failed");
+
+    m_buffer.resize(MSDK_TS_BUFFER_SIZE);
+    m_nContinuityErrors = 0;
+    ResetState();
+
+    return MFX_ERR_NONE;
+}
+
+void CTSBitstreamReader::Reset()
+{
+    CSmplBitstreamReader::Reset();
+    ResetState();
+}
+
+void CTSBitstreamReader::Close()
+{
+    CSmplBitstreamReader::Close();
+    m_buffer.clear();
+    ResetState();
+}
+
+const mfxU8* CTSBitstreamReader::PeekPacket()
+{
+    for (;;)
+    {
+        if (m_nBufferSize - m_nBufferPos < MSDK_TS_PACKET_SIZE)
+        {
+            // keep the partial packet and refill the rest of the buffer
+            memmove(&m_buffer[0], &m_buffer[m_nBufferPos], m_nBufferSize - m_nBufferPos);
+            m_nBufferSize -= m_nBufferPos;
+            m_nBufferPos = 0;
+            m_nBufferSize += (mfxU32)fread(&m_buffer[m_nBufferSize], 1, m_buffer.size() - m_nBufferSize, m_fSource);
+
+            if (m_nBufferSize < MSDK_TS_PACKET_SIZE)
+                return NULL;
+        }
+
+        if (MSDK_TS_SYNC_BYTE == m_buffer[m_nBufferPos])
+            return &m_buffer[m_nBufferPos];
+
+        // sync is lost, look for the next sync byte
+        m_nBufferPos++;
+    }
+}
+
+void CTSBitstreamReader::ParsePAT(const mfxU8 *pSection, mfxU32 nSize)
+{
+    // table_id 0, section header is 8 bytes, then 4 bytes per program
+    if (nSize < 8 || pSection[0] != 0x00)
+        return;
+
+    mfxU32 nEnd = GetSectionEnd(pSection, nSize);
+    for (mfxU32 i = 8; i + 4 <= nEnd; i += 4)
+    {
+        mfxU16 nProgram = (pSection[i] << 8) | pSection[i + 1];
+        // program 0 points to the network information table
+        if (nProgram)
+        {
+            m_nPmtPid = ((pSection[i + 2] & 0x1F) << 8) | pSection[i + 3];
+            return;
+        }
+    }
+}
+
+void CTSBitstreamReader::ParsePMT(const mfxU8 *pSection, mfxU32 nSize)
+{
+    // table_id 2, 12 bytes up to program_info_length, then the program descriptors and stream loop
+    if (nSize < 12 || pSection[0] != 0x02 || m_nPid != MSDK_TS_NULL_PID)
+        return;
+
+    mfxU32 nEnd = GetSectionEnd(pSection, nSize);
+    mfxU32 i = 12 + (((pSection[10] & 0x0F) << 8) | pSection[11]);
+
+    while (i + 5 <= nEnd)
+    {
+        mfxU8  streamType = pSection[i];
+        mfxU16 nPid = ((pSection[i + 1] & 0x1F) << 8) | pSection[i + 2];
+        mfxU32 nInfoLength = ((pSection[i + 3] & 0x0F) << 8) | pSection[i + 4];
+
+        if (GetCodecOfStreamType(streamType) == m_nCodecId)
+        {
+            m_nPid = nPid;
+            return;
+        }
+        i += 5 + nInfoLength;
+    }
+}
+
+mfxStatus CTSBitstreamReader::ParsePESHeader(const mfxU8 *pData, mfxU32 nSize, mfxU32 *pHeaderSize, mfxBitstream *pBS)
+{
+    // packet_start_code_prefix, stream_id, PES_packet_length, two flag bytes, PES_header_data_length
+    static const mfxU8 startCode[3] = { 0, 0, 1 };
+    if (memcmp(pData, startCode, (std::min)(nSize, (mfxU32)3)))
+        return MFX_ERR_UNSUPPORTED;
+    if (nSize < 9)
+        return MFX_ERR_MORE_DATA;
+
+    mfxU32 nHeaderSize = 9 + pData[8];
+    if (nHeaderSize > nSize)
+        return MFX_ERR_MORE_DATA;
+
+    // time stamps are only read from a header long enough to hold them
+    mfxU8 ptsDtsFlags = pData[7] >> 6;
+    pBS->TimeStamp = ((ptsDtsFlags & 0x2) && pData[8] >= 5) ? ReadTimeStamp(pData + 9) : (mfxU64)MFX_TIMESTAMP_UNKNOWN;
+    pBS->DecodeTimeStamp = (ptsDtsFlags == 0x3 && pData[8] >= 10) ? (mfxI64)ReadTimeStamp(pData + 14) : (mfxI64)pBS->TimeStamp;
+
+    *pHeaderSize = nHeaderSize;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CTSBitstreamReader::ReadNextFrame(mfxBitstream *pBS)
+{
+    if (!m_bInited)
+        return MFX_ERR_NOT_INITIALIZED;
+
+    MSDK_CHECK_POINTER(pBS, MFX_ERR_NULL_PTR);
+
+    if (pBS->DataOffset)
+    {
+        memmove(pBS->Data, pBS->Data + pBS->DataOffset, pBS->DataLength);
+        m_nMovedBytes += pBS->DataLength;
+    }
+    pBS->DataOffset = 0;
+    pBS->DataFlag = MFX_BITSTREAM_COMPLETE_FRAME;
+
+    bool bInPes = false;
+    for (const mfxU8 *pPacket = PeekPacket(); pPacket; pPacket = PeekPacket())
+    {
+        mfxU16 nPid = ((pPacket[1] & 0x1F) << 8) | pPacket[2];
+        bool bUnitStart = !!(pPacket[1] & 0x40);
+        mfxU8 adaptationControl = (pPacket[3] >> 4) & 0x3;
+
+        // a PES ends where the next one of its PID starts, that packet is left for the next call
+        if (nPid == m_nPid && bUnitStart && bInPes)
+            break;
+
+        m_nBufferPos += MSDK_TS_PACKET_SIZE;
+
+        mfxU32 nOffset = 4;
+        bool bDiscontinuity = false;
+        if (adaptationControl & 0x2)
+        {
+            nOffset += 1 + pPacket[4];
+            bDiscontinuity = pPacket[4] && (pPacket[5] & 0x80);
+        }
+        // packets without payload don't advance continuity_counter
+        if (!(adaptationControl & 0x1) || nOffset >= MSDK_TS_PACKET_SIZE)
+            continue;
+
+        const mfxU8 *pPayload = pPacket + nOffset;
+        mfxU32 nSize = MSDK_TS_PACKET_SIZE - nOffset;
+
+        if (0 == nPid || nPid == m_nPmtPid)
+        {
+            // pointer_field precedes the section in the first packet of a section
+            if (bUnitStart && 1 + pPayload[0] < nSize)
+            {
+                if (0 == nPid)
+                    ParsePAT(pPayload + 1 + pPayload[0], nSize - 1 - pPayload[0]);
+                else
+                    ParsePMT(pPayload + 1 + pPayload[0], nSize - 1 - pPayload[0]);
+            }
+            continue;
+        }
+
+        if (nPid != m_nPid)
+            continue;
+
+        mfxU8 nContinuity = pPacket[3] & 0x0F;
+        if (0xFF != m_nContinuity && !bDiscontinuity)
+        {
+            // a packet may be sent twice in a row with the same counter, the copy is dropped
+            if (nContinuity == ((m_nContinuity - 1) & 0x0F))
+                continue;
+            if (nContinuity != m_nContinuity)
+                m_nContinuityErrors++;
+        }
+        m_nContinuity = (nContinuity + 1) & 0x0F;
+
+        if (bUnitStart)
+            m_PESHeader.clear();
+
+        if (bUnitStart || !m_PESHeader.empty())
+        {
+            // a header split across packets is collected first
+            if (!m_PESHeader.empty())
+            {
+                m_PESHeader.insert(m_PESHeader.end(), pPayload, pPayload + nSize);
+                pPayload = &m_PESHeader[0];
+                nSize = (mfxU32)m_PESHeader.size();
+            }
+
+            mfxU32 nHeaderSize = 0;
+            mfxStatus sts = ParsePESHeader(pPayload, nSize, &nHeaderSize, pBS);
+            if (MFX_ERR_MORE_DATA == sts)
+            {
+                if (m_PESHeader.empty())
+                    m_PESHeader.assign(pPayload, pPayload + nSize);
+                continue;
+            }
+            if (MFX_ERR_NONE != sts)
+            {
+                m_PESHeader.clear();
+                continue;
+            }
+
+            bInPes = true;
+            pPayload += nHeaderSize;
+            nSize -= nHeaderSize;
+        }
+
+        // tail of a PES which started before the reader joined the stream is dropped
+        if (!bInPes)
+            continue;
+
+        if (nSize > pBS->MaxLength - pBS->DataLength)
+        {
+            mfxStatus sts = ExtendMfxBitstream(pBS, (std::max)(pBS->MaxLength * 2, pBS->DataLength + nSize));
+            MSDK_CHECK_STATUS(sts, "ExtendMfxBitstream failed");
+        }
+        MSDK_MEMCPY_BITSTREAM(*pBS, pBS->DataLength, pPayload, nSize);
+        pBS->DataLength += nSize;
+        m_PESHeader.clear();
+    }
+
+    return bInPes ? MFX_ERR_NONE : MFX_ERR_MORE_DATA;
+}
@@ -30,6 +30,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <assert.h>
 #include <linux/videodev2.h>
 #include "v4l2_util.h"
+#include "vm/thread_defs.h"
 
 /* Global Declaration */
 Buffer *buffers, *CurBuffers;
@@ -325,6 +326,8 @@ void *PollingThread(void *data)
 
     v4l2Device *v4l2 = (v4l2Device *)data;
 
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_CAPTURE);
+
     struct sigaction sigIntHandler;
     sigIntHandler.sa_handler = CtrlCTerminationHandler;
     sigemptyset(&sigIntHandler.sa_mask);
@@ -0,0 +1,221 @@
+/******************************************************************************\
+Copyright (c) 2005-2018, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <new>
+#include <chrono>
+#include <thread>
+
+#include "vm/thread_defs.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <intrin.h>
+#else
+#include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// rounds of polling before a waiter parks, a handoff between two busy
+// threads is usually over within that
+#define MSDK_FUTEX_SPIN_COUNT 2000
+
+static inline void msdk_cpu_relax()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// spinning only burns the time slice of the thread about to post on a single CPU
+static mfxU32 msdk_futex_spin_count()
+{
+    static const mfxU32 count = (std::thread::hardware_concurrency() > 1) ? MSDK_FUTEX_SPIN_COUNT : 0;
+    return count;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+// sleeps while *pWord is expected, wakeups may be spurious, callers recheck
+static void msdk_futex_wait(std::atomic<mfxU32> *pWord, mfxU32 expected, mfxU32 msec)
+{
+    WaitOnAddress(pWord, &expected, sizeof(expected), (MFX_INFINITE == msec) ? INFINITE : msec);
+}
+
+static void msdk_futex_wake(std::atomic<mfxU32> *pWord, bool bAll)
+{
+    if (bAll) WakeByAddressAll(pWord);
+    else      WakeByAddressSingle(pWord);
+}
+
+#else // #if defined(_WIN32) || defined(_WIN64)
+
+static void msdk_futex_wait(std::atomic<mfxU32> *pWord, mfxU32 expected, mfxU32 msec)
+{
+    struct timespec timeout;
+    timeout.tv_sec = msec / 1000;
+    timeout.tv_nsec = (msec % 1000) * 1000000;
+
+    syscall(SYS_futex, (mfxU32*)pWord, FUTEX_WAIT_PRIVATE, expected,
+        (MFX_INFINITE == msec) ? NULL : &timeout, NULL, 0);
+}
+
+static void msdk_futex_wake(std::atomic<mfxU32> *pWord, bool bAll)
+{
+    syscall(SYS_futex, (mfxU32*)pWord, FUTEX_WAKE_PRIVATE, bAll ? INT_MAX : 1, NULL, NULL, 0);
+}
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
+
+/* ****************************************************************************** */
+
+// a waiter registers in m_waiters before it parks and rechecks the word in the
+// wait call itself, a poster changes the word before it looks at m_waiters, so
+// one of the two always sees the other
+
+MSDKFutexSemaphore::MSDKFutexSemaphore(mfxStatus &sts, mfxU32 count)
+    : m_count(count)
+    , m_waiters(0)
+{
+    sts = MFX_ERR_NONE;
+}
+
+MSDKFutexSemaphore::~MSDKFutexSemaphore(void)
+{
+}
+
+bool MSDKFutexSemaphore::TryWait(void)
+{
+    mfxU32 count = m_count.load();
+    while (count)
+    {
+        if (m_count.compare_exchange_weak(count, count - 1))
+            return true;
+    }
+    return false;
+}
+
+mfxStatus MSDKFutexSemaphore::Post(void)
+{
+    ++m_count;
+    if (m_waiters.load())
+        msdk_futex_wake(&m_count, false);
+    return MFX_ERR_NONE;
+}
+
+mfxStatus MSDKFutexSemaphore::Wait(void)
+{
+    for (mfxU32 i = 0, n = msdk_futex_spin_count(); i < n; i++)
+    {
+        if (TryWait()) return MFX_ERR_NONE;
+        msdk_cpu_relax();
+    }
+
+    while (!TryWait())
+    {
+        ++m_waiters;
+        msdk_futex_wait(&m_count, 0, MFX_INFINITE);
+        --m_waiters;
+    }
+    return MFX_ERR_NONE;
+}
+
+/* ****************************************************************************** */
+
+MSDKFutexEvent::MSDKFutexEvent(mfxStatus &sts, bool manual, bool state)
+    : m_manual(manual)
+    , m_state(state ? 1 : 0)
+    , m_waiters(0)
+{
+    sts = MFX_ERR_NONE;
+}
+
+MSDKFutexEvent::~MSDKFutexEvent(void)
+{
+}
+
+bool MSDKFutexEvent::TryWait(void)
+{
+    if (m_manual)
+        return 0 != m_state.load();
+
+    // an auto reset event lets a single waiter through
+    mfxU32 state = 1;
+    return m_state.compare_exchange_strong(state, 0);
+}
+
+mfxStatus MSDKFutexEvent::Signal(void)
+{
+    m_state = 1;
+    if (m_waiters.load())
+        msdk_futex_wake(&m_state, m_manual);
+    return MFX_ERR_NONE;
+}
+
+mfxStatus MSDKFutexEvent::Reset(void)
+{
+    m_state = 0;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus MSDKFutexEvent::Wait(void)
+{
+    for (mfxU32 i = 0, n = msdk_futex_spin_count(); i < n; i++)
+    {
+        if (TryWait()) return MFX_ERR_NONE;
+        msdk_cpu_relax();
+    }
+
+    while (!TryWait())
+    {
+        ++m_waiters;
+        msdk_futex_wait(&m_state, 0, MFX_INFINITE);
+        --m_waiters;
+    }
+    return MFX_ERR_NONE;
+}
+
+mfxStatus MSDKFutexEvent::TimedWait(mfxU32 msec)
+{
+    if (MFX_INFINITE == msec) return MFX_ERR_UNSUPPORTED;
+
+    for (mfxU32 i = 0, n = msdk_futex_spin_count(); i < n; i++)
+    {
+        if (TryWait()) return MFX_ERR_NONE;
+        msdk_cpu_relax();
+    }
+
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+    while (!TryWait())
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= deadline) return MFX_TASK_WORKING;
+
+        mfxU32 left = (mfxU32)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        ++m_waiters;
+        msdk_futex_wait(&m_state, 0, left ? left : 1);
+        --m_waiters;
+    }
+    return MFX_ERR_NONE;
+}
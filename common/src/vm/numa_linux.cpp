@@ -0,0 +1,144 @@
+/******************************************************************************\
+Copyright (c) 2005-2018, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include "vm/numa_defs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <vector>
+
+// parses a sysfs list like "0-3,8-11" and marks the ids in pSet, returns the highest id or -1
+static int msdk_numa_parse_list(const char *path, cpu_set_t *pSet)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char buf[4096] = {0};
+    bool bRead = (NULL != fgets(buf, sizeof(buf), f));
+    fclose(f);
+    if (!bRead) return -1;
+
+    int highest = -1;
+    for (char *p = buf; *p && *p != '\n';)
+    {
+        char *end = NULL;
+        int first = (int)strtol(p, &end, 10);
+        if (end == p) break;
+        int last = first;
+        if ('-' == *end)
+        {
+            p = end + 1;
+            last = (int)strtol(p, &end, 10);
+        }
+        for (int i = first; i <= last; ++i)
+        {
+            if (pSet && i < CPU_SETSIZE)
+                CPU_SET(i, pSet);
+            highest = (i > highest) ? i : highest;
+        }
+        p = (',' == *end) ? end + 1 : end;
+    }
+    return highest;
+}
+
+mfxU32 msdk_numa_get_node_count()
+{
+    int highest = msdk_numa_parse_list("/sys/devices/system/node/online", NULL);
+    return (highest < 0) ? 1 : (mfxU32)highest + 1;
+}
+
+mfxI32 msdk_numa_get_current_node()
+{
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL))
+        return MSDK_NUMA_NODE_ANY;
+    return (mfxI32)node;
+}
+
+mfxStatus msdk_numa_get_node_affinity(mfxI32 node, msdk_cpu_affinity *pAffinity)
+{
+    if (!pAffinity) return MFX_ERR_NULL_PTR;
+    if (node < 0) return MFX_ERR_UNSUPPORTED;
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    CPU_ZERO(pAffinity);
+    if (msdk_numa_parse_list(path, pAffinity) < 0)
+        return MFX_ERR_UNSUPPORTED;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_bind_thread(mfxI32 node, msdk_cpu_affinity *pPrevious)
+{
+    cpu_set_t affinity;
+    mfxStatus sts = msdk_numa_get_node_affinity(node, &affinity);
+    if (MFX_ERR_NONE != sts) return sts;
+
+    // pid 0 is the calling thread
+    if (pPrevious && sched_getaffinity(0, sizeof(*pPrevious), pPrevious))
+        return MFX_ERR_UNKNOWN;
+    return sched_setaffinity(0, sizeof(affinity), &affinity) ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_restore_thread(const msdk_cpu_affinity *pAffinity)
+{
+    if (!pAffinity) return MFX_ERR_NULL_PTR;
+
+    return sched_setaffinity(0, sizeof(*pAffinity), pAffinity) ? MFX_ERR_UNKNOWN : MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_count_pages(const void *ptr, size_t size, mfxI32 node, mfxU32 nStep, mfxU32 *pLocal, mfxU32 *pRemote)
+{
+    if (!ptr || !pLocal || !pRemote) return MFX_ERR_NULL_PTR;
+    if (!nStep) nStep = 1;
+
+    size_t nPageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t nStride = nPageSize * nStep;
+
+    std::vector<void *> pages;
+    for (size_t offset = 0; offset < size; offset += nStride)
+        pages.push_back((void *)(((size_t)ptr + offset) & ~(nPageSize - 1)));
+    if (pages.empty()) return MFX_ERR_NONE;
+
+    // without target nodes move_pages only reports where the pages are
+    std::vector<int> status(pages.size());
+    if (syscall(SYS_move_pages, 0, (unsigned long)pages.size(), &pages[0], NULL, &status[0], 0))
+        return MFX_ERR_UNKNOWN;
+
+    // pages which were never touched report a negative error instead of a node
+    for (size_t i = 0; i < status.size(); i++)
+    {
+        if (status[i] < 0)
+            continue;
+        if (status[i] == node)
+            ++*pLocal;
+        else
+            ++*pRemote;
+    }
+    return MFX_ERR_NONE;
+}
+
+#endif // #if !defined(_WIN32) && !defined(_WIN64)
@@ -0,0 +1,110 @@
+/******************************************************************************\
+Copyright (c) 2005-2018, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+
+#include "vm/numa_defs.h"
+
+#include <psapi.h>
+#include <vector>
+
+mfxU32 msdk_numa_get_node_count()
+{
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest))
+        return 1;
+    return highest + 1;
+}
+
+mfxI32 msdk_numa_get_current_node()
+{
+    PROCESSOR_NUMBER proc;
+    USHORT node = 0;
+
+    GetCurrentProcessorNumberEx(&proc);
+    if (!GetNumaProcessorNodeEx(&proc, &node))
+        return MSDK_NUMA_NODE_ANY;
+    return node;
+}
+
+mfxStatus msdk_numa_get_node_affinity(mfxI32 node, msdk_cpu_affinity *pAffinity)
+{
+    if (!pAffinity) return MFX_ERR_NULL_PTR;
+    if (node < 0) return MFX_ERR_UNSUPPORTED;
+
+    ZeroMemory(pAffinity, sizeof(*pAffinity));
+    if (!GetNumaNodeProcessorMaskEx((USHORT)node, pAffinity) || !pAffinity->Mask)
+        return MFX_ERR_UNSUPPORTED;
+    return MFX_ERR_NONE;
+}
+
+mfxStatus msdk_numa_bind_thread(mfxI32 node, msdk_cpu_affinity *pPrevious)
+{
+    GROUP_AFFINITY affinity;
+    mfxStatus sts = msdk_numa_get_node_affinity(node, &affinity);
+    if (MFX_ERR_NONE != sts) return sts;
+
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, pPrevious) ? MFX_ERR_NONE : MFX_ERR_UNKNOWN;
+}
+
+mfxStatus msdk_numa_restore_thread(const msdk_cpu_affinity *pAffinity)
+{
+    if (!pAffinity) return MFX_ERR_NULL_PTR;
+
+    return SetThreadGroupAffinity(GetCurrentThread(), pAffinity, NULL) ? MFX_ERR_NONE : MFX_ERR_UNKNOWN;
+}
+
+mfxStatus msdk_numa_count_pages(const void *ptr, size_t size, mfxI32 node, mfxU32 nStep, mfxU32 *pLocal, mfxU32 *pRemote)
+{
+    if (!ptr || !pLocal || !pRemote) return MFX_ERR_NULL_PTR;
+    if (!nStep) nStep = 1;
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    size_t nStride = (size_t)si.dwPageSize * nStep;
+
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages;
+    for (size_t offset = 0; offset < size; offset += nStride)
+    {
+        PSAPI_WORKING_SET_EX_INFORMATION page;
+        ZeroMemory(&page, sizeof(page));
+        page.VirtualAddress = (PVOID)((const mfxU8 *)ptr + offset);
+        pages.push_back(page);
+    }
+    if (pages.empty()) return MFX_ERR_NONE;
+
+    if (!QueryWorkingSetEx(GetCurrentProcess(), &pages[0], (DWORD)(pages.size() * sizeof(pages[0]))))
+        return MFX_ERR_UNKNOWN;
+
+    // pages which were never touched or got paged out have no node
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        if (!pages[i].VirtualAttributes.Valid)
+            continue;
+        if ((mfxI32)pages[i].VirtualAttributes.Node == node)
+            ++*pLocal;
+        else
+            ++*pRemote;
+    }
+    return MFX_ERR_NONE;
+}
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
@@ -0,0 +1,270 @@
+/******************************************************************************\
+Copyright (c) 2005-2018, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <chrono>
+#include <algorithm>
+
+#include "vm/task_pool_defs.h"
+#include "vm/thread_defs.h"
+
+// interval a waiting group re-checks the pool for tasks it could help with, in milliseconds
+#define MSDK_TASK_GROUP_POLL_MS 1
+
+// worker the calling thread is, if any
+static thread_local MSDKTaskPool *g_pCurrentPool = NULL;
+static thread_local mfxU32        g_nCurrentWorker = 0;
+
+static std::atomic<mfxU32> g_nDefaultWorkers(0);
+
+MSDKTaskPool::MSDKTaskPool(mfxU32 nWorkers)
+    : m_nQueued(0)
+    , m_nNext(0)
+    , m_bStop(false)
+{
+    if (!nWorkers)
+        nWorkers = 1;
+
+    for (mfxU32 i = 0; i < nWorkers; i++)
+    {
+        m_Workers.push_back(std::unique_ptr<sWorker>(new sWorker));
+    }
+    // all deques exist before a worker may steal from them
+    for (mfxU32 i = 0; i < nWorkers; i++)
+    {
+        m_Workers[i]->thread = std::thread(&MSDKTaskPool::WorkerLoop, this, i);
+    }
+}
+
+MSDKTaskPool::~MSDKTaskPool(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_bStop = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (mfxU32 i = 0; i < m_Workers.size(); i++)
+    {
+        if (m_Workers[i]->thread.joinable())
+            m_Workers[i]->thread.join();
+    }
+}
+
+MSDKTaskPool& MSDKTaskPool::GetInstance()
+{
+    // never destroyed, joining the workers from a static destructor may happen
+    // under the loader lock on Windows
+    static MSDKTaskPool *pPool = new MSDKTaskPool(g_nDefaultWorkers ? (mfxU32)g_nDefaultWorkers : std::thread::hardware_concurrency());
+    return *pPool;
+}
+
+void MSDKTaskPool::SetDefaultWorkerCount(mfxU32 nWorkers)
+{
+    g_nDefaultWorkers = nWorkers;
+}
+
+void MSDKTaskPool::Submit(const msdk_task &task, MSDKTaskGroup *pGroup)
+{
+    sTaskItem item;
+    item.task = task;
+    item.pGroup = pGroup;
+
+    mfxU32 nWorker = (this == g_pCurrentPool) ? g_nCurrentWorker : (m_nNext++ % (mfxU32)m_Workers.size());
+    {
+        std::lock_guard<std::mutex> lock(m_Workers[nWorker]->mutex);
+        m_Workers[nWorker]->tasks.push_back(item);
+    }
+
+    {
+        // taken so that a worker going to sleep can't miss the new task
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        ++m_nQueued;
+    }
+    m_wakeUp.notify_one();
+}
+
+bool MSDKTaskPool::PopTask(mfxU32 nIndex, sTaskItem &item, MSDKTaskGroup *pGroup)
+{
+    if (!m_nQueued)
+        return false;
+
+    const mfxU32 nWorkers = (mfxU32)m_Workers.size();
+    for (mfxU32 i = 0; i < nWorkers; i++)
+    {
+        sWorker &worker = *m_Workers[(nIndex + i) % nWorkers];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+            continue;
+
+        // own tasks newest first, they're the ones still in cache; stolen ones oldest first
+        std::deque<sTaskItem>::iterator it = worker.tasks.end();
+        if (!pGroup)
+        {
+            it = (0 == i) ? worker.tasks.end() - 1 : worker.tasks.begin();
+        }
+        else if (0 == i)
+        {
+            for (std::deque<sTaskItem>::iterator cur = worker.tasks.end(); cur != worker.tasks.begin(); )
+            {
+                if ((--cur)->pGroup == pGroup)
+                {
+                    it = cur;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            for (std::deque<sTaskItem>::iterator cur = worker.tasks.begin(); cur != worker.tasks.end(); ++cur)
+            {
+                if (cur->pGroup == pGroup)
+                {
+                    it = cur;
+                    break;
+                }
+            }
+        }
+        if (it == worker.tasks.end())
+            continue;
+
+        item = *it;
+        worker.tasks.erase(it);
+        --m_nQueued;
+        return true;
+    }
+    return false;
+}
+
+void MSDKTaskPool::RunTask(sTaskItem &item)
+{
+    item.task();
+    if (item.pGroup)
+        item.pGroup->Done();
+}
+
+bool MSDKTaskPool::RunPendingTask(MSDKTaskGroup *pGroup)
+{
+    sTaskItem item;
+    mfxU32 nIndex = (this == g_pCurrentPool) ? g_nCurrentWorker : 0;
+    if (!PopTask(nIndex, item, pGroup))
+        return false;
+
+    RunTask(item);
+    return true;
+}
+
+void MSDKTaskPool::WorkerLoop(mfxU32 nIndex)
+{
+    g_pCurrentPool = this;
+    g_nCurrentWorker = nIndex;
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_POOL);
+
+    for (;;)
+    {
+        sTaskItem item;
+        if (PopTask(nIndex, item))
+        {
+            RunTask(item);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.wait(lock, [this]() { return m_bStop || m_nQueued; });
+        if (m_bStop)
+            break;
+    }
+}
+
+/* ****************************************************************************** */
+
+MSDKTaskGroup::MSDKTaskGroup(MSDKTaskPool &pool)
+    : m_pool(pool)
+    , m_nPending(0)
+{
+}
+
+MSDKTaskGroup::~MSDKTaskGroup(void)
+{
+    Wait();
+}
+
+void MSDKTaskGroup::Run(const msdk_task &task)
+{
+    ++m_nPending;
+    m_pool.Submit(task, this);
+}
+
+void MSDKTaskGroup::Done(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (0 == --m_nPending)
+        m_done.notify_all();
+}
+
+void MSDKTaskGroup::Wait(void)
+{
+    while (m_nPending)
+    {
+        // only the group's own tasks: anything else may sleep or need a lock the caller holds
+        if (m_pool.RunPendingTask(this))
+            continue;
+
+        // the rest runs on other workers, they may still queue tasks to help with
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait_for(lock, std::chrono::milliseconds(MSDK_TASK_GROUP_POLL_MS), [this]() { return 0 == m_nPending; });
+    }
+
+    // Done() may still hold the mutex after the last decrement
+    std::lock_guard<std::mutex> lock(m_mutex);
+}
+
+void msdk_parallel_for(mfxU32 begin, mfxU32 end, const std::function<void(mfxU32, mfxU32)> &body, mfxU32 nGrain)
+{
+    if (end <= begin)
+        return;
+
+    MSDKTaskPool &pool = MSDKTaskPool::GetInstance();
+    mfxU32 nGrainMin = nGrain ? nGrain : 1;
+    // a few ranges per worker so that stealing can even out uneven ones
+    mfxU32 nRanges = (std::min)(pool.GetWorkerCount() * 4, (end - begin + nGrainMin - 1) / nGrainMin);
+    if (nRanges <= 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    mfxU32 nSize = (end - begin) / nRanges;
+    mfxU32 nRemainder = (end - begin) % nRanges;
+
+    MSDKTaskGroup group(pool);
+    mfxU32 first = begin;
+    for (mfxU32 i = 0; i < nRanges; i++)
+    {
+        mfxU32 last = first + nSize + (i < nRemainder ? 1 : 0);
+        // the last range runs on the calling thread
+        if (i + 1 < nRanges)
+            group.Run([&body, first, last]() { body(first, last); });
+        else
+            body(first, last);
+        first = last;
+    }
+    group.Wait();
+}
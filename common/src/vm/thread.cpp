@@ -18,9 +18,19 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 \**********************************************************************************/
 
 #include <new> // std::bad_alloc
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
 
 #include "vm/thread_defs.h"
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
 AutomaticMutex::AutomaticMutex(MSDKMutex& mutex):
     m_rMutex(mutex),
     m_bLocked(false)
@@ -57,3 +67,215 @@ mfxStatus AutomaticMutex::Unlock(void)
     }
     return sts;
 }
+
+/* ****************************************************************************** */
+
+static const char* g_ThreadRoleNames[MSDK_THREAD_ROLE_COUNT] =
+{
+    "Pipeline",
+    "Deliver",
+    "Worker",
+    "Feeder",
+    "Drain",
+    "Capture",
+    "Segmenter",
+    "Pool"
+};
+
+static msdk_thread_policy g_ThreadPolicies[MSDK_THREAD_ROLE_COUNT];
+static bool               g_bThreadPolicySet[MSDK_THREAD_ROLE_COUNT];
+static std::atomic<bool>  g_bThreadPolicyWarned[MSDK_THREAD_ROLE_COUNT];
+
+const char* msdk_thread_get_role_name(msdk_thread_role role)
+{
+    return (role < MSDK_THREAD_ROLE_COUNT) ? g_ThreadRoleNames[role] : "Unknown";
+}
+
+mfxStatus msdk_thread_parse_cpu_list(const char *list, msdk_thread_policy *pPolicy)
+{
+    if (!list || !pPolicy) return MFX_ERR_NULL_PTR;
+
+    const char *p = list;
+    while (*p)
+    {
+        char *end = NULL;
+        unsigned long first = strtoul(p, &end, 10);
+        if (end == p) return MFX_ERR_UNSUPPORTED;
+
+        unsigned long last = first;
+        p = end;
+        if ('-' == *p)
+        {
+            last = strtoul(++p, &end, 10);
+            if (end == p || last < first) return MFX_ERR_UNSUPPORTED;
+            p = end;
+        }
+        if (last >= MSDK_THREAD_MAX_CPUS) return MFX_ERR_UNSUPPORTED;
+
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+            pPolicy->cpus[cpu / 64] |= (mfxU64)1 << (cpu % 64);
+
+        while (' ' == *p) p++;
+        if (',' == *p) p++;
+        else if (*p) return MFX_ERR_UNSUPPORTED;
+        while (' ' == *p) p++;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void msdk_thread_set_role_policy(msdk_thread_role role, const msdk_thread_policy *pPolicy)
+{
+    if (role >= MSDK_THREAD_ROLE_COUNT) return;
+
+    g_bThreadPolicySet[role] = (NULL != pPolicy);
+    if (pPolicy)
+        g_ThreadPolicies[role] = *pPolicy;
+}
+
+mfxStatus msdk_thread_read_role_policies(const std::function<bool(const std::string &key, std::string &value)> &lookup)
+{
+    for (int role = 0; role < MSDK_THREAD_ROLE_COUNT; role++)
+    {
+        std::string key = std::string("Thread") + msdk_thread_get_role_name((msdk_thread_role)role);
+        std::string cpus, sched, priority;
+        bool bCpus = lookup(key + "Cpus", cpus);
+        bool bSched = lookup(key + "Policy", sched);
+        bool bPriority = lookup(key + "Priority", priority);
+        if (!bCpus && !bSched && !bPriority)
+            continue;
+
+        msdk_thread_policy policy;
+        memset(&policy, 0, sizeof(policy));
+
+        if (!cpus.empty() && MFX_ERR_NONE != msdk_thread_parse_cpu_list(cpus.c_str(), &policy))
+        {
+            msdk_printf(MSDK_STRING("error: bad CPU list %hs in %hsCpus\n"), cpus.c_str(), key.c_str());
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        if (sched.empty())
+            sched = "normal";
+        if (sched != "fifo" && sched != "normal")
+        {
+            msdk_printf(MSDK_STRING("error: unknown scheduling policy %hs in %hsPolicy\n"), sched.c_str(), key.c_str());
+            return MFX_ERR_UNSUPPORTED;
+        }
+        policy.bRealtime = (sched == "fifo");
+        policy.priority = (mfxI32)strtol(priority.c_str(), NULL, 10);
+
+        msdk_thread_set_role_policy((msdk_thread_role)role, &policy);
+    }
+
+    return MFX_ERR_NONE;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+typedef HRESULT (WINAPI * msdk_set_thread_description)(HANDLE, PCWSTR);
+
+static void msdk_thread_set_name(const char *name)
+{
+    // not there before Windows 10 1607
+    msdk_set_thread_description pSetThreadDescription = (msdk_set_thread_description)
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription");
+    if (!pSetThreadDescription) return;
+
+    wchar_t wname[32];
+    swprintf(wname, sizeof(wname) / sizeof(wname[0]), L"msdk-%hs", name);
+    pSetThreadDescription(GetCurrentThread(), wname);
+}
+
+static mfxStatus msdk_thread_set_policy(const msdk_thread_policy &policy)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+
+    // a thread runs within one processor group, the group of the first CPU is taken
+    for (mfxU16 group = 0; group < MSDK_THREAD_MAX_CPUS / 64; group++)
+    {
+        if (!policy.cpus[group]) continue;
+
+        GROUP_AFFINITY affinity;
+        memset(&affinity, 0, sizeof(affinity));
+        affinity.Group = group;
+        affinity.Mask = (KAFFINITY)policy.cpus[group];
+        if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL))
+            sts = MFX_ERR_UNKNOWN;
+        break;
+    }
+
+    int priority = THREAD_PRIORITY_NORMAL;
+    if (policy.bRealtime)             priority = THREAD_PRIORITY_TIME_CRITICAL;
+    else if (policy.priority <= -10)  priority = THREAD_PRIORITY_HIGHEST;
+    else if (policy.priority < 0)     priority = THREAD_PRIORITY_ABOVE_NORMAL;
+    else if (policy.priority >= 10)   priority = THREAD_PRIORITY_LOWEST;
+    else if (policy.priority > 0)     priority = THREAD_PRIORITY_BELOW_NORMAL;
+
+    if (THREAD_PRIORITY_NORMAL != priority && !SetThreadPriority(GetCurrentThread(), priority))
+        sts = MFX_ERR_UNKNOWN;
+
+    return sts;
+}
+
+#else // #if defined(_WIN32) || defined(_WIN64)
+
+static void msdk_thread_set_name(const char *name)
+{
+    // 15 characters at most
+    char tname[16];
+    snprintf(tname, sizeof(tname), "msdk-%s", name);
+    pthread_setname_np(pthread_self(), tname);
+}
+
+static mfxStatus msdk_thread_set_policy(const msdk_thread_policy &policy)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    bool bCpus = false;
+    for (mfxU32 cpu = 0; cpu < MSDK_THREAD_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+    {
+        if (policy.cpus[cpu / 64] & ((mfxU64)1 << (cpu % 64)))
+        {
+            CPU_SET(cpu, &cpus);
+            bCpus = true;
+        }
+    }
+    if (bCpus && pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+        sts = MFX_ERR_UNKNOWN;
+
+    if (policy.bRealtime)
+    {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = policy.priority ? policy.priority : sched_get_priority_min(SCHED_FIFO);
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+            sts = MFX_ERR_UNKNOWN;
+    }
+    else if (policy.priority)
+    {
+        // the nice level is per thread on Linux
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), policy.priority))
+            sts = MFX_ERR_UNKNOWN;
+    }
+
+    return sts;
+}
+
+#endif // #if defined(_WIN32) || defined(_WIN64)
+
+mfxStatus msdk_thread_apply_role(msdk_thread_role role)
+{
+    if (role >= MSDK_THREAD_ROLE_COUNT) return MFX_ERR_UNSUPPORTED;
+
+    msdk_thread_set_name(g_ThreadRoleNames[role]);
+    if (!g_bThreadPolicySet[role]) return MFX_ERR_NONE;
+
+    mfxStatus sts = msdk_thread_set_policy(g_ThreadPolicies[role]);
+    // real-time scheduling and negative nice levels need privileges, tell once per role
+    if (MFX_ERR_NONE != sts && !g_bThreadPolicyWarned[role].exchange(true))
+        printf("WARNING: policy of the %s threads was not fully applied\n", g_ThreadRoleNames[role]);
+
+    return sts;
+}
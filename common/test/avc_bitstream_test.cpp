@@ -0,0 +1,288 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+// Standalone check and timing of AVCBaseBitstream::GetBits/GetVLCElement against the former
+// avcGetNBits/DecodeExpGolombOne reads, on random fixed, ue(v) and se(v) fields. Given an H.264
+// elementary stream it also times AVC_Spl over it, every SPS, PPS and slice header included.
+// Build it with the Media SDK headers:
+//   g++ -O2 -I common/include -I <msdk>/include common/test/avc_bitstream_test.cpp common/src/avc_bitstream.cpp
+//       common/src/avc_spl.cpp common/src/avc_nal_spl.cpp common/src/emulation_prevention.cpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include "avc_bitstream.h"
+#include "avc_spl.h"
+
+namespace ProtectedLibrary
+{
+mfxStatus DecodeExpGolombOne(mfxU32 **ppBitStream, mfxI32 *pBitOffset, mfxI32 *pDst, mfxI32 isSigned);
+
+// the reads GetBits and GetVLCElement replaced
+class CReferenceBitstream : public AVCBaseBitstream
+{
+public:
+    mfxU32 RefGetBits(mfxU32 nbits)
+    {
+        mfxU32 w;
+        avcGetNBits(m_pbs, m_bitOffset, nbits, w);
+        return w;
+    }
+
+    mfxI32 RefGetVLCElement(bool bIsSigned)
+    {
+        mfxI32 sval = 0;
+        DecodeExpGolombOne(&m_pbs, &m_bitOffset, &sval, bIsSigned);
+        return sval;
+    }
+
+    bool SamePosition(const CReferenceBitstream &other) const
+    {
+        return m_pbs == other.m_pbs && m_bitOffset == other.m_bitOffset;
+    }
+};
+}
+
+using namespace ProtectedLibrary;
+
+// writes dwords the way SwapMemoryAndRemovePreventingBytes leaves them, first bit at bit 31
+class CBitWriter
+{
+public:
+    CBitWriter() : m_acc(0), m_nBits(0) {}
+
+    void PutBits(mfxU32 val, mfxU32 nbits)
+    {
+        for (mfxI32 i = (mfxI32)nbits - 1; i >= 0; i--)
+        {
+            m_acc = (m_acc << 1) | ((val >> i) & 1);
+            if (32 == ++m_nBits)
+            {
+                m_dwords.push_back(m_acc);
+                m_acc = 0;
+                m_nBits = 0;
+            }
+        }
+    }
+
+    void PutUE(mfxU32 val)
+    {
+        mfxU64 code = (mfxU64)val + 1;
+        mfxU32 len = 0;
+        while (code >> (len + 1))
+            len++;
+        PutBits(0, len);
+        PutBits(1, 1);
+        if (len)
+            PutBits((mfxU32)(code & ((1ULL << len) - 1)), len);
+    }
+
+    void PutSE(mfxI32 val)
+    {
+        PutUE(val > 0 ? 2 * (mfxU32)val - 1 : 2 * (mfxU32)-val);
+    }
+
+    // padded, with two dwords of zeros past the end for the readers' look ahead
+    std::vector<mfxU32>& Finish(mfxU32 *pSize)
+    {
+        if (m_nBits)
+            PutBits(0, 32 - m_nBits);
+        *pSize = (mfxU32)m_dwords.size() * 4;
+        m_dwords.push_back(0);
+        m_dwords.push_back(0);
+        return m_dwords;
+    }
+
+private:
+    std::vector<mfxU32> m_dwords;
+    mfxU32 m_acc;
+    mfxU32 m_nBits;
+};
+
+enum { FIELD_BITS, FIELD_UE, FIELD_SE, FIELD_FLAG };
+
+struct sField
+{
+    int    type;
+    mfxU32 nbits;
+    mfxI64 value;
+};
+
+static double Ms(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+static int CheckFields()
+{
+    CBitWriter writer;
+    std::vector<sField> fields(3000000);
+
+    srand(1);
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        sField &f = fields[i];
+        f.type = rand() % 4;
+        f.nbits = 1 + rand() % 32;
+        // mostly short codes as in headers, some up to 30 bits
+        mfxU32 mag = (rand() % 100 < 90) ? rand() % 8 : rand() % 31;
+        mfxU32 r = (mfxU32)rand() & ((1u << mag) - 1);
+
+        switch (f.type)
+        {
+        case FIELD_BITS:
+            f.value = ((mfxU32)rand() * 2654435761u) & bits_data[f.nbits];
+            writer.PutBits((mfxU32)f.value, f.nbits);
+            break;
+        case FIELD_UE:
+            f.value = r;
+            writer.PutUE(r);
+            break;
+        case FIELD_SE:
+            f.value = (mfxI32)(r >> 1) * ((rand() % 2) ? 1 : -1);
+            writer.PutSE((mfxI32)f.value);
+            break;
+        default:
+            f.value = rand() & 1;
+            writer.PutBits((mfxU32)f.value, 1);
+            break;
+        }
+    }
+
+    mfxU32 nSize = 0;
+    std::vector<mfxU32> &buf = writer.Finish(&nSize);
+    CReferenceBitstream ref, bs;
+    ref.Reset((mfxU8*)&buf[0], nSize);
+    bs.Reset((mfxU8*)&buf[0], nSize);
+
+    mfxU32 nMismatches = 0;
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        const sField &f = fields[i];
+        mfxI64 a, b;
+        switch (f.type)
+        {
+        case FIELD_BITS: a = ref.RefGetBits(f.nbits);        b = bs.GetBits(f.nbits);        break;
+        case FIELD_UE:   a = ref.RefGetVLCElement(false);   b = bs.GetVLCElement(false);   break;
+        case FIELD_SE:   a = ref.RefGetVLCElement(true);    b = bs.GetVLCElement(true);    break;
+        default:         a = ref.RefGetBits(1);             b = bs.Get1Bit();              break;
+        }
+        if (a != f.value || b != f.value || !ref.SamePosition(bs))
+        {
+            if (!nMismatches)
+                printf("mismatch at field %u: written %lld, reference %lld, new %lld\n", (mfxU32)i, (long long)f.value, (long long)a, (long long)b);
+            nMismatches++;
+        }
+    }
+    printf("%u mismatches in %u fields\n", nMismatches, (mfxU32)fields.size());
+    return nMismatches ? 1 : 0;
+}
+
+// the element mix of a slice header: short ue(v), se(v) QP deltas and small fixed fields
+static void TimeFields()
+{
+    CBitWriter writer;
+    std::vector<int> types(4000000);
+
+    srand(2);
+    for (size_t i = 0; i < types.size(); i++)
+    {
+        types[i] = rand() % 3;
+        if (FIELD_BITS == types[i])
+            writer.PutBits(rand() & 15, 4);
+        else if (FIELD_UE == types[i])
+            writer.PutUE(rand() % 20);
+        else
+            writer.PutSE(rand() % 52 - 26);
+    }
+
+    mfxU32 nSize = 0;
+    std::vector<mfxU32> &buf = writer.Finish(&nSize);
+    CReferenceBitstream bs;
+    mfxI64 sum = 0;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < 5; r++)
+    {
+        bs.Reset((mfxU8*)&buf[0], nSize);
+        for (size_t i = 0; i < types.size(); i++)
+            sum += (FIELD_BITS == types[i]) ? bs.RefGetBits(4) : bs.RefGetVLCElement(FIELD_SE == types[i]);
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < 5; r++)
+    {
+        bs.Reset((mfxU8*)&buf[0], nSize);
+        for (size_t i = 0; i < types.size(); i++)
+            sum -= (FIELD_BITS == types[i]) ? bs.GetBits(4) : bs.GetVLCElement(FIELD_SE == types[i]);
+    }
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+    printf("5 x %u header fields: reference %.1f ms, new %.1f ms%s\n", (mfxU32)types.size(),
+        Ms(t1 - t0), Ms(t2 - t1), sum ? " (sums differ)" : "");
+}
+
+static int TimeSplitter(const char *strFileName)
+{
+    FILE *f = fopen(strFileName, "rb");
+    if (!f)
+    {
+        printf("error: can't open %s\n", strFileName);
+        return 1;
+    }
+    std::vector<mfxU8> data;
+    mfxU8 chunk[65536];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), f)) > 0;)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(f);
+
+    for (int r = 0; r < 3; r++)
+    {
+        mfxBitstream bs;
+        MSDK_ZERO_MEMORY(bs);
+        bs.Data = &data[0];
+        bs.DataLength = bs.MaxLength = (mfxU32)data.size();
+
+        AVC_Spl splitter;
+        FrameSplitterInfo *pFrame = NULL;
+        mfxU32 nFrames = 0, nSlices = 0;
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        while (MFX_ERR_NONE == splitter.GetFrame(bs.DataLength ? &bs : NULL, &pFrame) && pFrame)
+        {
+            nFrames++;
+            nSlices += pFrame->SliceNum;
+            splitter.ResetCurrentState();
+        }
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+        printf("%s: %u frames, %u slices split in %.1f ms\n", strFileName, nFrames, nSlices, Ms(t1 - t0));
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int res = CheckFields();
+    TimeFields();
+    if (argc > 1)
+        res |= TimeSplitter(argv[1]);
+    return res;
+}
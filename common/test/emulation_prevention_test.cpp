@@ -0,0 +1,110 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+// Standalone check of RemoveEmulationPrevention against the plain byte loop it replaced,
+// on random buffers of mixed zero density, followed by a timing of both on slice-like data.
+// Build it with the Media SDK headers, once more with -U__SSE2__ for the portable block test:
+//   g++ -O2 -I common/include -I <msdk>/include common/test/emulation_prevention_test.cpp common/src/emulation_prevention.cpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include "emulation_prevention.h"
+
+// the removal of the former H264SourcePointer_, a byte at a time
+static mfxU32 RefRemove(mfxU8 *pDst, const mfxU8 *pSrc, mfxU32 nSize)
+{
+    mfxU32 nZeros = 0, n = 0;
+    for (mfxU32 i = 0; i < nSize; i++)
+    {
+        if (nZeros >= 2 && 3 == pSrc[i])
+        {
+            nZeros = 0;
+            continue;
+        }
+        pDst[n++] = pSrc[i];
+        nZeros = pSrc[i] ? 0 : nZeros + 1;
+    }
+    return n;
+}
+
+static mfxU8 RandomByte(int mode)
+{
+    switch (mode)
+    {
+    case 0:  return (mfxU8)rand();                                       // any byte
+    case 1:  return (rand() % 4) ? 0 : (mfxU8)(rand() % 4);              // mostly zeros
+    case 2:  return (rand() % 8) ? (mfxU8)(1 + rand() % 255) : (mfxU8)(rand() % 4); // slice data
+    default: return (rand() % 3) ? 0 : 3;                                // escapes only
+    }
+}
+
+int main()
+{
+    srand(7);
+    mfxU32 nMismatches = 0;
+
+    for (int it = 0; it < 200000; it++)
+    {
+        mfxU32 nSize = rand() % 200;
+        int mode = rand() % 4;
+        std::vector<mfxU8> src(nSize + 1), a(nSize + 1, 0xAA), b(nSize + 1, 0xAA);
+        for (mfxU32 i = 0; i < nSize; i++)
+            src[i] = RandomByte(mode);
+
+        mfxU32 na = RefRemove(&a[0], &src[0], nSize);
+        mfxU32 nb = RemoveEmulationPrevention(&b[0], &src[0], nSize);
+        if (na != nb || memcmp(&a[0], &b[0], na))
+        {
+            if (!nMismatches)
+                printf("mismatch at iteration %d, %u bytes: %u vs %u\n", it, nSize, na, nb);
+            nMismatches++;
+        }
+    }
+    printf("%u mismatches in 200000 buffers\n", nMismatches);
+
+    // 8 MB of mostly nonzero bytes with an escape every 997 bytes
+    std::vector<mfxU8> big(8 << 20), dst(big.size());
+    for (size_t i = 0; i < big.size(); i++)
+        big[i] = (rand() % 64) ? (mfxU8)(1 + rand() % 255) : 0;
+    for (size_t i = 0; i + 2 < big.size(); i += 997)
+    {
+        big[i] = 0;
+        big[i + 1] = 0;
+        big[i + 2] = 3;
+    }
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point t0 = clock::now();
+    for (int r = 0; r < 10; r++)
+        RefRemove(&dst[0], &big[0], (mfxU32)big.size());
+    clock::time_point t1 = clock::now();
+    for (int r = 0; r < 10; r++)
+        RemoveEmulationPrevention(&dst[0], &big[0], (mfxU32)big.size());
+    clock::time_point t2 = clock::now();
+
+    printf("10 x 8 MB: byte loop %.1f ms, RemoveEmulationPrevention %.1f ms\n",
+        std::chrono::duration<double, std::milli>(t1 - t0).count(),
+        std::chrono::duration<double, std::milli>(t2 - t1).count());
+
+    return nMismatches ? 1 : 0;
+}
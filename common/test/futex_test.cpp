@@ -0,0 +1,154 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+// Standalone microbenchmark of the decode -> deliver handoff: two threads pass a token back and
+// forth, through MSDKFutexSemaphore/MSDKFutexEvent, through a mutex + condition variable pair and,
+// on Windows, through the MSDKSemaphore/MSDKEvent kernel objects. Reported are handoffs per second
+// and the latency from Post/Signal to the return of Wait on the other side.
+// Build it with the Media SDK headers, on Linux:
+//   g++ -O2 -pthread -I common/include -I <msdk>/include common/test/futex_test.cpp common/src/vm/futex.cpp
+// on Windows add common/src/vm/thread_windows.cpp and link Synchronization.lib.
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include "vm/thread_defs.h"
+
+#define MSDK_HANDOFFS 200000
+
+typedef std::chrono::steady_clock msdk_clock;
+
+static mfxU64 NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(msdk_clock::now().time_since_epoch()).count();
+}
+
+// the semaphore a pthread port would have, a system call for every post and wait
+class CCondVarSemaphore
+{
+public:
+    CCondVarSemaphore(mfxStatus &sts, mfxU32 count) : m_count(count) { sts = MFX_ERR_NONE; }
+
+    mfxStatus Post()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_count++;
+        m_cond.notify_one();
+        return MFX_ERR_NONE;
+    }
+
+    mfxStatus Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_count)
+            m_cond.wait(lock);
+        m_count--;
+        return MFX_ERR_NONE;
+    }
+
+private:
+    std::mutex              m_mutex;
+    std::condition_variable m_cond;
+    mfxU32                  m_count;
+};
+
+// semaphores and auto reset events have the same post / wait shape
+template <class T> struct sSignal
+{
+    static void Post(T &s) { s.Post(); }
+};
+template <> struct sSignal<MSDKFutexEvent>
+{
+    static void Post(MSDKFutexEvent &e) { e.Signal(); }
+};
+
+template <class T> T* Create(mfxStatus &sts) { return new T(sts, 0); }
+template <> MSDKFutexEvent* Create<MSDKFutexEvent>(mfxStatus &sts) { return new MSDKFutexEvent(sts, false, false); }
+
+#if defined(_WIN32) || defined(_WIN64)
+template <> struct sSignal<MSDKEvent>
+{
+    static void Post(MSDKEvent &e) { e.Signal(); }
+};
+template <> MSDKEvent* Create<MSDKEvent>(mfxStatus &sts) { return new MSDKEvent(sts, false, false); }
+#endif
+
+template <class T>
+static void Run(const char *name)
+{
+    mfxStatus sts = MFX_ERR_NONE;
+    T *pToDeliver = Create<T>(sts);
+    T *pToDecode = Create<T>(sts);
+    if (MFX_ERR_NONE != sts)
+    {
+        printf("%s: creation failed\n", name);
+        return;
+    }
+
+    std::atomic<mfxU64> postNs(0);
+    std::vector<mfxU64> latency(MSDK_HANDOFFS);
+
+    // the deliver side measures every wake up, then hands the token back
+    std::thread deliver([&]()
+    {
+        for (mfxU32 i = 0; i < MSDK_HANDOFFS; i++)
+        {
+            pToDeliver->Wait();
+            latency[i] = NowNs() - postNs.load(std::memory_order_acquire);
+            sSignal<T>::Post(*pToDecode);
+        }
+    });
+
+    msdk_clock::time_point t0 = msdk_clock::now();
+    for (mfxU32 i = 0; i < MSDK_HANDOFFS; i++)
+    {
+        postNs.store(NowNs(), std::memory_order_release);
+        sSignal<T>::Post(*pToDeliver);
+        pToDecode->Wait();
+    }
+    msdk_clock::time_point t1 = msdk_clock::now();
+    deliver.join();
+
+    std::sort(latency.begin(), latency.end());
+    double seconds = std::chrono::duration<double>(t1 - t0).count();
+    printf("%-20s %8.0f handoffs/s, wake latency p50 %.2f us, p99 %.2f us, max %.2f us\n", name,
+        2 * MSDK_HANDOFFS / seconds, latency[MSDK_HANDOFFS / 2] / 1000.0,
+        latency[MSDK_HANDOFFS * 99 / 100] / 1000.0, latency.back() / 1000.0);
+
+    delete pToDeliver;
+    delete pToDecode;
+}
+
+int main()
+{
+    printf("%u CPUs, %u round trips each\n", std::thread::hardware_concurrency(), MSDK_HANDOFFS);
+    Run<CCondVarSemaphore>("mutex + condvar");
+    Run<MSDKFutexSemaphore>("MSDKFutexSemaphore");
+    Run<MSDKFutexEvent>("MSDKFutexEvent");
+#if defined(_WIN32) || defined(_WIN64)
+    Run<MSDKSemaphore>("MSDKSemaphore");
+    Run<MSDKEvent>("MSDKEvent");
+#endif
+    return 0;
+}
@@ -0,0 +1,99 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+// Standalone measurement of what surface placement costs: NV12 surfaces are first touched on
+// one NUMA node, and a thread bound to each node converts I420 frames into them as the encoder
+// input does. Prints the share of surface pages found on the allocating node and the conversion
+// rate for every pair of nodes; a single node machine shows the local rate only.
+// Build it with the Media SDK headers, on Linux:
+//   g++ -O2 -pthread -I common/include -I <msdk>/include common/test/numa_test.cpp common/src/vm/numa.cpp
+//       common/src/vm/numa_linux.cpp
+// on Windows take common/src/vm/numa_windows.cpp instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include "vm/numa_defs.h"
+
+#define MSDK_WIDTH   1920
+#define MSDK_HEIGHT  1080
+#define MSDK_FRAMES  32  // about 100 MB of surfaces, well past the caches
+#define MSDK_PASSES  5
+
+static void ConvertI420ToNV12(mfxU8 *pDst, const mfxU8 *pSrc)
+{
+    const mfxU32 nLuma = MSDK_WIDTH * MSDK_HEIGHT;
+    memcpy(pDst, pSrc, nLuma);
+
+    const mfxU8 *u = pSrc + nLuma;
+    const mfxU8 *v = u + nLuma / 4;
+    mfxU8 *uv = pDst + nLuma;
+    for (mfxU32 i = 0; i < nLuma / 4; i++)
+    {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+int main()
+{
+    const mfxU32 nNodes = msdk_numa_get_node_count();
+    const size_t nFrameSize = MSDK_WIDTH * MSDK_HEIGHT * 3 / 2;
+    printf("%u NUMA nodes, %u frames of %ux%u\n", nNodes, MSDK_FRAMES, MSDK_WIDTH, MSDK_HEIGHT);
+
+    for (mfxU32 nAlloc = 0; nAlloc < nNodes; nAlloc++)
+    {
+        std::vector<mfxU8> surfaces;
+        {
+            // first touch places the pages, as for the pipeline's surfaces
+            MSDKNumaNodeScope scope((mfxI32)nAlloc);
+            surfaces.assign(nFrameSize * MSDK_FRAMES, 0);
+        }
+
+        mfxU32 nLocal = 0, nRemote = 0;
+        msdk_numa_count_pages(&surfaces[0], surfaces.size(), (mfxI32)nAlloc, 1, &nLocal, &nRemote);
+
+        for (mfxU32 nRun = 0; nRun < nNodes; nRun++)
+        {
+            MSDKNumaNodeScope scope((mfxI32)nRun);
+
+            // the source frame stays in the cache, the surfaces are what is measured
+            std::vector<mfxU8> source(nFrameSize);
+            for (size_t i = 0; i < source.size(); i++)
+                source[i] = (mfxU8)rand();
+
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for (mfxU32 pass = 0; pass < MSDK_PASSES; pass++)
+            {
+                for (mfxU32 f = 0; f < MSDK_FRAMES; f++)
+                    ConvertI420ToNV12(&surfaces[f * nFrameSize], &source[0]);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+            printf("surfaces on node %u (%.1f%% of pages there), converted on node %u: %.0f frames/s, %.0f MB/s\n",
+                nAlloc, (nLocal + nRemote) ? 100.0 * nLocal / (nLocal + nRemote) : 0.0, nRun,
+                MSDK_PASSES * MSDK_FRAMES / seconds, MSDK_PASSES * MSDK_FRAMES * nFrameSize / seconds / 1e6);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+// Writes a short H.264 stream of concatenated sequences at different resolutions, for the decoder's
+// frame reuse on resolution changes. Every sequence is an I_PCM IDR frame followed by skipped P
+// frames, so no encoder is needed. The default stream is common/test/resize_stream.264:
+//   g++ -O2 -I <msdk>/include common/test/resize_stream.cpp -o resize_stream
+//   ./resize_stream resize_stream.264
+// Decode it with app_dec and a decode.cfg holding
+//   InputFile: resize_stream.264
+//   CodecType: h264
+//   EncoderMode: 0
+//   MaxWidth: 64
+//   MaxHeight: 64
+// Both resolution changes fit into 64x64, so the output shows two "Frames reused" lines and a
+// final count of "2 kept frames, 0 reallocated". Without MaxWidth/MaxHeight, or with a sequence
+// larger than them, the resets print "Frames reallocated" instead.
+
+#include <stdio.h>
+#include <vector>
+
+#include "mfxdefs.h"
+
+// width, height and frame count of each sequence
+static const mfxU16 MSDK_SEQUENCES[][3] = { { 64, 64, 4 }, { 48, 32, 4 }, { 64, 48, 4 } };
+
+class CBitWriter
+{
+public:
+    void PutBits(mfxU32 nValue, mfxU32 nBits)
+    {
+        while (nBits--)
+        {
+            m_nByte = (mfxU8)((m_nByte << 1) | ((nValue >> nBits) & 1));
+            if (8 == ++m_nBits)
+                Flush();
+        }
+    }
+
+    void PutUE(mfxU32 nValue)
+    {
+        mfxU32 nCode = nValue + 1, nLength = 0;
+        while (nCode >> (nLength + 1))
+            nLength++;
+        PutBits(0, nLength);
+        PutBits(nCode, nLength + 1);
+    }
+
+    void PutSE(mfxI32 nValue)
+    {
+        PutUE(nValue > 0 ? 2 * nValue - 1 : -2 * nValue);
+    }
+
+    void Align()
+    {
+        while (m_nBits)
+            PutBits(0, 1);
+    }
+
+    // rbsp_trailing_bits
+    void Trail()
+    {
+        PutBits(1, 1);
+        Align();
+    }
+
+    std::vector<mfxU8> m_Data;
+
+private:
+    void Flush()
+    {
+        m_Data.push_back(m_nByte);
+        m_nByte = 0;
+        m_nBits = 0;
+    }
+
+    mfxU8 m_nByte = 0;
+    mfxU32 m_nBits = 0;
+};
+
+// start code, NAL header and the payload with emulation prevention bytes
+static void WriteNAL(FILE *f, mfxU8 nRefIdc, mfxU8 nType, const std::vector<mfxU8> &rbsp)
+{
+    std::vector<mfxU8> nal = { 0, 0, 0, 1, (mfxU8)((nRefIdc << 5) | nType) };
+    mfxU32 nZeros = 0;
+    for (mfxU8 b : rbsp)
+    {
+        if (2 == nZeros && b <= 3)
+        {
+            nal.push_back(3);
+            nZeros = 0;
+        }
+        nal.push_back(b);
+        nZeros = b ? 0 : nZeros + 1;
+    }
+    fwrite(&nal[0], 1, nal.size(), f);
+}
+
+static void WriteSequence(FILE *f, mfxU16 nWidth, mfxU16 nHeight, mfxU16 nFrames, mfxU32 nIdrPicId)
+{
+    const mfxU32 nMBs = (nWidth / 16) * (nHeight / 16);
+
+    CBitWriter sps;
+    sps.PutBits(66, 8);                 // profile_idc: baseline
+    sps.PutBits(0x40, 8);               // constraint_set1_flag
+    sps.PutBits(30, 8);                 // level_idc
+    sps.PutUE(0);                       // seq_parameter_set_id
+    sps.PutUE(0);                       // log2_max_frame_num_minus4
+    sps.PutUE(2);                       // pic_order_cnt_type
+    sps.PutUE(1);                       // max_num_ref_frames
+    sps.PutBits(0, 1);                  // gaps_in_frame_num_value_allowed_flag
+    sps.PutUE(nWidth / 16 - 1);
+    sps.PutUE(nHeight / 16 - 1);
+    sps.PutBits(1, 1);                  // frame_mbs_only_flag
+    sps.PutBits(1, 1);                  // direct_8x8_inference_flag
+    sps.PutBits(0, 1);                  // frame_cropping_flag
+    sps.PutBits(0, 1);                  // vui_parameters_present_flag
+    sps.Trail();
+    WriteNAL(f, 3, 7, sps.m_Data);
+
+    CBitWriter pps;
+    pps.PutUE(0);                       // pic_parameter_set_id
+    pps.PutUE(0);                       // seq_parameter_set_id
+    pps.PutBits(0, 1);                  // entropy_coding_mode_flag: CAVLC
+    pps.PutBits(0, 1);                  // bottom_field_pic_order_in_frame_present_flag
+    pps.PutUE(0);                       // num_slice_groups_minus1
+    pps.PutUE(0);                       // num_ref_idx_l0_default_active_minus1
+    pps.PutUE(0);                       // num_ref_idx_l1_default_active_minus1
+    pps.PutBits(0, 3);                  // weighted_pred_flag, weighted_bipred_idc
+    pps.PutSE(0);                       // pic_init_qp_minus26
+    pps.PutSE(0);                       // pic_init_qs_minus26
+    pps.PutSE(0);                       // chroma_qp_index_offset
+    pps.PutBits(1, 1);                  // deblocking_filter_control_present_flag
+    pps.PutBits(0, 2);                  // constrained_intra_pred_flag, redundant_pic_cnt_present_flag
+    pps.Trail();
+    WriteNAL(f, 3, 8, pps.m_Data);
+
+    // IDR frame, every macroblock I_PCM with a gradient
+    CBitWriter idr;
+    idr.PutUE(0);                       // first_mb_in_slice
+    idr.PutUE(7);                       // slice_type: I
+    idr.PutUE(0);                       // pic_parameter_set_id
+    idr.PutBits(0, 4);                  // frame_num
+    idr.PutUE(nIdrPicId);
+    idr.PutBits(0, 2);                  // no_output_of_prior_pics_flag, long_term_reference_flag
+    idr.PutSE(0);                       // slice_qp_delta
+    idr.PutUE(1);                       // disable_deblocking_filter_idc
+    for (mfxU32 mb = 0; mb < nMBs; mb++)
+    {
+        idr.PutUE(25);                  // mb_type: I_PCM
+        idr.Align();
+        for (mfxU32 i = 0; i < 256; i++)
+            idr.PutBits(16 + (mb * 16 + i) % 220, 8);
+        for (mfxU32 i = 0; i < 128; i++)
+            idr.PutBits(128, 8);
+    }
+    idr.Trail();
+    WriteNAL(f, 3, 5, idr.m_Data);
+
+    // P frames, every macroblock skipped
+    for (mfxU16 n = 1; n < nFrames; n++)
+    {
+        CBitWriter p;
+        p.PutUE(0);                     // first_mb_in_slice
+        p.PutUE(5);                     // slice_type: P
+        p.PutUE(0);                     // pic_parameter_set_id
+        p.PutBits(n, 4);                // frame_num
+        p.PutBits(0, 3);                // num_ref_idx_active_override_flag, ref_pic_list_modification_flag_l0,
+                                        // adaptive_ref_pic_marking_mode_flag
+        p.PutSE(0);                     // slice_qp_delta
+        p.PutUE(1);                     // disable_deblocking_filter_idc
+        p.PutUE(nMBs);                  // mb_skip_run
+        p.Trail();
+        WriteNAL(f, 2, 1, p.m_Data);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *strFileName = (argc > 1) ? argv[1] : "resize_stream.264";
+    FILE *f = fopen(strFileName, "wb");
+    if (!f)
+    {
+        printf("can't open %s\n", strFileName);
+        return 1;
+    }
+
+    mfxU32 nSequences = sizeof(MSDK_SEQUENCES) / sizeof(MSDK_SEQUENCES[0]);
+    for (mfxU32 i = 0; i < nSequences; i++)
+    {
+        WriteSequence(f, MSDK_SEQUENCES[i][0], MSDK_SEQUENCES[i][1], MSDK_SEQUENCES[i][2], i);
+        printf("sequence %u: %ux%u, %u frames\n", i, MSDK_SEQUENCES[i][0], MSDK_SEQUENCES[i][1], MSDK_SEQUENCES[i][2]);
+    }
+
+    fclose(f);
+    return 0;
+}
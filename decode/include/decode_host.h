@@ -0,0 +1,146 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#ifndef __DECODE_HOST_H__
+#define __DECODE_HOST_H__
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "pipeline_decode.h"
+#include "blockingconcurrentqueue.h"
+#include "vm/task_pool_defs.h"
+
+struct sChannelStat
+{
+    mfxU32    nFrames;
+    mfxF64    fps;           // over the time the channel was running
+    mfxF64    avgLatencyMs;
+    mfxF64    maxLatencyMs;
+    bool      bRunning;
+    mfxStatus sts;           // status of the last finished run
+    mfxI32    nNumaNode;     // MSDK_NUMA_NODE_ANY if the channel isn't placed
+    mfxF64    remoteTurns;   // share of the worker turns run on a CPU of another node
+    mfxF64    remotePages;   // share of the sampled surface pages on another node
+};
+
+/** \brief Decodes many streams on a fixed pool of worker threads.
+ *
+ * Every channel is a CDecodingPipeline driven step by step. Workers take the
+ * next channel from a shared queue, run a few decoding steps on it and put it
+ * back, so the number of threads doesn't grow with the number of streams.
+ * A channel fed in push mode is skipped while it has no input.
+ * Channels are added and controlled from a single thread.
+ * On a NUMA system every node gets its own workers and queue. A channel is
+ * assigned a node, round robin unless its parameters name one, its memory
+ * is allocated there and only that node's workers decode it.
+ * Without workers of its own, every turn is a task of the process-wide
+ * MSDKTaskPool instead, sharing its threads with the rest of the process.
+ * There a push mode channel without input is parked rather than queued again,
+ * and the next packet or stop request queues its turn.
+ */
+class CDecodingHost
+{
+public:
+    CDecodingHost();
+    virtual ~CDecodingHost();
+
+    // must be called before channels are added, 0 workers runs the channels on the task pool
+    mfxStatus Init(mfxU32 nWorkers);
+    void      Close();
+
+    // creates and initializes a pipeline, the channel stays stopped until StartChannel;
+    // a push mode channel is initialized by its first StartChannel instead, since
+    // reading the stream header waits for the packets submitted in between
+    mfxStatus AddChannel(sInputParams *pParams, mfxU32 *pChannelId);
+    // e.g. to submit packets to a push mode channel
+    CDecodingPipeline* GetPipeline(mfxU32 nChannelId);
+
+    mfxStatus StartChannel(mfxU32 nChannelId);
+    // returns once no worker uses the channel any more
+    mfxStatus StopChannel(mfxU32 nChannelId);
+
+    // returns true once no channel is running, false on timeout
+    bool      WaitAll(mfxU32 nTimeoutMs);
+
+    mfxStatus GetChannelStat(mfxU32 nChannelId, sChannelStat *pStat);
+    void      PrintStatistics();
+
+protected:
+    enum eChannelState
+    {
+        CHANNEL_STOPPED,
+        CHANNEL_RUNNING,
+        CHANNEL_FINISHED, // end of stream reached, can't be restarted
+    };
+
+    struct sChannel
+    {
+        sInputParams       params; // kept for ResetDecoder
+        bool               bInited;
+        eChannelState      state;
+        std::atomic<bool>  bStopRequest;
+        std::atomic<bool>  bParked;  // pool mode: no turn queued until input or a stop request arrives
+        mfxStatus          sts;
+        msdk_tick          startTick;
+        msdk_tick          runTicks; // accumulated over finished runs
+        mfxU32             nQueue;   // index of the node's queue in m_ReadyQueues
+        std::atomic<mfxU32> nTurns;
+        std::atomic<mfxU32> nRemoteTurns;
+        std::atomic<mfxU32> nRemotePagesPermille; // sampled by the worker, the pipeline is only used from there
+        // last, so that the input notify of a closing pipeline still finds the rest of the channel
+        std::unique_ptr<CDecodingPipeline> pPipeline;
+    };
+
+    typedef moodycamel::BlockingConcurrentQueue<sChannel*> ChannelQueue;
+
+    void WorkerLoop(mfxU32 nQueue);
+    // runs a few decoding steps on a ready channel, false once it's done
+    bool RunTurn(sChannel *pChannel);
+    // a turn as a task pool task, queues the next one itself
+    void PoolTurn(sChannel *pChannel);
+    void Enqueue(sChannel *pChannel);
+    // queues the turn of a parked channel, from any thread
+    void Wake(sChannel *pChannel);
+    // called by the worker owning the channel when its decoding loop is over
+    void FinishChannel(sChannel *pChannel);
+
+    std::vector<std::unique_ptr<sChannel> >       m_Channels;
+    std::vector<std::unique_ptr<ChannelQueue> >   m_ReadyQueues; // one per NUMA node in use
+    mfxU32                   m_nNodes; // nodes channels are spread over, 1 without NUMA placement
+    std::vector<std::thread> m_Workers;
+    std::unique_ptr<MSDKTaskGroup> m_pPoolTurns; // turns queued on the task pool
+    bool                     m_bInited;
+    std::atomic<bool>        m_bStop;
+    std::atomic<mfxU32>      m_nRunning;
+    msdk_tick                m_startTick;
+
+    // guards channel state changes, signalled when a channel leaves CHANNEL_RUNNING
+    std::mutex               m_mutex;
+    std::condition_variable  m_stateChanged;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CDecodingHost);
+};
+
+#endif // __DECODE_HOST_H__
@@ -47,6 +47,10 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include "plugin_loader.h"
 #include "general_allocator.h"
+#include "push_bitstream_reader.h"
+#include "ring_bitstream_reader.h"
+#include "ts_bitstream_reader.h"
+#include "stream_index.h"
 
 #ifndef MFX_VERSION
 #error MFX_VERSION not defined
@@ -117,6 +121,18 @@ struct sInputParams
 #if (MFX_VERSION >= 1025)
     bool    bErrorReport;
 #endif
+    bool    bPushMode; // bitstream is submitted through SubmitPacket instead of read from strSrcFile
+    bool    bRingBuffer; // input file is read through a mirrored ring buffer, without memmove on refill
+    bool    bSysMemArena; // system memory frames are carved from huge page slabs kept across resets
+    mfxI32  nNumaNode; // NUMA node for the pipeline's memory and threads, MSDK_NUMA_NODE_ANY for no placement
+    bool    bKeyFramesOnly; // decode only intra (AVC) or IRAP (HEVC) access units, e.g. for thumbnails
+    bool    bTransportStream; // input file is MPEG-2 TS, the stream of videoType is demuxed from it
+    mfxU16  nTsPid; // PID of the demuxed stream, 0 for the first one of videoType in the PMT
+    mfxU32  nStartFrame; // decoding starts at the nearest random access point before this frame, found via the stream index
+    mfxU32  nChannels; // number of streams decoded by CDecodingHost, 0 to run a single pipeline
+    mfxU32  nWorkers; // CDecodingHost worker threads, 0 for one per logical CPU
+    mfxU16  nMaxWidth; // frames are allocated for this size, a new stream that fits is decoded without reallocation
+    mfxU16  nMaxHeight;
 
     mfxI32  monitorType;
 #if defined(LIBVA_SUPPORT)
@@ -130,6 +146,7 @@ struct sInputParams
     sInputParams()
     {
         MSDK_ZERO_MEMORY(*this);
+        nNumaNode = MSDK_NUMA_NODE_ANY;
     }
 };
 
@@ -176,14 +193,40 @@ public:
 
     virtual mfxStatus Init(sInputParams *pParams);
     virtual mfxStatus RunDecoding();
+    // RunDecoding split for external schedulers: BeginDecoding once,
+    // RunDecodingStep until it returns false, then EndDecoding for the final status;
+    // bStopped tells EndDecoding the steps were stopped before the end of stream
+    virtual mfxStatus BeginDecoding();
+    virtual bool      RunDecodingStep();
+    virtual mfxStatus EndDecoding(bool bStopped = false);
+    // false if the next step would wait for pushed input
+    bool IsStepReady();
     virtual void Close();
     virtual mfxStatus ResetDecoder(sInputParams *pParams);
     virtual mfxStatus ResetDevice();
 
     void SetMultiView();
     void SetExtBuffersFlag()       { m_bIsExtBuffers = true; }
+    // no per-frame and summary console output, for hosts running many pipelines
+    void SetSilentMode()           { m_bSilent = true; }
+
+    // switches input to push mode, must be called before Init
+    mfxStatus SetPushMode(mfxU32 nPoolSize, mfxU32 nBufferSize);
+    // feeds input packet in push mode, blocks while all pool buffers are queued
+    mfxStatus SubmitPacket(const mfxU8 *pData, mfxU32 nSize, mfxU64 nTimeStamp, mfxU16 nFlags);
+    // releases a producer blocked in SubmitPacket, decoding then drains as on end of stream
+    void StopPushMode();
+    // called from the producer's thread whenever IsStepReady may have turned true
+    void SetInputNotify(const std::function<void()> &notify);
     virtual void PrintInfo();
     mfxU64 GetTotalBytesProcessed() { return totalBytesProcessed + m_mfxBS.DataOffset; }
+    mfxU32 GetOutputCount()         { return m_output_count; }
+    // decode submission to sync latency over all synced frames
+    void GetLatency(mfxF64 *pAvgMs, mfxF64 *pMaxMs);
+    mfxI32 GetNumaNode()            { return m_nNumaNode; }
+    // share of the sampled surface pages which are not on the pipeline's node,
+    // must be called from the thread running the pipeline
+    mfxF64 GetRemotePageRatio();
 
 #if (MFX_VERSION >= 1025)
     inline void PrintDecodeErrorReport(mfxExtDecodeErrorReport *pDecodeErrorReport)
@@ -228,6 +271,9 @@ protected: // functions
     virtual mfxStatus CreateHWDevice();
     virtual mfxStatus AllocFrames();
     virtual void DeleteFrames();
+    virtual mfxStatus QueryDecoderParams();
+    virtual bool CanReuseFrames();
+    virtual mfxStatus ReuseFrames();
     virtual void DeleteAllocator();
 
     /** \brief Performs SyncOperation on the current output surface with the specified timeout.
@@ -248,6 +294,10 @@ protected: // functions
 protected: // variables
     CSmplYUVWriter          m_FileWriter;
     std::unique_ptr<CSmplBitstreamReader>  m_FileReader;
+    CRingBitstreamReader*   m_pRingReader; // m_FileReader in ring buffer mode, NULL otherwise
+    CTSBitstreamReader*     m_pTSReader; // m_FileReader for transport stream input, NULL otherwise
+    CPushBitstreamReader*   m_pPushReader; // m_FileReader in push mode, NULL otherwise
+    CStreamIndex            m_StreamIndex; // random access points of the input file, loaded on seek only
     mfxBitstream            m_mfxBS; // contains encoded data
     mfxU64 totalBytesProcessed;
 
@@ -274,18 +324,29 @@ protected: // variables
     MemType                 m_memType;      // memory type of surfaces to use
     bool                    m_bExternalAlloc; // use memory allocator as external for Media SDK
     bool                    m_bDecOutSysmem; // use system memory between Decoder and VPP, if false - video memory
+    bool                    m_bSysMemArena;
+    mfxI32                  m_nNumaNode;
     mfxFrameAllocResponse   m_mfxResponse; // memory allocation response for decoder
     mfxFrameAllocResponse   m_mfxVppResponse;   // memory allocation response for vpp
+    mfxFrameInfo            m_DecAllocInfo; // frame info the decoder surfaces were allocated with
+    mfxU16                  m_nMaxWidth; // size the decoder surfaces are allocated for, 0 for the stream size
+    mfxU16                  m_nMaxHeight;
+    mfxU32                  m_nFastResets; // resets which kept the allocated frames
+    mfxU32                  m_nFullResets; // resets which reallocated the frames
 
     msdkFrameSurface*       m_pCurrentFreeSurface; // surface detached from free surfaces array
     msdkFrameSurface*       m_pCurrentFreeVppSurface; // VPP surface detached from free VPP surfaces array
     msdkOutputSurface*      m_pCurrentFreeOutputSurface; // surface detached from free output surfaces array
     msdkOutputSurface*      m_pCurrentOutputSurface; // surface detached from output surfaces array
 
-    MSDKSemaphore*          m_pDeliverOutputSemaphore; // to access to DeliverOutput method
-    MSDKEvent*              m_pDeliveredEvent; // to signal when output surfaces will be processed
+    MSDKFutexSemaphore*     m_pDeliverOutputSemaphore; // to access to DeliverOutput method
+    MSDKFutexEvent*         m_pDeliveredEvent; // to signal when output surfaces will be processed
     mfxStatus               m_error; // error returned by DeliverOutput method
     bool                    m_bStopDeliverLoop;
+    // decode -> deliver handoffs, written by the deliver thread only
+    mfxU32                  m_nHandoffs;
+    msdk_tick               m_handoffTicks;
+    msdk_tick               m_maxHandoffTicks;
 
     eWorkMode               m_eWorkMode; // work mode for the pipeline
     bool                    m_bIsMVC; // enables MVC mode (need to support several files as an output)
@@ -308,6 +369,16 @@ protected: // variables
     bool                    m_bVppFullColorRange;
     bool                    m_bSoftRobustFlag;
     std::vector<msdk_tick>  m_vLatency;
+    msdk_tick               m_latencySum;
+    msdk_tick               m_latencyMax;
+    bool                    m_bSilent;
+
+    // state of the decoding loop between BeginDecoding and EndDecoding
+    mfxBitstream*           m_pRunBitstream; // NULL once the decoder is being drained
+    mfxStatus               m_runSts;
+    bool                    m_bRunIncompatibleParams;
+    time_t                  m_runStartTime;
+    MSDKThread*             m_pDeliverThread;
 
     msdk_tick               m_startTick;
     msdk_tick               m_delayTicks;
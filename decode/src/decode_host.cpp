@@ -0,0 +1,406 @@
+/******************************************************************************\
+Copyright (c) 2005-2019, Intel Corporation
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This sample was distributed or derived from the Intel's Media Samples package.
+The original version of this sample may be obtained from https://software.intel.com/en-us/intel-media-server-studio
+or https://software.intel.com/en-us/media-client-solutions-support.
+\**********************************************************************************/
+
+#include "mfx_samples_config.h"
+
+#include <chrono>
+
+#include "decode_host.h"
+
+// interval to re-check the stop flag while waiting for a ready channel, in microseconds
+#define MSDK_HOST_WAIT_INTERVAL_US 100000
+// decoding steps a worker runs on a channel before handing it back to the queue
+#define MSDK_HOST_STEPS_PER_TURN 8
+// turns between two samples of where a channel's surface pages are
+#define MSDK_HOST_NUMA_SAMPLE_TURNS 256
+
+CDecodingHost::CDecodingHost()
+    : m_nNodes(1)
+    , m_bInited(false)
+    , m_bStop(false)
+    , m_nRunning(0)
+    , m_startTick(0)
+{
+}
+
+CDecodingHost::~CDecodingHost()
+{
+    Close();
+}
+
+mfxStatus CDecodingHost::Init(mfxU32 nWorkers)
+{
+    Close();
+
+    m_bStop = false;
+    m_bInited = true;
+    m_startTick = msdk_time_get_tick();
+
+    if (!nWorkers)
+    {
+        // no per-node queues, stealing moves the turns between the pool's workers
+        m_nNodes = 1;
+        m_pPoolTurns.reset(new MSDKTaskGroup);
+        return MFX_ERR_NONE;
+    }
+
+    // every node needs at least one worker, otherwise all channels share one queue
+    m_nNodes = msdk_numa_get_node_count();
+    if (m_nNodes > nWorkers)
+        m_nNodes = 1;
+
+    m_ReadyQueues.clear();
+    for (mfxU32 i = 0; i < m_nNodes; ++i)
+    {
+        m_ReadyQueues.push_back(std::unique_ptr<ChannelQueue>(new ChannelQueue));
+    }
+
+    for (mfxU32 i = 0; i < nWorkers; ++i)
+    {
+        m_Workers.push_back(std::thread(&CDecodingHost::WorkerLoop, this, i % m_nNodes));
+    }
+
+    return MFX_ERR_NONE;
+}
+
+void CDecodingHost::Close()
+{
+    for (mfxU32 i = 0; i < m_Channels.size(); ++i)
+    {
+        StopChannel(i);
+    }
+
+    m_bStop = true;
+    for (std::vector<std::thread>::iterator it = m_Workers.begin(); it != m_Workers.end(); ++it)
+    {
+        if (it->joinable())
+            it->join();
+    }
+    m_Workers.clear();
+
+    // stopped channels queue no more turns
+    if (m_pPoolTurns)
+        m_pPoolTurns->Wait();
+
+    // closing a push pipeline fires its input notify, which must not wake a parked channel now
+    for (mfxU32 i = 0; i < m_Channels.size(); ++i)
+    {
+        m_Channels[i]->bParked = false;
+    }
+    m_Channels.clear();
+
+    m_pPoolTurns.reset();
+    m_bInited = false;
+    m_ReadyQueues.clear();
+}
+
+mfxStatus CDecodingHost::AddChannel(sInputParams *pParams, mfxU32 *pChannelId)
+{
+    MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_POINTER(pChannelId, MFX_ERR_NULL_PTR);
+
+    std::unique_ptr<sChannel> pChannel(new sChannel);
+    pChannel->pPipeline.reset(new CDecodingPipeline);
+    pChannel->params = *pParams;
+    pChannel->bInited = false;
+    pChannel->state = CHANNEL_STOPPED;
+    pChannel->bStopRequest = false;
+    pChannel->bParked = false;
+    pChannel->sts = MFX_ERR_NONE;
+    pChannel->startTick = 0;
+    pChannel->runTicks = 0;
+    pChannel->nTurns = 0;
+    pChannel->nRemoteTurns = 0;
+    pChannel->nRemotePagesPermille = 0;
+
+    if (m_nNodes > 1)
+    {
+        if (MSDK_NUMA_NODE_ANY == pChannel->params.nNumaNode)
+            pChannel->params.nNumaNode = (mfxI32)(m_Channels.size() % m_nNodes);
+        else
+            pChannel->params.nNumaNode %= m_nNodes;
+    }
+    pChannel->nQueue = (m_nNodes > 1) ? (mfxU32)pChannel->params.nNumaNode : 0;
+
+    mfxStatus sts = MFX_ERR_NONE;
+    pChannel->pPipeline->SetSilentMode();
+    if (pChannel->params.bIsMVC)
+        pChannel->pPipeline->SetMultiView();
+    if (pChannel->params.bPushMode)
+    {
+        // same pool as sample_decode's push mode
+        sts = pChannel->pPipeline->SetPushMode(16, 1024 * 1024);
+        MSDK_CHECK_STATUS(sts, "Pipeline.SetPushMode failed");
+        if (m_pPoolTurns)
+        {
+            sChannel *pParked = pChannel.get();
+            pChannel->pPipeline->SetInputNotify([this, pParked]() { Wake(pParked); });
+        }
+    }
+
+    if (!pChannel->params.bPushMode)
+    {
+        sts = pChannel->pPipeline->Init(&pChannel->params);
+        MSDK_CHECK_STATUS(sts, "Pipeline.Init failed");
+        pChannel->bInited = true;
+    }
+
+    *pChannelId = (mfxU32)m_Channels.size();
+    m_Channels.push_back(std::move(pChannel));
+
+    return MFX_ERR_NONE;
+}
+
+CDecodingPipeline* CDecodingHost::GetPipeline(mfxU32 nChannelId)
+{
+    return (nChannelId < m_Channels.size()) ? m_Channels[nChannelId]->pPipeline.get() : NULL;
+}
+
+mfxStatus CDecodingHost::StartChannel(mfxU32 nChannelId)
+{
+    MSDK_CHECK_ERROR(nChannelId < m_Channels.size(), false, MFX_ERR_NOT_FOUND);
+    MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
+
+    sChannel *pChannel = m_Channels[nChannelId].get();
+
+    if (!pChannel->bInited)
+    {
+        // outside the lock, the header is read from packets which may still be on their way
+        mfxStatus sts = pChannel->pPipeline->Init(&pChannel->params);
+        MSDK_CHECK_STATUS(sts, "Pipeline.Init failed");
+        pChannel->bInited = true;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (CHANNEL_RUNNING == pChannel->state)
+        return MFX_ERR_NONE;
+    if (CHANNEL_FINISHED == pChannel->state)
+        return MFX_ERR_UNDEFINED_BEHAVIOR;
+
+    mfxStatus sts = pChannel->pPipeline->BeginDecoding();
+    MSDK_CHECK_STATUS(sts, "BeginDecoding failed");
+
+    pChannel->bStopRequest = false;
+    pChannel->state = CHANNEL_RUNNING;
+    pChannel->startTick = msdk_time_get_tick();
+    ++m_nRunning;
+
+    Enqueue(pChannel);
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CDecodingHost::StopChannel(mfxU32 nChannelId)
+{
+    MSDK_CHECK_ERROR(nChannelId < m_Channels.size(), false, MFX_ERR_NOT_FOUND);
+
+    sChannel *pChannel = m_Channels[nChannelId].get();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (CHANNEL_RUNNING != pChannel->state)
+        return MFX_ERR_NONE;
+
+    // channel is either queued, parked or being decoded, its worker finishes it at the end of the turn
+    pChannel->bStopRequest = true;
+    Wake(pChannel);
+    m_stateChanged.wait(lock, [pChannel]() { return CHANNEL_RUNNING != pChannel->state; });
+
+    return pChannel->sts;
+}
+
+bool CDecodingHost::WaitAll(mfxU32 nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_stateChanged.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), [this]() { return 0 == m_nRunning; });
+}
+
+void CDecodingHost::WorkerLoop(mfxU32 nQueue)
+{
+    mfxU32 nIdle = 0;
+    ChannelQueue &queue = *m_ReadyQueues[nQueue];
+
+    // the queue index is the node when channels are spread over nodes
+    if (m_nNodes > 1)
+        msdk_numa_bind_thread((mfxI32)nQueue);
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_WORKER);
+
+    while (!m_bStop)
+    {
+        sChannel *pChannel = NULL;
+        if (!queue.wait_dequeue_timed(pChannel, MSDK_HOST_WAIT_INTERVAL_US))
+            continue;
+
+        CDecodingPipeline *pPipeline = pChannel->pPipeline.get();
+
+        if (!pChannel->bStopRequest && !pPipeline->IsStepReady())
+        {
+            // nothing to decode yet, let the other channels go first
+            queue.enqueue(pChannel);
+            if (++nIdle >= m_nRunning)
+            {
+                MSDK_SLEEP(1);
+                nIdle = 0;
+            }
+            continue;
+        }
+        nIdle = 0;
+
+        if (RunTurn(pChannel))
+            queue.enqueue(pChannel);
+        else
+            FinishChannel(pChannel);
+    }
+}
+
+bool CDecodingHost::RunTurn(sChannel *pChannel)
+{
+    CDecodingPipeline *pPipeline = pChannel->pPipeline.get();
+
+    // a turn counts as remote if the worker got moved off the channel's node
+    mfxI32 nNode = pPipeline->GetNumaNode();
+    if (MSDK_NUMA_NODE_ANY != nNode)
+    {
+        mfxU32 nTurns = ++pChannel->nTurns;
+        if (msdk_numa_get_current_node() != nNode)
+            ++pChannel->nRemoteTurns;
+        if (1 == nTurns % MSDK_HOST_NUMA_SAMPLE_TURNS)
+            pChannel->nRemotePagesPermille = (mfxU32)(pPipeline->GetRemotePageRatio() * 1000);
+    }
+
+    bool bRunning = !pChannel->bStopRequest;
+    for (mfxU32 i = 0; i < MSDK_HOST_STEPS_PER_TURN && bRunning && !pChannel->bStopRequest; ++i)
+    {
+        bRunning = pPipeline->RunDecodingStep();
+        if (!pPipeline->IsStepReady())
+            break;
+    }
+
+    return bRunning && !pChannel->bStopRequest;
+}
+
+void CDecodingHost::PoolTurn(sChannel *pChannel)
+{
+    if (!pChannel->bStopRequest && !pChannel->pPipeline->IsStepReady())
+    {
+        // nothing to decode, leave the pool's workers to others until Wake
+        pChannel->bParked = true;
+        // input or a stop may have come in before the flag was set
+        if ((pChannel->bStopRequest || pChannel->pPipeline->IsStepReady()) && pChannel->bParked.exchange(false))
+            Enqueue(pChannel);
+        return;
+    }
+
+    if (RunTurn(pChannel))
+        Enqueue(pChannel);
+    else
+        FinishChannel(pChannel);
+}
+
+void CDecodingHost::Enqueue(sChannel *pChannel)
+{
+    if (m_pPoolTurns)
+        m_pPoolTurns->Run([this, pChannel]() { PoolTurn(pChannel); });
+    else
+        m_ReadyQueues[pChannel->nQueue]->enqueue(pChannel);
+}
+
+void CDecodingHost::Wake(sChannel *pChannel)
+{
+    // only one caller takes the flag, so a parked channel is queued once
+    if (pChannel->bParked.exchange(false))
+        Enqueue(pChannel);
+}
+
+void CDecodingHost::FinishChannel(sChannel *pChannel)
+{
+    CDecodingPipeline *pPipeline = pChannel->pPipeline.get();
+    bool bStopRequest = pChannel->bStopRequest;
+
+    mfxStatus sts = pPipeline->EndDecoding(bStopRequest);
+
+    if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts && !bStopRequest)
+    {
+        // stream parameters changed, continue with a reset decoder as sample_decode does
+        sts = pPipeline->ResetDecoder(&pChannel->params);
+        if (MFX_ERR_NONE == sts)
+            sts = pPipeline->BeginDecoding();
+        if (MFX_ERR_NONE == sts)
+        {
+            Enqueue(pChannel);
+            return;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    pChannel->sts = sts;
+    pChannel->runTicks += msdk_time_get_tick() - pChannel->startTick;
+    // a stopped channel may be resumed, one which got to the end of stream or failed may not
+    pChannel->state = (bStopRequest && MFX_ERR_NONE == sts) ? CHANNEL_STOPPED : CHANNEL_FINISHED;
+    --m_nRunning;
+    m_stateChanged.notify_all();
+}
+
+mfxStatus CDecodingHost::GetChannelStat(mfxU32 nChannelId, sChannelStat *pStat)
+{
+    MSDK_CHECK_POINTER(pStat, MFX_ERR_NULL_PTR);
+    MSDK_CHECK_ERROR(nChannelId < m_Channels.size(), false, MFX_ERR_NOT_FOUND);
+
+    sChannel *pChannel = m_Channels[nChannelId].get();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    msdk_tick runTicks = pChannel->runTicks;
+    if (CHANNEL_RUNNING == pChannel->state)
+        runTicks += msdk_time_get_tick() - pChannel->startTick;
+
+    pStat->nFrames = pChannel->pPipeline->GetOutputCount();
+    pStat->fps = runTicks ? (mfxF64)pStat->nFrames * msdk_time_get_frequency() / runTicks : 0.0;
+    pChannel->pPipeline->GetLatency(&pStat->avgLatencyMs, &pStat->maxLatencyMs);
+    pStat->bRunning = (CHANNEL_RUNNING == pChannel->state);
+    pStat->sts = pChannel->sts;
+    pStat->nNumaNode = pChannel->pPipeline->GetNumaNode();
+    mfxU32 nTurns = pChannel->nTurns;
+    pStat->remoteTurns = nTurns ? (mfxF64)pChannel->nRemoteTurns / nTurns : 0.0;
+    pStat->remotePages = pChannel->nRemotePagesPermille / 1000.0;
+
+    return MFX_ERR_NONE;
+}
+
+void CDecodingHost::PrintStatistics()
+{
+    mfxU64 nTotalFrames = 0;
+
+    for (mfxU32 i = 0; i < m_Channels.size(); ++i)
+    {
+        sChannelStat stat;
+        GetChannelStat(i, &stat);
+        nTotalFrames += stat.nFrames;
+
+        msdk_printf(MSDK_STRING("Channel %3d: frames %6d, fps %8.2f, latency avg %7.2f ms, max %7.2f ms, %s"),
+            i, stat.nFrames, stat.fps, stat.avgLatencyMs, stat.maxLatencyMs,
+            stat.bRunning ? MSDK_STRING("running") : (stat.sts ? MSDK_STRING("failed") : MSDK_STRING("stopped")));
+        if (MSDK_NUMA_NODE_ANY != stat.nNumaNode)
+            msdk_printf(MSDK_STRING(", node %d, remote turns %5.1f%%, remote pages %5.1f%%"),
+                stat.nNumaNode, stat.remoteTurns * 100, stat.remotePages * 100);
+        msdk_printf(MSDK_STRING("\n"));
+    }
+
+    msdk_tick elapsed = msdk_time_get_tick() - m_startTick;
+    msdk_printf(MSDK_STRING("Total: %d channels, %lld frames, aggregate fps %.2f\n"),
+        (int)m_Channels.size(), (long long)nTotalFrames,
+        elapsed ? (mfxF64)nTotalFrames * msdk_time_get_frequency() / elapsed : 0.0);
+}
@@ -68,6 +68,17 @@ CDecodingPipeline::CDecodingPipeline()
 
     m_pmfxDEC = NULL;
     m_pmfxVPP = NULL;
+    m_pRingReader = NULL;
+    m_pTSReader = NULL;
+    m_pPushReader = NULL;
+    m_pRunBitstream = NULL;
+    m_runSts = MFX_ERR_NONE;
+    m_bRunIncompatibleParams = false;
+    m_runStartTime = 0;
+    m_pDeliverThread = NULL;
+    m_bSilent = false;
+    m_latencySum = 0;
+    m_latencyMax = 0;
     m_impl = 0;
 
     MSDK_ZERO_MEMORY(m_mfxVideoParams);
@@ -78,10 +89,17 @@ CDecodingPipeline::CDecodingPipeline()
     m_memType = SYSTEM_MEMORY;
     m_bExternalAlloc = false;
     m_bDecOutSysmem = false;
+    m_bSysMemArena = false;
+    m_nNumaNode = MSDK_NUMA_NODE_ANY;
     m_bSoftRobustFlag = false;
 
     MSDK_ZERO_MEMORY(m_mfxResponse);
     MSDK_ZERO_MEMORY(m_mfxVppResponse);
+    MSDK_ZERO_MEMORY(m_DecAllocInfo);
+    m_nMaxWidth = 0;
+    m_nMaxHeight = 0;
+    m_nFastResets = 0;
+    m_nFullResets = 0;
 
     m_pCurrentFreeSurface = NULL;
     m_pCurrentFreeVppSurface = NULL;
@@ -92,6 +110,9 @@ CDecodingPipeline::CDecodingPipeline()
     m_pDeliveredEvent = NULL;
     m_error = MFX_ERR_NONE;
     m_bStopDeliverLoop = false;
+    m_nHandoffs = 0;
+    m_handoffTicks = 0;
+    m_maxHandoffTicks = 0;
 
     m_eWorkMode = MODE_PERFORMANCE;
     m_bIsMVC = false;
@@ -169,10 +190,57 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
 
     mfxStatus sts = MFX_ERR_NONE;
 
+    // everything allocated and first touched during Init lands on the pipeline's node
+    m_nNumaNode = pParams->nNumaNode;
+    MSDKNumaNodeScope numaScope(m_nNumaNode);
+
     // prepare input stream file reader
     // for VP8 complete and single frame reader is a requirement
     // create reader that supports completeframe mode for latency oriented scenarios
-    if (pParams->bLowLat || pParams->bCalLat)
+    if (m_pPushReader)
+    {
+        // push reader was created by SetPushMode, packets are expected to be complete frames in latency modes
+        m_bIsCompleteFrame = pParams->bLowLat || pParams->bCalLat;
+        m_bPrintLatency = pParams->bCalLat;
+    }
+    else if (pParams->bTransportStream)
+    {
+        // every PES packet carries one access unit
+        m_pTSReader = new CTSBitstreamReader();
+        m_pTSReader->SelectStream(pParams->videoType, pParams->nTsPid);
+        m_FileReader.reset(m_pTSReader);
+        m_bIsCompleteFrame = true;
+        m_bPrintLatency = pParams->bCalLat;
+    }
+    else if (pParams->bKeyFramesOnly)
+    {
+        // readers drop inter frames before submission, so decoder gets complete key frames only
+        switch (pParams->videoType)
+        {
+        case MFX_CODEC_AVC:
+            {
+                CH264FrameReader *pReader = new CH264FrameReader();
+                pReader->SetKeyFramesOnly(true);
+                m_FileReader.reset(pReader);
+            }
+            break;
+        case MFX_CODEC_HEVC:
+            {
+                CHEVCFrameReader *pReader = new CHEVCFrameReader();
+                pReader->SetKeyFramesOnly(true);
+                m_FileReader.reset(pReader);
+            }
+            break;
+        case MFX_CODEC_JPEG:
+            m_FileReader.reset(new CJPEGFrameReader());
+            break;
+        default:
+            return MFX_ERR_UNSUPPORTED; // key frames mode is supported only for H.264, HEVC and JPEG codecs
+        }
+        m_bIsCompleteFrame = true;
+        m_bPrintLatency = pParams->bCalLat;
+    }
+    else if (pParams->bLowLat || pParams->bCalLat)
     {
         switch (pParams->videoType)
         {
@@ -205,7 +273,15 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
             m_FileReader.reset(new CIVFFrameReader());
             break;
         default:
-            m_FileReader.reset(new CSmplBitstreamReader());
+            if (pParams->bRingBuffer)
+            {
+                m_pRingReader = new CRingBitstreamReader();
+                m_FileReader.reset(m_pRingReader);
+            }
+            else
+            {
+                m_FileReader.reset(new CSmplBitstreamReader());
+            }
             break;
         }
     }
@@ -225,6 +301,9 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
 
 
     m_memType = pParams->memType;
+    m_bSysMemArena = pParams->bSysMemArena;
+    m_nMaxWidth = pParams->nMaxWidth;
+    m_nMaxHeight = pParams->nMaxHeight;
 
     m_nMaxFps = pParams->nMaxFPS;
     m_nFrames = pParams->nFrames ? pParams->nFrames : MFX_INFINITE;
@@ -234,10 +313,34 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
     m_nTimeout = pParams->nTimeout;
     m_bSoftRobustFlag = pParams->bSoftRobustFlag;
 
-    // Initializing file reader
+    // Initializing file reader, push reader is already initialized and may hold submitted packets
     totalBytesProcessed = 0;
-    sts = m_FileReader->Init(pParams->strSrcFile);
-    MSDK_CHECK_STATUS(sts, "m_FileReader->Init failed");
+    if (!m_pPushReader)
+    {
+        sts = m_FileReader->Init(pParams->strSrcFile);
+        MSDK_CHECK_STATUS(sts, "m_FileReader->Init failed");
+    }
+
+    // start frame: the stream is read from the random access point before it, header included
+    if (pParams->nStartFrame && !m_pPushReader)
+    {
+        if (m_pTSReader)
+        {
+            msdk_printf(MSDK_STRING("error: start frame is not supported for transport stream input\n"));
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        sts = m_StreamIndex.LoadOrBuild(pParams->strSrcFile, pParams->videoType);
+        MSDK_CHECK_STATUS(sts, "m_StreamIndex.LoadOrBuild failed");
+
+        mfxU32 nKeyFrame = 0;
+        m_FileReader->SetIndex(&m_StreamIndex);
+        sts = m_FileReader->Seek(pParams->nStartFrame, &nKeyFrame);
+        MSDK_CHECK_STATUS(sts, "m_FileReader->Seek failed");
+
+        msdk_printf(MSDK_STRING("Start frame %u: decoding from random access point at frame %u (%u points, %u frames indexed)\n"),
+            pParams->nStartFrame, nKeyFrame, m_StreamIndex.GetEntryCount(), m_StreamIndex.GetFrameCount());
+    }
 
     mfxInitParam initPar;
     mfxExtThreadsParam threadsPar;
@@ -357,9 +460,17 @@ mfxStatus CDecodingPipeline::Init(sInputParams *pParams)
     // set video type in parameters
     m_mfxVideoParams.mfx.CodecId = pParams->videoType;
 
-    // prepare bit stream
-    sts = InitMfxBitstream(&m_mfxBS, 8 * 1024 * 1024);
-    MSDK_CHECK_STATUS(sts, "InitMfxBitstream failed");
+    // prepare bit stream, in ring buffer mode its memory belongs to the reader
+    if (m_pRingReader)
+    {
+        sts = m_pRingReader->AttachBitstream(&m_mfxBS);
+        MSDK_CHECK_STATUS(sts, "m_pRingReader->AttachBitstream failed");
+    }
+    else
+    {
+        sts = InitMfxBitstream(&m_mfxBS, 8 * 1024 * 1024);
+        MSDK_CHECK_STATUS(sts, "InitMfxBitstream failed");
+    }
 
     if (CheckVersion(&version, MSDK_FEATURE_PLUGIN_API)) {
         /* Here we actually define the following codec initialization scheme:
@@ -515,6 +626,8 @@ void CDecodingPipeline::Close()
 #if D3D_SURFACES_SUPPORT
     m_d3dRender.Close();
 #endif
+    if (m_pRingReader)
+        m_pRingReader->DetachBitstream(&m_mfxBS);
     WipeMfxBitstream(&m_mfxBS);
     MSDK_SAFE_DELETE(m_pmfxDEC);
     MSDK_SAFE_DELETE(m_pmfxVPP);
@@ -533,7 +646,7 @@ void CDecodingPipeline::Close()
     m_mfxSession.Close();
     m_FileWriter.Close();
     if (m_FileReader.get())
-        m_FileReader->Close();
+        m_FileReader->Close(); // aborts pending SubmitPacket calls and waits for them to return
 
     MSDK_SAFE_DELETE_ARRAY(m_VppDoNotUse.AlgList);
 
@@ -1016,21 +1129,8 @@ mfxStatus CDecodingPipeline::AllocFrames()
     MSDK_ZERO_MEMORY(VppRequest[0]);
     MSDK_ZERO_MEMORY(VppRequest[1]);
 
-    sts = m_pmfxDEC->Query(&m_mfxVideoParams, &m_mfxVideoParams);
-    MSDK_IGNORE_MFX_STS(sts, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
-    MSDK_CHECK_STATUS(sts, "m_pmfxDEC->Query failed");
-
-    // Workaround for VP9 codec
-    if (m_mfxVideoParams.mfx.CodecId == MFX_CODEC_VP9 &&
-        (   m_mfxVideoParams.mfx.FrameInfo.FourCC == MFX_FOURCC_P010
-#if (MFX_VERSION >= 1027)
-         || m_mfxVideoParams.mfx.FrameInfo.FourCC == MFX_FOURCC_Y210
-#endif
-        )
-    )
-    {
-        m_mfxVideoParams.mfx.FrameInfo.Shift = 1;
-    }
+    sts = QueryDecoderParams();
+    MSDK_CHECK_STATUS(sts, "QueryDecoderParams failed");
 
     // calculate number of surfaces required for decoder
     sts = m_pmfxDEC->QueryIOSurf(&m_mfxVideoParams, &Request);
@@ -1103,6 +1203,16 @@ mfxStatus CDecodingPipeline::AllocFrames()
         MFX_MEMTYPE_SYSTEM_MEMORY
         : MFX_MEMTYPE_VIDEO_MEMORY_DECODER_TARGET;
 
+    if (m_nMaxWidth && m_nMaxHeight && !m_bVppIsUsed)
+    {
+        // allocate for the largest expected stream, smaller ones are decoded into the same frames
+        Request.Info.Width = MSDK_ALIGN16((std::max)(Request.Info.Width, m_nMaxWidth));
+        Request.Info.Height = (MFX_PICSTRUCT_PROGRESSIVE == Request.Info.PicStruct) ?
+            MSDK_ALIGN16((std::max)(Request.Info.Height, m_nMaxHeight)) :
+            MSDK_ALIGN32((std::max)(Request.Info.Height, m_nMaxHeight));
+    }
+    m_DecAllocInfo = Request.Info;
+
 #ifdef LIBVA_SUPPORT
     if (!m_bVppIsUsed &&
         (m_export_mode != vaapiAllocatorParams::DONOT_EXPORT))
@@ -1183,6 +1293,81 @@ mfxStatus CDecodingPipeline::AllocFrames()
     return MFX_ERR_NONE;
 }
 
+mfxStatus CDecodingPipeline::QueryDecoderParams()
+{
+    mfxStatus sts = m_pmfxDEC->Query(&m_mfxVideoParams, &m_mfxVideoParams);
+    MSDK_IGNORE_MFX_STS(sts, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
+    MSDK_CHECK_STATUS(sts, "m_pmfxDEC->Query failed");
+
+    // Workaround for VP9 codec
+    if (m_mfxVideoParams.mfx.CodecId == MFX_CODEC_VP9 &&
+        (   m_mfxVideoParams.mfx.FrameInfo.FourCC == MFX_FOURCC_P010
+#if (MFX_VERSION >= 1027)
+         || m_mfxVideoParams.mfx.FrameInfo.FourCC == MFX_FOURCC_Y210
+#endif
+        )
+    )
+    {
+        m_mfxVideoParams.mfx.FrameInfo.Shift = 1;
+    }
+
+    return MFX_ERR_NONE;
+}
+
+bool CDecodingPipeline::CanReuseFrames()
+{
+    const mfxFrameInfo& Info = m_mfxVideoParams.mfx.FrameInfo;
+
+    // VPP sizes its frames from the stream, so only the decoder's own frames are kept
+    if (!m_nMaxWidth || !m_nMaxHeight || !m_pSurfaces || m_bVppIsUsed || m_pVppSurfaces)
+        return false;
+
+    if (MFX_ERR_NONE != QueryDecoderParams())
+        return false;
+
+    if (Info.FourCC != m_DecAllocInfo.FourCC ||
+        Info.ChromaFormat != m_DecAllocInfo.ChromaFormat ||
+        Info.Shift != m_DecAllocInfo.Shift ||
+        Info.Width > m_DecAllocInfo.Width ||
+        Info.Height > m_DecAllocInfo.Height)
+        return false;
+
+    mfxFrameAllocRequest Request;
+    MSDK_ZERO_MEMORY(Request);
+
+    mfxStatus sts = m_pmfxDEC->QueryIOSurf(&m_mfxVideoParams, &Request);
+    if (MFX_WRN_PARTIAL_ACCELERATION == sts)
+    {
+        // the decoder would need system memory frames now
+        if (!m_bDecOutSysmem)
+            return false;
+        sts = MFX_ERR_NONE;
+    }
+    if (MFX_ERR_NONE != sts)
+        return false;
+
+    return Request.NumFrameSuggested + m_nMaxFps / 3 <= m_mfxResponse.NumFrameActual;
+}
+
+mfxStatus CDecodingPipeline::ReuseFrames()
+{
+    // the new stream's crops on the allocated frame size
+    mfxFrameInfo Info = m_mfxVideoParams.mfx.FrameInfo;
+    Info.Width = m_DecAllocInfo.Width;
+    Info.Height = m_DecAllocInfo.Height;
+
+    for (mfxU32 i = 0; i < m_SurfacesNumber; i++)
+    {
+        MSDK_MEMCPY_VAR(m_pSurfaces[i].frame.Info, &Info, sizeof(mfxFrameInfo));
+    }
+
+    RecycleBuffers();
+    m_pCurrentFreeSurface = NULL;
+    m_pCurrentFreeVppSurface = NULL;
+
+    return MFX_ERR_NONE;
+}
+
 mfxStatus CDecodingPipeline::CreateAllocator()
 {
     mfxStatus sts = MFX_ERR_NONE;
@@ -1300,6 +1485,15 @@ mfxStatus CDecodingPipeline::CreateAllocator()
         //m_pGeneralAllocator = new SysMemFrameAllocator;
         //MSDK_CHECK_POINTER(m_pGeneralAllocator, MFX_ERR_MEMORY_ALLOC);
 
+        // slabs are touched at allocation, calloc'ed frames only by whichever thread writes them first
+        if (m_bSysMemArena || MSDK_NUMA_NODE_ANY != m_nNumaNode)
+        {
+            SysMemAllocatorParams *pSysMemAllocParams = new SysMemAllocatorParams;
+            MSDK_CHECK_POINTER(pSysMemAllocParams, MFX_ERR_MEMORY_ALLOC);
+            pSysMemAllocParams->bUseArena = true;
+            m_pmfxAllocatorParams = pSysMemAllocParams;
+        }
+
         /* In case of system memory we demonstrate "no external allocator" usage model.
         We don't call SetAllocator, MediaSDK uses internal allocator.
         We use system memory allocator simply as a memory manager for application*/
@@ -1344,6 +1538,62 @@ void CDecodingPipeline::SetMultiView()
     m_bIsMVC = true;
 }
 
+mfxStatus CDecodingPipeline::SetPushMode(mfxU32 nPoolSize, mfxU32 nBufferSize)
+{
+    MSDK_CHECK_ERROR(nPoolSize, 0, MFX_ERR_UNSUPPORTED);
+    MSDK_CHECK_ERROR(nBufferSize, 0, MFX_ERR_UNSUPPORTED);
+
+    m_pPushReader = new CPushBitstreamReader(nPoolSize, nBufferSize);
+    m_FileReader.reset(m_pPushReader);
+
+    mfxStatus sts = m_pPushReader->Init(NULL);
+    MSDK_CHECK_STATUS(sts, "m_pPushReader->Init failed");
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CDecodingPipeline::SubmitPacket(const mfxU8 *pData, mfxU32 nSize, mfxU64 nTimeStamp, mfxU16 nFlags)
+{
+    MSDK_CHECK_POINTER(m_pPushReader, MFX_ERR_NOT_INITIALIZED);
+
+    return m_pPushReader->SubmitPacket(pData, nSize, nTimeStamp, nFlags);
+}
+
+void CDecodingPipeline::StopPushMode()
+{
+    if (m_pPushReader)
+        m_pPushReader->Abort();
+}
+
+void CDecodingPipeline::SetInputNotify(const std::function<void()> &notify)
+{
+    if (m_pPushReader)
+        m_pPushReader->SetPacketNotify(notify);
+}
+
+void CDecodingPipeline::GetLatency(mfxF64 *pAvgMs, mfxF64 *pMaxMs)
+{
+    mfxU32 nSynced = m_synced_count;
+    if (pAvgMs)
+        *pAvgMs = nSynced ? CTimer::ConvertToSeconds((msdk_tick)((mfxF64)m_latencySum / nSynced)) * 1000 : 0.0;
+    if (pMaxMs)
+        *pMaxMs = CTimer::ConvertToSeconds(m_latencyMax) * 1000;
+}
+
+mfxF64 CDecodingPipeline::GetRemotePageRatio()
+{
+    mfxU32 nLocal = 0, nRemote = 0;
+    if (MSDK_NUMA_NODE_ANY == m_nNumaNode || m_bExternalAlloc)
+        return 0.0;
+
+    for (mfxU32 i = 0; m_pSurfaces && i < m_mfxResponse.NumFrameActual; i++)
+        CountSurfacePages(&m_pSurfaces[i].frame, m_nNumaNode, &nLocal, &nRemote);
+    for (mfxU32 i = 0; m_pVppSurfaces && i < m_mfxVppResponse.NumFrameActual; i++)
+        CountSurfacePages(&m_pVppSurfaces[i].frame, m_nNumaNode, &nLocal, &nRemote);
+
+    return (nLocal + nRemote) ? (mfxF64)nRemote / (nLocal + nRemote) : 0.0;
+}
+
 // function for allocating a specific external buffer
 template <typename Buffer>
 mfxStatus CDecodingPipeline::AllocateExtBuffer()
@@ -1425,6 +1675,8 @@ mfxStatus CDecodingPipeline::ResetDecoder(sInputParams *pParams)
 {
     mfxStatus sts = MFX_ERR_NONE;
 
+    MSDKNumaNodeScope numaScope(m_nNumaNode);
+
     // close decoder
     sts = m_pmfxDEC->Close();
     MSDK_IGNORE_MFX_STS(sts, MFX_ERR_NOT_INITIALIZED);
@@ -1438,16 +1690,38 @@ mfxStatus CDecodingPipeline::ResetDecoder(sInputParams *pParams)
         MSDK_CHECK_STATUS(sts, "m_pmfxVPP->Close failed");
     }
 
-    // free allocated frames
-    DeleteFrames();
+    CTimer resetTimer;
+    resetTimer.Start();
 
     // initialize parameters with values from parsed header
     sts = InitMfxParams(pParams);
     MSDK_CHECK_STATUS(sts, "InitMfxParams failed");
 
-    // in case of HW accelerated decode frames must be allocated prior to decoder initialization
-    sts = AllocFrames();
-    MSDK_CHECK_STATUS(sts, "AllocFrames failed");
+    if (CanReuseFrames())
+    {
+        // the new stream fits into the frames allocated for the max resolution
+        sts = ReuseFrames();
+        MSDK_CHECK_STATUS(sts, "ReuseFrames failed");
+
+        m_nFastResets++;
+        msdk_printf(MSDK_STRING("Frames reused for %dx%d in %.2f ms (resets: %u kept frames, %u reallocated)\n"),
+            m_mfxVideoParams.mfx.FrameInfo.CropW, m_mfxVideoParams.mfx.FrameInfo.CropH,
+            resetTimer.GetTime() * 1000, m_nFastResets, m_nFullResets);
+    }
+    else
+    {
+        // free allocated frames
+        DeleteFrames();
+
+        // in case of HW accelerated decode frames must be allocated prior to decoder initialization
+        sts = AllocFrames();
+        MSDK_CHECK_STATUS(sts, "AllocFrames failed");
+
+        // with arena mode the frames come from the slabs of the previous allocation
+        m_nFullResets++;
+        msdk_printf(MSDK_STRING("Frames reallocated in %.2f ms (resets: %u kept frames, %u reallocated)\n"),
+            resetTimer.GetTime() * 1000, m_nFastResets, m_nFullResets);
+    }
 
     // init decoder
     sts = m_pmfxDEC->Init(&m_mfxVideoParams);
@@ -1542,6 +1816,12 @@ mfxStatus CDecodingPipeline::DeliverLoop(void)
         }
         mfxFrameSurface1* frame = &(pCurrentDeliveredSurface->surface->frame);
 
+        // time from the post to the deliver thread picking the frame up
+        msdk_tick handoff = msdk_time_get_tick() - pCurrentDeliveredSurface->posted;
+        m_handoffTicks += handoff;
+        m_maxHandoffTicks = (std::max)(m_maxHandoffTicks, handoff);
+        m_nHandoffs++;
+
         m_error = DeliverOutput(frame);
         ReturnSurfaceToBuffers(pCurrentDeliveredSurface);
 
@@ -1556,6 +1836,10 @@ unsigned int MFX_STDCALL CDecodingPipeline::DeliverThreadFunc(void* ctx)
 {
     CDecodingPipeline* pipeline = (CDecodingPipeline*)ctx;
 
+    if (MSDK_NUMA_NODE_ANY != pipeline->m_nNumaNode)
+        msdk_numa_bind_thread(pipeline->m_nNumaNode);
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_DELIVER);
+
     mfxStatus sts;
     sts = pipeline->DeliverLoop();
 
@@ -1566,6 +1850,9 @@ void CDecodingPipeline::PrintPerFrameStat(bool force)
 {
 #define MY_COUNT 1 // TODO: this will be cmd option
 #define MY_THRESHOLD 10000.0
+    if (m_bSilent)
+        return;
+
     if ((!(m_output_count % MY_COUNT) && (m_eWorkMode != MODE_PERFORMANCE)) || force) {
         double fps, fps_fread, fps_fwrite;
 
@@ -1613,8 +1900,11 @@ mfxStatus CDecodingPipeline::SyncOutputSurface(mfxU32 wait)
     if (MFX_ERR_NONE == sts) {
         // we got completely decoded frame - pushing it to the delivering thread...
         ++m_synced_count;
+        msdk_tick latency = m_timer_overall.Sync() - m_pCurrentOutputSurface->surface->submit;
+        m_latencySum += latency;
+        m_latencyMax = (std::max)(m_latencyMax, latency);
         if (m_bPrintLatency) {
-            m_vLatency.push_back(m_timer_overall.Sync() - m_pCurrentOutputSurface->surface->submit);
+            m_vLatency.push_back(latency);
         }
         else {
             PrintPerFrameStat();
@@ -1632,6 +1922,7 @@ mfxStatus CDecodingPipeline::SyncOutputSurface(mfxU32 wait)
             }
             ReturnSurfaceToBuffers(m_pCurrentOutputSurface);
         } else if (m_eWorkMode == MODE_RENDERING) {
+            m_pCurrentOutputSurface->posted = msdk_time_get_tick();
             m_DeliveredSurfacesPool.AddSurface(m_pCurrentOutputSurface);
             m_pDeliveredEvent->Reset();
             m_pDeliverOutputSemaphore->Post();
@@ -1644,288 +1935,347 @@ mfxStatus CDecodingPipeline::SyncOutputSurface(mfxU32 wait)
 
 mfxStatus CDecodingPipeline::RunDecoding()
 {
-    mfxFrameSurface1*   pOutSurface = NULL;
-    mfxBitstream*       pBitstream = &m_mfxBS;
-    mfxStatus           sts = MFX_ERR_NONE;
-    bool                bErrIncompatibleVideoParams = false;
-    CTimeInterval<>     decodeTimer(m_bIsCompleteFrame);
-    time_t start_time = time(0);
-    MSDKThread * pDeliverThread = NULL;
-#if (MFX_VERSION >= 1025)
-    mfxExtDecodeErrorReport *pDecodeErrorReport = NULL;
-#endif
+    // the decoding loop stays on the node of its memory
+    if (MSDK_NUMA_NODE_ANY != m_nNumaNode)
+        msdk_numa_bind_thread(m_nNumaNode);
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_PIPELINE);
+
+    mfxStatus sts = BeginDecoding();
+    MSDK_CHECK_STATUS(sts, "BeginDecoding failed");
+
+    while (RunDecodingStep())
+    {
+    }
+
+    return EndDecoding();
+}
+
+mfxStatus CDecodingPipeline::BeginDecoding()
+{
+    mfxStatus sts = MFX_ERR_NONE;
+
+    m_pRunBitstream = &m_mfxBS;
+    m_runSts = MFX_ERR_NONE;
+    m_bRunIncompatibleParams = false;
+    m_runStartTime = time(0);
+    m_pDeliverThread = NULL;
+    // a channel may be stopped and started again, nothing of the previous run carries over
+    m_error = MFX_ERR_NONE;
+    m_bStopDeliverLoop = false;
 
     if (m_eWorkMode == MODE_RENDERING) {
-        m_pDeliverOutputSemaphore = new MSDKSemaphore(sts);
-        m_pDeliveredEvent = new MSDKEvent(sts, false, false);
-        pDeliverThread = new MSDKThread(sts, DeliverThreadFunc, this);
-        if (!pDeliverThread || !m_pDeliverOutputSemaphore || !m_pDeliveredEvent) {
-            MSDK_SAFE_DELETE(pDeliverThread);
+        m_nHandoffs = 0;
+        m_handoffTicks = 0;
+        m_maxHandoffTicks = 0;
+        m_pDeliverOutputSemaphore = new MSDKFutexSemaphore(sts);
+        m_pDeliveredEvent = new MSDKFutexEvent(sts, false, false);
+        m_pDeliverThread = new MSDKThread(sts, DeliverThreadFunc, this);
+        if (!m_pDeliverThread || !m_pDeliverOutputSemaphore || !m_pDeliveredEvent) {
+            MSDK_SAFE_DELETE(m_pDeliverThread);
             MSDK_SAFE_DELETE(m_pDeliverOutputSemaphore);
             MSDK_SAFE_DELETE(m_pDeliveredEvent);
             return MFX_ERR_MEMORY_ALLOC;
         }
     }
 
-    while (((sts == MFX_ERR_NONE) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) && (m_nFrames > m_output_count))
+    return MFX_ERR_NONE;
+}
+
+bool CDecodingPipeline::IsStepReady()
+{
+    // only pushed input can make a step wait, file input is always at hand
+    if (m_pPushReader && m_pRunBitstream &&
+        ((MFX_ERR_MORE_DATA == m_runSts) || (m_bIsCompleteFrame && !m_pRunBitstream->DataLength)))
     {
-        if (MFX_ERR_NONE != m_error) {
-            msdk_printf(MSDK_STRING("DeliverOutput return error = %d\n"),m_error);
-            break;
-        }
+        return m_pPushReader->HasPacket();
+    }
+    return true;
+}
+
+bool CDecodingPipeline::RunDecodingStep()
+{
+    mfxFrameSurface1*   pOutSurface = NULL;
+    mfxBitstream*&      pBitstream = m_pRunBitstream;
+    mfxStatus&          sts = m_runSts;
+#if (MFX_VERSION >= 1025)
+    mfxExtDecodeErrorReport *pDecodeErrorReport = NULL;
+#endif
 
-        if (pBitstream && ((MFX_ERR_MORE_DATA == sts) || (m_bIsCompleteFrame && !pBitstream->DataLength))) {
-            CAutoTimer timer_fread(m_tick_fread);
-            sts = m_FileReader->ReadNextFrame(pBitstream); // read more data to input bit stream
+    if (!(((sts == MFX_ERR_NONE) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) && (m_nFrames > m_output_count)))
+        return false;
 
-            if (MFX_ERR_MORE_DATA == sts) {
-                sts = MFX_ERR_NONE;
-                // Timeout has expired or videowall mode
-                m_timer_overall.Sync();
-                if ( ((CTimer::ConvertToSeconds(m_tick_overall) < m_nTimeout) && m_nTimeout ) || m_bIsVideoWall)
-                {
-                    m_FileReader->Reset();
-                    m_bResetFileWriter = true;
-                    continue;
-                }
+    if (MFX_ERR_NONE != m_error) {
+        msdk_printf(MSDK_STRING("DeliverOutput return error = %d\n"),m_error);
+        return false;
+    }
+
+    if (pBitstream && ((MFX_ERR_MORE_DATA == sts) || (m_bIsCompleteFrame && !pBitstream->DataLength))) {
+        CAutoTimer timer_fread(m_tick_fread);
+        sts = m_FileReader->ReadNextFrame(pBitstream); // read more data to input bit stream
 
-                // we almost reached end of stream, need to pull buffered data now
-                pBitstream = NULL;
+        if (MFX_ERR_MORE_DATA == sts) {
+            sts = MFX_ERR_NONE;
+            // Timeout has expired or videowall mode, pushed input can't be replayed
+            m_timer_overall.Sync();
+            if (!m_pPushReader &&
+                (((CTimer::ConvertToSeconds(m_tick_overall) < m_nTimeout) && m_nTimeout ) || m_bIsVideoWall))
+            {
+                m_FileReader->Reset();
+                m_bResetFileWriter = true;
+                return true;
             }
+
+            // we almost reached end of stream, need to pull buffered data now
+            pBitstream = NULL;
         }
+    }
 
-        if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
-            // here we check whether output is ready, though we do not wait...
+    if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
+        // here we check whether output is ready, though we do not wait...
 #ifndef __SYNC_WA
-            mfxStatus _sts = SyncOutputSurface(0);
-            if (MFX_ERR_UNKNOWN == _sts) {
-                sts = _sts;
-                break;
-            } else if (MFX_ERR_NONE == _sts) {
-                continue;
-            }
+        mfxStatus _sts = SyncOutputSurface(0);
+        if (MFX_ERR_UNKNOWN == _sts) {
+            sts = _sts;
+            return false;
+        } else if (MFX_ERR_NONE == _sts) {
+            return true;
+        }
 #endif
+    }
+    else
+    {
+        MSDK_CHECK_STATUS_NO_RET(sts, "ReadNextFrame failed");
+    }
+
+    if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
+        SyncFrameSurfaces();
+        SyncVppFrameSurfaces();
+        if (!m_pCurrentFreeSurface) {
+            m_pCurrentFreeSurface = m_FreeSurfacesPool.GetSurface();
         }
-        else
-        {
-            MSDK_CHECK_STATUS_NO_RET(sts, "ReadNextFrame failed");
+        if (!m_pCurrentFreeVppSurface) {
+          m_pCurrentFreeVppSurface = m_FreeVppSurfacesPool.GetSurface();
         }
-
-        if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
-            SyncFrameSurfaces();
-            SyncVppFrameSurfaces();
-            if (!m_pCurrentFreeSurface) {
-                m_pCurrentFreeSurface = m_FreeSurfacesPool.GetSurface();
-            }
-            if (!m_pCurrentFreeVppSurface) {
-              m_pCurrentFreeVppSurface = m_FreeVppSurfacesPool.GetSurface();
-            }
 #ifndef __SYNC_WA
-            if (!m_pCurrentFreeSurface || !m_pCurrentFreeVppSurface) {
+        if (!m_pCurrentFreeSurface || !m_pCurrentFreeVppSurface) {
 #else
-            if (!m_pCurrentFreeSurface || (!m_pCurrentFreeVppSurface && m_bVppIsUsed) || (m_OutputSurfacesPool.GetSurfaceCount() == m_mfxVideoParams.AsyncDepth)) {
+        if (!m_pCurrentFreeSurface || (!m_pCurrentFreeVppSurface && m_bVppIsUsed) || (m_OutputSurfacesPool.GetSurfaceCount() == m_mfxVideoParams.AsyncDepth)) {
 #endif
-                // we stuck with no free surface available, now we will sync...
-                sts = SyncOutputSurface(MSDK_DEC_WAIT_INTERVAL);
-                if (MFX_ERR_MORE_DATA == sts) {
-                    if ((m_eWorkMode == MODE_PERFORMANCE) || (m_eWorkMode == MODE_FILE_DUMP)) {
+            // we stuck with no free surface available, now we will sync...
+            sts = SyncOutputSurface(MSDK_DEC_WAIT_INTERVAL);
+            if (MFX_ERR_MORE_DATA == sts) {
+                if ((m_eWorkMode == MODE_PERFORMANCE) || (m_eWorkMode == MODE_FILE_DUMP)) {
+                    sts = MFX_ERR_NOT_FOUND;
+                } else if (m_eWorkMode == MODE_RENDERING) {
+                    if (m_synced_count != m_output_count) {
+                        sts = m_pDeliveredEvent->TimedWait(MSDK_DEC_WAIT_INTERVAL);
+                    } else {
                         sts = MFX_ERR_NOT_FOUND;
-                    } else if (m_eWorkMode == MODE_RENDERING) {
-                        if (m_synced_count != m_output_count) {
-                            sts = m_pDeliveredEvent->TimedWait(MSDK_DEC_WAIT_INTERVAL);
-                        } else {
-                            sts = MFX_ERR_NOT_FOUND;
-                        }
-                    }
-                    if (MFX_ERR_NOT_FOUND == sts) {
-                        msdk_printf(MSDK_STRING("fatal: failed to find output surface, that's a bug!\n"));
-                        break;
                     }
                 }
-                // note: MFX_WRN_IN_EXECUTION will also be treated as an error at this point
-                continue;
-            }
-
-            if (!m_pCurrentFreeOutputSurface) 
-            {
-                m_pCurrentFreeOutputSurface = GetFreeOutputSurface();
-            }
-            if (!m_pCurrentFreeOutputSurface) 
-            {
-                sts = MFX_ERR_NOT_FOUND;
-                break;
+                if (MFX_ERR_NOT_FOUND == sts) {
+                    msdk_printf(MSDK_STRING("fatal: failed to find output surface, that's a bug!\n"));
+                    return false;
+                }
             }
+            // note: MFX_WRN_IN_EXECUTION will also be treated as an error at this point
+            return true;
         }
 
-        // exit by timeout
-        if ((MFX_ERR_NONE == sts) && m_bIsVideoWall && (time(0)-start_time) >= m_nTimeout) {
-            sts = MFX_ERR_NONE;
-            break;
+        if (!m_pCurrentFreeOutputSurface) 
+        {
+            m_pCurrentFreeOutputSurface = GetFreeOutputSurface();
+        }
+        if (!m_pCurrentFreeOutputSurface) 
+        {
+            sts = MFX_ERR_NOT_FOUND;
+            return false;
         }
+    }
 
-        if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
-            if (m_bIsCompleteFrame) 
-            {
-                m_pCurrentFreeSurface->submit = m_timer_overall.Sync();
-            }
-            pOutSurface = NULL;
-            do {
+    // exit by timeout
+    if ((MFX_ERR_NONE == sts) && m_bIsVideoWall && (time(0)-m_runStartTime) >= m_nTimeout) {
+        sts = MFX_ERR_NONE;
+        return false;
+    }
+
+    if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
+        m_pCurrentFreeSurface->submit = m_timer_overall.Sync();
+        pOutSurface = NULL;
+        do {
 #if (MFX_VERSION >= 1025)
-                if (pBitstream) {
-                    pDecodeErrorReport = (mfxExtDecodeErrorReport *)GetExtBuffer(pBitstream->ExtParam, pBitstream->NumExtParam, MFX_EXTBUFF_DECODE_ERROR_REPORT);
-                }
+            if (pBitstream) {
+                pDecodeErrorReport = (mfxExtDecodeErrorReport *)GetExtBuffer(pBitstream->ExtParam, pBitstream->NumExtParam, MFX_EXTBUFF_DECODE_ERROR_REPORT);
+            }
 #endif
-                sts = m_pmfxDEC->DecodeFrameAsync(pBitstream, &(m_pCurrentFreeSurface->frame), &pOutSurface, &(m_pCurrentFreeOutputSurface->syncp));
+            sts = m_pmfxDEC->DecodeFrameAsync(pBitstream, &(m_pCurrentFreeSurface->frame), &pOutSurface, &(m_pCurrentFreeOutputSurface->syncp));
 
 #if (MFX_VERSION >= 1025)
-                PrintDecodeErrorReport(pDecodeErrorReport);
+            PrintDecodeErrorReport(pDecodeErrorReport);
 #endif
 
-                if (pBitstream && MFX_ERR_MORE_DATA == sts && pBitstream->MaxLength == pBitstream->DataLength)
+            if (pBitstream && MFX_ERR_MORE_DATA == sts && pBitstream->MaxLength == pBitstream->DataLength)
+            {
+                mfxStatus stsExt = ExtendMfxBitstream(pBitstream, pBitstream->MaxLength * 2);
+                if (MFX_ERR_NONE != stsExt)
                 {
-                    mfxStatus stsExt = ExtendMfxBitstream(pBitstream, pBitstream->MaxLength * 2);
-                    MSDK_CHECK_STATUS_SAFE(stsExt, "ExtendMfxBitstream failed", MSDK_SAFE_DELETE(pDeliverThread));
+                    MSDK_PRINT_RET_MSG(stsExt, "ExtendMfxBitstream failed");
+                    sts = stsExt;
+                    return false;
                 }
+            }
 
-                if (MFX_WRN_DEVICE_BUSY == sts) {
-                    if (m_bIsCompleteFrame) {
-                        //in low latency mode device busy leads to increasing of latency
-                        //msdk_printf(MSDK_STRING("Warning : latency increased due to MFX_WRN_DEVICE_BUSY\n"));
-                    }
-                    mfxStatus _sts = SyncOutputSurface(MSDK_DEC_WAIT_INTERVAL);
-                    // note: everything except MFX_ERR_NONE are errors at this point
-                    if (MFX_ERR_NONE == _sts) {
-                        sts = MFX_WRN_DEVICE_BUSY;
-                    } else {
-                        sts = _sts;
-                        if (MFX_ERR_MORE_DATA == sts) {
-                            // we can't receive MFX_ERR_MORE_DATA and have no output - that's a bug
-                            sts = MFX_WRN_DEVICE_BUSY;//MFX_ERR_NOT_FOUND;
-                        }
-                    }
+            if (MFX_WRN_DEVICE_BUSY == sts) {
+                if (m_bIsCompleteFrame) {
+                    //in low latency mode device busy leads to increasing of latency
+                    //msdk_printf(MSDK_STRING("Warning : latency increased due to MFX_WRN_DEVICE_BUSY\n"));
                 }
-            } while (MFX_WRN_DEVICE_BUSY == sts);
-
-            if (sts > MFX_ERR_NONE) {
-                // ignoring warnings...
-                if (m_pCurrentFreeOutputSurface->syncp) {
-                    MSDK_SELF_CHECK(pOutSurface);
-                    // output is available
-                    sts = MFX_ERR_NONE;
+                mfxStatus _sts = SyncOutputSurface(MSDK_DEC_WAIT_INTERVAL);
+                // note: everything except MFX_ERR_NONE are errors at this point
+                if (MFX_ERR_NONE == _sts) {
+                    sts = MFX_WRN_DEVICE_BUSY;
                 } else {
-                    // output is not available
-                    sts = MFX_ERR_MORE_SURFACE;
-                }
-            } else if ((MFX_ERR_MORE_DATA == sts) && pBitstream) {
-                if (m_bIsCompleteFrame && pBitstream->DataLength)
-                {
-                    // In low_latency mode decoder have to process bitstream completely
-                    msdk_printf(MSDK_STRING("error: Incorrect decoder behavior in low latency mode (bitstream length is not equal to 0 after decoding)\n"));
-                    sts = MFX_ERR_UNDEFINED_BEHAVIOR;
-                    continue;
+                    sts = _sts;
+                    if (MFX_ERR_MORE_DATA == sts) {
+                        // we can't receive MFX_ERR_MORE_DATA and have no output - that's a bug
+                        sts = MFX_WRN_DEVICE_BUSY;//MFX_ERR_NOT_FOUND;
+                    }
                 }
-            } else if ((MFX_ERR_MORE_DATA == sts) && !pBitstream) {
-                // that's it - we reached end of stream; now we need to render bufferred data...
-                do {
-                    sts = SyncOutputSurface(MSDK_DEC_WAIT_INTERVAL);
-                } while (MFX_ERR_NONE == sts);
-
-                MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
-                if (sts) MSDK_PRINT_WRN_MSG(sts, "SyncOutputSurface failed")
+            }
+        } while (MFX_WRN_DEVICE_BUSY == sts);
 
-                while (m_synced_count != m_output_count) {
-                    m_pDeliveredEvent->Wait();
-                }
-                break;
-            } else if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts) {
-                bErrIncompatibleVideoParams = true;
-                // need to go to the buffering loop prior to reset procedure
-                pBitstream = NULL;
+        if (sts > MFX_ERR_NONE) {
+            // ignoring warnings...
+            if (m_pCurrentFreeOutputSurface->syncp) {
+                MSDK_SELF_CHECK(pOutSurface);
+                // output is available
                 sts = MFX_ERR_NONE;
-                continue;
+            } else {
+                // output is not available
+                sts = MFX_ERR_MORE_SURFACE;
             }
-        }
+        } else if ((MFX_ERR_MORE_DATA == sts) && pBitstream) {
+            if (m_bIsCompleteFrame && pBitstream->DataLength)
+            {
+                // In low_latency mode decoder have to process bitstream completely
+                msdk_printf(MSDK_STRING("error: Incorrect decoder behavior in low latency mode (bitstream length is not equal to 0 after decoding)\n"));
+                sts = MFX_ERR_UNDEFINED_BEHAVIOR;
+                return true;
+            }
+        } else if ((MFX_ERR_MORE_DATA == sts) && !pBitstream) {
+            // that's it - we reached end of stream; now we need to render bufferred data...
+            do {
+                sts = SyncOutputSurface(MSDK_DEC_WAIT_INTERVAL);
+            } while (MFX_ERR_NONE == sts);
+
+            MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
+            if (sts) MSDK_PRINT_WRN_MSG(sts, "SyncOutputSurface failed")
 
-        if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
-            // if current free surface is locked we are moving it to the used surfaces array
-            /*if (m_pCurrentFreeSurface->frame.Data.Locked)*/ {
-                m_UsedSurfacesPool.AddSurface(m_pCurrentFreeSurface);
-                m_pCurrentFreeSurface = NULL;
+            while (m_synced_count != m_output_count) {
+                m_pDeliveredEvent->Wait();
             }
+            return false;
+        } else if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts) {
+            m_bRunIncompatibleParams = true;
+            // need to go to the buffering loop prior to reset procedure
+            pBitstream = NULL;
+            sts = MFX_ERR_NONE;
+            return true;
         }
-        else
-        {
-            MSDK_CHECK_STATUS_NO_RET(sts, "DecodeFrameAsync returned error status");
+    }
+
+    if ((MFX_ERR_NONE == sts) || (MFX_ERR_MORE_DATA == sts) || (MFX_ERR_MORE_SURFACE == sts)) {
+        // if current free surface is locked we are moving it to the used surfaces array
+        /*if (m_pCurrentFreeSurface->frame.Data.Locked)*/ {
+            m_UsedSurfacesPool.AddSurface(m_pCurrentFreeSurface);
+            m_pCurrentFreeSurface = NULL;
         }
+    }
+    else
+    {
+        MSDK_CHECK_STATUS_NO_RET(sts, "DecodeFrameAsync returned error status");
+    }
 
-        if (MFX_ERR_NONE == sts)
+    if (MFX_ERR_NONE == sts)
+    {
+        if (m_bVppIsUsed)
         {
-            if (m_bVppIsUsed)
+            if(m_pCurrentFreeVppSurface)
             {
-                if(m_pCurrentFreeVppSurface)
+                do
                 {
-                    do
-                    {
-                        if ((m_pCurrentFreeVppSurface->frame.Info.CropW == 0) ||
-                            (m_pCurrentFreeVppSurface->frame.Info.CropH == 0)) {
-                                m_pCurrentFreeVppSurface->frame.Info.CropW = pOutSurface->Info.CropW;
-                                m_pCurrentFreeVppSurface->frame.Info.CropH = pOutSurface->Info.CropH;
-                                m_pCurrentFreeVppSurface->frame.Info.CropX = pOutSurface->Info.CropX;
-                                m_pCurrentFreeVppSurface->frame.Info.CropY = pOutSurface->Info.CropY;
-                        }
-                        if (pOutSurface->Info.PicStruct != m_pCurrentFreeVppSurface->frame.Info.PicStruct) {
-                            m_pCurrentFreeVppSurface->frame.Info.PicStruct = pOutSurface->Info.PicStruct;
-                        }
-                        if ((pOutSurface->Info.PicStruct == 0) && (m_pCurrentFreeVppSurface->frame.Info.PicStruct == 0)) {
-                            m_pCurrentFreeVppSurface->frame.Info.PicStruct = pOutSurface->Info.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
-                        }
-
-                        if (m_diMode)
-                            m_pCurrentFreeVppSurface->frame.Info.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
-
-                        // WA: RunFrameVPPAsync doesn't copy ViewId from input to output
-                        m_pCurrentFreeVppSurface->frame.Info.FrameId.ViewId = pOutSurface->Info.FrameId.ViewId;
-                        sts = m_pmfxVPP->RunFrameVPPAsync(pOutSurface, &(m_pCurrentFreeVppSurface->frame), NULL, &(m_pCurrentFreeOutputSurface->syncp));
-
-                        if (MFX_WRN_DEVICE_BUSY == sts)
-                        {
-                            MSDK_SLEEP(1); // just wait and then repeat the same call to RunFrameVPPAsync
-                        }
-                    } while (MFX_WRN_DEVICE_BUSY == sts);
-
-                    // process errors
-                    if (MFX_ERR_MORE_DATA == sts) 
-                    { // will never happen actually
-                        continue;
+                    if ((m_pCurrentFreeVppSurface->frame.Info.CropW == 0) ||
+                        (m_pCurrentFreeVppSurface->frame.Info.CropH == 0)) {
+                            m_pCurrentFreeVppSurface->frame.Info.CropW = pOutSurface->Info.CropW;
+                            m_pCurrentFreeVppSurface->frame.Info.CropH = pOutSurface->Info.CropH;
+                            m_pCurrentFreeVppSurface->frame.Info.CropX = pOutSurface->Info.CropX;
+                            m_pCurrentFreeVppSurface->frame.Info.CropY = pOutSurface->Info.CropY;
                     }
-                    else if (MFX_ERR_NONE != sts) 
-                    {
-                        MSDK_PRINT_RET_MSG(sts, "RunFrameVPPAsync failed");
-                        break;
+                    if (pOutSurface->Info.PicStruct != m_pCurrentFreeVppSurface->frame.Info.PicStruct) {
+                        m_pCurrentFreeVppSurface->frame.Info.PicStruct = pOutSurface->Info.PicStruct;
+                    }
+                    if ((pOutSurface->Info.PicStruct == 0) && (m_pCurrentFreeVppSurface->frame.Info.PicStruct == 0)) {
+                        m_pCurrentFreeVppSurface->frame.Info.PicStruct = pOutSurface->Info.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
                     }
 
-                    m_UsedVppSurfacesPool.AddSurface(m_pCurrentFreeVppSurface);
-                    msdk_atomic_inc16(&(m_pCurrentFreeVppSurface->render_lock));
+                    if (m_diMode)
+                        m_pCurrentFreeVppSurface->frame.Info.PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
+
+                    // WA: RunFrameVPPAsync doesn't copy ViewId from input to output
+                    m_pCurrentFreeVppSurface->frame.Info.FrameId.ViewId = pOutSurface->Info.FrameId.ViewId;
+                    sts = m_pmfxVPP->RunFrameVPPAsync(pOutSurface, &(m_pCurrentFreeVppSurface->frame), NULL, &(m_pCurrentFreeOutputSurface->syncp));
 
-                    m_pCurrentFreeOutputSurface->surface = m_pCurrentFreeVppSurface;
-                    m_OutputSurfacesPool.AddSurface(m_pCurrentFreeOutputSurface);
+                    if (MFX_WRN_DEVICE_BUSY == sts)
+                    {
+                        MSDK_SLEEP(1); // just wait and then repeat the same call to RunFrameVPPAsync
+                    }
+                } while (MFX_WRN_DEVICE_BUSY == sts);
 
-                    m_pCurrentFreeOutputSurface = NULL;
-                    m_pCurrentFreeVppSurface = NULL;
+                // process errors
+                if (MFX_ERR_MORE_DATA == sts) 
+                { // will never happen actually
+                    return true;
+                }
+                else if (MFX_ERR_NONE != sts) 
+                {
+                    MSDK_PRINT_RET_MSG(sts, "RunFrameVPPAsync failed");
+                    return false;
                 }
-            }
-            else
-            {
-                msdkFrameSurface* surface = FindUsedSurface(pOutSurface);
 
-                msdk_atomic_inc16(&(surface->render_lock));
+                m_UsedVppSurfacesPool.AddSurface(m_pCurrentFreeVppSurface);
+                msdk_atomic_inc16(&(m_pCurrentFreeVppSurface->render_lock));
 
-                m_pCurrentFreeOutputSurface->surface = surface;
+                m_pCurrentFreeOutputSurface->surface = m_pCurrentFreeVppSurface;
                 m_OutputSurfacesPool.AddSurface(m_pCurrentFreeOutputSurface);
+
                 m_pCurrentFreeOutputSurface = NULL;
+                m_pCurrentFreeVppSurface = NULL;
             }
         }
-    } //while processing
+        else
+        {
+            msdkFrameSurface* surface = FindUsedSurface(pOutSurface);
+
+            msdk_atomic_inc16(&(surface->render_lock));
+
+            m_pCurrentFreeOutputSurface->surface = surface;
+            m_OutputSurfacesPool.AddSurface(m_pCurrentFreeOutputSurface);
+            m_pCurrentFreeOutputSurface = NULL;
+        }
+    }
+
+    return true;
+}
+
+mfxStatus CDecodingPipeline::EndDecoding(bool bStopped)
+{
+    mfxStatus sts = m_runSts;
+
+    if (bStopped && (MFX_ERR_MORE_DATA == sts || MFX_ERR_MORE_SURFACE == sts))
+    {
+        // stopped between two steps, the next run continues from here
+        sts = MFX_ERR_NONE;
+    }
 
     if (m_nFrames == m_output_count)
     {
@@ -1938,6 +2288,23 @@ mfxStatus CDecodingPipeline::RunDecoding()
 
     PrintPerFrameStat(true);
 
+    if (m_FileReader.get() && !m_bSilent)
+    {
+        mfxU64 nMBs = (mfxU64)m_output_count * (MSDK_ALIGN16(m_mfxVideoParams.mfx.FrameInfo.CropW) / 16) * (MSDK_ALIGN16(m_mfxVideoParams.mfx.FrameInfo.CropH) / 16);
+        msdk_printf(MSDK_STRING("\nBitstream memmove: %lld bytes, %.3f bytes per decoded MB\n"),
+            (long long)m_FileReader->GetMovedBytes(),
+            nMBs ? (mfxF64)m_FileReader->GetMovedBytes() / nMBs : 0.0);
+        if (m_FileReader->GetSkippedFrames())
+            msdk_printf(MSDK_STRING("Skipped non-key frames: %d\n"), m_FileReader->GetSkippedFrames());
+        if (m_pTSReader)
+            msdk_printf(MSDK_STRING("Transport stream PID 0x%x, continuity errors: %d\n"), m_pTSReader->GetPid(), m_pTSReader->GetContinuityErrors());
+    }
+
+    if (MSDK_NUMA_NODE_ANY != m_nNumaNode && !m_bSilent)
+    {
+        msdk_printf(MSDK_STRING("NUMA node %d, remote surface pages: %.1f%%\n"), m_nNumaNode, GetRemotePageRatio() * 100);
+    }
+
     if (m_bPrintLatency && m_vLatency.size() > 0) {
         unsigned int frame_idx = 0;
         msdk_tick sum = 0;
@@ -1954,27 +2321,39 @@ mfxStatus CDecodingPipeline::RunDecoding()
     }
 
     if (m_eWorkMode == MODE_RENDERING) {
+        // frames already synced are delivered before the thread goes, so their surfaces are released
+        while (m_pDeliveredEvent && MFX_ERR_NONE == m_error && m_synced_count != m_output_count) {
+            m_pDeliveredEvent->Wait();
+        }
         m_bStopDeliverLoop = true;
         m_pDeliverOutputSemaphore->Post();
-        if (pDeliverThread)
-            pDeliverThread->Wait();
+        if (m_pDeliverThread)
+            m_pDeliverThread->Wait();
+
+        if (m_nHandoffs && !m_bSilent)
+        {
+            msdk_printf(MSDK_STRING("Deliver handoffs: %u, wake latency avg %.2f us, max %.2f us\n"), m_nHandoffs,
+                CTimer::ConvertToSeconds(m_handoffTicks) * 1e6 / m_nHandoffs,
+                CTimer::ConvertToSeconds(m_maxHandoffTicks) * 1e6);
+        }
     }
 
     MSDK_SAFE_DELETE(m_pDeliverOutputSemaphore);
     MSDK_SAFE_DELETE(m_pDeliveredEvent);
-    MSDK_SAFE_DELETE(pDeliverThread);
+    MSDK_SAFE_DELETE(m_pDeliverThread);
 
     // exit in case of other errors
     MSDK_CHECK_STATUS(sts, "Unexpected error!!");
 
     // if we exited main decoding loop with ERR_INCOMPATIBLE_PARAM we need to send this status to caller
-    if (bErrIncompatibleVideoParams) {
+    if (m_bRunIncompatibleParams) {
         sts = MFX_ERR_INCOMPATIBLE_VIDEO_PARAM;
     }
 
     return sts; // ERR_NONE or ERR_INCOMPATIBLE_VIDEO_PARAM
 }
 
+
 void CDecodingPipeline::PrintInfo()
 {
     msdk_printf(MSDK_STRING("Decoding Sample Version %s\n\n"), GetMSDKSampleVersion().c_str());
@@ -30,6 +30,10 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "sample_utils.h"
 #include "base_allocator.h"
 #include "time_statistics.h"
+#include "mux_bitstream_writer.h"
+#include "bitstream_segmenter.h"
+#include "shm_frame_ring.h"
+#include "shm_bitstream_ring.h"
 
 #include "mfxmvc.h"
 #include "mfxvideo.h"
@@ -38,12 +42,17 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "mfxplugin++.h"
 
 #include <vector>
+#include <deque>
 #include <memory>
+#include <atomic>
 
 #include "plugin_loader.h"
 
 #include "preset_manager.h"
 #include "concurrentqueue.h"
+#include "lookahead.h"
+#include "frame_diff.h"
+#include "frame_ctrl_table.h"
 
 #if defined (ENABLE_V4L2_SUPPORT)
 #include "v4l2_util.h"
@@ -51,6 +60,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #if (MFX_VERSION >= 1024)
 #include "brc_routines.h"
+#include "brc_trace.h"
 #endif
 
 #ifndef MFX_VERSION
@@ -74,6 +84,34 @@ enum MemType {
     D3D11_MEMORY  = 0x02,
 };
 
+// what becomes of an input frame identical to the previous one
+enum eStaticFrameMode {
+    STATIC_FRAME_ENCODE = 0, // encoded like any other
+    STATIC_FRAME_SKIP,       // encoded as a dummy frame of skipped blocks
+    STATIC_FRAME_DROP,       // not encoded, its time stamp is left out
+};
+
+// what a change of the encoding parameters while running takes, cheapest first
+enum eReconfigType {
+    RECONFIG_NONE = 0,     // nothing changed
+    RECONFIG_RESET,        // MFXVideoENCODE_Reset, the sequence goes on
+    RECONFIG_NEW_SEQUENCE, // MFXVideoENCODE_Reset starting a new sequence with an IDR frame
+    RECONFIG_REINIT,       // the encoder is closed and initialized again on the same surfaces
+    RECONFIG_FULL,         // components, surfaces and tasks are all created again
+};
+
+// changes of the encoding applied while running, 0 keeps a value
+struct sReconfigParams
+{
+    mfxU32 nBitRate;    // kbps, BRCParamMultiplier is applied by the pipeline
+    mfxU32 nMaxKbps;
+    mfxU16 nGopPicSize;
+    mfxU16 nGopRefDist;
+    mfxF64 dFrameRate;
+    mfxU16 nDstWidth;   // set by the pipeline itself when the size of the input frames changes
+    mfxU16 nDstHeight;
+};
+
 struct sInputParams
 {
     mfxU16 nTargetUsage;
@@ -184,17 +222,38 @@ struct sInputParams
     mfxU16 IntRefCycleDist;
 
     bool bUncut;
+    eMuxFormat MuxFormat; // container of the output, raw elementary stream by default
+    mfxU32 nSegmentFrames;   // output is split into segments of this many frames
+    mfxF64 dSegmentSeconds;  // same in seconds, used if nSegmentFrames is 0
+    mfxU16 nCpuLookAhead;    // frames analyzed on the CPU ahead of the encoder, 0 for none
+    bool bSceneCutIDR;       // scene cuts found by the lookahead start with an IDR frame
+    bool bFrameCtrl;         // controls sent with the frames are applied (ROI, reference hints, frame type)
+    bool bEnableMBQP;        // QP maps sent with the frames are applied, constant QP only
+    eStaticFrameMode StaticFrameMode;
+    mfxU16 nMaxStaticFrames; // static frames in a row before one is encoded anyway, 0 for no limit
+    mfxU32 nReconfigFrame;   // Reconfig is requested before sending this input frame, 0 for never
+    sReconfigParams Reconfig;
     bool shouldUseShifted10BitEnc;
     bool shouldUseShifted10BitVPP;
     bool IsSourceMSB;
 
     bool bSingleTexture;
+    bool bSysMemArena; // system memory frames are carved from huge page slabs kept across resets
+    mfxI32 nNumaNode;  // NUMA node for the pipeline's memory and threads, MSDK_NUMA_NODE_ANY for no placement
 
 #if (MFX_VERSION >= 1027)
     msdk_char *RoundingOffsetFile;
 #endif
+    msdk_char FrameCtrlTableFile[MSDK_MAX_FILENAME_LEN]; // per-frame encoder controls, read once before encoding
     msdk_char DumpFileName[MSDK_MAX_FILENAME_LEN];
     msdk_char uSEI[MSDK_MAX_USER_DATA_UNREG_SEI_LEN];
+    msdk_char ShmRingName[MSDK_MAX_FILENAME_LEN]; // input frames come from a shared memory ring of another process,
+                                                  // of one size and without CPU look ahead or static frame detection
+    msdk_char ShmEgressName[MSDK_MAX_FILENAME_LEN]; // encoded frames go to a shared memory ring instead of a file
+    mfxU32 nShmEgressSize; // bytes of the egress ring, MSDK_SHM_EGRESS_DEFAULT_SIZE if 0
+    msdk_char BRCTraceFile[MSDK_MAX_FILENAME_LEN]; // calls of the sample ExtBRC are recorded here for offline replay
+    msdk_char BRCReplayFile[MSDK_MAX_FILENAME_LEN]; // a BRC trace is replayed instead of encoding
+    msdk_char BRCReplayCurvesFile[MSDK_MAX_FILENAME_LEN]; // per-frame CSV of the replay
 
     EPresetModes PresetMode;
     bool shouldPrintPresets;
@@ -218,6 +277,8 @@ struct bufSet
 {
     mfxU16 m_nFields;
     std::vector<mfxExtBuffer *> buffers;
+    // buffers given to the encoder with the current frame, reserved to the size of buffers
+    std::vector<mfxExtBuffer *> attached;
 
     bufSet(mfxU16 n_fields = 1)
     : m_nFields(n_fields)
@@ -240,6 +301,28 @@ struct bufSet
                 }
                 break;
 #endif
+                case MFX_EXTBUFF_ENCODER_ROI:
+                {
+                    mfxExtEncoderROI* roi = reinterpret_cast<mfxExtEncoderROI*>(buffers[i]);
+                    MSDK_SAFE_DELETE(roi);
+                    ++i;
+                }
+                break;
+                case MFX_EXTBUFF_MBQP:
+                {
+                    mfxExtMBQP* mbqp = reinterpret_cast<mfxExtMBQP*>(buffers[i]);
+                    MSDK_SAFE_DELETE_ARRAY(mbqp->QP);
+                    MSDK_SAFE_DELETE(mbqp);
+                    ++i;
+                }
+                break;
+                case MFX_EXTBUFF_AVC_REFLIST_CTRL:
+                {
+                    mfxExtAVCRefListCtrl* refList = reinterpret_cast<mfxExtAVCRefListCtrl*>(buffers[i]);
+                    MSDK_SAFE_DELETE(refList);
+                    ++i;
+                }
+                break;
                 default:
                     ++i;
                     break;
@@ -247,6 +330,7 @@ struct bufSet
         }
 
         buffers.clear();
+        attached.clear();
     }
 };
 
@@ -356,9 +440,17 @@ public:
     void SetNumView(mfxU32 numViews) { m_nNumView = numViews; }
 	mfxStatus SndFrame(frame_desc_t* frame);
 	mfxStatus GetBitstreams(mfxBitstream* &pBitstream);
+    // may be called from any thread, the frames sent before are encoded with the old parameters
+    mfxStatus Reconfigure(const sReconfigParams &par);
 
     virtual void  PrintInfo();
 
+    mfxI32 GetNumaNode() { return m_nNumaNode; }
+    // tiles of the last input frame that changed, for region of interest use
+    const CFrameDiff& GetFrameDiff() const { return m_FrameDiff; }
+    // share of sampled system memory surface pages not placed on the pipeline's node
+    mfxF64 GetRemotePageRatio();
+
     void InitV4L2Pipeline(sInputParams *pParams);
     mfxStatus CaptureStartV4L2Pipeline();
     void CaptureStopV4L2Pipeline();
@@ -366,6 +458,8 @@ public:
     void InsertIDR(bool bIsNextFrameIDR);
 
     virtual mfxStatus AllocExtBuffers(sInputParams *pInParams);
+    // 16x16 blocks of the encoded frame
+    mfxU32 GetQPMapSize();
     mfxStatus InitEncFrameParams(sTask* pTask);
 
 #if defined (ENABLE_V4L2_SUPPORT)
@@ -375,6 +469,9 @@ public:
 
 protected:
     std::pair<CSmplBitstreamWriter *,CSmplBitstreamWriter *> m_FileWriters;
+    eMuxFormat m_MuxFormat;
+    CMuxBitstreamWriter *m_pMuxWriter; // m_FileWriters.first when the output is muxed, NULL otherwise
+    CBitstreamSegmenter *m_pSegmenter; // NULL if the output isn't segmented
     CSmplYUVReader m_FileReader;
     CEncTaskPool   m_TaskPool;
 
@@ -397,6 +494,8 @@ protected:
     MemType m_memType;
     mfxU16 m_nMemBuffer;
     bool m_bExternalAlloc; // use memory allocator as external for Media SDK
+    bool m_bSysMemArena;
+    mfxI32 m_nNumaNode;
 
     mfxFrameSurface1* m_pEncSurfaces; // frames array for encoder input (vpp output)
     mfxFrameSurface1* m_pVppSurfaces; // frames array for vpp input
@@ -427,6 +526,8 @@ protected:
 
 #if (MFX_VERSION >= 1024)
     mfxExtBRC           m_ExtBRC;
+    CBRCTraceWriter     m_BRCTrace;
+    ExtBRC             *m_pExtBRC; // the sample BRC behind m_ExtBRC, which may point to the trace writer
 #endif
 
     // external parameters for each component are stored in a vector
@@ -439,9 +540,19 @@ protected:
 
     bool isV4L2InputEnabled;
     bufList m_encExtBufs;
-#if (MFX_VERSION >= 1027)
-    FILE* m_round_in;
-#endif
+    CFrameCtrlTable        m_FrameCtrlTable;  // rounding offsets, QP changes and frame types by input frame order
+    const sFrameCtrlEntry *m_pFrameCtrlEntry; // entry of the next frame given to the encoder, NULL for none
+
+    sReconfigParams   m_Reconfig;          // changes waiting for the next frame, under m_lock
+    std::atomic<bool> m_bReconfigPending;
+    mfxU32            m_nReconfigFrame;    // input frame the changes apply from, under m_lock
+    mfxU32            m_nFramesSent;       // frames given to SndFrame, under m_lock
+    frame_desc_t     *m_pHeldFrame;        // first frame of a new size, waits for the encoder to be reconfigured
+    sFrameComplexity  m_HeldComplexity;
+    mfxFrameInfo      m_EncAllocInfo;      // frame info the encoder surfaces were allocated with
+    mfxU32            m_nReconfigs[RECONFIG_FULL + 1];
+    mfxF64            m_dReconfigTimeMs;   // encoding stopped for reconfigurations, drain included
+    mfxF64            m_dMaxReconfigTimeMs;
     bool m_bSoftRobustFlag;
 
     mfxU32 m_nTimeout;
@@ -457,6 +568,27 @@ protected:
 
     mfxEncodeCtrl m_encCtrl;
 	moodycamel::ConcurrentQueue<frame_desc_t*> m_readyQueue;
+
+    CLookAhead m_LookAhead;
+    std::deque<frame_desc_t*> m_LookAheadFrames; // frames in the lookahead window
+    msdk_tick m_nLookAheadTick;  // last time a frame entered the window
+    mfxU32    m_nLookAheadOrder; // display order of the next frame given to the encoder
+    mfxU32    m_nLastIDROrder;
+    mfxU32    m_nSceneCutIDRs;
+    bool      m_bSceneCutIDR;
+
+    CFrameDiff       m_FrameDiff;
+    eStaticFrameMode m_StaticFrameMode;
+    mfxU16           m_nMaxStaticFrames;
+    mfxU32           m_nStaticRun;    // static frames in a row so far
+    mfxU32           m_nStaticFrames;
+    bool             m_bSkipFrame;    // the next frame is encoded as skipped
+
+    frame_ctrl_t     m_FrameCtrl;     // controls of the next frame given to the encoder
+
+    CShmFrameRing *m_pShmRing;
+    bool m_bShmZeroCopy; // input surfaces point into the ring slots
+    std::vector<std::pair<mfxFrameSurface1*, mfxU32> > m_ShmHeldSlots; // slots in use by surfaces
 	Mutex   m_lock;
 	FILE * fou;
 
@@ -468,6 +600,8 @@ protected:
     virtual mfxStatus InitFileWriters(sInputParams *pParams);
     virtual void FreeFileWriters();
     virtual mfxStatus InitFileWriter(CSmplBitstreamWriter **ppWriter, const msdk_char *filename);
+    // passes parameter sets of the initialized encoder to the muxing writer
+    virtual mfxStatus SetMuxStreamInfo();
 
     virtual mfxStatus AllocAndInitVppDoNotUse();
     virtual void FreeVppDoNotUse();
@@ -494,6 +628,25 @@ protected:
 
     virtual mfxU32 FileFourCC2EncFourCC(mfxU32 fcc);
 	mfxStatus GetFrame(mfxFrameSurface1* pSurf);
+    // next frame out of the lookahead window, false while the window fills
+    bool GetLookAheadFrame(frame_desc_t **ppFrame, sFrameComplexity *pComplexity);
+    // scene cut IDR and BRC hints of the frame given to the encoder next
+    void ApplyLookAhead(const sFrameComplexity &la);
+    // table controls of the frame given to the encoder next, added to the ones sent with it
+    void ApplyFrameCtrlTable();
+    // compares the frame with the previous one if static frames are skipped or dropped
+    bool IsStaticFrame(frame_desc_t *pFrame);
+    mfxF64 GetFrameRate();
+    // cheapest way to move the encoder to the parameters given
+    eReconfigType ClassifyReconfig(const mfxVideoParam &par);
+    // applies the changes waiting, between two frames
+    mfxStatus ApplyReconfig();
+    // encodes the frames the encoder holds and writes out every task
+    mfxStatus DrainEncoder();
+    virtual mfxStatus InitShmRing(sInputParams *pParams);
+    virtual mfxStatus LoadShmFrame(mfxFrameSurface1* pSurf);
+    // gives back slots of surfaces the components are done with, or all of them
+    void ReleaseShmSlots(bool bAll);
 };
 
 #endif // __PIPELINE_ENCODE_H__
@@ -38,6 +38,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 
 #include "plugin_loader.h"
 #include "sample_utils.h"
+#include "vm/task_pool_defs.h"
 
 #if defined (ENABLE_V4L2_SUPPORT)
 #include <pthread.h>
@@ -49,6 +50,11 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #error MFX_VERSION not defined
 #endif
 
+#define MSDK_SHM_OPEN_TIMEOUT   10000 // ms to wait for the producer to create the ring
+#define MSDK_SHM_WAIT_INTERVAL  100   // ms to wait for a frame before the main loop gets control back
+#define MSDK_SHM_EGRESS_DEFAULT_SIZE (16 * 1024 * 1024) // bytes, a few seconds of a high bitrate stream
+#define MSDK_INPUT_CONVERT_GRAIN 16 // chroma rows per task of the input conversion
+
 /* obtain the clock tick of an uninterrupted master clock */
 msdk_tick time_get_tick(void)
 {
@@ -597,7 +603,7 @@ mfxStatus CEncodingPipeline::InitMfxEncParams(sInputParams *pInParams)
     if (pInParams->nLADepth || pInParams->nMaxSliceSize || pInParams->nMaxFrameSize || pInParams->nBRefType ||
         (pInParams->nExtBRC && (pInParams->CodecId == MFX_CODEC_HEVC || pInParams->CodecId == MFX_CODEC_AVC)) ||
         pInParams->IntRefType || pInParams->IntRefCycleSize || pInParams->IntRefQPDelta ||
-        pInParams->AdaptiveI || pInParams->AdaptiveB)
+        pInParams->AdaptiveI || pInParams->AdaptiveB || pInParams->StaticFrameMode == STATIC_FRAME_SKIP)
     {
         m_CodingOption2.LookAheadDepth = pInParams->nLADepth;
         m_CodingOption2.MaxSliceSize   = pInParams->nMaxSliceSize;
@@ -618,6 +624,8 @@ mfxStatus CEncodingPipeline::InitMfxEncParams(sInputParams *pInParams)
         m_CodingOption2.IntRefQPDelta = pInParams->IntRefQPDelta;
         m_CodingOption2.AdaptiveI = pInParams->AdaptiveI;
         m_CodingOption2.AdaptiveB = pInParams->AdaptiveB;
+        if (pInParams->StaticFrameMode == STATIC_FRAME_SKIP)
+            m_CodingOption2.SkipFrame = MFX_SKIPFRAME_INSERT_DUMMY;
         m_EncExtParams.push_back((mfxExtBuffer *)&m_CodingOption2);
     }
 
@@ -626,6 +634,12 @@ mfxStatus CEncodingPipeline::InitMfxEncParams(sInputParams *pInParams)
     if (pInParams->nExtBRC == EXTBRC_ON && (pInParams->CodecId == MFX_CODEC_HEVC || pInParams->CodecId == MFX_CODEC_AVC))
     {
        HEVCExtBRC::Create(m_ExtBRC);
+       m_pExtBRC = (ExtBRC*)m_ExtBRC.pthis;
+       if (*pInParams->BRCTraceFile)
+       {
+           mfxStatus sts = m_BRCTrace.Attach(m_ExtBRC, pInParams->BRCTraceFile);
+           MSDK_CHECK_STATUS(sts, "m_BRCTrace.Attach failed");
+       }
        m_EncExtParams.push_back((mfxExtBuffer *)&m_ExtBRC);
     }
 #endif
@@ -638,7 +652,7 @@ mfxStatus CEncodingPipeline::InitMfxEncParams(sInputParams *pInParams)
 #if (MFX_VERSION >= MFX_VERSION_NEXT)
         || pInParams->DeblockingAlphaTcOffset || pInParams->DeblockingBetaOffset
 #endif
-        || pInParams->WinBRCMaxAvgKbps || pInParams->nTransformSkip)
+        || pInParams->WinBRCMaxAvgKbps || pInParams->nTransformSkip || pInParams->bEnableMBQP)
     {
         if (pInParams->CodecId == MFX_CODEC_HEVC)
         {
@@ -665,6 +679,8 @@ mfxStatus CEncodingPipeline::InitMfxEncParams(sInputParams *pInParams)
 #endif
         m_CodingOption3.WinBRCSize = pInParams->WinBRCSize;
         m_CodingOption3.WinBRCMaxAvgKbps = pInParams->WinBRCMaxAvgKbps;
+        if (pInParams->bEnableMBQP)
+            m_CodingOption3.EnableMBQP = MFX_CODINGOPTION_ON;
 
 #if (MFX_VERSION >= MFX_VERSION_NEXT)
         if (pInParams->DeblockingAlphaTcOffset || pInParams->DeblockingBetaOffset)
@@ -941,6 +957,7 @@ mfxStatus CEncodingPipeline::AllocFrames()
     // alloc frames for encoder
     sts = m_pMFXAllocator->Alloc(m_pMFXAllocator->pthis, &EncRequest, &m_EncResponse);
     MSDK_CHECK_STATUS(sts, "m_pMFXAllocator->Alloc failed");
+    m_EncAllocInfo = EncRequest.Info;
 
     // alloc frames for vpp if vpp is enabled
     if (m_pmfxVPP)
@@ -1127,6 +1144,15 @@ mfxStatus CEncodingPipeline::CreateAllocator()
         m_pMFXAllocator = new SysMemFrameAllocator;
         MSDK_CHECK_POINTER(m_pMFXAllocator, MFX_ERR_MEMORY_ALLOC);
 
+        // slabs are prefaulted by the thread that allocates them, which keeps them on the node
+        if (m_bSysMemArena || MSDK_NUMA_NODE_ANY != m_nNumaNode)
+        {
+            SysMemAllocatorParams *pSysMemAllocParams = new SysMemAllocatorParams;
+            MSDK_CHECK_POINTER(pSysMemAllocParams, MFX_ERR_MEMORY_ALLOC);
+            pSysMemAllocParams->bUseArena = true;
+            m_pmfxAllocatorParams = pSysMemAllocParams;
+        }
+
         /* In case of system memory we demonstrate "no external allocator" usage model.
         We don't call SetAllocator, Media SDK uses internal allocator.
         We use system memory allocator simply as a memory manager for application*/
@@ -1141,6 +1167,9 @@ mfxStatus CEncodingPipeline::CreateAllocator()
 
 void CEncodingPipeline::DeleteFrames()
 {
+    // surfaces must not keep ring slots
+    ReleaseShmSlots(true);
+
     // delete surfaces array
     MSDK_SAFE_DELETE_ARRAY(m_pEncSurfaces);
     MSDK_SAFE_DELETE_ARRAY(m_pVppSurfaces);
@@ -1175,6 +1204,8 @@ CEncodingPipeline::CEncodingPipeline()
     m_pmfxAllocatorParams = NULL;
     m_memType = SYSTEM_MEMORY;
     m_bExternalAlloc = false;
+    m_bSysMemArena = false;
+    m_nNumaNode = MSDK_NUMA_NODE_ANY;
     m_pEncSurfaces = NULL;
     m_pVppSurfaces = NULL;
     m_InputFourCC = 0;
@@ -1192,6 +1223,25 @@ CEncodingPipeline::CEncodingPipeline()
     m_nNumView = 0;
 
     m_FileWriters.first = m_FileWriters.second = NULL;
+    m_MuxFormat = MUX_FORMAT_NONE;
+    m_pMuxWriter = NULL;
+    m_pSegmenter = NULL;
+
+    m_pShmRing = NULL;
+    m_bShmZeroCopy = false;
+
+    m_nLookAheadTick = 0;
+    m_nLookAheadOrder = 0;
+    m_nLastIDROrder = 0;
+    m_nSceneCutIDRs = 0;
+    m_bSceneCutIDR = false;
+
+    m_StaticFrameMode = STATIC_FRAME_ENCODE;
+    m_nMaxStaticFrames = 0;
+    m_nStaticRun = 0;
+    m_nStaticFrames = 0;
+    m_bSkipFrame = false;
+    ClearFrameCtrl(&m_FrameCtrl);
 
     MSDK_ZERO_MEMORY(m_MVCSeqDesc);
     m_MVCSeqDesc.Header.BufferId = MFX_EXTBUFF_MVC_SEQ_DESC;
@@ -1241,12 +1291,22 @@ CEncodingPipeline::CEncodingPipeline()
     MSDK_ZERO_MEMORY(m_ExtBRC);
     m_ExtBRC.Header.BufferId = MFX_EXTBUFF_BRC;
     m_ExtBRC.Header.BufferSz = sizeof(m_ExtBRC);
+    m_pExtBRC = NULL;
 #endif
     m_hwdev = NULL;
 
-#if (MFX_VERSION >= 1027)
-    m_round_in = NULL;
-#endif
+    m_pFrameCtrlEntry = NULL;
+
+    MSDK_ZERO_MEMORY(m_Reconfig);
+    m_bReconfigPending = false;
+    m_nReconfigFrame = 0;
+    m_nFramesSent = 0;
+    m_pHeldFrame = NULL;
+    MSDK_ZERO_MEMORY(m_HeldComplexity);
+    MSDK_ZERO_MEMORY(m_EncAllocInfo);
+    MSDK_ZERO_MEMORY(m_nReconfigs);
+    m_dReconfigTimeMs = 0;
+    m_dMaxReconfigTimeMs = 0;
 
     MSDK_ZERO_MEMORY(m_mfxEncParams);
     MSDK_ZERO_MEMORY(m_mfxVppParams);
@@ -1287,24 +1347,122 @@ mfxStatus CEncodingPipeline::InitFileWriter(CSmplBitstreamWriter **ppWriter, con
     MSDK_CHECK_ERROR(ppWriter, NULL, MFX_ERR_NULL_PTR);
 
     MSDK_SAFE_DELETE(*ppWriter);
-    *ppWriter = new CSmplBitstreamWriter;
+    if (MUX_FORMAT_NONE != m_MuxFormat)
+    {
+        m_pMuxWriter = new CMuxBitstreamWriter(m_MuxFormat);
+        *ppWriter = m_pMuxWriter;
+    }
+    else
+    {
+        *ppWriter = new CSmplBitstreamWriter;
+    }
     MSDK_CHECK_POINTER(*ppWriter, MFX_ERR_MEMORY_ALLOC);
+    if (m_pSegmenter)
+    {
+        filename = m_pSegmenter->GetFirstSegmentName();
+        (*ppWriter)->SetSegmenter(m_pSegmenter);
+    }
     mfxStatus sts = (*ppWriter)->Init(filename);
     MSDK_CHECK_STATUS(sts, " failed");
 
     return sts;
 }
 
+mfxStatus CEncodingPipeline::SetMuxStreamInfo()
+{
+    if (!m_pMuxWriter)
+        return MFX_ERR_NONE;
+
+    // buffers are filled by GetVideoParam with the headers the encoder writes
+    std::vector<mfxU8> spsBuf(1024), ppsBuf(1024), vpsBuf(1024);
+
+    mfxExtCodingOptionSPSPPS spspps;
+    MSDK_ZERO_MEMORY(spspps);
+    spspps.Header.BufferId = MFX_EXTBUFF_CODING_OPTION_SPSPPS;
+    spspps.Header.BufferSz = sizeof(spspps);
+    spspps.SPSBuffer = &spsBuf[0];
+    spspps.SPSBufSize = (mfxU16)spsBuf.size();
+    spspps.PPSBuffer = &ppsBuf[0];
+    spspps.PPSBufSize = (mfxU16)ppsBuf.size();
+
+    mfxExtCodingOptionVPS vps;
+    MSDK_ZERO_MEMORY(vps);
+    vps.Header.BufferId = MFX_EXTBUFF_CODING_OPTION_VPS;
+    vps.Header.BufferSz = sizeof(vps);
+    vps.VPSBuffer = &vpsBuf[0];
+    vps.VPSBufSize = (mfxU16)vpsBuf.size();
+
+    bool bHEVC = (MFX_CODEC_HEVC == m_mfxEncParams.mfx.CodecId);
+    mfxExtBuffer* extBufs[2] = { &spspps.Header, &vps.Header };
+
+    mfxVideoParam par;
+    MSDK_ZERO_MEMORY(par);
+    par.ExtParam = extBufs;
+    par.NumExtParam = bHEVC ? 2 : 1;
+
+    mfxStatus sts = m_pmfxENC->GetVideoParam(&par);
+    MSDK_CHECK_STATUS(sts, "m_pmfxENC->GetVideoParam failed");
+
+    sts = m_pMuxWriter->SetStreamInfo(par, &spspps, bHEVC ? &vps : NULL);
+    MSDK_CHECK_STATUS(sts, "m_pMuxWriter->SetStreamInfo failed");
+
+    return MFX_ERR_NONE;
+}
+
 mfxStatus CEncodingPipeline::InitFileWriters(sInputParams *pParams)
 {
     MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
 
     mfxStatus sts = MFX_ERR_NONE;
 
+    // encoded frames go to another process, no files are written
+    if (*pParams->ShmEgressName)
+    {
+        if (MUX_FORMAT_NONE != pParams->MuxFormat || pParams->nSegmentFrames || pParams->dSegmentSeconds > 0 ||
+            (MVC_VIEWOUTPUT & pParams->MVC_flags))
+        {
+            msdk_printf(MSDK_STRING("error: shared memory output is not supported with muxed, segmented or MVC view output\n"));
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        mfxU32 nSize = pParams->nShmEgressSize ? pParams->nShmEgressSize : MSDK_SHM_EGRESS_DEFAULT_SIZE;
+        m_FileWriters.first = new CShmBitstreamWriter(nSize);
+        sts = m_FileWriters.first->Init(pParams->ShmEgressName);
+        MSDK_CHECK_STATUS(sts, "m_FileWriters.first->Init failed");
+
+        msdk_printf(MSDK_STRING("Shared memory output\t%s, %u bytes\n"), pParams->ShmEgressName, nSize);
+        return MFX_ERR_NONE;
+    }
+
     // no output mode
     if (!pParams->dstFileBuff.size())
         return MFX_ERR_NONE;
 
+    // containers hold a single view
+    m_MuxFormat = pParams->MuxFormat;
+    if (MUX_FORMAT_NONE != m_MuxFormat && (MVC_VIEWOUTPUT & pParams->MVC_flags))
+    {
+        msdk_printf(MSDK_STRING("error: muxed output is not supported in MVC view output mode\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // segment file names and the playlist are derived from the output file name
+    mfxU32 nSegmentFrames = pParams->nSegmentFrames;
+    if (!nSegmentFrames && pParams->dSegmentSeconds > 0)
+        nSegmentFrames = (mfxU32)(pParams->dSegmentSeconds * pParams->dFrameRate + 0.5);
+    if (nSegmentFrames)
+    {
+        if (MVC_VIEWOUTPUT & pParams->MVC_flags)
+        {
+            msdk_printf(MSDK_STRING("error: segmented output is not supported in MVC view output mode\n"));
+            return MFX_ERR_UNSUPPORTED;
+        }
+
+        m_pSegmenter = new CBitstreamSegmenter;
+        sts = m_pSegmenter->Init(pParams->dstFileBuff[0], nSegmentFrames, pParams->dFrameRate);
+        MSDK_CHECK_STATUS(sts, "m_pSegmenter->Init failed");
+    }
+
     // prepare output file writers
 
     // ViewOutput mode: output in single bitstream
@@ -1538,7 +1696,7 @@ mfxStatus CEncodingPipeline::Init(sInputParams *pParams)
     }
 
     // Preparing readers and writers
-    if (!isV4L2InputEnabled)
+    if (!isV4L2InputEnabled && !*pParams->ShmRingName)
     {
         // prepare input file reader
         sts = m_FileReader.Init(pParams->InputFiles,
@@ -1552,10 +1710,25 @@ mfxStatus CEncodingPipeline::Init(sInputParams *pParams)
 
     // set memory type
     m_memType = pParams->memType;
+    m_bSysMemArena = pParams->bSysMemArena;
+    m_nNumaNode = pParams->nNumaNode;
+
+    // allocations below are first touched from the pipeline's node
+    MSDKNumaNodeScope numaScope(m_nNumaNode);
     m_nMemBuffer = pParams->nMemBuf;
 
     m_bSoftRobustFlag = pParams->bSoftRobustFlag;
 
+    if (pParams->nCpuLookAhead)
+    {
+        sts = m_LookAhead.Init(pParams->nCpuLookAhead);
+        MSDK_CHECK_STATUS(sts, "m_LookAhead.Init failed");
+        m_bSceneCutIDR = pParams->bSceneCutIDR;
+    }
+
+    m_StaticFrameMode = pParams->StaticFrameMode;
+    m_nMaxStaticFrames = pParams->nMaxStaticFrames;
+
     // create and init frame allocator
     sts = CreateAllocator();
     MSDK_CHECK_STATUS(sts, "CreateAllocator failed");
@@ -1579,13 +1752,16 @@ mfxStatus CEncodingPipeline::Init(sInputParams *pParams)
     sts = AllocExtBuffers(pParams);
     MSDK_CHECK_STATUS(sts, "Alloc extend buffer failed");
 
+    sts = InitShmRing(pParams);
+    MSDK_CHECK_STATUS(sts, "InitShmRing failed");
 
     InitV4L2Pipeline(pParams);
 
 	m_nFramesToProcess = 600;//pParams->nNumFrames;
 
     // If output isn't specified work in performance mode and do not insert idr
-    m_bCutOutput = pParams->dstFileBuff.size() ? !pParams->bUncut : false;
+    // Segmented output is never rewritten, segments are cut by the segmenter
+    m_bCutOutput = (pParams->dstFileBuff.size() && !m_pSegmenter) ? !pParams->bUncut : false;
 
     // Dumping components configuration if required
     if(*pParams->DumpFileName)
@@ -1678,6 +1854,10 @@ mfxStatus CEncodingPipeline::InitEncFrameParams(sTask* pTask)
     pTask->extBufs = m_encExtBufs.GetFreeSet();
     MSDK_CHECK_POINTER(pTask->extBufs, MFX_ERR_NULL_PTR);
 
+    std::vector<mfxExtBuffer*>& attached = pTask->extBufs->attached;
+    attached.clear();
+    mfxU16 fieldId = 0;
+
     for (std::vector<mfxExtBuffer*>::iterator it = pTask->extBufs->buffers.begin();
             it != pTask->extBufs->buffers.end(); ++it)
     {
@@ -1685,17 +1865,91 @@ mfxStatus CEncodingPipeline::InitEncFrameParams(sTask* pTask)
         {
 #if (MFX_VERSION >= 1027)
             case MFX_EXTBUFF_AVC_ROUNDING_OFFSET:
-                if (m_round_in)
+                // the buffers of a set follow the fields in order
+                if (m_pFrameCtrlEntry && (m_pFrameCtrlEntry->Flags & MSDK_FRAME_CTRL_ROUNDING) && fieldId < 2)
                 {
                     mfxExtAVCRoundingOffset *pAVCRoundingOffset = reinterpret_cast<mfxExtAVCRoundingOffset*>(*it);
+                    const sRoundingOffset& rounding = m_pFrameCtrlEntry->Rounding[fieldId];
 
-                    SAFE_FREAD(&pAVCRoundingOffset->EnableRoundingIntra, sizeof(mfxU16), 1, m_round_in, MFX_ERR_MORE_DATA);
-                    SAFE_FREAD(&pAVCRoundingOffset->RoundingOffsetIntra, sizeof(mfxU16), 1, m_round_in, MFX_ERR_MORE_DATA);
-                    SAFE_FREAD(&pAVCRoundingOffset->EnableRoundingInter, sizeof(mfxU16), 1, m_round_in, MFX_ERR_MORE_DATA);
-                    SAFE_FREAD(&pAVCRoundingOffset->RoundingOffsetInter, sizeof(mfxU16), 1, m_round_in, MFX_ERR_MORE_DATA);
+                    pAVCRoundingOffset->EnableRoundingIntra = rounding.EnableIntra;
+                    pAVCRoundingOffset->RoundingOffsetIntra = rounding.OffsetIntra;
+                    pAVCRoundingOffset->EnableRoundingInter = rounding.EnableInter;
+                    pAVCRoundingOffset->RoundingOffsetInter = rounding.OffsetInter;
+                    attached.push_back(*it);
                 }
+                fieldId++;
                 break;
 #endif
+            case MFX_EXTBUFF_ENCODER_ROI:
+                if (m_FrameCtrl.numROI)
+                {
+                    mfxExtEncoderROI *pROI = reinterpret_cast<mfxExtEncoderROI*>(*it);
+                    pROI->NumROI = (std::min)(m_FrameCtrl.numROI, (mfxU16)MSDK_FRAME_CTRL_MAX_ROI);
+#if (MFX_VERSION >= 1022)
+                    pROI->ROIMode = MFX_ROI_MODE_QP_DELTA;
+#endif
+                    for (mfxU16 i = 0; i < pROI->NumROI; i++)
+                    {
+                        pROI->ROI[i].Left   = m_FrameCtrl.roi[i].left;
+                        pROI->ROI[i].Top    = m_FrameCtrl.roi[i].top;
+                        pROI->ROI[i].Right  = m_FrameCtrl.roi[i].right;
+                        pROI->ROI[i].Bottom = m_FrameCtrl.roi[i].bottom;
+#if (MFX_VERSION >= 1022)
+                        pROI->ROI[i].DeltaQP = m_FrameCtrl.roi[i].deltaQP;
+#else
+                        // a priority has the opposite sign of a QP change
+                        pROI->ROI[i].Priority = -m_FrameCtrl.roi[i].deltaQP;
+#endif
+                    }
+                    attached.push_back(*it);
+                }
+                break;
+
+            case MFX_EXTBUFF_MBQP:
+                // the buffers were sized for the first frame size, a larger frame goes without a map
+                if (!m_FrameCtrl.qpMap.empty() && reinterpret_cast<mfxExtMBQP*>(*it)->NumQPAlloc >= GetQPMapSize())
+                {
+                    mfxExtMBQP *pMBQP = reinterpret_cast<mfxExtMBQP*>(*it);
+                    mfxU32 n = (std::min)((mfxU32)m_FrameCtrl.qpMap.size(), pMBQP->NumQPAlloc);
+                    memcpy(pMBQP->QP, m_FrameCtrl.qpMap.data(), n);
+                    // blocks past the end of a short map take the QP of its last block
+                    if (n < pMBQP->NumQPAlloc)
+                        memset(pMBQP->QP + n, pMBQP->QP[n - 1], pMBQP->NumQPAlloc - n);
+                    attached.push_back(*it);
+                }
+                break;
+
+            case MFX_EXTBUFF_AVC_REFLIST_CTRL:
+                if (m_FrameCtrl.numPreferredRefs || m_FrameCtrl.numRejectedRefs || m_FrameCtrl.longTermRef)
+                {
+                    mfxExtAVCRefListCtrl *pRefList = reinterpret_cast<mfxExtAVCRefListCtrl*>(*it);
+                    for (mfxU32 i = 0; i < MSDK_ARRAY_LEN(pRefList->PreferredRefList); i++)
+                    {
+                        pRefList->PreferredRefList[i].FrameOrder = MFX_FRAMEORDER_UNKNOWN;
+                        pRefList->RejectedRefList[i].FrameOrder = MFX_FRAMEORDER_UNKNOWN;
+                        pRefList->LongTermRefList[i].FrameOrder = MFX_FRAMEORDER_UNKNOWN;
+                    }
+                    mfxU16 nPreferred = (std::min)(m_FrameCtrl.numPreferredRefs, (mfxU16)MSDK_FRAME_CTRL_MAX_REFS);
+                    for (mfxU16 i = 0; i < nPreferred; i++)
+                    {
+                        pRefList->PreferredRefList[i].FrameOrder = m_FrameCtrl.preferredRefs[i];
+                        pRefList->PreferredRefList[i].PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
+                    }
+                    mfxU16 nRejected = (std::min)(m_FrameCtrl.numRejectedRefs, (mfxU16)MSDK_FRAME_CTRL_MAX_REFS);
+                    for (mfxU16 i = 0; i < nRejected; i++)
+                    {
+                        pRefList->RejectedRefList[i].FrameOrder = m_FrameCtrl.rejectedRefs[i];
+                        pRefList->RejectedRefList[i].PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
+                    }
+                    if (m_FrameCtrl.longTermRef)
+                    {
+                        // the frame being encoded is the last one read
+                        pRefList->LongTermRefList[0].FrameOrder = m_nFramesRead - 1;
+                        pRefList->LongTermRefList[0].PicStruct = MFX_PICSTRUCT_PROGRESSIVE;
+                    }
+                    attached.push_back(*it);
+                }
+                break;
 
             default:
                 msdk_printf(MSDK_STRING("Unsupported extension buffer, ignored\n"));
@@ -1703,20 +1957,30 @@ mfxStatus CEncodingPipeline::InitEncFrameParams(sTask* pTask)
         }
     }
 
-    if(!pTask->extBufs->buffers.empty())
-    {
-        m_encCtrl.NumExtParam = (mfxU16)(pTask->extBufs->buffers.size());
-        m_encCtrl.ExtParam    = pTask->extBufs->buffers.data();
-    }
+    // buffers of the previous frame must not stay attached
+    m_encCtrl.NumExtParam = (mfxU16)attached.size();
+    m_encCtrl.ExtParam    = attached.empty() ? NULL : attached.data();
 
     return sts;
 }
 
+// a frame from the producer with everything it owns
+static void FreeFrameDesc(frame_desc_t* pFrame)
+{
+	if (pFrame->yuvBuf[0]) delete pFrame->yuvBuf[0];
+	if (pFrame->yuvBuf[1]) delete pFrame->yuvBuf[1];
+	if (pFrame->yuvBuf[2]) delete pFrame->yuvBuf[2];
+	if (pFrame->pCtrl) delete pFrame->pCtrl;
+	delete pFrame;
+}
+
 void CEncodingPipeline::Close()
 {
     if (m_FileWriters.first)
     {
         msdk_printf(MSDK_STRING("Frame number: %u\r\n"), m_FileWriters.first->m_nProcessedFramesNum);
+        if (MSDK_NUMA_NODE_ANY != m_nNumaNode)
+            msdk_printf(MSDK_STRING("NUMA node %d, remote surface pages: %.1f%%\r\n"), m_nNumaNode, GetRemotePageRatio() * 100);
 #ifdef TIME_STATS
         mfxF64 ProcDeltaTime = m_statOverall.GetDeltaTime() - m_statFile.GetDeltaTime() - m_TaskPool.GetFileStatistics().GetDeltaTime();
         msdk_printf(MSDK_STRING("Encoding fps: %.0f\n"), m_FileWriters.first->m_nProcessedFramesNum / ProcDeltaTime);
@@ -1740,14 +2004,58 @@ void CEncodingPipeline::Close()
     MSDK_SAFE_DELETE(m_pmfxVPP);
 
 #if (MFX_VERSION >= 1024)
+    if (m_pExtBRC)
+        msdk_printf(MSDK_STRING("BRC recodes: %u\r\n"), m_pExtBRC->GetRecodeCount());
+    m_BRCTrace.Detach(m_ExtBRC);
     HEVCExtBRC::Destroy(m_ExtBRC);
+    m_pExtBRC = NULL;
 #endif
 
+    if (m_LookAhead.GetDepth())
+    {
+        msdk_printf(MSDK_STRING("Lookahead: %u frames, %u scene cuts, %u IDR inserted, %.2f ms/frame\r\n"),
+            m_LookAhead.GetFrameCount(), m_LookAhead.GetSceneCutCount(), m_nSceneCutIDRs, m_LookAhead.GetAvgTimeMs());
+        m_LookAhead.Close();
+    }
+    if (m_FrameDiff.GetFrameCount())
+    {
+        msdk_printf(MSDK_STRING("Static frames: %u of %u %s, %.1f%% of tiles changed, %.2f ms/frame\r\n"),
+            m_nStaticFrames, m_FrameDiff.GetFrameCount(),
+            STATIC_FRAME_DROP == m_StaticFrameMode ? MSDK_STRING("dropped") : MSDK_STRING("skipped"),
+            m_FrameDiff.GetAvgDirtyRatio() * 100, m_FrameDiff.GetAvgTimeMs());
+        m_FrameDiff.Close();
+    }
+    m_nStaticRun = 0;
+    m_nStaticFrames = 0;
+    while (!m_LookAheadFrames.empty())
+    {
+        FreeFrameDesc(m_LookAheadFrames.front());
+        m_LookAheadFrames.pop_front();
+    }
+    if (m_pHeldFrame)
+    {
+        FreeFrameDesc(m_pHeldFrame);
+        m_pHeldFrame = NULL;
+    }
+
+    mfxU32 nReconfigs = m_nReconfigs[RECONFIG_RESET] + m_nReconfigs[RECONFIG_NEW_SEQUENCE] +
+        m_nReconfigs[RECONFIG_REINIT] + m_nReconfigs[RECONFIG_FULL];
+    if (nReconfigs)
+    {
+        msdk_printf(MSDK_STRING("Reconfigurations: %u reset, %u new sequence, %u reinit, %u full, %.2f ms average, %.2f ms max\r\n"),
+            m_nReconfigs[RECONFIG_RESET], m_nReconfigs[RECONFIG_NEW_SEQUENCE], m_nReconfigs[RECONFIG_REINIT],
+            m_nReconfigs[RECONFIG_FULL], m_dReconfigTimeMs / nReconfigs, m_dMaxReconfigTimeMs);
+    }
+    MSDK_ZERO_MEMORY(m_nReconfigs);
+    m_dReconfigTimeMs = 0;
+    m_dMaxReconfigTimeMs = 0;
+
 
     FreeMVCSeqDesc();
     FreeVppDoNotUse();
 
     DeleteFrames();
+    MSDK_SAFE_DELETE(m_pShmRing);
 
     m_pPlugin.reset();
 
@@ -1757,13 +2065,8 @@ void CEncodingPipeline::Close()
     m_FileReader.Close();
     FreeFileWriters();
 
-#if (MFX_VERSION >= 1027)
-    if(m_round_in)
-    {
-        fclose(m_round_in);
-        m_round_in = NULL;
-    }
-#endif
+    m_FrameCtrlTable.Close();
+    m_pFrameCtrlEntry = NULL;
 
     m_encExtBufs.Clear();
 
@@ -1785,6 +2088,13 @@ void CEncodingPipeline::FreeFileWriters()
     if (m_FileWriters.second)
         m_FileWriters.second->Close();
     MSDK_SAFE_DELETE(m_FileWriters.second);
+
+    m_pMuxWriter = NULL;
+
+    // after the writer closed the last segment
+    if (m_pSegmenter)
+        m_pSegmenter->Close();
+    MSDK_SAFE_DELETE(m_pSegmenter);
 }
 
 mfxStatus CEncodingPipeline::FillBuffers()
@@ -1807,6 +2117,20 @@ mfxStatus CEncodingPipeline::FillBuffers()
     return MFX_ERR_NONE;
 }
 
+mfxF64 CEncodingPipeline::GetRemotePageRatio()
+{
+    mfxU32 nLocal = 0, nRemote = 0;
+    if (MSDK_NUMA_NODE_ANY == m_nNumaNode || m_bExternalAlloc)
+        return 0.0;
+
+    for (mfxU32 i = 0; m_pEncSurfaces && i < m_EncResponse.NumFrameActual; i++)
+        CountSurfacePages(&m_pEncSurfaces[i], m_nNumaNode, &nLocal, &nRemote);
+    for (mfxU32 i = 0; m_pVppSurfaces && i < m_VppResponse.NumFrameActual; i++)
+        CountSurfacePages(&m_pVppSurfaces[i], m_nNumaNode, &nLocal, &nRemote);
+
+    return (nLocal + nRemote) ? (mfxF64)nRemote / (nLocal + nRemote) : 0.0;
+}
+
 mfxStatus CEncodingPipeline::ResetMFXComponents(sInputParams* pParams)
 {
     MSDK_CHECK_POINTER(pParams, MFX_ERR_NULL_PTR);
@@ -1825,14 +2149,26 @@ mfxStatus CEncodingPipeline::ResetMFXComponents(sInputParams* pParams)
         MSDK_CHECK_STATUS(sts, "m_pmfxVPP->Close failed");
     }
 
+    MSDKNumaNodeScope numaScope(m_nNumaNode);
+
+    CTimer resetTimer;
+    resetTimer.Start();
+
     // free allocated frames
     DeleteFrames();
 
     m_TaskPool.Close();
 
+    // the encoder counts display order from 0 again
+    m_nLookAheadOrder = 0;
+    m_nLastIDROrder = 0;
+
     sts = AllocFrames();
     MSDK_CHECK_STATUS(sts, "AllocFrames failed");
 
+    // with arena mode the frames come from the slabs of the previous allocation
+    msdk_printf(MSDK_STRING("Frames reallocated in %.2f ms\n"), resetTimer.GetTime() * 1000);
+
     m_mfxEncParams.mfx.FrameInfo.FourCC       = m_mfxVppParams.vpp.Out.FourCC;
     m_mfxEncParams.mfx.FrameInfo.ChromaFormat = m_mfxVppParams.vpp.Out.ChromaFormat;
 
@@ -1851,6 +2187,9 @@ mfxStatus CEncodingPipeline::ResetMFXComponents(sInputParams* pParams)
 
     MSDK_CHECK_STATUS(sts, "m_pmfxENC->Init failed");
 
+    sts = SetMuxStreamInfo();
+    MSDK_CHECK_STATUS(sts, "SetMuxStreamInfo failed");
+
     if (m_bIsFieldSplitting)
     {
         if (pParams->nPicStruct & MFX_PICSTRUCT_FIELD_BFF)
@@ -1887,34 +2226,56 @@ mfxStatus CEncodingPipeline::ResetMFXComponents(sInputParams* pParams)
     return MFX_ERR_NONE;
 }
 
+mfxU32 CEncodingPipeline::GetQPMapSize()
+{
+    const mfxFrameInfo& info = m_mfxEncParams.mfx.FrameInfo;
+    return ((info.Width + MSDK_FRAME_CTRL_QP_BLOCK - 1) / MSDK_FRAME_CTRL_QP_BLOCK) *
+           ((info.Height + MSDK_FRAME_CTRL_QP_BLOCK - 1) / MSDK_FRAME_CTRL_QP_BLOCK);
+}
+
 mfxStatus CEncodingPipeline::AllocExtBuffers(sInputParams *pInParams)
 {
     MSDK_CHECK_POINTER(pInParams, MFX_ERR_NULL_PTR);
     mfxStatus sts = MFX_ERR_NONE;
 
+    mfxU16  numOfFields  = pInParams->nPicStruct != MFX_PICSTRUCT_PROGRESSIVE ? 2 : 1;
+
+    // the table is read and checked once, encoding only indexes it
+    const msdk_char* tableFile = pInParams->FrameCtrlTableFile[0] ? pInParams->FrameCtrlTableFile : NULL;
 #if (MFX_VERSION >= 1027)
-    bool enableRoundingOffset = pInParams->RoundingOffsetFile && pInParams->CodecId == MFX_CODEC_AVC;
-    if (enableRoundingOffset && m_round_in == NULL)
+    // an older rounding offset file is read as a table too
+    if (!tableFile)
+        tableFile = pInParams->RoundingOffsetFile;
+#endif
+    if (tableFile && !m_FrameCtrlTable.GetFrameCount())
     {
-        MSDK_FOPEN(m_round_in, pInParams->RoundingOffsetFile, MSDK_CHAR("rb"));
-        if (m_round_in == NULL) {
-            msdk_printf(MSDK_STRING("ERROR: Can't open file %s\n"), pInParams->RoundingOffsetFile);
-            return MFX_ERR_UNSUPPORTED;
-        }
-
-        msdk_printf(MSDK_STRING("Using rounding offset input file: %s\n"), pInParams->RoundingOffsetFile);
+        sts = m_FrameCtrlTable.Load(tableFile, numOfFields);
+        MSDK_CHECK_STATUS(sts, "m_FrameCtrlTable.Load failed");
     }
-    else
+
+    bool enableRoundingOffset = false;
+#if (MFX_VERSION >= 1027)
+    enableRoundingOffset = (m_FrameCtrlTable.GetFlags() & MSDK_FRAME_CTRL_ROUNDING) && pInParams->CodecId == MFX_CODEC_AVC;
+#endif
+    // a QP change of the table is a region of interest over the whole frame
+    const bool enableROI = pInParams->bFrameCtrl || (m_FrameCtrlTable.GetFlags() & MSDK_FRAME_CTRL_QP_DELTA);
+    if (!enableRoundingOffset && !enableROI && !pInParams->bEnableMBQP)
     {
         return sts;
     }
 
+    // QP map of the 16x16 blocks of the encoded frame
+    const mfxU32 numOfQP = GetQPMapSize();
+
     std::unique_ptr<bufSet> tmpForInit;
-    mfxU16  numOfFields  = pInParams->nPicStruct != MFX_PICSTRUCT_PROGRESSIVE ? 2 : 1;
     mfxU16  numOfBuffers = pInParams->nGopRefDist * 2 + pInParams->nAsyncDepth + pInParams->nNumRefFrame + 1;
 
+    // every buffer is allocated here and cycled, a frame only fills and attaches the ones it uses
     for (int k = 0; k < numOfBuffers; k++)
     {
+        tmpForInit.reset(new bufSet(numOfFields));
+
+#if (MFX_VERSION >= 1027)
         mfxExtAVCRoundingOffset* pAvcRoundingOffset = NULL;
         for (mfxU16 fieldId = 0; fieldId < numOfFields; fieldId++)
         {
@@ -1932,7 +2293,6 @@ mfxStatus CEncodingPipeline::AllocExtBuffers(sInputParams *pInParams)
             }
         }
 
-        tmpForInit.reset(new bufSet(numOfFields));
         if(enableRoundingOffset)
         {
             for (mfxU16 fieldId = 0; fieldId < numOfFields; fieldId++)
@@ -1940,10 +2300,45 @@ mfxStatus CEncodingPipeline::AllocExtBuffers(sInputParams *pInParams)
                 tmpForInit->buffers.push_back(reinterpret_cast<mfxExtBuffer*>(&pAvcRoundingOffset[fieldId]));
             }
         }
+#endif
+
+        if (enableROI)
+        {
+            mfxExtEncoderROI* pROI = new mfxExtEncoderROI;
+            MSDK_CHECK_POINTER(pROI, MFX_ERR_MEMORY_ALLOC);
+            MSDK_ZERO_MEMORY(*pROI);
+            pROI->Header.BufferId = MFX_EXTBUFF_ENCODER_ROI;
+            pROI->Header.BufferSz = sizeof(mfxExtEncoderROI);
+            tmpForInit->buffers.push_back(reinterpret_cast<mfxExtBuffer*>(pROI));
+        }
+
+        if (pInParams->bFrameCtrl)
+        {
+            mfxExtAVCRefListCtrl* pRefList = new mfxExtAVCRefListCtrl;
+            MSDK_CHECK_POINTER(pRefList, MFX_ERR_MEMORY_ALLOC);
+            MSDK_ZERO_MEMORY(*pRefList);
+            pRefList->Header.BufferId = MFX_EXTBUFF_AVC_REFLIST_CTRL;
+            pRefList->Header.BufferSz = sizeof(mfxExtAVCRefListCtrl);
+            tmpForInit->buffers.push_back(reinterpret_cast<mfxExtBuffer*>(pRefList));
+        }
+
+        if (pInParams->bEnableMBQP)
+        {
+            mfxExtMBQP* pMBQP = new mfxExtMBQP;
+            MSDK_CHECK_POINTER(pMBQP, MFX_ERR_MEMORY_ALLOC);
+            MSDK_ZERO_MEMORY(*pMBQP);
+            pMBQP->Header.BufferId = MFX_EXTBUFF_MBQP;
+            pMBQP->Header.BufferSz = sizeof(mfxExtMBQP);
+            tmpForInit->buffers.push_back(reinterpret_cast<mfxExtBuffer*>(pMBQP));
+
+            pMBQP->QP = new mfxU8[numOfQP];
+            MSDK_CHECK_POINTER(pMBQP->QP, MFX_ERR_MEMORY_ALLOC);
+            pMBQP->NumQPAlloc = numOfQP;
+        }
 
+        tmpForInit->attached.reserve(tmpForInit->buffers.size());
         m_encExtBufs.AddSet(std::move(tmpForInit));
     }
-#endif
 
     return sts;
 }
@@ -2010,6 +2405,10 @@ mfxStatus CEncodingPipeline::Run()
     m_statOverall.StartTimeMeasurement();
     MSDK_CHECK_POINTER(m_pmfxENC, MFX_ERR_NOT_INITIALIZED);
 
+    if (MSDK_NUMA_NODE_ANY != m_nNumaNode)
+        msdk_numa_bind_thread(m_nNumaNode);
+    msdk_thread_apply_role(MSDK_THREAD_ROLE_PIPELINE);
+
     mfxStatus sts = MFX_ERR_NONE;
 
     mfxFrameSurface1* pSurf = NULL; // dispatching pointer
@@ -2053,6 +2452,13 @@ mfxStatus CEncodingPipeline::Run()
             break;
         }
 #endif
+        // between two frames, with no VPP output waiting for the encoder
+        if (m_bReconfigPending && !bVppMultipleOutput && !skipLoadingNextFrame)
+        {
+            sts = ApplyReconfig();
+            MSDK_BREAK_ON_ERROR(sts);
+        }
+
         // get a pointer to a free task (bit stream and sync point for encoder)
         sts = GetFreeTask(&pCurrentTask);
         MSDK_BREAK_ON_ERROR(sts);
@@ -2108,6 +2514,10 @@ mfxStatus CEncodingPipeline::Run()
 
                 MSDK_BREAK_ON_ERROR(sts);
 
+                // the first frame of a segment must be an IDR frame
+                if (m_pSegmenter && m_pSegmenter->IsBoundary(pSurf->Data.TimeStamp))
+                    m_bInsertIDR = true;
+
                 if (MVC_ENABLED & m_MVCflags)
                 {
                     currViewNum ^= 1; // Flip between 0 and 1 for ViewId
@@ -2168,16 +2578,23 @@ mfxStatus CEncodingPipeline::Run()
             VppSyncPoint = NULL;
         }
 
-        for (;;)
-        {
-            InsertIDR(m_bInsertIDR);
+        ApplyFrameCtrlTable();
+
+        InsertIDR(m_bInsertIDR);
+        // a frame type sent with the frame, unless an IDR is due anyway
+        if (m_FrameCtrl.frameType && !m_bInsertIDR)
+            m_encCtrl.FrameType = m_FrameCtrl.frameType;
+        // an unchanged frame goes out as a dummy frame of skipped blocks, unless its type is forced
+        m_encCtrl.SkipFrame = (m_bSkipFrame && MFX_FRAMETYPE_UNKNOWN == m_encCtrl.FrameType) ? 1 : 0;
 
-            sts = InitEncFrameParams(pCurrentTask);
-            MSDK_CHECK_STATUS(sts, "ENCODE: InitEncFrameParams failed");
+        // once per frame, retries below resubmit the same controls and buffers
+        sts = InitEncFrameParams(pCurrentTask);
+        MSDK_CHECK_STATUS(sts, "ENCODE: InitEncFrameParams failed");
 
+        for (;;)
+        {
             // at this point surface for encoder contains either a frame from file or a frame processed by vpp
             sts = m_pmfxENC->EncodeFrameAsync(&m_encCtrl, &m_pEncSurfaces[nEncSurfIdx], &pCurrentTask->mfxBS, &pCurrentTask->EncSyncP);
-            m_bInsertIDR = false;
 
             if (m_nMemBuffer)
             {
@@ -2207,6 +2624,13 @@ mfxStatus CEncodingPipeline::Run()
             }
         }
 
+        // the frame was taken or failed, its controls must not reach the next one
+        m_bInsertIDR = false;
+        m_bSkipFrame = false;
+        m_encCtrl.SkipFrame = 0;
+        ClearFrameCtrl(&m_FrameCtrl);
+        m_pFrameCtrlEntry = NULL;
+
         nFramesProcessed++;
     }
 
@@ -2374,6 +2798,22 @@ mfxStatus CEncodingPipeline::SndFrame(frame_desc_t* frame)
 	//printf("[DEBUG]--->CEncodingPipeline::SndFrame Cnt(%d)\r\n", ++t);
 	AutoLock l(m_lock);
 	m_readyQueue.enqueue(frame);
+	m_nFramesSent++;
+	return MFX_ERR_NONE;
+}
+
+mfxStatus CEncodingPipeline::Reconfigure(const sReconfigParams &par)
+{
+	AutoLock l(m_lock);
+	// changes not applied yet are kept unless given again
+	if (par.nBitRate)    m_Reconfig.nBitRate = par.nBitRate;
+	if (par.nMaxKbps)    m_Reconfig.nMaxKbps = par.nMaxKbps;
+	if (par.nGopPicSize) m_Reconfig.nGopPicSize = par.nGopPicSize;
+	if (par.nGopRefDist) m_Reconfig.nGopRefDist = par.nGopRefDist;
+	if (par.dFrameRate > 0) m_Reconfig.dFrameRate = par.dFrameRate;
+	// frames already queued keep the old parameters
+	m_nReconfigFrame = m_nFramesSent;
+	m_bReconfigPending = true;
 	return MFX_ERR_NONE;
 }
 
@@ -2381,16 +2821,68 @@ mfxStatus CEncodingPipeline::GetFrame(mfxFrameSurface1* pSurf)
 {
 	mfxStatus sts = MFX_ERR_NONE;
 	MSDK_CHECK_POINTER(pSurf, MFX_ERR_NULL_PTR);
-	mfxU32 i;
 	mfxU16 w, h, pitch;
 	mfxU8* ptr_y;
 	mfxU8* ptr_uv;
 	mfxFrameInfo& pInfo = pSurf->Info;
 	mfxFrameData& pData = pSurf->Data;
 
-	frame_desc_t* pFrame;
+	if (m_pShmRing)
+		return LoadShmFrame(pSurf);
+
+	frame_desc_t* pFrame = NULL;
+	sFrameComplexity la;
 	AutoLock l(m_lock);
-	bool found = m_readyQueue.try_dequeue(pFrame);
+	bool found = false;
+	if (m_pHeldFrame)
+	{
+		// the encoder has been reconfigured for its size meanwhile
+		pFrame = m_pHeldFrame;
+		la = m_HeldComplexity;
+		m_pHeldFrame = NULL;
+		found = true;
+	}
+	else
+	{
+		found = m_LookAhead.GetDepth() ? GetLookAheadFrame(&pFrame, &la) : m_readyQueue.try_dequeue(pFrame);
+
+		// a frame of another size is held back until the encoder takes that size, VPP scales any size
+		const mfxFrameInfo& encInfo = m_mfxEncParams.mfx.FrameInfo;
+		if (found && !m_pmfxVPP && (pFrame->lumaWidth != encInfo.CropW || pFrame->lumaHeight != encInfo.CropH))
+		{
+			m_pHeldFrame = pFrame;
+			m_HeldComplexity = la;
+			m_Reconfig.nDstWidth = (mfxU16)pFrame->lumaWidth;
+			m_Reconfig.nDstHeight = (mfxU16)pFrame->lumaHeight;
+			m_nReconfigFrame = m_nFramesRead;
+			m_bReconfigPending = true;
+			return MFX_ERR_MORE_DATA;
+		}
+	}
+
+	if (found && IsStaticFrame(pFrame))
+	{
+		// a frame with a forced type is skipped at most, never dropped
+		const sFrameCtrlEntry* pEntry = m_FrameCtrlTable.Get(m_nFramesRead);
+		const bool bForcedType = (pFrame->pCtrl && pFrame->pCtrl->frameType) ||
+			(pEntry && (pEntry->Flags & MSDK_FRAME_CTRL_FRAME_TYPE));
+		if (STATIC_FRAME_DROP == m_StaticFrameMode && !bForcedType)
+		{
+			// the frame is not encoded, its time slot stays empty in the output
+			m_nFramesRead++;
+			FreeFrameDesc(pFrame);
+			return MFX_ERR_MORE_DATA;
+		}
+		// still converted below, the surface keeps the picture should the encoder not skip it
+		m_bSkipFrame = true;
+	}
+	if (found && m_LookAhead.GetDepth())
+		ApplyLookAhead(la);
+
+	// controls sent with the frame apply when it is encoded
+	if (found && pFrame->pCtrl)
+		std::swap(m_FrameCtrl, *pFrame->pCtrl);
+
 	if (found)
 	{
 		//printf("[DEBUG]--->CEncodingPipeline::GetFrame Cnt(%d)\r\n", ++t);
@@ -2408,36 +2900,46 @@ mfxStatus CEncodingPipeline::GetFrame(mfxFrameSurface1* pSurf)
 		if (MFX_FOURCC_NV12 == pInfo.FourCC)
 		{
 			pitch = pData.Pitch;
-			ptr_y = pData.Y + pInfo.CropX + pInfo.CropY * pData.Pitch;
-
-			// read luminance plane
-			memcpy(ptr_y, pFrame->yuvBuf[0], pFrame->lumaHeight * pFrame->lumaWidth);
-#if 1
-			// read chroma planes
+			ptr_y = pData.Y + pInfo.CropX + pInfo.CropY * pitch;
 			ptr_uv = pData.UV + pInfo.CropX + (pInfo.CropY / 2) * pitch;
-			int i32Len = pFrame->lumaHeight * pFrame->lumaWidth / 4;
-			mfxU8* u = new mfxU8[i32Len];
-			mfxU8* v = new mfxU8[i32Len];
-			memcpy(u, pFrame->yuvBuf[1], i32Len);
-			memcpy(v, pFrame->yuvBuf[2], i32Len);
 
-			for (i = 0; i < i32Len; i++)
+			// a frame larger than the surface, should the encoder not have taken its size, is cropped
+			const mfxU32 width = (std::min)(pFrame->lumaWidth, (unsigned int)w);
+			const mfxU32 height = (std::min)(pFrame->lumaHeight, (unsigned int)h);
+			const mfxU32 lumaStride = pFrame->lumaStride ? (mfxU32)pFrame->lumaStride : pFrame->lumaWidth;
+			const mfxU32 chromaStride = pFrame->chromaStride ? (mfxU32)pFrame->chromaStride : pFrame->lumaWidth / 2;
+
+			// I420 -> NV12 on the task pool, a chroma row and its two luma rows at a time
+			msdk_parallel_for(0, height / 2, [&](mfxU32 first, mfxU32 last)
 			{
-				ptr_uv[2 * i + 0] = u[i];
-				ptr_uv[2 * i + 1] = v[i];
-			}
-			if (u)delete u;
-			if (v)delete v;
-
-			//fwrite(ptr_y, 1, w * h, fou);
-			//fwrite(ptr_uv, 1, w * h >> 1, fou);
-#endif
+				for (mfxU32 row = first; row < last; row++)
+				{
+					memcpy(ptr_y + 2 * row * pitch, pFrame->yuvBuf[0] + 2 * row * lumaStride, width);
+					memcpy(ptr_y + (2 * row + 1) * pitch, pFrame->yuvBuf[0] + (2 * row + 1) * lumaStride, width);
+
+					const mfxU8 *u = pFrame->yuvBuf[1] + row * chromaStride;
+					const mfxU8 *v = pFrame->yuvBuf[2] + row * chromaStride;
+					mfxU8 *uv = ptr_uv + row * pitch;
+					for (mfxU32 i = 0; i < width / 2; i++)
+					{
+						uv[2 * i + 0] = u[i];
+						uv[2 * i + 1] = v[i];
+					}
+				}
+			}, MSDK_INPUT_CONVERT_GRAIN);
+		}
+		// 90 kHz time stamps for the muxing writer, the encoder derives DecodeTimeStamp from them
+		if (m_pMuxWriter)
+		{
+			const mfxFrameInfo& encInfo = m_mfxEncParams.mfx.FrameInfo;
+			pData.TimeStamp = encInfo.FrameRateExtN ? (mfxU64)m_nFramesRead * 90000 * encInfo.FrameRateExtD / encInfo.FrameRateExtN : 0;
 		}
+		// reference hints name frames by this order
+		pData.FrameOrder = m_nFramesRead;
+		m_nFramesRead++;
+
 		//printf("[DEBUG]--->CEncodingPipeline::GetFrame Cnt---------------( 3 )\r\n");
-		if (pFrame->yuvBuf[0]) delete pFrame->yuvBuf[0];
-		if (pFrame->yuvBuf[1]) delete pFrame->yuvBuf[1];
-		if (pFrame->yuvBuf[2]) delete pFrame->yuvBuf[2];
-		if (pFrame) delete pFrame;
+		FreeFrameDesc(pFrame);
 
 		sts = MFX_ERR_NONE;
 	}
@@ -2448,6 +2950,584 @@ mfxStatus CEncodingPipeline::GetFrame(mfxFrameSurface1* pSurf)
 	return sts;
 }
 
+bool CEncodingPipeline::GetLookAheadFrame(frame_desc_t **ppFrame, sFrameComplexity *pComplexity)
+{
+    frame_desc_t *pFrame = NULL;
+    while (m_LookAheadFrames.size() <= m_LookAhead.GetDepth() && m_readyQueue.try_dequeue(pFrame))
+    {
+        const mfxU32 lumaStride = pFrame->lumaStride ? (mfxU32)pFrame->lumaStride : pFrame->lumaWidth;
+        m_LookAhead.Push(pFrame->yuvBuf[0], pFrame->lumaWidth, pFrame->lumaHeight, lumaStride);
+        m_LookAheadFrames.push_back(pFrame);
+        m_nLookAheadTick = msdk_time_get_tick();
+    }
+    if (m_LookAheadFrames.empty())
+        return false;
+
+    // the window is not full: wait for more, unless a live source stalled for about two windows
+    if (m_LookAheadFrames.size() <= m_LookAhead.GetDepth())
+    {
+        mfxF64 idle = (mfxF64)(msdk_time_get_tick() - m_nLookAheadTick) / msdk_time_get_frequency();
+        if (idle * GetFrameRate() < 2.0 * m_LookAhead.GetDepth())
+            return false;
+    }
+
+    m_LookAhead.Pop(pComplexity);
+    *ppFrame = m_LookAheadFrames.front();
+    m_LookAheadFrames.pop_front();
+    return true;
+}
+
+void CEncodingPipeline::ApplyLookAhead(const sFrameComplexity &la)
+{
+    // an IDR at the cut instead of a P frame predicting from the old scene, at most two a second
+    if (m_bSceneCutIDR && la.bSceneCut && la.nOrder && m_nLookAheadOrder - m_nLastIDROrder >= GetFrameRate() / 2)
+    {
+        m_bInsertIDR = true;
+        m_nSceneCutIDRs++;
+    }
+    if (m_bInsertIDR)
+        m_nLastIDROrder = m_nLookAheadOrder;
+
+#if (MFX_VERSION >= 1024)
+    // VPP may change the frame count, the BRC would see the analysis of other frames
+    if (m_pExtBRC && !m_pmfxVPP)
+        m_pExtBRC->SetFrameComplexity(m_nLookAheadOrder, la);
+#endif
+    m_nLookAheadOrder++;
+}
+
+void CEncodingPipeline::ApplyFrameCtrlTable()
+{
+    // the frame being encoded is the last one read
+    m_pFrameCtrlEntry = m_nFramesRead ? m_FrameCtrlTable.Get(m_nFramesRead - 1) : NULL;
+    if (!m_pFrameCtrlEntry)
+        return;
+
+    // controls sent with the frame come first
+    if ((m_pFrameCtrlEntry->Flags & MSDK_FRAME_CTRL_FRAME_TYPE) && !m_FrameCtrl.frameType)
+        m_FrameCtrl.frameType = m_pFrameCtrlEntry->FrameType;
+
+    // the regions sent with the frame are listed first and keep their own QP
+    if ((m_pFrameCtrlEntry->Flags & MSDK_FRAME_CTRL_QP_DELTA) && m_pFrameCtrlEntry->QPDelta &&
+        m_FrameCtrl.numROI < MSDK_FRAME_CTRL_MAX_ROI)
+    {
+        const mfxFrameInfo& info = m_mfxEncParams.mfx.FrameInfo;
+        const mfxU16 i = m_FrameCtrl.numROI++;
+        m_FrameCtrl.roi[i].left    = 0;
+        m_FrameCtrl.roi[i].top     = 0;
+        m_FrameCtrl.roi[i].right   = info.Width;
+        m_FrameCtrl.roi[i].bottom  = info.Height;
+        m_FrameCtrl.roi[i].deltaQP = m_pFrameCtrlEntry->QPDelta;
+    }
+}
+
+mfxF64 CEncodingPipeline::GetFrameRate()
+{
+    const mfxFrameInfo& info = m_mfxEncParams.mfx.FrameInfo;
+    return (info.FrameRateExtN && info.FrameRateExtD) ? (mfxF64)info.FrameRateExtN / info.FrameRateExtD : 30.0;
+}
+
+eReconfigType CEncodingPipeline::ClassifyReconfig(const mfxVideoParam &par)
+{
+    const mfxInfoMFX& cur = m_mfxEncParams.mfx;
+    const mfxInfoMFX& mfx = par.mfx;
+
+    bool bSize = mfx.FrameInfo.CropW != cur.FrameInfo.CropW || mfx.FrameInfo.CropH != cur.FrameInfo.CropH;
+    bool bFrameRate = (mfxU64)mfx.FrameInfo.FrameRateExtN * cur.FrameInfo.FrameRateExtD !=
+        (mfxU64)cur.FrameInfo.FrameRateExtN * mfx.FrameInfo.FrameRateExtD;
+    bool bBitRate = mfx.TargetKbps != cur.TargetKbps || mfx.MaxKbps != cur.MaxKbps;
+    bool bGop = mfx.GopPicSize != cur.GopPicSize || mfx.GopRefDist != cur.GopRefDist;
+
+    if (!bSize && !bFrameRate && !bBitRate && !bGop)
+        return RECONFIG_NONE;
+
+    if (bSize)
+    {
+        // only the size of the input frames changes it, and only without VPP (which scales them, field splitting included);
+        // the encoder can be reset to any size up to the one its surfaces were allocated for
+        if (mfx.FrameInfo.Width > m_EncAllocInfo.Width || mfx.FrameInfo.Height > m_EncAllocInfo.Height)
+            return RECONFIG_FULL;
+        return RECONFIG_NEW_SEQUENCE;
+    }
+
+    // the rules of cBRCParams::GetBRCResetType: within a sequence the frame rate stays
+    // and the bit rate changes only for VBR without HRD conformance
+    if (bFrameRate)
+        return RECONFIG_NEW_SEQUENCE;
+
+    if (bBitRate && (MFX_RATECONTROL_CBR == mfx.RateControlMethod || MFX_RATECONTROL_VBR == mfx.RateControlMethod))
+    {
+        bool bHRD = true;
+        for (size_t i = 0; i < m_EncExtParams.size(); i++)
+        {
+            if (m_EncExtParams[i] == (mfxExtBuffer *)&m_CodingOption)
+                bHRD = MFX_CODINGOPTION_OFF != m_CodingOption.NalHrdConformance;
+        }
+        if (bHRD || MFX_RATECONTROL_CBR == mfx.RateControlMethod)
+            return RECONFIG_NEW_SEQUENCE;
+    }
+
+    // GOP changes and other rate control methods are left to the encoder, a refused Reset falls back
+    return RECONFIG_RESET;
+}
+
+mfxStatus CEncodingPipeline::ApplyReconfig()
+{
+    sReconfigParams req;
+    {
+        AutoLock l(m_lock);
+        if (m_nFramesRead < m_nReconfigFrame)
+            return MFX_ERR_NONE;
+        req = m_Reconfig;
+        MSDK_ZERO_MEMORY(m_Reconfig);
+        m_bReconfigPending = false;
+    }
+
+    mfxStatus sts = MFX_ERR_NONE;
+    mfxVideoParam par = m_mfxEncParams;
+    mfxFrameInfo& info = par.mfx.FrameInfo;
+
+    // the rate fields count in units of BRCParamMultiplier kbps
+    const mfxU32 nMultiplier = (std::max)(par.mfx.BRCParamMultiplier, (mfxU16)1);
+    if (req.nBitRate && MFX_RATECONTROL_CQP != par.mfx.RateControlMethod && MFX_RATECONTROL_ICQ != par.mfx.RateControlMethod)
+        par.mfx.TargetKbps = (mfxU16)(std::min)((req.nBitRate + nMultiplier - 1) / nMultiplier, (mfxU32)0xFFFF);
+    if (req.nMaxKbps)
+        par.mfx.MaxKbps = (mfxU16)(std::min)((req.nMaxKbps + nMultiplier - 1) / nMultiplier, (mfxU32)0xFFFF);
+    if (req.nGopPicSize)
+        par.mfx.GopPicSize = req.nGopPicSize;
+    if (req.nGopRefDist)
+        par.mfx.GopRefDist = req.nGopRefDist;
+    if (req.dFrameRate > 0)
+    {
+        sts = ConvertFrameRate(req.dFrameRate, &info.FrameRateExtN, &info.FrameRateExtD);
+        MSDK_CHECK_STATUS(sts, "ConvertFrameRate failed");
+    }
+    if (req.nDstWidth && req.nDstHeight)
+    {
+        info.Width  = MSDK_ALIGN16(req.nDstWidth);
+        info.Height = (MFX_PICSTRUCT_PROGRESSIVE == info.PicStruct) ? MSDK_ALIGN16(req.nDstHeight) : MSDK_ALIGN32(req.nDstHeight);
+        info.CropX  = 0;
+        info.CropY  = 0;
+        info.CropW  = req.nDstWidth;
+        info.CropH  = req.nDstHeight;
+    }
+
+    eReconfigType type = ClassifyReconfig(par);
+    if (RECONFIG_NONE == type)
+        return MFX_ERR_NONE;
+
+    const bool bSize = info.CropW != m_mfxEncParams.mfx.FrameInfo.CropW || info.CropH != m_mfxEncParams.mfx.FrameInfo.CropH;
+
+    CTimer reconfigTimer;
+    reconfigTimer.Start();
+
+    // the frames given so far are encoded with the old parameters
+    sts = DrainEncoder();
+    MSDK_CHECK_STATUS(sts, "DrainEncoder failed");
+
+    if (bSize && m_ExtHEVCParam.PicWidthInLumaSamples)
+    {
+        m_ExtHEVCParam.PicWidthInLumaSamples = info.CropW;
+        m_ExtHEVCParam.PicHeightInLumaSamples = info.CropH;
+    }
+
+    if (RECONFIG_RESET == type || RECONFIG_NEW_SEQUENCE == type)
+    {
+        // the reset option goes with this call only
+        mfxExtEncoderResetOption resetOption;
+        MSDK_ZERO_MEMORY(resetOption);
+        resetOption.Header.BufferId = MFX_EXTBUFF_ENCODER_RESET_OPTION;
+        resetOption.Header.BufferSz = sizeof(resetOption);
+        resetOption.StartNewSequence = (RECONFIG_NEW_SEQUENCE == type) ? MFX_CODINGOPTION_ON : MFX_CODINGOPTION_OFF;
+
+        std::vector<mfxExtBuffer*> extParams(m_EncExtParams);
+        extParams.push_back(&resetOption.Header);
+        mfxVideoParam resetPar = par;
+        resetPar.ExtParam = &extParams[0];
+        resetPar.NumExtParam = (mfxU16)extParams.size();
+
+        sts = m_pmfxENC->Reset(&resetPar);
+        MSDK_IGNORE_MFX_STS(sts, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
+        if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts || MFX_ERR_INVALID_VIDEO_PARAM == sts)
+        {
+            msdk_printf(MSDK_STRING("Reset refused the new parameters, the encoder is initialized again\n"));
+            type = RECONFIG_REINIT;
+            sts = MFX_ERR_NONE;
+        }
+        MSDK_CHECK_STATUS(sts, "m_pmfxENC->Reset failed");
+    }
+
+    m_mfxEncParams.mfx = par.mfx;
+
+    if (RECONFIG_REINIT == type)
+    {
+        sts = m_pmfxENC->Close();
+        MSDK_IGNORE_MFX_STS(sts, MFX_ERR_NOT_INITIALIZED);
+        MSDK_CHECK_STATUS(sts, "m_pmfxENC->Close failed");
+
+        sts = m_pmfxENC->Init(&m_mfxEncParams);
+        MSDK_IGNORE_MFX_STS(sts, MFX_WRN_PARTIAL_ACCELERATION);
+        MSDK_CHECK_STATUS(sts, "m_pmfxENC->Init failed");
+    }
+    else if (RECONFIG_FULL == type)
+    {
+        // only the picture structure of the input parameters is used
+        sInputParams params = {};
+        params.nPicStruct = info.PicStruct;
+        sts = ResetMFXComponents(&params);
+        MSDK_CHECK_STATUS(sts, "ResetMFXComponents failed");
+    }
+
+    // the surfaces are reused as long as the new size fits, ResetMFXComponents does the rest itself
+    if (bSize && RECONFIG_FULL != type)
+    {
+        for (mfxU16 i = 0; i < m_EncResponse.NumFrameActual; i++)
+            m_pEncSurfaces[i].Info = m_mfxEncParams.mfx.FrameInfo;
+
+        sts = SetMuxStreamInfo();
+        MSDK_CHECK_STATUS(sts, "SetMuxStreamInfo failed");
+    }
+
+    // a new sequence counts display order from 0 again
+    if (RECONFIG_RESET != type)
+    {
+        m_nLookAheadOrder = 0;
+        m_nLastIDROrder = 0;
+    }
+
+    static const msdk_char* names[] = { MSDK_STRING("none"), MSDK_STRING("reset"), MSDK_STRING("new sequence"),
+                                        MSDK_STRING("reinit"), MSDK_STRING("full") };
+    const mfxF64 ms = reconfigTimer.GetTime() * 1000;
+    m_nReconfigs[type]++;
+    m_dReconfigTimeMs += ms;
+    m_dMaxReconfigTimeMs = (std::max)(m_dMaxReconfigTimeMs, ms);
+    msdk_printf(MSDK_STRING("Reconfiguration (%s): %ux%u, %u kbps, encoding stopped for %.2f ms, %.1f frames\n"),
+        names[type], info.CropW, info.CropH, m_mfxEncParams.mfx.TargetKbps * nMultiplier, ms, ms * GetFrameRate() / 1000);
+
+    return MFX_ERR_NONE;
+}
+
+mfxStatus CEncodingPipeline::DrainEncoder()
+{
+    mfxStatus sts = MFX_ERR_NONE;
+    sTask *pTask = NULL;
+
+    // frames buffered in VPP go to the encoder first
+    while (m_pmfxVPP && (MFX_ERR_NONE <= sts || MFX_ERR_MORE_SURFACE == sts))
+    {
+        mfxU16 nEncSurfIdx = GetFreeSurface(m_pEncSurfaces, m_EncResponse.NumFrameActual);
+        MSDK_CHECK_ERROR(nEncSurfIdx, MSDK_INVALID_SURF_IDX, MFX_ERR_MEMORY_ALLOC);
+
+        mfxSyncPoint VppSyncPoint = NULL;
+        for (;;)
+        {
+            sts = m_pmfxVPP->RunFrameVPPAsync(NULL, &m_pEncSurfaces[nEncSurfIdx], NULL, &VppSyncPoint);
+
+            if (MFX_ERR_NONE < sts && !VppSyncPoint) // repeat the call if warning and no output
+            {
+                if (MFX_WRN_DEVICE_BUSY == sts)
+                    MSDK_SLEEP(1); // wait if device is busy
+            }
+            else
+            {
+                if (MFX_ERR_NONE < sts)
+                    sts = MFX_ERR_NONE; // ignore warnings if output is available
+                break;
+            }
+        }
+
+        if (MFX_ERR_MORE_SURFACE == sts)
+            continue;
+        MSDK_BREAK_ON_ERROR(sts);
+
+        sts = GetFreeTask(&pTask);
+        MSDK_BREAK_ON_ERROR(sts);
+        pTask->DependentVppTasks.push_back(VppSyncPoint);
+
+        for (;;)
+        {
+            sts = m_pmfxENC->EncodeFrameAsync(NULL, &m_pEncSurfaces[nEncSurfIdx], &pTask->mfxBS, &pTask->EncSyncP);
+
+            if (MFX_ERR_NONE < sts && !pTask->EncSyncP) // repeat the call if warning and no output
+            {
+                if (MFX_WRN_DEVICE_BUSY == sts)
+                    MSDK_SLEEP(1); // wait if device is busy
+            }
+            else if (MFX_ERR_NONE < sts && pTask->EncSyncP)
+            {
+                sts = MFX_ERR_NONE; // ignore warnings if output is available
+                break;
+            }
+            else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts)
+            {
+                sts = AllocateSufficientBuffer(&pTask->mfxBS);
+                MSDK_CHECK_STATUS(sts, "AllocateSufficientBuffer failed");
+            }
+            else
+            {
+                break;
+            }
+        }
+        // MFX_ERR_MORE_DATA: the encoder buffers the frame, VPP may still have more
+        MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
+    }
+
+    // MFX_ERR_MORE_DATA: nothing is left in VPP
+    MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
+    MSDK_CHECK_STATUS(sts, "m_pmfxVPP->RunFrameVPPAsync failed");
+
+    while (MFX_ERR_NONE <= sts)
+    {
+        sts = GetFreeTask(&pTask);
+        MSDK_BREAK_ON_ERROR(sts);
+
+        for (;;)
+        {
+            sts = m_pmfxENC->EncodeFrameAsync(NULL, NULL, &pTask->mfxBS, &pTask->EncSyncP);
+
+            if (MFX_ERR_NONE < sts && !pTask->EncSyncP) // repeat the call if warning and no output
+            {
+                if (MFX_WRN_DEVICE_BUSY == sts)
+                    MSDK_SLEEP(1); // wait if device is busy
+            }
+            else if (MFX_ERR_NONE < sts && pTask->EncSyncP)
+            {
+                sts = MFX_ERR_NONE; // ignore warnings if output is available
+                break;
+            }
+            else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts)
+            {
+                sts = AllocateSufficientBuffer(&pTask->mfxBS);
+                MSDK_CHECK_STATUS(sts, "AllocateSufficientBuffer failed");
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    // MFX_ERR_MORE_DATA: nothing is left in the encoder
+    MSDK_IGNORE_MFX_STS(sts, MFX_ERR_MORE_DATA);
+    MSDK_CHECK_STATUS(sts, "m_pmfxENC->EncodeFrameAsync failed");
+
+    while (MFX_ERR_NONE == sts)
+    {
+        sts = m_TaskPool.SynchronizeFirstTask();
+    }
+    MSDK_IGNORE_MFX_STS(sts, MFX_ERR_NOT_FOUND);
+    MSDK_CHECK_STATUS(sts, "m_TaskPool.SynchronizeFirstTask failed");
+
+    return sts;
+}
+
+bool CEncodingPipeline::IsStaticFrame(frame_desc_t *pFrame)
+{
+    if (STATIC_FRAME_ENCODE == m_StaticFrameMode)
+        return false;
+
+    const mfxU32 lumaStride = pFrame->lumaStride ? (mfxU32)pFrame->lumaStride : pFrame->lumaWidth;
+    bool bStatic = !m_FrameDiff.Compare(pFrame->yuvBuf[0], pFrame->lumaWidth, pFrame->lumaHeight, lumaStride);
+
+    // a long still picture is encoded now and then, players joining late or losing data catch up
+    if (bStatic && m_nMaxStaticFrames && m_nStaticRun >= m_nMaxStaticFrames)
+        bStatic = false;
+
+    m_nStaticRun = bStatic ? m_nStaticRun + 1 : 0;
+    m_nStaticFrames += bStatic;
+    return bStatic;
+}
+
+mfxStatus CEncodingPipeline::InitShmRing(sInputParams *pParams)
+{
+    if (!*pParams->ShmRingName)
+        return MFX_ERR_NONE;
+
+    m_pShmRing = new CShmFrameRing;
+    MSDK_CHECK_POINTER(m_pShmRing, MFX_ERR_MEMORY_ALLOC);
+
+    // the producer may start after the encoder
+    mfxStatus sts = m_pShmRing->Open(pParams->ShmRingName, MSDK_SHM_OPEN_TIMEOUT);
+    MSDK_CHECK_STATUS(sts, "m_pShmRing->Open failed");
+
+    const msdkShmRingHeader *pHeader = m_pShmRing->GetHeader();
+    const mfxFrameInfo &info = m_pmfxVPP ? m_mfxVppParams.vpp.In : m_mfxEncParams.mfx.FrameInfo;
+    mfxU16 nWidth = info.CropW ? info.CropW : info.Width;
+    mfxU16 nHeight = info.CropH ? info.CropH : info.Height;
+    if (pHeader->Width != nWidth || pHeader->Height != nHeight ||
+        (MFX_FOURCC_NV12 != info.FourCC && MFX_FOURCC_YV12 != info.FourCC))
+    {
+        msdk_printf(MSDK_STRING("error: shared memory ring has %ux%u frames, input is %ux%u\n"),
+            pHeader->Width, pHeader->Height, nWidth, nHeight);
+        return MFX_ERR_INCOMPATIBLE_VIDEO_PARAM;
+    }
+
+    // frames are taken from the slots as they are, the steps run on queued input frames do not apply
+    if (m_LookAhead.GetDepth() || STATIC_FRAME_ENCODE != m_StaticFrameMode)
+    {
+        msdk_printf(MSDK_STRING("error: CPU look ahead and static frame detection are not supported with shared memory input\n"));
+        return MFX_ERR_UNSUPPORTED;
+    }
+
+    // system memory surfaces can point straight into the slots, the encoder reads the frame where the producer wrote it
+    m_bShmZeroCopy = !m_bExternalAlloc && !m_nMemBuffer &&
+        MFX_FOURCC_NV12 == pHeader->FourCC && MFX_FOURCC_NV12 == info.FourCC &&
+        pHeader->AlignedHeight >= info.Height && pHeader->Pitch <= 0xFFFF;
+
+    if (m_bShmZeroCopy)
+    {
+        // the producer needs a free slot while the encoder holds frames for reordering, look ahead and async depth
+        mfxVideoParam par;
+        MSDK_ZERO_MEMORY(par);
+        sts = m_pmfxENC->GetVideoParam(&par);
+        MSDK_CHECK_STATUS(sts, "m_pmfxENC->GetVideoParam failed");
+
+        mfxU32 nHeld = (std::max)(par.mfx.GopRefDist, (mfxU16)1) + par.AsyncDepth + m_CodingOption2.LookAheadDepth;
+        if (pHeader->NumSlots <= nHeld)
+        {
+            msdk_printf(MSDK_STRING("error: shared memory ring has %u slots, the encoder holds up to %u frames\n"),
+                pHeader->NumSlots, nHeld);
+            return MFX_ERR_NOT_ENOUGH_BUFFER;
+        }
+    }
+
+    msdk_printf(MSDK_STRING("Shared memory input\t%s, %u slots%s\n"), pParams->ShmRingName, pHeader->NumSlots,
+        m_bShmZeroCopy ? MSDK_STRING(", zero copy") : MSDK_STRING(""));
+
+    return MFX_ERR_NONE;
+}
+
+void CEncodingPipeline::ReleaseShmSlots(bool bAll)
+{
+    if (!m_pShmRing)
+        return;
+
+    for (size_t i = 0; i < m_ShmHeldSlots.size();)
+    {
+        if (bAll || !m_ShmHeldSlots[i].first->Data.Locked)
+        {
+            m_pShmRing->ReleaseReadSlot(m_ShmHeldSlots[i].second);
+            m_ShmHeldSlots.erase(m_ShmHeldSlots.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+mfxStatus CEncodingPipeline::LoadShmFrame(mfxFrameSurface1* pSurf)
+{
+    MSDK_CHECK_POINTER(pSurf, MFX_ERR_NULL_PTR);
+
+    // surfaces unlocked since the last frame give their slots back to the producer
+    ReleaseShmSlots(false);
+
+    msdkShmFrame frame;
+    mfxStatus sts = m_pShmRing->AcquireReadSlot(&frame, MSDK_SHM_WAIT_INTERVAL);
+    if (MFX_ERR_MORE_DATA == sts)
+    {
+        // the producer finished, remaining frames are drained like on timeout
+        m_bTimeOutExceed = m_pShmRing->IsEndOfStream();
+        return sts;
+    }
+    MSDK_CHECK_STATUS(sts, "m_pShmRing->AcquireReadSlot failed");
+
+    mfxFrameInfo& info = pSurf->Info;
+    mfxFrameData& data = pSurf->Data;
+
+    if (m_bShmZeroCopy)
+    {
+        // the slot stays with the surface until the components release it
+        data.Y = frame.Y;
+        data.UV = frame.U;
+        data.V = frame.U + 1;
+        data.Pitch = (mfxU16)frame.Pitch;
+        m_ShmHeldSlots.push_back(std::make_pair(pSurf, frame.Seq));
+    }
+    else
+    {
+        if (m_bExternalAlloc)
+        {
+            sts = m_pMFXAllocator->Lock(m_pMFXAllocator->pthis, data.MemId, &data);
+            MSDK_CHECK_STATUS(sts, "m_pMFXAllocator->Lock failed");
+        }
+
+        const msdkShmRingHeader *pHeader = m_pShmRing->GetHeader();
+        mfxU32 w = pHeader->Width, h = pHeader->Height;
+        mfxU32 pitch = data.Pitch;
+        mfxU8 *ptr = data.Y + info.CropX + info.CropY * pitch;
+        for (mfxU32 i = 0; i < h; i++)
+            memcpy(ptr + i * pitch, frame.Y + i * frame.Pitch, w);
+
+        if (MFX_FOURCC_NV12 == info.FourCC)
+        {
+            ptr = data.UV + info.CropX + (info.CropY / 2) * pitch;
+            for (mfxU32 i = 0; i < h / 2; i++)
+            {
+                mfxU8 *pDst = ptr + i * pitch;
+                if (MFX_FOURCC_NV12 == pHeader->FourCC)
+                {
+                    memcpy(pDst, frame.U + i * frame.Pitch, w);
+                }
+                else
+                {
+                    const mfxU8 *pU = frame.U + i * frame.Pitch / 2;
+                    const mfxU8 *pV = frame.V + i * frame.Pitch / 2;
+                    for (mfxU32 j = 0; j < w / 2; j++)
+                    {
+                        pDst[2 * j] = pU[j];
+                        pDst[2 * j + 1] = pV[j];
+                    }
+                }
+            }
+        }
+        else // YV12 surface, V plane first
+        {
+            mfxU32 chromaPitch = pitch / 2;
+            for (mfxU32 i = 0; i < h / 2; i++)
+            {
+                mfxU8 *pU = data.U + info.CropX / 2 + (info.CropY / 2 + i) * chromaPitch;
+                mfxU8 *pV = data.V + info.CropX / 2 + (info.CropY / 2 + i) * chromaPitch;
+                if (MFX_FOURCC_NV12 == pHeader->FourCC)
+                {
+                    const mfxU8 *pUV = frame.U + i * frame.Pitch;
+                    for (mfxU32 j = 0; j < w / 2; j++)
+                    {
+                        pU[j] = pUV[2 * j];
+                        pV[j] = pUV[2 * j + 1];
+                    }
+                }
+                else
+                {
+                    memcpy(pU, frame.U + i * frame.Pitch / 2, w / 2);
+                    memcpy(pV, frame.V + i * frame.Pitch / 2, w / 2);
+                }
+            }
+        }
+
+        if (m_bExternalAlloc)
+        {
+            sts = m_pMFXAllocator->Unlock(m_pMFXAllocator->pthis, data.MemId, &data);
+            MSDK_CHECK_STATUS(sts, "m_pMFXAllocator->Unlock failed");
+        }
+
+        sts = m_pShmRing->ReleaseReadSlot(frame.Seq);
+        MSDK_CHECK_STATUS(sts, "m_pShmRing->ReleaseReadSlot failed");
+    }
+
+    // producer time stamps are kept, when muxing frames without one are spaced by the frame rate
+    const mfxFrameInfo& encInfo = m_mfxEncParams.mfx.FrameInfo;
+    if ((mfxU64)MFX_TIMESTAMP_UNKNOWN != frame.TimeStamp || !m_pMuxWriter)
+        data.TimeStamp = frame.TimeStamp;
+    else
+        data.TimeStamp = encInfo.FrameRateExtN ? (mfxU64)m_nFramesRead * 90000 * encInfo.FrameRateExtD / encInfo.FrameRateExtN : 0;
+    data.FrameOrder = m_nFramesRead;
+    m_nFramesRead++;
+
+    return MFX_ERR_NONE;
+}
+
 mfxStatus CEncodingPipeline::GetBitstreams(mfxBitstream* &pBitstream)
 {
 	return (m_FileWriters.first)->GetBitstream(pBitstream);
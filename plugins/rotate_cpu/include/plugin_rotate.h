@@ -26,6 +26,7 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include "mfx_plugin_base.h"
 #include "rotate_plugin_api.h"
 #include "sample_defs.h"
+#include "vm/task_pool_defs.h"
 
 typedef struct {
     mfxU32 StartLine;
@@ -39,6 +40,10 @@ public:
     virtual ~Processor();
     virtual mfxStatus SetAllocator(mfxFrameAllocator *pAlloc);
     virtual mfxStatus Init(mfxFrameSurface1 *frame_in, mfxFrameSurface1 *frame_out);
+    // maps both frames around the processing of all chunks
+    virtual mfxStatus Lock();
+    virtual mfxStatus Unlock();
+    // chunks of a frame are processed concurrently, each writes its own lines only
     virtual mfxStatus Process(DataChunk *chunk) = 0;
 
 protected:
@@ -50,9 +55,6 @@ protected:
     mfxFrameSurface1  *m_pOut;
     mfxFrameAllocator *m_pAlloc;
 
-    std::vector<mfxU8> m_YIn, m_UVIn;
-    std::vector<mfxU8> m_YOut, m_UVOut;
-
     mfxHDL             m_uid;
 
 };
@@ -24,6 +24,8 @@ or https://software.intel.com/en-us/media-client-solutions-support.
 #include <map>
 #include <tuple>
 #include <mutex>
+#include <vector>
+#include <algorithm>
 #include "plugin_rotate.h"
 
 // disable "unreferenced formal parameter" warning -
@@ -168,25 +170,32 @@ mfxStatus Rotate::Execute(mfxThreadTask task, mfxU32 uid_p, mfxU32 uid_a)
 {
     MSDK_CHECK_ERROR(m_bInited, false, MFX_ERR_NOT_INITIALIZED);
 
-    mfxStatus sts = MFX_ERR_NONE;
     RotateTask *current_task = (RotateTask *)task;
+    Processor *pProcessor = current_task->pProcessor;
+
+    // the SDK calls once per task (MaxThreadNum is 1), the chunks run on the module's shared pool
+    mfxStatus sts = pProcessor->Lock();
+    MSDK_CHECK_STATUS(sts, "pProcessor->Lock failed");
 
-    // 0,...,NumChunks - 2 calls return TASK_WORKING, NumChunks - 1,.. return TASK_DONE
-    if (uid_a < m_NumChunks)
+    std::vector<mfxStatus> chunk_sts(m_NumChunks, MFX_ERR_NONE);
     {
-        // there's data to process
-        sts = current_task->pProcessor->Process(&m_pChunks[uid_a]);
-        MSDK_CHECK_STATUS(sts, "current_task->pProcessor->Process failed");
-        // last call?
-        sts = ((m_NumChunks - 1) == uid_a) ? MFX_TASK_DONE : MFX_TASK_WORKING;
+        MSDKTaskGroup group;
+        for (mfxU32 i = 1; i < m_NumChunks; i++)
+        {
+            group.Run([this, pProcessor, &chunk_sts, i]() { chunk_sts[i] = pProcessor->Process(&m_pChunks[i]); });
+        }
+        chunk_sts[0] = pProcessor->Process(&m_pChunks[0]);
+        group.Wait();
     }
-    else
+
+    sts = pProcessor->Unlock();
+    for (mfxU32 i = 0; i < m_NumChunks; i++)
     {
-        // no data to process
-        sts =  MFX_TASK_DONE;
+        MSDK_CHECK_STATUS(chunk_sts[i], "pProcessor->Process failed");
     }
+    MSDK_CHECK_STATUS(sts, "pProcessor->Unlock failed");
 
-    return sts;
+    return MFX_TASK_DONE;
 }
 
 mfxStatus Rotate::FreeResources(mfxThreadTask task, mfxStatus sts)
@@ -247,7 +256,9 @@ mfxStatus Rotate::Init(mfxVideoParam *mfxParam)
     MSDK_CHECK_POINTER(m_pTasks, MFX_ERR_MEMORY_ALLOC);
     memset(m_pTasks, 0, sizeof(RotateTask) * m_MaxNumTasks);
 
-    m_NumChunks = m_PluginParam.MaxThreadNum;
+    // a chunk per pool worker, stealing evens them out; all plugin instances of the
+    // module share the pool, so several of them don't oversubscribe the CPUs
+    m_NumChunks = (std::min)(MSDKTaskPool::GetInstance().GetWorkerCount(), (mfxU32)MSDK_MAX(mfxParam->vpp.In.CropH, 1));
     m_pChunks = new DataChunk [m_NumChunks];
     MSDK_CHECK_POINTER(m_pChunks, MFX_ERR_MEMORY_ALLOC);
     memset(m_pChunks, 0, sizeof(DataChunk) * m_NumChunks);
@@ -415,6 +426,24 @@ mfxStatus Processor::Init(mfxFrameSurface1 *frame_in, mfxFrameSurface1 *frame_ou
     return MFX_ERR_NONE;
 }
 
+mfxStatus Processor::Lock()
+{
+    mfxStatus sts = LockFrame(m_pIn);
+    if (MFX_ERR_NONE != sts) return sts;
+
+    sts = LockFrame(m_pOut);
+    if (MFX_ERR_NONE != sts)
+        UnlockFrame(m_pIn);
+    return sts;
+}
+
+mfxStatus Processor::Unlock()
+{
+    mfxStatus sts = UnlockFrame(m_pIn);
+    mfxStatus sts_out = UnlockFrame(m_pOut);
+    return (MFX_ERR_NONE != sts) ? sts : sts_out;
+}
+
 mfxStatus Processor::LockFrame(mfxFrameSurface1 *frame)
 {
     MSDK_CHECK_POINTER(m_pAlloc, MFX_ERR_NULL_PTR);
@@ -494,14 +523,6 @@ mfxStatus Rotator180::Process(DataChunk *chunk)
 {
     MSDK_CHECK_POINTER(chunk, MFX_ERR_NULL_PTR);
 
-    mfxStatus sts = MFX_ERR_NONE;
-    if (MFX_ERR_NONE != (sts = LockFrame(m_pIn)))return sts;
-    if (MFX_ERR_NONE != (sts = LockFrame(m_pOut)))
-    {
-        UnlockFrame(m_pIn);
-        return sts;
-    }
-
     mfxU32 i, j, in_pitch, out_pitch, h, w;
 
     in_pitch = m_pIn->Data.Pitch;
@@ -509,18 +530,14 @@ mfxStatus Rotator180::Process(DataChunk *chunk)
     h = m_pIn->Info.CropH;
     w = m_pIn->Info.CropW;
 
-    m_YIn.assign(m_pIn->Data.Y, m_pIn->Data.Y + h * in_pitch);
-    m_UVIn.assign(m_pIn->Data.UV, m_pIn->Data.UV + h * in_pitch / 2);
+    // frames are locked by the caller, lines go straight from one to the other
+    mfxU8 *in_luma = m_pIn->Data.Y + m_pIn->Info.CropY * in_pitch + m_pIn->Info.CropX;
+    mfxU8 *out_luma = m_pOut->Data.Y + m_pOut->Info.CropY * out_pitch + m_pOut->Info.CropX;
 
-    m_YOut.resize(m_pOut->Info.Height * out_pitch);
-    m_UVOut.resize(m_pOut->Info.Height * out_pitch / 2);
-
-    mfxU8 *in_luma = &m_YIn.front() + m_pIn->Info.CropY * in_pitch + m_pIn->Info.CropX;
-    mfxU8 *out_luma = &m_YOut.front() + m_pOut->Info.CropY * out_pitch + m_pOut->Info.CropX;
-
-    mfxU8 *in_chroma = &m_UVIn.front() + m_pIn->Info.CropY / 2 * in_pitch + m_pIn->Info.CropX;
-    mfxU8 *out_chroma = &m_UVOut.front() + m_pOut->Info.CropY / 2 * out_pitch + m_pOut->Info.CropX;
+    mfxU8 *in_chroma = m_pIn->Data.UV + m_pIn->Info.CropY / 2 * in_pitch + m_pIn->Info.CropX;
+    mfxU8 *out_chroma = m_pOut->Data.UV + m_pOut->Info.CropY / 2 * out_pitch + m_pOut->Info.CropX;
 
+    mfxU8 *in_line = 0;  // current line in the source image
     mfxU8 *cur_line = 0; // current line in the destination image
 
     switch (m_pIn->Info.FourCC)
@@ -528,29 +545,25 @@ mfxStatus Rotator180::Process(DataChunk *chunk)
     case MFX_FOURCC_NV12:
           for (i = chunk->StartLine; i <= chunk->EndLine; i++)
           {
-              // rotate Y plane
+              // rotate Y plane: i-th line mirrored into h-1-i-th line, element=Yj
+              in_line = in_luma + i * in_pitch;
               cur_line = out_luma + (h-1-i) * out_pitch;
-
-              // i-th line images into h-1-i-th line, w bytes in line
-              MSDK_MEMCPY_BUF(cur_line, 0, w,  in_luma + i * in_pitch, w);
-
-              // mirror line's elements with respect to the middle element, element=Yj
-              for (j = 0; j < w / 2; j++)
+              for (j = 0; j < w; j++)
               {
-                  SWAP_BYTES(cur_line[j], cur_line[w-1-j]);
+                  cur_line[j] = in_line[w-1-j];
               }
 
-              // rotate VU plane, contains h/2 lines
-              cur_line = out_chroma + (h/2-1-i/2) * out_pitch;
-
-              // i-th line images into h-1-i-th line, w bytes in line
-              MSDK_MEMCPY_BUF(cur_line, 0, w, in_chroma + i/2 * in_pitch, w);
+              // rotate VU plane, contains h/2 lines, each handled by the chunk with its even luma line
+              if (i & 1)
+                  continue;
 
-              // mirror line's elements with respect to the middle element, element=VjUj
-              for (j = 0; j < w/2 - 1; j = j + 2)
+              in_line = in_chroma + i/2 * in_pitch;
+              cur_line = out_chroma + (h/2-1-i/2) * out_pitch;
+              // mirrored by elements, element=VjUj
+              for (j = 0; j + 1 < w; j = j + 2)
               {
-                  SWAP_BYTES(cur_line[j], cur_line[w-1-j-1]); // 0 -> -1
-                  SWAP_BYTES(cur_line[j+1], cur_line[w-1-j]); // 1 -> -0
+                  cur_line[j] = in_line[w-2-j];
+                  cur_line[j+1] = in_line[w-1-j];
               }
           }
           break;
@@ -558,15 +571,5 @@ mfxStatus Rotator180::Process(DataChunk *chunk)
         return MFX_ERR_UNSUPPORTED;
     }
 
-    // copy data from temporary buffer to output surface
-    MSDK_MEMCPY_BUF(m_pOut->Data.Y, chunk->StartLine * out_pitch, m_YOut.size(), &m_YOut.front(), m_YOut.size());
-    MSDK_MEMCPY_BUF(m_pOut->Data.UV, chunk->StartLine * out_pitch, m_UVOut.size(), &m_UVOut.front(), m_UVOut.size());
-
-    sts = UnlockFrame(m_pIn);
-    MSDK_CHECK_STATUS(sts, "UnlockFrame(m_pIn) failed");
-    sts = UnlockFrame(m_pOut);
-    MSDK_CHECK_STATUS(sts, "UnlockFrame(m_pOut) failed");
-
-
-    return sts;
+    return MFX_ERR_NONE;
 }